@@ -1,9 +1,17 @@
 #pragma once
 
 #include "application.h"
+#include "benchmark.h"
 #include "statistics.h"
+#include "tiledhatching.h"
 
-#include <glm\gtx\string_cast.hpp>
+#include <glm/gtx/string_cast.hpp>
+
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
 
 namespace Copperplate {
 
@@ -11,33 +19,502 @@ namespace Copperplate {
 	bool Application::ShouldClose = false;
 	Shared<Window> Application::m_Window;
 	Unique<Scene> Application::m_Scene;
+	Unique<Benchmark> Application::m_Benchmark;
+	LaunchSettings Application::m_Settings;
+	SceneDescription Application::m_Description;
+	AnimationPath Application::m_Animation;
+
+	// Only flags are set from the signal handler, the main loop acts on them between frames
+	volatile std::sig_atomic_t QuitRequested = 0;
+	volatile std::sig_atomic_t DumpRequested = 0;
+
+	void handleSignal(int signal) {
+		if (signal == SIGINT || signal == SIGTERM)
+			QuitRequested = 1;
+		else
+			DumpRequested = 1;
+	}
+
+	bool LaunchSettings::Parse(int argc, char* argv[], LaunchSettings& outSettings) {
+		LaunchSettings settings;
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			bool hasValue = (i + 1 < argc);
+			if (arg == "--headless") {
+				settings.m_Headless = true;
+			}
+			else if (arg == "--scene" && hasValue) {
+				settings.m_SceneFile = argv[++i];
+			}
+			else if ((arg == "--animation" || arg == "--camera-path") && hasValue) {
+				settings.m_AnimationFile = argv[++i];
+			}
+			else if (arg == "--frames" && hasValue) {
+				settings.m_FrameCount = std::atoi(argv[++i]);
+			}
+			else if (arg == "--output" && hasValue) {
+				settings.m_OutputDir = argv[++i];
+			}
+			else if (arg == "--video" && hasValue) {
+				settings.m_VideoFile = argv[++i];
+			}
+			else if (arg == "--fps" && hasValue) {
+				settings.m_VideoFps = std::atoi(argv[++i]);
+			}
+			else if (arg == "--vector" && hasValue) {
+				settings.m_VectorFile = argv[++i];
+			}
+			else if (arg == "--simplify" && hasValue) {
+				settings.m_SimplifyTolerance = (float)std::atof(argv[++i]);
+			}
+			else if (arg == "--strokes" && hasValue) {
+				settings.m_StrokeFile = argv[++i];
+			}
+			else if (arg == "--keyframes" && hasValue) {
+				settings.m_StrokeKeyframes = std::atoi(argv[++i]);
+			}
+			else if (arg == "--writer-threads" && hasValue) {
+				settings.m_WriterThreads = std::atoi(argv[++i]);
+			}
+			else if (arg == "--tiled" && hasValue) {
+				settings.m_TiledOutput = argv[++i];
+			}
+			else if (arg == "--tile" && hasValue) {
+				settings.m_TileSize = std::atoi(argv[++i]);
+			}
+			else if (arg == "--guard" && hasValue) {
+				settings.m_GuardBand = std::atoi(argv[++i]);
+			}
+			else if (arg == "--tile-iterations" && hasValue) {
+				settings.m_TileIterations = std::atoi(argv[++i]);
+			}
+			else if (arg == "--seed" && hasValue) {
+				settings.m_RandomSeed = std::atoi(argv[++i]);
+			}
+			else if (arg == "--mesh-cache" && hasValue) {
+				settings.m_MeshCacheDir = argv[++i];
+			}
+			else if (arg == "--no-mesh-cache") {
+				settings.m_MeshCacheDir = "";
+			}
+			else if (arg == "--loader-threads" && hasValue) {
+				settings.m_LoaderThreads = std::atoi(argv[++i]);
+			}
+			else if (arg == "--lod-error" && hasValue) {
+				settings.m_LodPixelError = std::atof(argv[++i]);
+			}
+			else if (arg == "--trace" && hasValue) {
+				settings.m_TraceFile = argv[++i];
+			}
+			else if (arg == "--histograms" && hasValue) {
+				settings.m_HistogramFile = argv[++i];
+			}
+			else if (arg == "--perf-counters") {
+				settings.m_PerfCounters = true;
+			}
+			else if (arg == "--compare" && i + 2 < argc) {
+				settings.m_CompareBase = argv[++i];
+				settings.m_CompareNew = argv[++i];
+			}
+			else if (arg == "--tolerance" && hasValue) {
+				settings.m_Tolerance = (float)std::atof(argv[++i]);
+			}
+			else if (arg == "--capture" && hasValue) {
+				settings.m_CaptureFile = argv[++i];
+			}
+			else if (arg == "--hud") {
+				settings.m_ShowHud = true;
+			}
+			else if (arg == "--heatmaps" && hasValue) {
+				settings.m_HeatmapDir = argv[++i];
+			}
+			else if (arg == "--benchmark" && hasValue) {
+				settings.m_BenchmarkOutput = argv[++i];
+			}
+			else if (arg == "--warmup" && hasValue) {
+				settings.m_WarmupFrames = std::atoi(argv[++i]);
+			}
+			else if (arg == "--runs" && hasValue) {
+				settings.m_BenchmarkRuns = std::atoi(argv[++i]);
+			}
+			else if (arg == "--alloc-limit" && hasValue) {
+				settings.m_AllocationLimit = std::atoi(argv[++i]);
+			}
+			else if (arg == "--size" && hasValue) {
+				std::string size = argv[++i];
+				size_t separator = size.find('x');
+				if (separator == std::string::npos) {
+					std::cout << "Invalid size " << size << ", expected <width>x<height>" << std::endl;
+					return false;
+				}
+				settings.m_Width = std::atoi(size.substr(0, separator).c_str());
+				settings.m_Height = std::atoi(size.substr(separator + 1).c_str());
+			}
+			else {
+				std::cout << "Unknown or incomplete argument " << arg << std::endl;
+				return false;
+			}
+		}
+
+		if (!settings.m_CompareBase.empty()) {
+			outSettings = settings;
+			return true;
+		}
+
+		if (settings.m_Width <= 0 || settings.m_Height <= 0) {
+			std::cout << "Viewport size has to be positive" << std::endl;
+			return false;
+		}
+		if (settings.m_VideoFps <= 0) {
+			std::cout << "Video frame rate has to be positive" << std::endl;
+			return false;
+		}
+		if (!settings.m_TiledOutput.empty()) {
+			if (!settings.m_Headless) {
+				std::cout << "Tiled rendering needs --headless" << std::endl;
+				return false;
+			}
+			if (settings.m_TileSize <= 0 || settings.m_GuardBand < 0 || settings.m_TileIterations <= 0) {
+				std::cout << "Tiled rendering needs a positive tile size and iteration count" << std::endl;
+				return false;
+			}
+			if (!settings.m_BenchmarkOutput.empty() || !settings.m_OutputDir.empty() || !settings.m_VideoFile.empty()
+				|| !settings.m_VectorFile.empty() || !settings.m_StrokeFile.empty() || !settings.m_CaptureFile.empty() || !settings.m_HeatmapDir.empty()) {
+				std::cout << "Tiled rendering only writes the tiled image" << std::endl;
+				return false;
+			}
+			// the frame count is given by the tiles
+			settings.m_FrameCount = 0;
+		}
+		else if (settings.m_Headless && settings.m_FrameCount <= 0) {
+			std::cout << "Headless mode needs a frame count" << std::endl;
+			return false;
+		}
+		if (!settings.m_BenchmarkOutput.empty()) {
+			if (settings.m_FrameCount <= settings.m_WarmupFrames || settings.m_WarmupFrames < 0) {
+				std::cout << "Benchmark mode needs more frames than warm-up frames" << std::endl;
+				return false;
+			}
+			if (settings.m_BenchmarkRuns <= 0) {
+				std::cout << "Benchmark mode needs at least one run" << std::endl;
+				return false;
+			}
+			if (!settings.m_CaptureFile.empty()) {
+				std::cout << "Capturing is not possible in benchmark mode" << std::endl;
+				return false;
+			}
+			if (!settings.m_HeatmapDir.empty()) {
+				std::cout << "Heatmaps are not possible in benchmark mode" << std::endl;
+				return false;
+			}
+			if (!settings.m_OutputDir.empty() || !settings.m_VideoFile.empty() || !settings.m_VectorFile.empty() || !settings.m_StrokeFile.empty()) {
+				std::cout << "Saving frames is not possible in benchmark mode" << std::endl;
+				return false;
+			}
+		}
+		if (settings.m_AllocationLimit >= 0) {
+#ifndef COPPERPLATE_ALLOC_TRACKING
+			std::cout << "Allocation limits need a build with COPPERPLATE_ALLOC_TRACKING" << std::endl;
+			return false;
+#endif
+			if (settings.m_BenchmarkOutput.empty()) {
+				std::cout << "Allocation limits only apply to benchmark mode" << std::endl;
+				return false;
+			}
+		}
+
+		outSettings = settings;
+		return true;
+	}
+
+	void LaunchSettings::PrintUsage() {
+		std::cout << "Usage: Copperplate [options]" << std::endl
+			<< "  --headless             render offscreen without a window (EGL)" << std::endl
+			<< "  --scene <file>         scene description json" << std::endl
+			<< "  --animation <file>     camera and object keyframes json" << std::endl
+			<< "  --camera-path <file>   same as --animation" << std::endl
+			<< "  --frames <count>       number of frames to render before exiting" << std::endl
+			<< "  --output <dir>         save every rendered frame as png into dir" << std::endl
+			<< "  --video <file>         append every frame to an uncompressed stream, .y4m or raw rgb24 otherwise" << std::endl
+			<< "  --fps <n>              frame rate stored in the y4m header, default 30" << std::endl
+			<< "  --writer-threads <n>   threads encoding saved frames, default half the cores" << std::endl
+			<< "  --vector <file>        write the lines and contours of every frame as .svg, .eps (a file per frame) or .pdf (a page per frame)" << std::endl
+			<< "  --simplify <px>        drop points of exported lines that are closer than px to the simplified line" << std::endl
+			<< "  --strokes <file>       archive the lines of every frame as a stroke stream for CopperplatePlayer" << std::endl
+			<< "  --keyframes <n>        frames between the keyframes of the stroke stream, default 120" << std::endl
+			<< "  --size <w>x<h>         viewport size, default 2400x1050" << std::endl
+			<< "  --tiled <file>         render the --size image tile by tile into a ppm file, needs --headless" << std::endl
+			<< "  --tile <n>             edge length of the tiles, default 1024" << std::endl
+			<< "  --guard <n>            pixels every tile is rendered and hatched beyond its borders, default 64" << std::endl
+			<< "  --tile-iterations <n>  hatching updates per tile, default 30" << std::endl
+			<< "  --seed <n>             fixed seed for all random generators" << std::endl
+			<< "  --mesh-cache <dir>     where imported meshes and their seeds are baked for faster starts, default cache/" << std::endl
+			<< "  --no-mesh-cache        always import the meshes through assimp" << std::endl
+			<< "  --loader-threads <n>   threads importing and seeding the meshes, default all cores but one" << std::endl
+			<< "  --lod-error <px>       error of the simplified meshes on screen, default 0.5, 0 keeps the full resolution" << std::endl
+			<< "  --trace <file>         write the timed scopes of every frame as chrome trace json" << std::endl
+			<< "  --histograms <file>    write p50/p95/p99/max of every stage over the session on exit and on SIGUSR1" << std::endl
+			<< "  --perf-counters        count cycles, instructions and cache/branch misses per stage (Linux)" << std::endl
+			<< "  --compare <base> <new> flag stages that got slower between two histogram dumps and exit" << std::endl
+			<< "  --tolerance <f>        relative slowdown --compare accepts, default 0.1" << std::endl
+			<< "  --capture <file>       record the hatching inputs of every frame for CopperplateReplay" << std::endl
+			<< "  --hud                  show the performance overlay from the start, toggle it with H" << std::endl
+			<< "  --heatmaps <dir>       save where the hatching spent its work in every frame as png into dir" << std::endl
+			<< "  --benchmark <base>     run the animation with vsync off and write timings to base.csv and base.json" << std::endl
+			<< "  --warmup <n>           benchmark frames left out of the summary, default 10" << std::endl
+			<< "  --runs <n>             number of benchmark runs, default 3" << std::endl
+			<< "  --alloc-limit <n>      fail the benchmark if a measured frame allocates more than n times" << std::endl;
+	}
+
+	bool Application::Init(const LaunchSettings& settings) {
+		m_Settings = settings;
+		if (!settings.m_TraceFile.empty() && !Statistics::Get().startTrace(settings.m_TraceFile))
+			return false;
+		if (settings.m_PerfCounters)
+			Statistics::Get().enablePerfCounters();
+		std::signal(SIGINT, handleSignal);
+		std::signal(SIGTERM, handleSignal);
+#ifdef SIGUSR1
+		std::signal(SIGUSR1, handleSignal);
+#elif defined(SIGBREAK)
+		std::signal(SIGBREAK, handleSignal);
+#endif
 
-	void Application::Init() {
-		m_Window = CreateShared<Window>();
-		m_Scene = CreateUnique<Scene>(m_Window);
+		SceneDescription description = SceneDescription::CreateDefault();
+		if (!settings.m_SceneFile.empty() && !SceneDescription::Load(settings.m_SceneFile, description))
+			return false;
+		if (!settings.m_AnimationFile.empty() && !m_Animation.Load(settings.m_AnimationFile))
+			return false;
+		if (settings.m_RandomSeed >= 0)
+			description.m_RandomSeed = settings.m_RandomSeed;
+		// benchmark runs always have to be reproducible
+		if (!settings.m_BenchmarkOutput.empty() && description.m_RandomSeed < 0)
+			description.m_RandomSeed = 0;
+		m_Description = description;
+		for (const std::string& dir : { settings.m_OutputDir, settings.m_HeatmapDir }) {
+			if (dir.empty())
+				continue;
+			std::error_code error;
+			std::filesystem::create_directories(dir, error);
+			if (error) {
+				std::cout << "Could not create output directory " << dir << ": " << error.message() << std::endl;
+				return false;
+			}
+		}
+
+		// tiled renders only need a framebuffer of one tile and its guard band
+		glm::ivec2 windowSize = glm::ivec2(settings.m_Width, settings.m_Height);
+		if (!settings.m_TiledOutput.empty())
+			windowSize = TiledHatching(windowSize, settings.m_TileSize, settings.m_GuardBand).GetWindowSize();
+		m_Window = CreateShared<Window>(settings.m_Headless, windowSize.x, windowSize.y);
+		if (!m_Window->IsValid())
+			return false;
+		DisplaySettings::RecordThreads = settings.m_WriterThreads;
+		MeshCreator::CacheDirectory = settings.m_MeshCacheDir;
+		MeshLibrary::LoaderThreads = settings.m_LoaderThreads;
+		DisplaySettings::LodPixelError = settings.m_LodPixelError;
+		m_Scene = CreateUnique<Scene>(m_Window, description);
+		// interactive sessions show the scene while it fills up, scripted runs start from the complete scene
+		// so their frames are reproducible. Captures, stroke streams and vector exports also need every
+		// object from the start, they record the seeds and objects they find when they are opened.
+		if (settings.m_Headless || settings.m_FrameCount >= 0 || !settings.m_CaptureFile.empty()
+			|| !settings.m_StrokeFile.empty() || !settings.m_VectorFile.empty())
+			m_Scene->FinishLoading();
+		if (!settings.m_VideoFile.empty() && !m_Scene->StartVideo(settings.m_VideoFile, settings.m_VideoFps))
+			return false;
+		if (!settings.m_VectorFile.empty() && !m_Scene->StartVectorExport(settings.m_VectorFile, settings.m_SimplifyTolerance))
+			return false;
+		if (!settings.m_StrokeFile.empty() && !m_Scene->StartStrokeStream(settings.m_StrokeFile, settings.m_StrokeKeyframes))
+			return false;
+		if (!settings.m_CaptureFile.empty() && !m_Scene->StartCapture(settings.m_CaptureFile))
+			return false;
+		if (!settings.m_HeatmapDir.empty())
+			m_Scene->EnableCostRecording();
+		DisplaySettings::RenderHud = settings.m_ShowHud;
+
+		// animations advance one keyframe step per rendered frame, so exports do not need to wait for the display
+		if (!settings.m_OutputDir.empty() || !settings.m_VideoFile.empty() || !settings.m_VectorFile.empty() || !settings.m_StrokeFile.empty())
+			m_Window->SetVSync(false);
+		if (!settings.m_BenchmarkOutput.empty()) {
+			m_Window->SetVSync(false);
+			m_Benchmark = CreateUnique<Benchmark>(settings.m_BenchmarkOutput, settings.m_WarmupFrames, settings.m_AllocationLimit);
+		}
 
 		glClearColor(0.89f, 0.87f, 0.53f, 1.0f);
 		glEnable(GL_DEPTH_TEST);
 		
 		ShouldClose = false;
+		return true;
 	}
 
-	void Application::Run() {
-		while (!ShouldClose) {
-			Statistics::Get().newFrame();
-			// Poll and handle Input
-			glfwPollEvents();
+	bool Application::Run() {
+		if (m_Benchmark) {
+			bool success = RunBenchmark();
+			Statistics::Get().stopTrace();
+			DumpStatistics();
+			return success;
+		}
 
-			m_Scene->Update();
+		if (!m_Settings.m_TiledOutput.empty()) {
+			bool success = RunTiled();
+			Statistics::Get().stopTrace();
+			DumpStatistics();
+			return success;
+		}
 
-			//Render
-			glEnable(GL_DEPTH_TEST);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		int frame = 0;
+		while (!ShouldClose) {
+			// the first frame only covers the setup
+			Statistics::Get().newFrame(frame > 0);
+			// Poll and handle Input
+			m_Window->PollEvents();
+			PollSignals();
 
-			m_Scene->Draw();
+			RenderFrame(frame);
 						
 			m_Window->SwapBuffers();
+
+			frame++;
+			if (m_Settings.m_FrameCount >= 0 && frame >= m_Settings.m_FrameCount)
+				ShouldClose = true;
+		}
+		m_Scene->FinishSaving();
+		Statistics::Get().newFrame();
+		Statistics::Get().stopTrace();
+		DumpStatistics();
+		return true;
+	}
+
+	bool Application::RunBenchmark() {
+		for (int run = 0; run < m_Settings.m_BenchmarkRuns && !ShouldClose; run++) {
+			// every run starts from a freshly built scene so all runs do the same work
+			if (run > 0) {
+				m_Scene = CreateUnique<Scene>(m_Window, m_Description);
+				m_Scene->FinishLoading();
+			}
+			std::cout << "Benchmark run " << run + 1 << " of " << m_Settings.m_BenchmarkRuns << std::endl;
+
+			m_Benchmark->BeginRun();
+			Statistics::Get().newFrame(false);
+			for (int frame = 0; frame < m_Settings.m_FrameCount && !ShouldClose; frame++) {
+				auto start = std::chrono::steady_clock::now();
+				m_Window->PollEvents();
+				PollSignals();
+
+				RenderFrame(frame);
+
+				m_Window->SwapBuffers();
+				// wait for the gpu so the frame time includes all rendering work
+				glFinish();
+				float wallTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+				m_Scene->CollectGpuTimes();
+
+				Statistics::Get().newFrame();
+				m_Benchmark->RecordFrame(frame, Statistics::Get().getLastFrame(), wallTime);
+			}
 		}
+		bool success = m_Benchmark->WriteResults(m_Settings, m_Description.m_RandomSeed);
+		return m_Benchmark->IsWithinAllocationLimit() && success;
+	}
+
+	bool Application::RunTiled() {
+		glm::ivec2 imageSize = glm::ivec2(m_Settings.m_Width, m_Settings.m_Height);
+		TiledHatching tiles(imageSize, m_Settings.m_TileSize, m_Settings.m_GuardBand);
+		TiledImageWriter writer;
+		if (!writer.Open(m_Settings.m_TiledOutput, imageSize))
+			return false;
+
+		std::vector<unsigned char> pixels;
+		int frame = 0;
+		for (int tile = 0; tile < tiles.GetNumTiles() && !ShouldClose; tile++) {
+			glm::ivec2 windowOrigin = tiles.GetWindowOrigin(tile);
+			m_Scene->SetTile(imageSize, windowOrigin, tiles.GetWindowSize());
+			tiles.BeginTile(tile, m_Scene->GetHatching());
+
+			// the whole tile is one still frame of the animation, the lines need a few updates to fill it
+			for (int iteration = 0; iteration < m_Settings.m_TileIterations && !ShouldClose; iteration++) {
+				Statistics::Get().newFrame(frame > 0);
+				m_Window->PollEvents();
+				PollSignals();
+
+				RenderFrame(0);
+
+				if (iteration == m_Settings.m_TileIterations - 1) {
+					glm::ivec2 coreOrigin = tiles.GetCoreOrigin(tile);
+					glm::ivec2 coreSize = tiles.GetCoreSize(tile);
+					m_Scene->ReadFrame(coreOrigin - windowOrigin, coreSize, pixels);
+					writer.WriteTile(coreOrigin, coreSize, pixels.data());
+				}
+				m_Window->SwapBuffers();
+				frame++;
+			}
+
+			tiles.EndTile(tile, m_Scene->GetHatching());
+			std::cout << "Tile " << tile + 1 << " of " << tiles.GetNumTiles() << " done, " << tiles.GetNumStrokes() << " strokes kept for the next tiles" << std::endl;
+		}
+		Statistics::Get().newFrame();
+
+		if (!writer.Close() || ShouldClose) {
+			std::cout << "Tiled image " << m_Settings.m_TiledOutput << " is incomplete" << std::endl;
+			return false;
+		}
+		std::cout << "Wrote " << imageSize.x << "x" << imageSize.y << " image to " << m_Settings.m_TiledOutput << std::endl;
+		return true;
+	}
+
+	void Application::RenderFrame(int frame) {
+		if (m_Animation.HasCameraPath()) {
+			m_Scene->SetCameraPosition(m_Animation.EvaluateCamera(frame));
+		}
+		for (int i = 0; i < m_Scene->GetNumObjects(); i++) {
+			ObjectPose pose;
+			if (m_Animation.EvaluateObject(i, frame, pose))
+				m_Scene->SetObjectPose(i, pose);
+		}
+
+		m_Scene->Update();
+
+		//Render
+		glBindFramebuffer(GL_FRAMEBUFFER, m_Window->GetDefaultFramebuffer());
+		glEnable(GL_DEPTH_TEST);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		m_Scene->Draw();
+
+		if (!m_Settings.m_OutputDir.empty()) {
+			std::ostringstream path;
+			path << m_Settings.m_OutputDir << "/frame" << std::setfill('0') << std::setw(5) << frame << ".png";
+			m_Scene->SaveFrame(path.str());
+		}
+		if (!m_Settings.m_VideoFile.empty())
+			m_Scene->SaveVideoFrame();
+		if (!m_Settings.m_HeatmapDir.empty()) {
+			std::ostringstream path;
+			path << m_Settings.m_HeatmapDir << "/heatmap" << std::setfill('0') << std::setw(5) << frame << ".png";
+			m_Scene->SaveCostHeatmap(path.str());
+		}
+	}
+
+	void Application::PollSignals() {
+		if (QuitRequested)
+			ShouldClose = true;
+		if (DumpRequested) {
+			DumpRequested = 0;
+			DumpStatistics();
+		}
+	}
+
+	void Application::DumpStatistics() {
+		if (m_Settings.m_HistogramFile.empty()) {
+			Statistics::Get().printAllocations();
+			Statistics::Get().printMemory();
+			Statistics::Get().printImports();
+			Statistics::Get().printPerfCounters();
+			return;
+		}
+		Statistics::Get().printPercentiles();
+		if (Statistics::Get().writeHistograms(m_Settings.m_HistogramFile))
+			std::cout << "Wrote histograms to " << m_Settings.m_HistogramFile << std::endl;
 	}
 
 	void Application::HandleKeyInput(int key) {
@@ -75,7 +552,7 @@ namespace Copperplate {
 			DisplaySettings::RenderHatching = !DisplaySettings::RenderHatching;
 		}
 		else if (key == GLFW_KEY_KP_5) {
-			DisplaySettings::RegenerateHatching = !DisplaySettings::RegenerateHatching;
+			HatchingDebugSettings::RegenerateHatching = !HatchingDebugSettings::RegenerateHatching;
 		}
 		else if (key == GLFW_KEY_KP_6) {
 			DisplaySettings::RenderHatchingCollision = !DisplaySettings::RenderHatchingCollision;
@@ -84,18 +561,18 @@ namespace Copperplate {
 			DisplaySettings::RenderCurrentDebug = !DisplaySettings::RenderCurrentDebug;
 		}
 		else if (key == GLFW_KEY_KP_ADD) {
-			DisplaySettings::NumHatchingLines++;
-			std::cout << "Drawing " << DisplaySettings::NumHatchingLines << "lines now \n";
+			HatchingDebugSettings::NumHatchingLines++;
+			std::cout << "Drawing " << HatchingDebugSettings::NumHatchingLines << "lines now \n";
 		}
 		else if (key == GLFW_KEY_KP_SUBTRACT) {
-			DisplaySettings::NumHatchingLines--;
-			std::cout << "Drawing " << DisplaySettings::NumHatchingLines << "lines now \n";
+			HatchingDebugSettings::NumHatchingLines--;
+			std::cout << "Drawing " << HatchingDebugSettings::NumHatchingLines << "lines now \n";
 		}
 		else if (key == GLFW_KEY_KP_MULTIPLY) {
-			DisplaySettings::NumPointsPerHatch++;
+			HatchingDebugSettings::NumPointsPerHatch++;
 		}
 		else if (key == GLFW_KEY_KP_DIVIDE) {
-			DisplaySettings::NumPointsPerHatch--;
+			HatchingDebugSettings::NumPointsPerHatch--;
 		}
 		else if (key == GLFW_KEY_PAGE_UP) {
 			
@@ -124,6 +601,19 @@ namespace Copperplate {
 		else if (key == GLFW_KEY_7) {
 			DisplaySettings::FramebufferToDisplay = EFramebuffers::FB_ShadingGradient;
 		}
+		else if (key == GLFW_KEY_8) {
+			DisplaySettings::RenderCostHeatmap = !DisplaySettings::RenderCostHeatmap;
+		}
+		else if (key == GLFW_KEY_9) {
+			DisplaySettings::CostHeatmapType = (EHatchingCosts)((DisplaySettings::CostHeatmapType + 1) % (HC_NumCosts + 1));
+			std::cout << "Heatmap shows " << getHatchingCostName(DisplaySettings::CostHeatmapType) << std::endl;
+		}
+		else if (key == GLFW_KEY_0) {
+			DisplaySettings::RecordCostHeatmap = true;
+		}
+		else if (key == GLFW_KEY_H) {
+			DisplaySettings::RenderHud = !DisplaySettings::RenderHud;
+		}
 		else if (key == GLFW_KEY_F1) {
 			m_Scene->SetLayer1Direction(HD_LargestCurvature);
 			//DisplaySettings::HatchingDirection = EHatchingDirections::HD_LargestCurvature;
@@ -154,7 +644,7 @@ namespace Copperplate {
 			m_Scene->ExampleAnimation();
 		}
 		else if (key == GLFW_KEY_F8) {
-			Statistics::Get().printMeanValues();
+			Statistics::Get().printPercentiles();
 		}
 		else if (key == GLFW_KEY_F9) {
 			Statistics::Get().printLastFrame();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "scene.h"
+#include "scenedescription.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -10,11 +11,61 @@ namespace Copperplate {
 
 	class Window;
 	class Scene;
+	class Benchmark;
+
+	// Settings given on the command line
+	struct LaunchSettings {
+		bool m_Headless = false;
+		int m_Width = 2400;
+		int m_Height = 1050;
+		std::string m_SceneFile;
+		std::string m_AnimationFile;
+		int m_FrameCount = -1;		//-1 runs until the window is closed
+		std::string m_OutputDir;	//if set, every frame is saved here
+		std::string m_VideoFile;	//if set, every frame is appended to this uncompressed stream
+		int m_VideoFps = 30;
+		int m_WriterThreads = 0;	//encoder threads for saved frames, 0 picks a count from the cores
+		std::string m_VectorFile;	//if set, the lines and contours of every frame are written as svg, eps or pdf
+		float m_SimplifyTolerance = 0.0f;	//px, 0 keeps every point of the exported lines
+		std::string m_StrokeFile;	//if set, the lines of every frame are archived here as a stroke stream
+		int m_StrokeKeyframes = STROKESTREAM_KEYFRAME_INTERVAL;
+		int m_RandomSeed = -1;		//overrides the seed of the scene description if set
+		std::string m_MeshCacheDir = "cache/";	//baked meshes and seeds, empty always imports the meshes
+		int m_LoaderThreads = 0;	//threads importing and seeding the meshes, 0 picks a count from the cores
+		float m_LodPixelError = 0.5f;	//px, 0 always draws the full resolution meshes
+		std::string m_CaptureFile;	//if set, the hatching inputs of every frame are recorded here
+		bool m_ShowHud = false;		//start with the performance overlay, toggled with H
+		std::string m_HeatmapDir;	//if set, the hatching cost heatmap of every frame is saved here
+		std::string m_TraceFile;	//if set, all timed scopes are written here as chrome trace events
+		std::string m_HistogramFile;	//if set, the session histograms are written here on exit and on SIGUSR1
+		bool m_PerfCounters = false;	//read hardware counters around every timer, Linux only
+
+		// Tiled mode, renders an image of the viewport size in tiles into one ppm file
+		std::string m_TiledOutput;
+		int m_TileSize = 1024;
+		int m_GuardBand = 64;		//pixels every tile is rendered beyond its borders
+		int m_TileIterations = 30;	//hatching updates per tile until the lines settled
+
+		// Compare mode, checks two histogram dumps for regressions instead of rendering
+		std::string m_CompareBase;
+		std::string m_CompareNew;
+		float m_Tolerance = 0.1f;
+
+		// Benchmark mode
+		std::string m_BenchmarkOutput;
+		int m_WarmupFrames = 10;
+		int m_BenchmarkRuns = 3;
+		int m_AllocationLimit = -1;	//measured frames may not allocate more often, needs COPPERPLATE_ALLOC_TRACKING
+
+		static bool Parse(int argc, char* argv[], LaunchSettings& outSettings);
+		static void PrintUsage();
+	};
 
 	class Application {
 	public:
-		static void Init();
-		static void Run();
+		static bool Init(const LaunchSettings& settings);
+		// Returns false if the benchmark failed
+		static bool Run();
 
 		static void HandleKeyInput(int key);
 		static void Resize(int width, int height);
@@ -22,8 +73,18 @@ namespace Copperplate {
 		static bool ShouldClose;
 
 	private:
+		static bool RunBenchmark();
+		static bool RunTiled();
+		static void RenderFrame(int frame);
+		static void PollSignals();
+		static void DumpStatistics();
+
 		static Shared<Window> m_Window;
 		static Unique<Scene> m_Scene;
+		static Unique<Benchmark> m_Benchmark;
+		static LaunchSettings m_Settings;
+		static SceneDescription m_Description;
+		static AnimationPath m_Animation;
 	};
 	
 }
\ No newline at end of file
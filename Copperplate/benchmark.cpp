@@ -0,0 +1,219 @@
+#pragma once
+
+#include "benchmark.h"
+#include "application.h"
+
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace Copperplate {
+
+	struct MetricSummary {
+		double mean = 0.0;
+		double stddev = 0.0;
+		double min = 0.0;
+		double max = 0.0;
+	};
+
+	MetricSummary summarize(const std::vector<double>& values) {
+		MetricSummary result;
+		if (values.empty()) return result;
+		result.min = values[0];
+		result.max = values[0];
+		for (double value : values) {
+			result.mean += value;
+			result.min = std::min(result.min, value);
+			result.max = std::max(result.max, value);
+		}
+		result.mean /= values.size();
+		for (double value : values) {
+			result.stddev += (value - result.mean) * (value - result.mean);
+		}
+		result.stddev = std::sqrt(result.stddev / values.size());
+		return result;
+	}
+
+	Benchmark::Benchmark(const std::string& outputBase, int warmupFrames, int allocationLimit) {
+		m_OutputBase = outputBase;
+		m_WarmupFrames = warmupFrames;
+		m_AllocationLimit = allocationLimit;
+		m_NumFramesOverLimit = 0;
+		m_Runs = std::vector<std::vector<FrameSample>>();
+	}
+
+	void Benchmark::BeginRun() {
+		m_Runs.push_back(std::vector<FrameSample>());
+	}
+
+	void Benchmark::RecordFrame(int frame, const StatFrame& stats, float wallTime) {
+		FrameSample sample;
+		sample.m_Frame = frame;
+		// the wall time comes first, followed by all StatFrame fields
+		sample.m_Values.push_back(wallTime);
+		for (const StatFrameField& field : getStatFrameFields()) {
+			sample.m_Values.push_back(field.GetValue(stats));
+		}
+		m_Runs.back().push_back(sample);
+
+		if (m_AllocationLimit < 0 || frame < m_WarmupFrames) return;
+		int totalAllocations = 0;
+		int worstStage = T_NumTimers;
+		for (int i = 0; i <= T_NumTimers; i++) {
+			totalAllocations += stats.allocations[i];
+			if (stats.allocations[i] > stats.allocations[worstStage])
+				worstStage = i;
+		}
+		if (totalAllocations > m_AllocationLimit) {
+			m_NumFramesOverLimit++;
+			std::cout << "Frame " << frame << " allocated " << totalAllocations << " times, the limit is " << m_AllocationLimit << ". Most allocations in "
+				<< (worstStage < T_NumTimers ? getTimerName((ETimerType)worstStage) : "untimed code") << " (" << stats.allocations[worstStage] << ")" << std::endl;
+		}
+	}
+
+	bool Benchmark::IsWithinAllocationLimit() {
+		if (m_NumFramesOverLimit > 0)
+			std::cout << m_NumFramesOverLimit << " measured frames exceeded the allocation limit of " << m_AllocationLimit << std::endl;
+		return m_NumFramesOverLimit == 0;
+	}
+
+	bool Benchmark::WriteResults(const LaunchSettings& settings, int randomSeed) {
+		bool success = WriteTable(m_OutputBase + ".csv");
+		success &= WriteSummary(m_OutputBase + ".json", settings, randomSeed);
+		if (success)
+			std::cout << "Benchmark results written to " << m_OutputBase << ".csv and " << m_OutputBase << ".json" << std::endl;
+		return success;
+	}
+
+	bool Benchmark::WriteTable(const std::string& path) {
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			std::cout << "Could not open " << path << std::endl;
+			return false;
+		}
+		file << "run,frame,warmup,wallTime";
+		for (const StatFrameField& field : getStatFrameFields()) {
+			file << "," << field.m_Name;
+		}
+		file << "\n";
+		for (int run = 0; run < m_Runs.size(); run++) {
+			for (const FrameSample& sample : m_Runs[run]) {
+				file << run << "," << sample.m_Frame << "," << (sample.m_Frame < m_WarmupFrames ? 1 : 0);
+				for (double value : sample.m_Values) {
+					file << "," << value;
+				}
+				file << "\n";
+			}
+		}
+		return true;
+	}
+
+	bool Benchmark::WriteSummary(const std::string& path, const LaunchSettings& settings, int randomSeed) {
+		rapidjson::StringBuffer buffer;
+		rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+		writer.StartObject();
+
+		writer.Key("config");
+		writer.StartObject();
+		writer.Key("scene");
+		writer.String(settings.m_SceneFile.c_str());
+		writer.Key("animation");
+		writer.String(settings.m_AnimationFile.c_str());
+		writer.Key("width");
+		writer.Int(settings.m_Width);
+		writer.Key("height");
+		writer.Int(settings.m_Height);
+		writer.Key("headless");
+		writer.Bool(settings.m_Headless);
+		writer.Key("frames");
+		writer.Int(settings.m_FrameCount);
+		writer.Key("warmupFrames");
+		writer.Int(m_WarmupFrames);
+		writer.Key("runs");
+		writer.Int(m_Runs.size());
+		writer.Key("seed");
+		writer.Int(randomSeed);
+		writer.Key("allocationLimit");
+		writer.Int(m_AllocationLimit);
+		writer.EndObject();
+
+		writer.Key("metrics");
+		writer.StartObject();
+		std::vector<const char*> names = { "wallTime" };
+		for (const StatFrameField& field : getStatFrameFields()) {
+			names.push_back(field.m_Name);
+		}
+		for (int i = 0; i < names.size(); i++) {
+			// gather the measured frames of all runs and the mean of every single run
+			std::vector<double> allValues;
+			std::vector<double> runMeans;
+			for (const std::vector<FrameSample>& run : m_Runs) {
+				std::vector<double> runValues;
+				for (const FrameSample& sample : run) {
+					if (sample.m_Frame < m_WarmupFrames) continue;
+					runValues.push_back(sample.m_Values[i]);
+					allValues.push_back(sample.m_Values[i]);
+				}
+				if (!runValues.empty())
+					runMeans.push_back(summarize(runValues).mean);
+			}
+			MetricSummary frames = summarize(allValues);
+			MetricSummary runs = summarize(runMeans);
+
+			writer.Key(names[i]);
+			writer.StartObject();
+			writer.Key("mean");
+			writer.Double(frames.mean);
+			writer.Key("stddev");
+			writer.Double(frames.stddev);
+			writer.Key("min");
+			writer.Double(frames.min);
+			writer.Key("max");
+			writer.Double(frames.max);
+			writer.Key("runMeans");
+			writer.StartArray();
+			for (double mean : runMeans) {
+				writer.Double(mean);
+			}
+			writer.EndArray();
+			// run to run variation, the coefficient of variation is relative to the mean over all runs
+			writer.Key("runStddev");
+			writer.Double(runs.stddev);
+			writer.Key("runCV");
+			writer.Double(runs.mean != 0.0 ? runs.stddev / runs.mean : 0.0);
+			writer.EndObject();
+		}
+		writer.EndObject();
+
+		writer.Key("framesOverAllocationLimit");
+		writer.Int(m_NumFramesOverLimit);
+
+		// bytes over the whole process lifetime, the peaks include the loading and warmup frames
+		writer.Key("memory");
+		writer.StartObject();
+		for (int i = 0; i < MC_NumCategories; i++) {
+			EMemoryCategory category = (EMemoryCategory)i;
+			writer.Key(getMemoryCategoryName(category));
+			writer.StartObject();
+			writer.Key("live");
+			writer.Int64(Statistics::Get().getLiveMemory(category));
+			writer.Key("peak");
+			writer.Int64(Statistics::Get().getPeakMemory(category));
+			writer.EndObject();
+		}
+		writer.EndObject();
+
+		writer.EndObject();
+
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			std::cout << "Could not open " << path << std::endl;
+			return false;
+		}
+		file << buffer.GetString();
+		return true;
+	}
+}
\ No newline at end of file
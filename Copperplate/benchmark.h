@@ -0,0 +1,45 @@
+#pragma once
+
+#include "statistics.h"
+
+#include <string>
+#include <vector>
+
+namespace Copperplate {
+
+	struct LaunchSettings;
+
+	// Collects the frame statistics of several identical runs of a scripted animation.
+	// The first frames of every run are warm-up frames, they are written to the csv table
+	// but left out of the summary. With an allocation limit every measured frame that allocates
+	// more often than the limit fails the benchmark.
+	class Benchmark {
+	public:
+
+		Benchmark(const std::string& outputBase, int warmupFrames, int allocationLimit);
+
+		void BeginRun();
+		void RecordFrame(int frame, const StatFrame& stats, float wallTime);
+
+		// Writes <outputBase>.csv with one row per frame and <outputBase>.json with the summary
+		bool WriteResults(const LaunchSettings& settings, int randomSeed);
+
+		bool IsWithinAllocationLimit();
+
+	private:
+
+		struct FrameSample {
+			int m_Frame;
+			std::vector<double> m_Values;	//one value per metric
+		};
+
+		bool WriteTable(const std::string& path);
+		bool WriteSummary(const std::string& path, const LaunchSettings& settings, int randomSeed);
+
+		std::string m_OutputBase;
+		int m_WarmupFrames;
+		int m_AllocationLimit;		//-1 if there is none
+		int m_NumFramesOverLimit;
+		std::vector<std::vector<FrameSample>> m_Runs;
+	};
+}
\ No newline at end of file
@@ -1,16 +1,10 @@
 #pragma once
 
 #include <iostream>
-#include <glad/glad.h>
+#include <memory>
 
 namespace Copperplate {
 
-	GLenum glCheckError_(const char* file, int line);
-	#define glCheckError() glCheckError_(__FILE__, __LINE__)	
-
-	GLenum glCheckFrameBufferError_(const char* file, int line);
-	#define glCheckFrameBufferError() glCheckFrameBufferError_(__FILE__, __LINE__)
-
 	template<typename T>
 	using Unique = std::unique_ptr<T>;
 
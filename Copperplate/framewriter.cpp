@@ -0,0 +1,318 @@
+#pragma once
+
+#include "framewriter.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace Copperplate {
+
+	FrameWriter::FrameWriter(int numThreads)
+		: m_BufferMemory(MC_GLBuffers)
+		, m_PixelMemory(MC_Images) {
+		m_NextReadback = 0;
+		m_NumStalls = 0;
+		m_StreamFormat = FF_Png;
+		m_StreamSize = glm::ivec2(0, 0);
+		m_NumStreamFrames = 0;
+		m_NumPixelBuffers = 0;
+		m_NumEncoding = 0;
+		m_NextStreamIndex = 0;
+		m_NumFramesWritten = 0;
+		m_Stopping = false;
+
+		for (Readback& readback : m_Readbacks) {
+			glGenBuffers(1, &readback.m_Buffer);
+			readback.m_BufferSize = 0;
+			readback.m_Fence = nullptr;
+			readback.m_Size = glm::ivec2(0, 0);
+		}
+
+		// encoding a PNG takes several frames worth of time, but the render thread should keep most of the cores
+		if (numThreads <= 0)
+			numThreads = std::max(1, (int)std::thread::hardware_concurrency() / 2);
+		numThreads = std::min(numThreads, FRAMEWRITER_MAX_THREADS);
+		for (int i = 0; i < numThreads; i++) {
+			m_Threads.emplace_back(&FrameWriter::EncoderLoop, this);
+		}
+	}
+
+	FrameWriter::~FrameWriter() {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_QueueChanged.notify_all();
+		for (std::thread& thread : m_Threads) {
+			thread.join();
+		}
+
+		for (Readback& readback : m_Readbacks) {
+			if (readback.m_Fence) glDeleteSync(readback.m_Fence);
+			glDeleteBuffers(1, &readback.m_Buffer);
+		}
+	}
+
+	bool FrameWriter::OpenStream(const std::string& path, EFrameFormats format, glm::ivec2 size, int framesPerSecond) {
+		if (format == FF_Png) {
+			std::cout << "PNG frames are written one file per frame, not as a stream" << std::endl;
+			return false;
+		}
+		m_Stream.open(path, std::ios::binary);
+		if (!m_Stream.is_open()) {
+			std::cout << "Could not open " << path << std::endl;
+			return false;
+		}
+		m_StreamFormat = format;
+		m_StreamSize = size;
+		if (format == FF_Y4m)
+			m_Stream << "YUV4MPEG2 W" << size.x << " H" << size.y << " F" << framesPerSecond << ":1 Ip A1:1 C444\n";
+		return true;
+	}
+
+	bool FrameWriter::HasStream() {
+		return m_Stream.is_open();
+	}
+
+	void FrameWriter::ReadFramebuffer(glm::ivec2 size, const std::string& path) {
+		TIME_FUNCTION(T_SaveFrame);
+		Readback& readback = m_Readbacks[m_NextReadback];
+		m_NextReadback = (m_NextReadback + 1) % FRAMEWRITER_NUM_PBOS;
+		// the oldest readback was issued a few frames ago, so its fence has usually signaled by now
+		if (readback.m_Fence)
+			FinishReadback(readback);
+
+		int64_t bytes = (int64_t)size.x * size.y * 4;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.m_Buffer);
+		if (bytes > readback.m_BufferSize) {
+			glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+			readback.m_BufferSize = bytes;
+			int64_t bufferBytes = 0;
+			for (const Readback& other : m_Readbacks) {
+				bufferBytes += other.m_BufferSize;
+			}
+			m_BufferMemory.Set(bufferBytes);
+		}
+		// RGBA bytes are the format drivers copy without a conversion on the CPU
+		glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		readback.m_Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		readback.m_Size = size;
+		readback.m_Path = path;
+		glCheckError();
+	}
+
+	void FrameWriter::Flush() {
+		TIME_FUNCTION(T_SaveFrame);
+		for (int i = 0; i < FRAMEWRITER_NUM_PBOS; i++) {
+			Readback& readback = m_Readbacks[(m_NextReadback + i) % FRAMEWRITER_NUM_PBOS];
+			if (readback.m_Fence)
+				FinishReadback(readback);
+		}
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_QueueChanged.wait(lock, [this] { return m_Queue.empty() && m_NumEncoding == 0; });
+		}
+		if (m_Stream.is_open())
+			m_Stream.flush();
+		if (m_NumStalls > 0) {
+			std::cout << "Frame writer: the render thread waited " << m_NumStalls << " times for a full queue, consider more --writer-threads" << std::endl;
+			m_NumStalls = 0;
+		}
+	}
+
+	int FrameWriter::GetNumFramesWritten() {
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_NumFramesWritten;
+	}
+
+	// PRIVATE FUNCTIONS //
+
+	void FrameWriter::FinishReadback(Readback& readback) {
+		GLenum result;
+		do {
+			result = glClientWaitSync(readback.m_Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(readback.m_Fence);
+		readback.m_Fence = nullptr;
+
+		int streamIndex = -1;
+		if (readback.m_Path.empty()) {
+			if (!m_Stream.is_open() || readback.m_Size != m_StreamSize) {
+				std::cout << "Dropped a stream frame of size " << readback.m_Size.x << "x" << readback.m_Size.y << ", the stream has "
+					<< m_StreamSize.x << "x" << m_StreamSize.y << std::endl;
+				return;
+			}
+			streamIndex = m_NumStreamFrames++;
+		}
+
+		int64_t bytes = (int64_t)readback.m_Size.x * readback.m_Size.y * 4;
+		std::vector<unsigned char> pixels;
+		int numPixelBuffers;
+		{
+			// a full queue means the encoders fall behind, waiting here keeps the memory bounded
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			if (m_Queue.size() >= FRAMEWRITER_QUEUE_SIZE) {
+				m_NumStalls++;
+				m_QueueChanged.wait(lock, [this] { return m_Queue.size() < FRAMEWRITER_QUEUE_SIZE; });
+			}
+			if (!m_FreePixels.empty()) {
+				pixels = std::move(m_FreePixels.back());
+				m_FreePixels.pop_back();
+			}
+			else {
+				m_NumPixelBuffers++;
+			}
+			numPixelBuffers = m_NumPixelBuffers;
+		}
+		pixels.resize(bytes);
+		m_PixelMemory.Set(numPixelBuffers * bytes);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.m_Buffer);
+		const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+		if (data) {
+			std::memcpy(pixels.data(), data, bytes);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		else {
+			std::cout << "Could not map the readback of " << (readback.m_Path.empty() ? "a stream frame" : readback.m_Path) << std::endl;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glCheckError();
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Queue.push_back({ std::move(pixels), readback.m_Size, readback.m_Path, streamIndex });
+		}
+		m_QueueChanged.notify_all();
+	}
+
+	void FrameWriter::EncoderLoop() {
+		std::vector<unsigned char> scratch;
+		while (true) {
+			EncodeJob job;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_QueueChanged.wait(lock, [this] { return m_Stopping || !m_Queue.empty(); });
+				// the queue is drained before the threads stop
+				if (m_Queue.empty()) return;
+				job = std::move(m_Queue.front());
+				m_Queue.pop_front();
+				m_NumEncoding++;
+			}
+			// a slot in the queue became free
+			m_QueueChanged.notify_all();
+
+			Encode(job, scratch);
+
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_FreePixels.push_back(std::move(job.m_Pixels));
+				m_NumEncoding--;
+				m_NumFramesWritten++;
+			}
+			m_QueueChanged.notify_all();
+		}
+	}
+
+	void FrameWriter::Encode(EncodeJob& job, std::vector<unsigned char>& scratch) {
+		const int width = job.m_Size.x;
+		const int height = job.m_Size.y;
+		const unsigned char* pixels = job.m_Pixels.data();
+
+		if (job.m_StreamIndex < 0) {
+			// drop the alpha channel, rows stay bottom up and padded the way writePngImage expects them
+			int stride = (width * 3 + 3) / 4 * 4;
+			scratch.resize((size_t)stride * height);
+			for (int y = 0; y < height; y++) {
+				const unsigned char* source = pixels + (size_t)y * width * 4;
+				unsigned char* target = scratch.data() + (size_t)y * stride;
+				for (int x = 0; x < width; x++) {
+					target[3 * x] = source[4 * x];
+					target[3 * x + 1] = source[4 * x + 1];
+					target[3 * x + 2] = source[4 * x + 2];
+				}
+			}
+			writePngImage(job.m_Path, job.m_Size, scratch.data(), 3);
+			return;
+		}
+
+		// streams store the top row first
+		size_t planeSize = (size_t)width * height;
+		scratch.resize(planeSize * 3);
+		for (int y = 0; y < height; y++) {
+			const unsigned char* source = pixels + (size_t)(height - 1 - y) * width * 4;
+			size_t row = (size_t)y * width;
+			for (int x = 0; x < width; x++) {
+				int r = source[4 * x];
+				int g = source[4 * x + 1];
+				int b = source[4 * x + 2];
+				if (m_StreamFormat == FF_Y4m) {
+					scratch[row + x] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+					scratch[planeSize + row + x] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+					scratch[2 * planeSize + row + x] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+				}
+				else {
+					scratch[3 * (row + x)] = (unsigned char)r;
+					scratch[3 * (row + x) + 1] = (unsigned char)g;
+					scratch[3 * (row + x) + 2] = (unsigned char)b;
+				}
+			}
+		}
+
+		// frames are converted in parallel, but only the thread holding the next index may append
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_StreamAdvanced.wait(lock, [this, &job] { return m_NextStreamIndex == job.m_StreamIndex; });
+		}
+		if (m_StreamFormat == FF_Y4m)
+			m_Stream << "FRAME\n";
+		m_Stream.write((const char*)scratch.data(), scratch.size());
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_NextStreamIndex++;
+		}
+		m_StreamAdvanced.notify_all();
+	}
+
+	TiledImageWriter::TiledImageWriter() {
+		m_Size = glm::ivec2(0, 0);
+		m_HeaderSize = 0;
+	}
+
+	bool TiledImageWriter::Open(const std::string& path, glm::ivec2 size) {
+		m_File.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!m_File.is_open()) {
+			std::cout << "Could not open " << path << std::endl;
+			return false;
+		}
+		m_Size = size;
+		m_File << "P6\n" << size.x << " " << size.y << "\n255\n";
+		m_HeaderSize = (int64_t)m_File.tellp();
+		// reserve the whole file so the tiles can be written in any order
+		m_File.seekp(m_HeaderSize + (int64_t)size.x * size.y * 3 - 1);
+		m_File.put(0);
+		if (!m_File.good()) {
+			std::cout << "Could not reserve " << (int64_t)size.x * size.y * 3 / (1024 * 1024) << " MB for " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	void TiledImageWriter::WriteTile(glm::ivec2 origin, glm::ivec2 size, const unsigned char* pixels) {
+		TIME_FUNCTION(T_SaveFrame);
+		// the file stores the top row first
+		for (int y = 0; y < size.y; y++) {
+			int fileRow = m_Size.y - 1 - (origin.y + y);
+			m_File.seekp(m_HeaderSize + ((int64_t)fileRow * m_Size.x + origin.x) * 3);
+			m_File.write((const char*)pixels + (size_t)y * size.x * 3, (std::streamsize)size.x * 3);
+		}
+	}
+
+	bool TiledImageWriter::Close() {
+		m_File.close();
+		return !m_File.fail();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "gldebug.h"
+#include "statistics.h"
+
+#include <glm/ext/vector_int2.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Copperplate {
+
+	const int FRAMEWRITER_NUM_PBOS = 3;			//readbacks in flight before the render thread maps the oldest one
+	const int FRAMEWRITER_QUEUE_SIZE = 8;		//frames waiting for the encoders, the render thread blocks when it is full
+	const int FRAMEWRITER_MAX_THREADS = 8;
+
+	enum EFrameFormats {
+		FF_Png,		//one file per frame
+		FF_Y4m,		//YUV4MPEG2 stream, 4:4:4 in BT.601 studio range, readable by ffmpeg and most players
+		FF_Raw,		//headerless rgb24 stream, top row first
+	};
+
+	// Saves framebuffer contents without stalling the render thread. glReadPixels goes into a ring of pixel pack
+	// buffers and only maps a buffer once its fence signaled, a few frames later. The pixels are then encoded by a
+	// pool of threads: PNGs are written in any order, stream frames are converted in parallel but appended in the
+	// order they were read.
+	class FrameWriter {
+	public:
+
+		// 0 threads picks a count from the available cores
+		FrameWriter(int numThreads);
+		// Finishes the queued frames, readbacks that were never mapped are lost without Flush
+		~FrameWriter();
+
+		bool OpenStream(const std::string& path, EFrameFormats format, glm::ivec2 size, int framesPerSecond);
+		bool HasStream();
+
+		// Starts the readback of the current read framebuffer, an empty path appends the frame to the stream
+		void ReadFramebuffer(glm::ivec2 size, const std::string& path);
+		// Blocks until everything that was read so far is on disk
+		void Flush();
+
+		int GetNumFramesWritten();
+
+	private:
+
+		struct Readback {
+			unsigned int m_Buffer;
+			int64_t m_BufferSize;
+			GLsync m_Fence;
+			glm::ivec2 m_Size;
+			std::string m_Path;
+		};
+
+		struct EncodeJob {
+			std::vector<unsigned char> m_Pixels;	//RGBA, bottom row first like GL
+			glm::ivec2 m_Size;
+			std::string m_Path;
+			int m_StreamIndex;						//-1 for single files
+		};
+
+		// Waits for the fence, copies the pixels out of the buffer and queues them
+		void FinishReadback(Readback& readback);
+		void EncoderLoop();
+		void Encode(EncodeJob& job, std::vector<unsigned char>& scratch);
+
+		// Render thread only
+		Readback m_Readbacks[FRAMEWRITER_NUM_PBOS];
+		int m_NextReadback;
+		int m_NumStalls;
+
+		EFrameFormats m_StreamFormat;
+		glm::ivec2 m_StreamSize;
+		std::ofstream m_Stream;
+		int m_NumStreamFrames;
+
+		// Shared with the encoders, guarded by the mutex
+		std::mutex m_Mutex;
+		std::condition_variable m_QueueChanged;
+		std::condition_variable m_StreamAdvanced;
+		std::deque<EncodeJob> m_Queue;
+		std::vector<std::vector<unsigned char>> m_FreePixels;	//recycled so frames do not allocate
+		int m_NumPixelBuffers;
+		int m_NumEncoding;
+		int m_NextStreamIndex;
+		int m_NumFramesWritten;
+		bool m_Stopping;
+
+		std::vector<std::thread> m_Threads;
+
+		MemoryCounter m_BufferMemory;
+		MemoryCounter m_PixelMemory;
+	};
+
+	// Assembles an image that never fits into memory at once from tiles. The output is a binary PPM, its rows have
+	// a fixed size, so every tile row is written straight to its place in the file.
+	class TiledImageWriter {
+	public:
+
+		TiledImageWriter();
+
+		bool Open(const std::string& path, glm::ivec2 size);
+		// RGB rows starting at the bottom like GL, the origin is counted from the bottom left corner of the image
+		void WriteTile(glm::ivec2 origin, glm::ivec2 size, const unsigned char* pixels);
+		bool Close();
+
+	private:
+
+		std::fstream m_File;
+		glm::ivec2 m_Size;
+		int64_t m_HeaderSize;
+	};
+}
\ No newline at end of file
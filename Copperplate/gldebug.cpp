@@ -1,6 +1,6 @@
 #pragma once
 
-#include "core.h"
+#include "gldebug.h"
 
 namespace Copperplate {
 
@@ -46,4 +46,39 @@ namespace Copperplate {
 		}
 		return errorCode;
 	}
+
+	int64_t getGLTextureBytes(unsigned int texture) {
+		glBindTexture(GL_TEXTURE_2D, texture);
+		int64_t bytes = 0;
+		// undefined mip levels report a width of zero
+		for (int level = 0; level < 16; level++) {
+			int width = 0, height = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+			if (width == 0 || height == 0) break;
+			int bits = 0;
+			for (GLenum size : { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE }) {
+				int componentBits = 0;
+				glGetTexLevelParameteriv(GL_TEXTURE_2D, level, size, &componentBits);
+				bits += componentBits;
+			}
+			bytes += (int64_t)width * height * bits / 8;
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return bytes;
+	}
+
+	int64_t getGLRenderbufferBytes(unsigned int renderbuffer) {
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+		int width = 0, height = 0, bits = 0;
+		glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_WIDTH, &width);
+		glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &height);
+		for (GLenum size : { GL_RENDERBUFFER_RED_SIZE, GL_RENDERBUFFER_GREEN_SIZE, GL_RENDERBUFFER_BLUE_SIZE, GL_RENDERBUFFER_ALPHA_SIZE, GL_RENDERBUFFER_DEPTH_SIZE, GL_RENDERBUFFER_STENCIL_SIZE }) {
+			int componentBits = 0;
+			glGetRenderbufferParameteriv(GL_RENDERBUFFER, size, &componentBits);
+			bits += componentBits;
+		}
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		return (int64_t)width * height * bits / 8;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "core.h"
+
+#include <glad/glad.h>
+
+namespace Copperplate {
+
+	GLenum glCheckError_(const char* file, int line);
+	#define glCheckError() glCheckError_(__FILE__, __LINE__)	
+
+	GLenum glCheckFrameBufferError_(const char* file, int line);
+	#define glCheckFrameBufferError() glCheckFrameBufferError_(__FILE__, __LINE__)
+
+	// Storage of GL objects from the sizes the driver reports, for the memory statistics.
+	// Both bind the object to query it.
+	int64_t getGLTextureBytes(unsigned int texture);
+	int64_t getGLRenderbufferBytes(unsigned int renderbuffer);
+
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "gputimer.h"
+
+namespace Copperplate {
+
+	GpuTimer::GpuTimer() {
+		m_CurrFrame = 0;
+		m_OpenScope = -1;
+		m_NumDroppedFrames = 0;
+		m_TimestampOffset = 0;
+		for (FrameQueries& frame : m_Frames) {
+			frame.m_FrameNumber = -1;
+			frame.m_Pending = false;
+			frame.m_NumScopes = 0;
+		}
+
+#ifdef COPPERPLATE_PROFILE
+		for (FrameQueries& frame : m_Frames) {
+			frame.m_Types.resize(GPU_TIMER_INITIAL_SCOPES);
+			frame.m_Queries.resize(GPU_TIMER_INITIAL_SCOPES * 2);
+			glGenQueries(frame.m_Queries.size(), frame.m_Queries.data());
+		}
+
+		// the GPU clock has its own time base, line it up with the CPU clock once
+		GLint64 gpuTime;
+		glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+		m_TimestampOffset = Statistics::Get().getTimestamp() - gpuTime;
+		glCheckError();
+#endif
+	}
+
+	GpuTimer::~GpuTimer() {
+#ifdef COPPERPLATE_PROFILE
+		for (FrameQueries& frame : m_Frames) {
+			glDeleteQueries(frame.m_Queries.size(), frame.m_Queries.data());
+		}
+#endif
+	}
+
+	void GpuTimer::BeginFrame() {
+#ifdef COPPERPLATE_PROFILE
+		// a scope that was never ended has no end query to wait for
+		if (m_OpenScope >= 0)
+			m_Frames[m_CurrFrame].m_NumScopes--;
+
+		m_CurrFrame = (m_CurrFrame + 1) % GPU_TIMER_FRAMES;
+		FrameQueries& frame = m_Frames[m_CurrFrame];
+		if (frame.m_Pending) {
+			// the GPU is more frames behind than the ring is long, rather lose the results than wait
+			m_NumDroppedFrames++;
+			if (m_NumDroppedFrames == 1)
+				std::cout << "GPU timer results are lagging behind, some frames will have no GPU times" << std::endl;
+		}
+		frame.m_FrameNumber = Statistics::Get().getFrameNumber();
+		frame.m_Pending = false;
+		frame.m_NumScopes = 0;
+		m_OpenScope = -1;
+#endif
+	}
+
+	void GpuTimer::Begin(EGpuTimerType type) {
+#ifdef COPPERPLATE_PROFILE
+		FrameQueries& frame = m_Frames[m_CurrFrame];
+		if (frame.m_FrameNumber < 0 || m_OpenScope >= 0) return;
+		if (frame.m_NumScopes == (int)frame.m_Types.size()) {
+			// the results of this frame's queries were already read or dropped, so new ones can simply be added
+			int numQueries = frame.m_Queries.size();
+			frame.m_Types.resize(frame.m_Types.size() * 2);
+			frame.m_Queries.resize(numQueries * 2);
+			glGenQueries(numQueries, &frame.m_Queries[numQueries]);
+		}
+		m_OpenScope = frame.m_NumScopes++;
+		frame.m_Types[m_OpenScope] = type;
+		glQueryCounter(frame.m_Queries[m_OpenScope * 2], GL_TIMESTAMP);
+#else
+		(void)type;
+#endif
+	}
+
+	void GpuTimer::End(EGpuTimerType type) {
+#ifdef COPPERPLATE_PROFILE
+		FrameQueries& frame = m_Frames[m_CurrFrame];
+		if (m_OpenScope < 0 || frame.m_Types[m_OpenScope] != type) return;
+		glQueryCounter(frame.m_Queries[m_OpenScope * 2 + 1], GL_TIMESTAMP);
+		frame.m_Pending = true;
+		m_OpenScope = -1;
+#else
+		(void)type;
+#endif
+	}
+
+	void GpuTimer::Collect() {
+#ifdef COPPERPLATE_PROFILE
+		for (FrameQueries& frame : m_Frames) {
+			if (!frame.m_Pending || (m_OpenScope >= 0 && &frame == &m_Frames[m_CurrFrame])) continue;
+
+			// queries finish in order, if the last one is available all of them are
+			GLint available = 0;
+			glGetQueryObjectiv(frame.m_Queries[frame.m_NumScopes * 2 - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) continue;
+
+			for (int i = 0; i < frame.m_NumScopes; i++) {
+				GLuint64 start, end;
+				glGetQueryObjectui64v(frame.m_Queries[i * 2], GL_QUERY_RESULT, &start);
+				glGetQueryObjectui64v(frame.m_Queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+				Statistics::Get().recordGpuTime(frame.m_FrameNumber, frame.m_Types[i], (int64_t)start + m_TimestampOffset, (int64_t)(end - start));
+			}
+			frame.m_Pending = false;
+		}
+#endif
+	}
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "gldebug.h"
+#include "statistics.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Copperplate {
+
+	const int GPU_TIMER_FRAMES = 4;				//frames the results may lag behind before they are dropped
+	const int GPU_TIMER_INITIAL_SCOPES = 64;	//queries per frame grow beyond this, scenes open scopes for every object
+
+	// Timestamp queries around GPU passes. Every frame uses its own set of query objects from a ring,
+	// they are read back a few frames later when the results are available, so the CPU never waits.
+	// The times end up in the StatFrame of the frame the passes were issued in.
+	class GpuTimer {
+	public:
+
+		GpuTimer();
+		~GpuTimer();
+
+		// Starts a new set of queries for the current statistics frame
+		void BeginFrame();
+
+		void Begin(EGpuTimerType type);
+		void End(EGpuTimerType type);
+
+		// Reads the results of all finished frames without blocking
+		void Collect();
+
+	private:
+
+		struct FrameQueries {
+			int m_FrameNumber;
+			bool m_Pending;
+			int m_NumScopes;
+			std::vector<EGpuTimerType> m_Types;
+			std::vector<unsigned int> m_Queries;	//start and end of every scope
+		};
+
+		FrameQueries m_Frames[GPU_TIMER_FRAMES];
+		int m_CurrFrame;
+		int m_OpenScope;
+		int m_NumDroppedFrames;
+
+		// added to GPU timestamps to get the time base of the statistics
+		int64_t m_TimestampOffset;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,346 @@
+#pragma once
+
+#include "halfedge.h"
+#include "statistics.h"
+#include "utility.h"
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <queue>
+
+namespace Copperplate {
+
+	// Sum of the squared distances to a set of planes as a symmetric 4x4 matrix, after Garland and Heckbert
+	struct EdgeQuadric {
+		double m[10] = {};
+
+		void AddPlane(glm::dvec3 normal, double offset) {
+			m[0] += normal.x * normal.x; m[1] += normal.x * normal.y; m[2] += normal.x * normal.z; m[3] += normal.x * offset;
+			m[4] += normal.y * normal.y; m[5] += normal.y * normal.z; m[6] += normal.y * offset;
+			m[7] += normal.z * normal.z; m[8] += normal.z * offset;
+			m[9] += offset * offset;
+		}
+
+		void Add(const EdgeQuadric& other) {
+			for (int i = 0; i < 10; i++) {
+				m[i] += other.m[i];
+			}
+		}
+
+		double Evaluate(glm::dvec3 p) const {
+			return m[0] * p.x * p.x + 2.0 * m[1] * p.x * p.y + 2.0 * m[2] * p.x * p.z + 2.0 * m[3] * p.x
+				+ m[4] * p.y * p.y + 2.0 * m[5] * p.y * p.z + 2.0 * m[6] * p.y
+				+ m[7] * p.z * p.z + 2.0 * m[8] * p.z + m[9];
+		}
+
+		// The point of the smallest error, false if the planes do not pin down a single one
+		bool Minimize(glm::dvec3& outPos) const {
+			glm::dmat3 a(m[0], m[1], m[2], m[1], m[4], m[5], m[2], m[5], m[7]);
+			double trace = m[0] + m[4] + m[7];
+			if (std::abs(glm::determinant(a)) <= 1e-9 * trace * trace * trace)
+				return false;
+			outPos = glm::inverse(a) * -glm::dvec3(m[3], m[6], m[8]);
+			return true;
+		}
+	};
+
+	struct EdgeCollapse {
+		float m_Cost;
+		uint32_t m_Keep;
+		uint32_t m_Remove;
+		uint32_t m_KeepVersion;		//collapses queued before either vertex changed are outdated
+		uint32_t m_RemoveVersion;
+		glm::vec3 m_Target;
+
+		bool operator>(const EdgeCollapse& other) const { return m_Cost > other.m_Cost; }
+	};
+
+	float HalfEdgeMesh::GetFaceArea(int face) const {
+		glm::vec3 a = GetCorner(face, 0);
+		glm::vec3 b = GetCorner(face, 1);
+		glm::vec3 c = GetCorner(face, 2);
+
+		glm::vec3 ab = b - a;
+		glm::vec3 ac = c - a;
+		return glm::length(glm::cross(ab, ac)) * 0.5f;
+	}
+
+	float HalfEdgeMesh::GetTotalArea() const {
+		float area = 0.0f;
+		for (int face = 0; face < GetNumFaces(); face++) {
+			area += GetFaceArea(face);
+		}
+		return area;
+	}
+
+	void HalfEdgeMesh::ComputeAreaSums(std::vector<float>& outSums) const {
+		outSums.resize(GetNumFaces());
+		float sum = 0.0f;
+		for (int face = 0; face < GetNumFaces(); face++) {
+			sum += GetFaceArea(face);
+			outSums[face] = sum;
+		}
+	}
+
+	void HalfEdgeMesh::ConnectHalfEdges() {
+		int numHalfEdges = halfEdges.size();
+		int numVertices = vertices.size();
+		auto getOther = [this](uint32_t halfEdge) {
+			return std::max(halfEdges[halfEdge].origin, halfEdges[Next(halfEdge)].origin);
+		};
+
+		// bucket the half edges by the smaller vertex of their edge, so both halves of an edge share a bucket
+		std::vector<std::atomic<uint32_t>> bucketCursors(numVertices);
+		parallelFor(numHalfEdges, [&](int begin, int end) {
+			for (int h = begin; h < end; h++) {
+				halfEdges[h].twin = NO_HALFEDGE;
+				uint32_t smaller = std::min(halfEdges[h].origin, halfEdges[Next(h)].origin);
+				bucketCursors[smaller].fetch_add(1, std::memory_order_relaxed);
+			}
+		});
+		std::vector<uint32_t> bucketStarts(numVertices + 1);
+		uint32_t sum = 0;
+		for (int v = 0; v < numVertices; v++) {
+			bucketStarts[v] = sum;
+			sum += bucketCursors[v].load(std::memory_order_relaxed);
+			bucketCursors[v].store(bucketStarts[v], std::memory_order_relaxed);
+		}
+		bucketStarts[numVertices] = sum;
+
+		std::vector<uint32_t> buckets(numHalfEdges);
+		parallelFor(numHalfEdges, [&](int begin, int end) {
+			for (int h = begin; h < end; h++) {
+				uint32_t smaller = std::min(halfEdges[h].origin, halfEdges[Next(h)].origin);
+				buckets[bucketCursors[smaller].fetch_add(1, std::memory_order_relaxed)] = h;
+			}
+		});
+
+		// sorted by the other vertex the halves of an edge are neighbors, the index keeps the pairing independent of the threads
+		parallelFor(numVertices, [&](int begin, int end) {
+			for (int v = begin; v < end; v++) {
+				auto first = buckets.begin() + bucketStarts[v];
+				auto last = buckets.begin() + bucketStarts[v + 1];
+				std::sort(first, last, [&](uint32_t a, uint32_t b) {
+					uint32_t otherA = getOther(a);
+					uint32_t otherB = getOther(b);
+					return (otherA != otherB) ? otherA < otherB : a < b;
+				});
+				for (auto edgeStart = first; edgeStart != last; ) {
+					auto edgeEnd = edgeStart + 1;
+					while (edgeEnd != last && getOther(*edgeEnd) == getOther(*edgeStart)) {
+						edgeEnd++;
+					}
+					// manifold edges have one half in each direction, on others every half edge takes the next free one of the opposite direction
+					for (auto a = edgeStart; a != edgeEnd; a++) {
+						if (halfEdges[*a].twin != NO_HALFEDGE) continue;
+						for (auto b = a + 1; b != edgeEnd; b++) {
+							if (halfEdges[*b].twin == NO_HALFEDGE && halfEdges[*b].origin != halfEdges[*a].origin) {
+								halfEdges[*a].twin = *b;
+								halfEdges[*b].twin = *a;
+								break;
+							}
+						}
+					}
+					edgeStart = edgeEnd;
+				}
+			}
+		}, 1024);
+
+		// every vertex keeps the first half edge that starts at it
+		for (Vertex& vertex : vertices) {
+			vertex.edge = NO_HALFEDGE;
+		}
+		for (int h = numHalfEdges - 1; h >= 0; h--) {
+			vertices[halfEdges[h].origin].edge = h;
+		}
+	}
+
+	void HalfEdgeMesh::Simplify(int targetFaces, HalfEdgeMesh& outMesh, float& outError) const {
+		int numVertices = vertices.size();
+		int numFaces = GetNumFaces();
+		std::vector<glm::vec3> positions(numVertices);
+		std::vector<glm::vec3> normals(numVertices);
+		for (int v = 0; v < numVertices; v++) {
+			positions[v] = vertices[v].position;
+			normals[v] = vertices[v].normal;
+		}
+
+		// faces as corner triples that are rewritten by the collapses, every vertex lists the faces around it
+		std::vector<glm::uvec3> faces(numFaces);
+		std::vector<bool> faceRemoved(numFaces, false);
+		std::vector<std::vector<uint32_t>> vertexFaces(numVertices);
+		std::vector<EdgeQuadric> quadrics(numVertices);
+		for (int f = 0; f < numFaces; f++) {
+			faces[f] = glm::uvec3(halfEdges[3 * f].origin, halfEdges[3 * f + 1].origin, halfEdges[3 * f + 2].origin);
+			glm::dvec3 a = positions[faces[f].x];
+			glm::dvec3 normal = glm::cross(glm::dvec3(positions[faces[f].y]) - a, glm::dvec3(positions[faces[f].z]) - a);
+			double length = glm::length(normal);
+			for (int c = 0; c < 3; c++) {
+				vertexFaces[faces[f][c]].push_back(f);
+				if (length > 0.0)
+					quadrics[faces[f][c]].AddPlane(normal / length, -glm::dot(normal / length, a));
+			}
+		}
+		// the outline of open meshes would shrink, so border vertices never move
+		std::vector<bool> locked(numVertices, false);
+		for (int h = 0; h < halfEdges.size(); h++) {
+			if (halfEdges[h].twin == NO_HALFEDGE) {
+				locked[halfEdges[h].origin] = true;
+				locked[halfEdges[Next(h)].origin] = true;
+			}
+		}
+		std::vector<bool> vertexRemoved(numVertices, false);
+		std::vector<uint32_t> versions(numVertices, 0);
+
+		std::priority_queue<EdgeCollapse, std::vector<EdgeCollapse>, std::greater<EdgeCollapse>> queue;
+		auto pushCollapse = [&](uint32_t keep, uint32_t remove) {
+			if (locked[keep] || locked[remove])
+				return;
+			EdgeQuadric quadric = quadrics[keep];
+			quadric.Add(quadrics[remove]);
+			glm::dvec3 a = positions[keep];
+			glm::dvec3 b = positions[remove];
+			glm::dvec3 target = (a + b) * 0.5;
+			double cost = quadric.Evaluate(target);
+			// the optimum is only trusted close to the edge, nearly flat regions put it anywhere
+			glm::dvec3 optimum;
+			if (quadric.Minimize(optimum) && glm::length(optimum - target) <= glm::length(b - a)) {
+				target = optimum;
+				cost = quadric.Evaluate(optimum);
+			}
+			for (glm::dvec3 end : { a, b }) {
+				double endCost = quadric.Evaluate(end);
+				if (endCost < cost) {
+					target = end;
+					cost = endCost;
+				}
+			}
+			queue.push({ (float)std::max(cost, 0.0), keep, remove, versions[keep], versions[remove], glm::vec3(target) });
+		};
+		for (uint32_t h = 0; h < halfEdges.size(); h++) {
+			if (halfEdges[h].twin == NO_HALFEDGE || h < halfEdges[h].twin)
+				pushCollapse(halfEdges[h].origin, halfEdges[Next(h)].origin);
+		}
+
+		std::vector<uint32_t> neighborsKeep;
+		std::vector<uint32_t> neighborsRemove;
+		auto gatherNeighbors = [&](uint32_t v, std::vector<uint32_t>& outNeighbors) {
+			outNeighbors.clear();
+			for (uint32_t f : vertexFaces[v]) {
+				if (faceRemoved[f]) continue;
+				for (int c = 0; c < 3; c++) {
+					if (faces[f][c] != v) outNeighbors.push_back(faces[f][c]);
+				}
+			}
+			std::sort(outNeighbors.begin(), outNeighbors.end());
+			outNeighbors.erase(std::unique(outNeighbors.begin(), outNeighbors.end()), outNeighbors.end());
+		};
+		// a face around the collapse must not turn over or degenerate when its corner moves to the target
+		auto flipsFace = [&](uint32_t f, uint32_t moved, glm::vec3 target) {
+			glm::vec3 corners[3] = { positions[faces[f].x], positions[faces[f].y], positions[faces[f].z] };
+			glm::vec3 oldNormal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+			for (int c = 0; c < 3; c++) {
+				if (faces[f][c] == moved) corners[c] = target;
+			}
+			glm::vec3 newNormal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+			float lengths = glm::length(oldNormal) * glm::length(newNormal);
+			return lengths <= 0.0f || glm::dot(oldNormal, newNormal) < 0.2f * lengths;
+		};
+
+		int liveFaces = numFaces;
+		float maxCost = 0.0f;
+		while (liveFaces > targetFaces && !queue.empty()) {
+			EdgeCollapse collapse = queue.top();
+			queue.pop();
+			uint32_t keep = collapse.m_Keep;
+			uint32_t remove = collapse.m_Remove;
+			if (vertexRemoved[keep] || vertexRemoved[remove] || versions[keep] != collapse.m_KeepVersion || versions[remove] != collapse.m_RemoveVersion)
+				continue;
+
+			// the link condition: the vertices next to both ends are exactly the tips of the faces on the edge,
+			// otherwise the collapse pinches the surface into a non-manifold edge
+			gatherNeighbors(keep, neighborsKeep);
+			gatherNeighbors(remove, neighborsRemove);
+			int sharedFaces = 0;
+			for (uint32_t f : vertexFaces[remove]) {
+				if (!faceRemoved[f] && (faces[f].x == keep || faces[f].y == keep || faces[f].z == keep)) sharedFaces++;
+			}
+			std::vector<uint32_t> common;
+			std::set_intersection(neighborsKeep.begin(), neighborsKeep.end(), neighborsRemove.begin(), neighborsRemove.end(), std::back_inserter(common));
+			if (sharedFaces == 0 || common.size() != sharedFaces)
+				continue;
+
+			bool flips = false;
+			for (uint32_t v : { keep, remove }) {
+				for (uint32_t f : vertexFaces[v]) {
+					if (faceRemoved[f]) continue;
+					bool onEdge = (faces[f].x == keep || faces[f].y == keep || faces[f].z == keep)
+						&& (faces[f].x == remove || faces[f].y == remove || faces[f].z == remove);
+					if (!onEdge && flipsFace(f, v, collapse.m_Target)) {
+						flips = true;
+						break;
+					}
+				}
+			}
+			if (flips)
+				continue;
+
+			for (uint32_t f : vertexFaces[remove]) {
+				if (faceRemoved[f]) continue;
+				if (faces[f].x == keep || faces[f].y == keep || faces[f].z == keep) {
+					faceRemoved[f] = true;
+					liveFaces--;
+					continue;
+				}
+				for (int c = 0; c < 3; c++) {
+					if (faces[f][c] == remove) faces[f][c] = keep;
+				}
+				vertexFaces[keep].push_back(f);
+			}
+			std::vector<uint32_t>& keepFaces = vertexFaces[keep];
+			keepFaces.erase(std::remove_if(keepFaces.begin(), keepFaces.end(), [&](uint32_t f) { return faceRemoved[f]; }), keepFaces.end());
+			vertexFaces[remove] = std::vector<uint32_t>();
+			vertexRemoved[remove] = true;
+
+			positions[keep] = collapse.m_Target;
+			glm::vec3 normal = normals[keep] + normals[remove];
+			if (glm::length(normal) > 0.0f)
+				normals[keep] = glm::normalize(normal);
+			quadrics[keep].Add(quadrics[remove]);
+			versions[keep]++;
+			maxCost = std::max(maxCost, collapse.m_Cost);
+
+			gatherNeighbors(keep, neighborsKeep);
+			for (uint32_t neighbor : neighborsKeep) {
+				pushCollapse(keep, neighbor);
+			}
+		}
+
+		// the remaining faces keep their order, their vertices are numbered in the order they are first used
+		std::vector<uint32_t> remap(numVertices, NO_HALFEDGE);
+		outMesh.vertices.clear();
+		outMesh.halfEdges.clear();
+		outMesh.halfEdges.reserve(3 * liveFaces);
+		for (int f = 0; f < numFaces; f++) {
+			if (faceRemoved[f]) continue;
+			for (int c = 0; c < 3; c++) {
+				uint32_t v = faces[f][c];
+				if (remap[v] == NO_HALFEDGE) {
+					remap[v] = outMesh.vertices.size();
+					outMesh.vertices.push_back({ positions[v], normals[v], NO_HALFEDGE });
+				}
+				outMesh.halfEdges.push_back({ remap[v], NO_HALFEDGE });
+			}
+		}
+		outMesh.ConnectHalfEdges();
+		outError = std::sqrt(maxCost);
+	}
+
+	int64_t HalfEdgeMesh::EstimateMemoryBytes() const {
+		return estimateVectorBytes(vertices) + estimateVectorBytes(halfEdges);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glm/ext/vector_float3.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace Copperplate {
+
+	const uint32_t NO_HALFEDGE = 0xffffffff;
+
+	// Half Edge data structure, all references are indices into the HalfEdgeMesh
+	struct HalfEdge {
+		uint32_t origin;
+		uint32_t twin;		//NO_HALFEDGE on borders
+	};
+
+	struct Vertex {
+		glm::vec3 position;
+		glm::vec3 normal;
+		uint32_t edge;		//one of the outgoing half edges
+	};
+
+	// Triangle mesh whose half edges are stored per face, the half edges of face f are 3f, 3f+1 and 3f+2 in
+	// order. Next, previous and face follow from the index, so only origin and twin are stored.
+	class HalfEdgeMesh {
+	public:
+
+		std::vector<Vertex> vertices;
+		std::vector<HalfEdge> halfEdges;
+
+		static uint32_t Next(uint32_t halfEdge) { return (halfEdge % 3 == 2) ? halfEdge - 2 : halfEdge + 1; };
+		static uint32_t Prev(uint32_t halfEdge) { return (halfEdge % 3 == 0) ? halfEdge + 2 : halfEdge - 1; };
+		static uint32_t GetFace(uint32_t halfEdge) { return halfEdge / 3; };
+
+		int GetNumFaces() const { return halfEdges.size() / 3; };
+		// Position of the corner of a face, corner 0 is the origin of its first half edge
+		glm::vec3 GetCorner(int face, int corner) const { return vertices[halfEdges[3 * face + corner].origin].position; };
+		float GetFaceArea(int face) const;
+		float GetTotalArea() const;
+		// Running sums of the face areas in face order, the last one is the total area
+		void ComputeAreaSums(std::vector<float>& outSums) const;
+
+		// Matches the twins and picks the outgoing edge of every vertex, only the origins have to be set.
+		// Runs in parallel over the faces.
+		void ConnectHalfEdges();
+
+		// Quadric edge collapse down to about targetFaces faces. Vertices on borders stay where they are and collapses
+		// that would fold a face over or make an edge non-manifold are skipped, so the result may keep more faces. The
+		// half edges of the result are connected, outError is an estimate of its largest distance to this surface.
+		void Simplify(int targetFaces, HalfEdgeMesh& outMesh, float& outError) const;
+
+		int64_t EstimateMemoryBytes() const;
+	};
+}
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 #include "hatching.h"
+#include "statistics.h"
 #include "utility.h"
 
+#include <algorithm>
 #include <random>
 #include <queue>
 
@@ -9,32 +11,44 @@ float GridCellSize = 8.0f;
 
 namespace Copperplate {
 
-	
-	float getFaceArea(Face& face) {
-		glm::vec3 a = face.outer->origin->position;
-		glm::vec3 b = face.outer->next->origin->position;
-		glm::vec3 c = face.outer->next->next->origin->position;
-		
-		glm::vec3 ab = b - a;
-		glm::vec3 ac = c - a;
-		return glm::length(glm::cross(ab, ac)) * 0.5f;
+	const char* getHatchingCostName(EHatchingCosts type) {
+		switch (type) {
+		case HC_CollisionQueries: return "collision queries";
+		case HC_SeedScans: return "seed scans";
+		case HC_RelaxEvaluations: return "relax evaluations";
+		case HC_ExtendSteps: return "extend steps";
+		case HC_NumCosts: return "all costs";
+		}
+		return "Unknown";
+	}
+
+	size_t ScreenSeedHash::operator()(const ScreenSpaceSeed* seed) const {
+		return std::hash<unsigned int>()(seed->m_Id);
 	}
 
-	Hatching::Hatching(int viewportWidth, int viewportHeight) {
+	Hatching::Hatching(int viewportWidth, int viewportHeight)
+		: m_SeedMemory(MC_Seeds)
+		, m_SeedGridMemory(MC_SeedGrids) {
 		m_ViewportSize = glm::vec2((float)viewportWidth, (float)viewportHeight);
+		m_RandomSeed = -1;
 		int gridSizeX = (int)(m_ViewportSize.x / GridCellSize) + 1;
 		int gridSizeY = (int)(m_ViewportSize.y / GridCellSize) + 1;
 		m_GridSize = glm::ivec2(gridSizeX, gridSizeY);
 
-		m_VisibleSeedsGrid = std::vector<std::unordered_set<ScreenSpaceSeed*>>();
+		m_VisibleSeedsGrid = std::vector<ScreenSeedSet>();
 		m_VisibleSeedsGrid.reserve(gridSizeX * gridSizeY);
 		
 		for (int i = 0; i < gridSizeX; i++) {
 			for (int j = 0; j < gridSizeY; j++) {
-				m_VisibleSeedsGrid.push_back(std::unordered_set<ScreenSpaceSeed*>());
+				m_VisibleSeedsGrid.push_back(ScreenSeedSet());
 			}
 		}
 
+		m_RecordCosts = false;
+		for (std::vector<int>& grid : m_CostGrids) {
+			grid = std::vector<int>(gridSizeX * gridSizeY, 0);
+		}
+
 		m_NormalData = CreateUnique<Image>(m_ViewportSize.x, m_ViewportSize.y);
 		m_CurvatureData = CreateUnique<Image>(m_ViewportSize.x, m_ViewportSize.y);
 		m_GradientData = CreateUnique<Image>(m_ViewportSize.x, m_ViewportSize.y);
@@ -48,74 +62,64 @@ namespace Copperplate {
 		m_Layers.push_back(CreateUnique<HatchingLayer>(m_GridSize, *this, settings));
 		//settings = HatchingSettings(3.0f, 20.0f, 10.0f, 1.5f, 3.0f, 0.7f, 1.0f, HD_ShadeNormal);
 		//m_Layers.push_back(CreateUnique<HatchingLayer>(m_GridSize, *this, settings));
-		
-		// setup opengl buffers
-		// Screen Space Seed Points
-		glGenVertexArrays(1, &m_ScreenSeedsVAO);
-		glGenBuffers(1, &m_ScreenSeedsVBO);
-
-		glBindVertexArray(m_ScreenSeedsVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_ScreenSeedsVBO);
-		glBufferData(GL_ARRAY_BUFFER, m_ScreenSeeds.size() * 2 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+	}
 
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (GLvoid*)0);
+	void Hatching::SetRandomSeed(int seed) {
+		m_RandomSeed = seed;
+	}
 
-		glCheckError();
+	int Hatching::GetRandomSeed() {
+		return m_RandomSeed;
 	}
 
-	void Hatching::CreateSeedPoints(std::vector<SeedPoint>& outSeedPoints, Mesh& mesh, unsigned int objectId, int totalPoints) {
-		//Setup Random
+	void Hatching::CreateSeedPoints(std::vector<SeedPoint>& outSeedPoints, const HalfEdgeMesh& mesh, const std::vector<float>& areaSums, unsigned int objectId, int totalPoints) {
+		//Setup Random, every object gets its own fixed seed so adding objects does not change the others
 		std::random_device rd;
-		std::mt19937 engine(rd());
-		std::uniform_real_distribution<> dist(0.0, 1.0);
-
-		HaltonSequence haltonImportance(3);
-		HaltonSequence haltonFaceSelect(7);
-
-		std::vector<Face>& faces = mesh.GetFaces();
-		float totalArea = mesh.GetTotalArea();
-		// construct vector of summed face areas for face selection
-		std::vector<float> summedAreas;
-		summedAreas.reserve(faces.size());
-		float sum = 0.0f;
-		for (int i = 0; i < faces.size(); i++) {
-			sum += getFaceArea(faces[i]);
-			summedAreas.push_back(sum);
-		}
-
-		unsigned int seedId = 0;
-		for (int i = 0; i < totalPoints; i++) {
-			// pseudo-randomly select a face weighted by its area
-			float faceSelect = haltonFaceSelect.NextNumber() * totalArea;
-			int index = 0;
-			for (int i = 0; i < summedAreas.size(); i++) {
-				if (summedAreas[i] > faceSelect) {
-					index = i;
-					break;
+		unsigned int seed = (m_RandomSeed < 0) ? rd() : (unsigned int)m_RandomSeed + objectId;
+		if (areaSums.empty())
+			return;
+
+		float totalArea = areaSums.back();
+		int firstPoint = outSeedPoints.size();
+		outSeedPoints.resize(firstPoint + totalPoints);
+		// every block has its own random stream and its own part of the halton sequences
+		int numBlocks = (totalPoints + SEED_BLOCK_SIZE - 1) / SEED_BLOCK_SIZE;
+		parallelFor(numBlocks, [&](int beginBlock, int endBlock) {
+			for (int block = beginBlock; block < endBlock; block++) {
+				std::seed_seq blockSeed = { seed, (unsigned int)block };
+				std::mt19937 engine(blockSeed);
+				std::uniform_real_distribution<> dist(0.0, 1.0);
+				int end = std::min(totalPoints, (block + 1) * SEED_BLOCK_SIZE);
+				for (int i = block * SEED_BLOCK_SIZE; i < end; i++) {
+					// pseudo-randomly select a face weighted by its area, the first one whose running sum exceeds the sample
+					float faceSelect = HaltonSequence::Get(7, i + 1) * totalArea;
+					int index = std::upper_bound(areaSums.begin(), areaSums.end(), faceSelect) - areaSums.begin();
+					index = std::min(index, (int)areaSums.size() - 1);
+
+					// construct a new Seed Point at a random position within the face
+					glm::vec3 v1 = mesh.GetCorner(index, 0);
+					glm::vec3 v2 = mesh.GetCorner(index, 1);
+					glm::vec3 v3 = mesh.GetCorner(index, 2);
+					float a = dist(engine);
+					float b = dist(engine);
+					float c = dist(engine);
+					float sum = a + b + c;
+					a /= sum;
+					b /= sum;
+					c /= sum;
+					glm::vec3 pos = (a * v1) + (b * v2) + (c * v3);
+					float importance = HaltonSequence::Get(3, i + 1);
+					outSeedPoints[firstPoint + i] = { pos, index, importance, (unsigned int)i + 1 };
 				}
 			}
+		}, 1);
+	}
 
-			// construct a new Seed Point at a random position within the face
-			Face face = faces[index];
-			seedId++;
-			glm::vec3 v1 = face.outer->origin->position;
-			glm::vec3 v2 = face.outer->next->origin->position;
-			glm::vec3 v3 = face.outer->next->next->origin->position;
-			float a = dist(engine);
-			float b = dist(engine);
-			float c = dist(engine);
-			float sum = a + b + c;
-			a /= sum;
-			b /= sum;
-			c /= sum;
-			glm::vec3 pos = (a * v1) + (b * v2) + (c * v3);
-			float importance = haltonImportance.NextNumber();
-			SeedPoint sp = { pos, face, importance, seedId };
-			outSeedPoints.push_back(sp);
-
-			unsigned int id = (objectId << 16) + seedId;
-			ScreenSpaceSeed ssp = { glm::vec2(pos), importance, id, false };
+	void Hatching::AddSeedPoints(const std::vector<SeedPoint>& seedPoints, unsigned int objectId) {
+		ReserveScreenSeeds(seedPoints.size());
+		for (const SeedPoint& sp : seedPoints) {
+			unsigned int id = (objectId << 16) + sp.m_Id;
+			ScreenSpaceSeed ssp = { glm::vec2(sp.m_Pos), sp.m_Importance, id, false };
 			m_ScreenSeeds.push_back(ssp);
 		}
 
@@ -141,52 +145,132 @@ namespace Copperplate {
 	}
 	
 	void Hatching::CreateHatchingLines() {
+		if (m_RecordCosts) {
+			for (std::vector<int>& grid : m_CostGrids) {
+				std::fill(grid.begin(), grid.end(), 0);
+			}
+		}
 		PrepareForHatching();
 
 		for (auto& layer : m_Layers) {
 			layer->Update();
-		}		
-		
-		FillGLBuffers();
-	}
-	
-	void Hatching::DrawScreenSeeds() {
-		glBindVertexArray(m_ScreenSeedsVAO);
-		glDrawArrays(GL_POINTS, 0, m_NumVisibleScreenSeeds);
+		}
+		UpdateMemoryCounters();
 	}
 
-	void Hatching::DrawHatchingLines(Shared<Shader> shader) {
+	void Hatching::ClearLines() {
 		for (auto& layer : m_Layers) {
-			layer->Draw(shader);
+			layer->ClearLines();
 		}
 	}
 
-	void Hatching::DrawCollisionPoints() {
-		for (auto& layer : m_Layers) {
-			layer->DrawCollision();
-		}
+	void Hatching::SetBlockedRegions(const std::vector<glm::vec4>& regions) {
+		m_BlockedRegions = regions;
+	}
+	
+	float* Hatching::GetFieldData(EHatchingFields field) {
+		return GetField(field)->GetData();
+	}
+
+	void Hatching::SetFieldData(EHatchingFields field, const float* data) {
+		GetField(field)->SetData(data);
+	}
+
+	const std::vector<ScreenSpaceSeed>& Hatching::GetScreenSeeds() {
+		return m_ScreenSeeds;
 	}
 
-	void Hatching::GrabNormalData() {
-		m_NormalData->CopyFrameBuffer();
+	void Hatching::AddScreenSeeds(const std::vector<ScreenSpaceSeed>& seeds) {
+		ReserveScreenSeeds(seeds.size());
+		m_ScreenSeeds.insert(m_ScreenSeeds.end(), seeds.begin(), seeds.end());
+		UpdateScreenSeedIdMap();
 	}
 
-	void Hatching::GrabCurvatureData() {
-		m_CurvatureData->CopyFrameBuffer();
+	void Hatching::SetScreenSeed(int index, glm::vec2 screenPos, bool visible) {
+		m_ScreenSeeds[index].m_Pos = screenPos;
+		m_ScreenSeeds[index].m_Visible = visible;
 	}
 
-	void Hatching::GrabGradientData() {
-		m_GradientData->CopyFrameBuffer();
+	const std::vector<Unique<HatchingLayer>>& Hatching::GetLayers() {
+		return m_Layers;
 	}
 
-	void Hatching::GrabMovementData() {
-		m_MovementData->CopyFrameBuffer();
+	glm::vec2 Hatching::GetViewportSize() {
+		return m_ViewportSize;
 	}
 
 	glm::vec2 Hatching::SampleMovement(glm::vec2 point) {
 		return ViewToScreen(glm::vec2(m_MovementData->Sample(point)));
 	}
 
+	float Hatching::SampleShade(glm::vec2 point) {
+		return 1.0f - abs(GetField(HF_Shading)->Sample(point).x);
+	}
+
+	void Hatching::SetCostRecording(bool enabled) {
+		m_RecordCosts = enabled;
+	}
+
+	bool Hatching::IsRecordingCosts() {
+		return m_RecordCosts;
+	}
+
+	int Hatching::GetCost(EHatchingCosts type, glm::ivec2 gridPos) {
+		int index = gridPos.y * m_GridSize.x + gridPos.x;
+		if (type != HC_NumCosts)
+			return m_CostGrids[type][index];
+		int sum = 0;
+		for (const std::vector<int>& grid : m_CostGrids) {
+			sum += grid[index];
+		}
+		return sum;
+	}
+
+	glm::ivec2 Hatching::GetGridSize() {
+		return m_GridSize;
+	}
+
+	void Hatching::BuildCostHeatmap(EHatchingCosts type, std::vector<unsigned char>& outPixels) {
+		outPixels.resize(m_GridSize.x * m_GridSize.y * 4);
+		int maxCost = 1;
+		for (int y = 0; y < m_GridSize.y; y++) {
+			for (int x = 0; x < m_GridSize.x; x++) {
+				maxCost = std::max(maxCost, GetCost(type, glm::ivec2(x, y)));
+			}
+		}
+		for (int y = 0; y < m_GridSize.y; y++) {
+			for (int x = 0; x < m_GridSize.x; x++) {
+				// the square root keeps moderately busy cells visible next to the hot spots
+				float heat = sqrt((float)GetCost(type, glm::ivec2(x, y)) / maxCost);
+				// black body ramp: dark red, yellow, white
+				glm::vec3 color = glm::clamp(glm::vec3(heat * 3.0f, heat * 3.0f - 1.0f, heat * 3.0f - 2.0f), 0.0f, 1.0f);
+				unsigned char* pixel = &outPixels[(y * m_GridSize.x + x) * 4];
+				pixel[0] = (unsigned char)(color.r * 255.0f);
+				pixel[1] = (unsigned char)(color.g * 255.0f);
+				pixel[2] = (unsigned char)(color.b * 255.0f);
+				pixel[3] = (unsigned char)(std::min(heat * 2.0f, 0.85f) * 255.0f);
+			}
+		}
+	}
+
+	void Hatching::SaveCostHeatmap(const std::string& path, EHatchingCosts type) {
+		std::vector<unsigned char> cells;
+		BuildCostHeatmap(type, cells);
+		// scale the cells up to the viewport so the image lines up with screenshots, without transparency
+		glm::ivec2 size = glm::ivec2(m_ViewportSize);
+		std::vector<unsigned char> pixels(size.x * size.y * 3);
+		for (int y = 0; y < size.y; y++) {
+			for (int x = 0; x < size.x; x++) {
+				glm::ivec2 gridPos = glm::min(glm::ivec2(x, y) / (int)GridCellSize, m_GridSize - glm::ivec2(1));
+				const unsigned char* cell = &cells[(gridPos.y * m_GridSize.x + gridPos.x) * 4];
+				for (int c = 0; c < 3; c++) {
+					pixels[(y * size.x + x) * 3 + c] = cell[c];
+				}
+			}
+		}
+		writePngImage(path, size, pixels.data(), 3);
+	}
+
 	void Hatching::SetLayer1Direction(EHatchingDirections newDir) {
 		m_Layers.front()->m_Settings.m_Direction = newDir;
 	}
@@ -209,11 +293,11 @@ namespace Copperplate {
 	// PRIVATE FUNCTIONS //
 		
 	void Hatching::PrepareForHatching() {
+		TIME_SCOPE("Hatching::PrepareForHatching");
 		// Reset Screen Seed Grid
 		for (int i = 0; i < m_VisibleSeedsGrid.size(); i++) {
 			m_VisibleSeedsGrid[i].clear();
 		}
-		m_NumVisibleScreenSeeds = 0;
 		// Fill Screen Seed Grid, this already omits seeds that collide with the contours
 		for (ScreenSpaceSeed& seed : m_ScreenSeeds) {
 			//TODO: is it a problem if i dont check for collision here?
@@ -226,6 +310,7 @@ namespace Copperplate {
 	}
 
 	std::vector<ScreenSpaceSeed*> Hatching::FindVisibleSeedsInRadius(glm::vec2 point, float radius) {
+		CountCost(HC_SeedScans, point);
 		std::vector<ScreenSpaceSeed*> out;
 		if (IsInBounds(point)) {
 			glm::ivec2 gridCenter = ScreenPosToGridPos(point);
@@ -233,7 +318,7 @@ namespace Copperplate {
 				for (int y = -1; y <= 1; y++) {
 					glm::ivec2 gridPos = gridCenter + glm::ivec2(x, y);
 					gridPos = glm::clamp(gridPos, glm::ivec2(0), (m_GridSize - glm::ivec2(1)));
-					std::unordered_set<ScreenSpaceSeed*>& gridCell = *GetVisibleScreenSeeds(gridPos);
+					ScreenSeedSet& gridCell = *GetVisibleScreenSeeds(gridPos);
 					for (ScreenSpaceSeed* seed : gridCell) {
 						if (glm::distance(point, seed->m_Pos) <= radius) {
 							out.push_back(seed);
@@ -245,20 +330,18 @@ namespace Copperplate {
 		return out;
 	}
 	
-	void Hatching::FillGLBuffers() {
-		// Fill Buffers for Screen Space Seeds
-		std::vector<glm::vec2> screenSeedPos;
-		for (ScreenSpaceSeed& seed : m_ScreenSeeds) {
-			if (seed.m_Visible) {
-				screenSeedPos.push_back(ScreenToView(seed.m_Pos));
-				m_NumVisibleScreenSeeds++;
-			}
+	Image* Hatching::GetField(EHatchingFields field) {
+		switch (field) {
+		case HF_Normals: return m_NormalData.get();
+		case HF_Curvature: return m_CurvatureData.get();
+		case HF_ShadingGradient: return m_GradientData.get();
+		case HF_Movement: return m_MovementData.get();
+		case HF_Shading:
+			if (!m_ShadingData)
+				m_ShadingData = CreateUnique<Image>(m_ViewportSize.x, m_ViewportSize.y);
+			return m_ShadingData.get();
 		}
-
-		glBindVertexArray(m_ScreenSeedsVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_ScreenSeedsVBO);
-		glBufferData(GL_ARRAY_BUFFER, screenSeedPos.size() * 2 * sizeof(float), screenSeedPos.data(), GL_DYNAMIC_DRAW);
-
+		return nullptr;
 	}
 	
 	void Hatching::UpdateScreenSeedIdMap() {
@@ -266,9 +349,39 @@ namespace Copperplate {
 		for (ScreenSpaceSeed& seed : m_ScreenSeeds) {
 			m_ScreenSeedIdMap[seed.m_Id] = &seed;
 		}
+		m_SeedMemory.Set(estimateVectorBytes(m_ScreenSeeds) + estimateNodeBytes(m_ScreenSeedIdMap));
+	}
+
+	void Hatching::ReserveScreenSeeds(size_t count) {
+		size_t size = m_ScreenSeeds.size() + count;
+		if (size <= m_ScreenSeeds.capacity())
+			return;
+		// the old seeds stay alive until the lines point to the new ones
+		std::vector<ScreenSpaceSeed> seeds;
+		seeds.reserve(std::max(size, 2 * m_ScreenSeeds.capacity()));
+		seeds.assign(m_ScreenSeeds.begin(), m_ScreenSeeds.end());
+		for (auto& layer : m_Layers) {
+			layer->RebaseSeeds(m_ScreenSeeds.data(), seeds.data());
+		}
+		m_ScreenSeeds.swap(seeds);
 	}
 
-	std::unordered_set<ScreenSpaceSeed*>* Hatching::GetVisibleScreenSeeds(glm::ivec2 gridPos) {
+	void Hatching::UpdateMemoryCounters() {
+		TIME_SCOPE("Hatching::UpdateMemoryCounters");
+		m_SeedMemory.Set(estimateVectorBytes(m_ScreenSeeds) + estimateNodeBytes(m_ScreenSeedIdMap));
+
+		int64_t seedGridBytes = estimateVectorBytes(m_VisibleSeedsGrid);
+		for (const ScreenSeedSet& gridCell : m_VisibleSeedsGrid) {
+			seedGridBytes += estimateHashSetBytes(gridCell);
+		}
+		m_SeedGridMemory.Set(seedGridBytes);
+
+		for (auto& layer : m_Layers) {
+			layer->UpdateMemoryCounters();
+		}
+	}
+
+	ScreenSeedSet* Hatching::GetVisibleScreenSeeds(glm::ivec2 gridPos) {
 		return &m_VisibleSeedsGrid[gridPos.y * m_GridSize.x + gridPos.x];
 	}
 
@@ -318,7 +431,23 @@ namespace Copperplate {
 		return glm::ivec2(x, y);
 	}
 
+	void Hatching::CountCost(EHatchingCosts type, glm::vec2 screenPos) {
+		if (!m_RecordCosts || !IsInBounds(screenPos)) return;
+		glm::ivec2 gridPos = glm::clamp(ScreenPosToGridPos(screenPos), glm::ivec2(0), m_GridSize - glm::ivec2(1));
+		m_CostGrids[type][gridPos.y * m_GridSize.x + gridPos.x]++;
+	}
+
 	bool Hatching::IsInBounds(glm::vec2 screenPos) {
+		if (!IsInViewport(screenPos))
+			return false;
+		for (const glm::vec4& region : m_BlockedRegions) {
+			if (screenPos.x >= region.x && screenPos.x < region.z && screenPos.y >= region.y && screenPos.y < region.w)
+				return false;
+		}
+		return true;
+	}
+
+	bool Hatching::IsInViewport(glm::vec2 screenPos) {
 		return (screenPos.x > 0 && screenPos.x < m_ViewportSize.x
 			&& screenPos.y > 0 && screenPos.y < m_ViewportSize.y);
 	}
@@ -1,13 +1,17 @@
 #pragma once
+#include "halfedge.h"
 #include "hatchinglayer.h"
-#include "mesh.h"
 #include "image.h"
 
+#include <map>
+
 namespace Copperplate {
 
+	const int SEED_BLOCK_SIZE = 1024;	//seeds sharing one random stream, blocks are created in parallel
+
 	struct SeedPoint {
 		glm::vec3 m_Pos;
-		Face& m_Face;
+		int m_Face;		//index into the faces of the HalfEdgeMesh
 		float m_Importance;
 		unsigned int m_Id;
 	};
@@ -18,14 +22,32 @@ namespace Copperplate {
 		unsigned int m_Id;
 		bool m_Visible;
 	};	
+
+	// The screen space fields the strokes are guided by, one RGBA float image each
+	enum EHatchingFields {
+		HF_Normals,
+		HF_Curvature,
+		HF_ShadingGradient,
+		HF_Movement,
+		HF_Shading,		//diffuse lighting, only read back for vector exports
+	};
 	
 	class Hatching {
 		friend class HatchingLayer;
+		friend class HatchingFixture;	//microbenchmarks of the private hot paths
 	public:
 		
 		Hatching(int viewportWidth, int viewportHeight);
 	
-		void CreateSeedPoints(std::vector<SeedPoint>& outSeedPoints, Mesh& mesh, unsigned int objectId, int totalPoints);
+		// a negative seed uses a nondeterministic random device
+		void SetRandomSeed(int seed);
+		int GetRandomSeed();
+		// Places the seeds on the faces weighted by their area, areaSums are the running sums of HalfEdgeMesh::ComputeAreaSums.
+		// The object id only picks the random sequence, the seeds are used once they are added. The result does
+		// not depend on the number of threads the blocks of seeds are spread over.
+		void CreateSeedPoints(std::vector<SeedPoint>& outSeedPoints, const HalfEdgeMesh& mesh, const std::vector<float>& areaSums, unsigned int objectId, int totalPoints);
+		// Registers the seed points as screen seeds of the object, objects placing the same mesh share its seed points
+		void AddSeedPoints(const std::vector<SeedPoint>& seedPoints, unsigned int objectId);
 
 		void ResetCollisions();
 
@@ -33,21 +55,43 @@ namespace Copperplate {
 		void AddContourCollision(const std::vector<glm::vec2>& contourSegments);
 
 		void CreateHatchingLines();
-
-		void DrawScreenSeeds();
-		void DrawHatchingLines(Shared<Shader> shader);
-		void DrawCollisionPoints();
-				
-		void GrabNormalData();
-		void GrabCurvatureData();
-		void GrabGradientData();
-		void GrabMovementData();
+		void ClearLines();
+
+		// Screen rectangles as min and max corner that count as out of bounds, no line enters them and their seeds
+		// are ignored. Tiled renders block the tiles that are already finished.
+		void SetBlockedRegions(const std::vector<glm::vec4>& regions);
+
+		// Row major RGBA floats of the viewport size, the pointer can be written to directly
+		float* GetFieldData(EHatchingFields field);
+		void SetFieldData(EHatchingFields field, const float* data);
+
+		const std::vector<ScreenSpaceSeed>& GetScreenSeeds();
+		// Seeds that do not come from a mesh, e.g. when replaying a capture
+		void AddScreenSeeds(const std::vector<ScreenSpaceSeed>& seeds);
+		void SetScreenSeed(int index, glm::vec2 screenPos, bool visible);
+		const std::vector<Unique<HatchingLayer>>& GetLayers();
+		glm::vec2 GetViewportSize();
 		
 		bool IsInBounds(glm::vec2 screenPos);
+		// Ignores the blocked regions, collision is kept there so lines keep their distance to the blocked lines
+		bool IsInViewport(glm::vec2 screenPos);
 		glm::vec2 ViewToScreen(glm::vec2 screenPos);
 		glm::vec2 ScreenToView(glm::vec2 pixPos);
 
 		glm::vec2 SampleMovement(glm::vec2 point);	
+		// Darkness in [0, 1] the way hatching.geom derives the line width from the shading field
+		float SampleShade(glm::vec2 point);
+
+		// Counting is off by default, it adds a grid lookup to the innermost loops
+		void SetCostRecording(bool enabled);
+		bool IsRecordingCosts();
+		// Work of the last CreateHatchingLines in one grid cell
+		int GetCost(EHatchingCosts type, glm::ivec2 gridPos);
+		glm::ivec2 GetGridSize();
+		// RGBA with one pixel per grid cell, rows start at the bottom like the GL framebuffers.
+		// Cells without work are transparent, the hottest cell is opaque white.
+		void BuildCostHeatmap(EHatchingCosts type, std::vector<unsigned char>& outPixels);
+		void SaveCostHeatmap(const std::string& path, EHatchingCosts type);
 
 		//DEBUG
 		void SetLayer1Direction(EHatchingDirections newDir);
@@ -58,18 +102,24 @@ namespace Copperplate {
 		std::vector<ScreenSpaceSeed*> FindVisibleSeedsInRadius(glm::vec2 point, float radius);
 
 		void PrepareForHatching();
-		void FillGLBuffers();
+		Image* GetField(EHatchingFields field);
 
 		void UpdateScreenSeedIdMap();
+		// Objects can join while lines exist, their seed pointers follow the screen seeds when these move
+		void ReserveScreenSeeds(size_t count);
+		void UpdateMemoryCounters();
 
-		std::unordered_set<ScreenSpaceSeed*>* GetVisibleScreenSeeds(glm::ivec2 gridPos);
+		ScreenSeedSet* GetVisibleScreenSeeds(glm::ivec2 gridPos);
 				
 		glm::vec2 GetHatchingDir(glm::vec2 screenPos, EHatchingDirections direction);
 		ScreenSpaceSeed* GetScreenSeedById(unsigned int id);
 		glm::ivec2 ScreenPosToGridPos(glm::vec2 screenPos);
+		void CountCost(EHatchingCosts type, glm::vec2 screenPos);
 
 		// Member Variables
 		glm::vec2 m_ViewportSize;
+		int m_RandomSeed;
+		std::vector<glm::vec4> m_BlockedRegions;
 
 		std::vector<Unique<HatchingLayer>> m_Layers;
 
@@ -77,16 +127,19 @@ namespace Copperplate {
 		std::map<unsigned int, ScreenSpaceSeed*> m_ScreenSeedIdMap;
 		
 		glm::ivec2 m_GridSize;
-		std::vector<std::unordered_set<ScreenSpaceSeed*>> m_VisibleSeedsGrid;
+		std::vector<ScreenSeedSet> m_VisibleSeedsGrid;
+
+		MemoryCounter m_SeedMemory;
+		MemoryCounter m_SeedGridMemory;
+
+		bool m_RecordCosts;
+		std::vector<int> m_CostGrids[HC_NumCosts];
 
 		Unique<Image> m_NormalData;
 		Unique<Image> m_CurvatureData;
 		Unique<Image> m_GradientData;
 		Unique<Image> m_MovementData;
-
-		unsigned int m_ScreenSeedsVAO;
-		unsigned int m_ScreenSeedsVBO;
-		int m_NumVisibleScreenSeeds;
+		Unique<Image> m_ShadingData;	//created on first use
 	};
 	
 
@@ -0,0 +1,294 @@
+#pragma once
+
+#include "hatchingcapture.h"
+
+#include <cstring>
+
+namespace Copperplate {
+
+	uint32_t floatToWord(float value) {
+		uint32_t word;
+		std::memcpy(&word, &value, sizeof(float));
+		return word;
+	}
+
+	float wordToFloat(uint32_t word) {
+		float value;
+		std::memcpy(&value, &word, sizeof(float));
+		return value;
+	}
+
+	void writeWord(std::ofstream& file, uint32_t word) {
+		file.write((const char*)&word, sizeof(uint32_t));
+	}
+
+	bool readWord(std::ifstream& file, uint32_t& outWord) {
+		file.read((char*)&outWord, sizeof(uint32_t));
+		return (bool)file;
+	}
+
+	void writeMatrix(std::ofstream& file, const glm::mat4& matrix) {
+		file.write((const char*)&matrix[0][0], sizeof(glm::mat4));
+	}
+
+	bool readMatrix(std::ifstream& file, glm::mat4& outMatrix) {
+		file.read((char*)&outMatrix[0][0], sizeof(glm::mat4));
+		return (bool)file;
+	}
+
+	// HATCHING CAPTURE WRITER IMPLEMENTATION
+	HatchingCaptureWriter::HatchingCaptureWriter() {
+		m_NumFrames = 0;
+		m_Contours = std::vector<glm::vec2>();
+		m_View = glm::mat4(1.0f);
+		m_Projection = glm::mat4(1.0f);
+		m_CameraChanged = true;
+	}
+
+	bool HatchingCaptureWriter::Open(const std::string& path, Hatching& hatching) {
+		m_File.open(path, std::ios::binary | std::ios::trunc);
+		if (!m_File.is_open()) {
+			std::cout << "Could not open capture file " << path << std::endl;
+			return false;
+		}
+
+		glm::ivec2 size = glm::ivec2(hatching.GetViewportSize());
+		const std::vector<ScreenSpaceSeed>& seeds = hatching.GetScreenSeeds();
+		writeWord(m_File, CAPTURE_MAGIC);
+		writeWord(m_File, CAPTURE_VERSION);
+		writeWord(m_File, size.x);
+		writeWord(m_File, size.y);
+		writeWord(m_File, seeds.size());
+		for (const ScreenSpaceSeed& seed : seeds) {
+			writeWord(m_File, seed.m_Id);
+			writeWord(m_File, floatToWord(seed.m_Importance));
+		}
+
+		for (int i = 0; i < CAPTURE_NUM_FIELDS; i++) {
+			m_PrevFields[i] = std::vector<uint32_t>(size.x * size.y * 2, 0);
+		}
+		m_PrevSeeds = std::vector<uint32_t>(seeds.size() * 3, 0);
+		return true;
+	}
+
+	void HatchingCaptureWriter::AddContours(const std::vector<glm::vec2>& contourSegments) {
+		m_Contours.insert(m_Contours.end(), contourSegments.begin(), contourSegments.end());
+	}
+
+	void HatchingCaptureWriter::SetCamera(const glm::mat4& view, const glm::mat4& projection) {
+		if (view != m_View || projection != m_Projection)
+			m_CameraChanged = true;
+		m_View = view;
+		m_Projection = projection;
+	}
+
+	void HatchingCaptureWriter::WriteFrame(Hatching& hatching) {
+		if (!m_File.is_open()) return;
+		// the header lists the seeds once, frames with other seeds could not be replayed
+		if (hatching.GetScreenSeeds().size() * 3 != m_PrevSeeds.size()) {
+			std::cout << "Capture stopped after " << m_NumFrames << " frames, the number of seeds changed" << std::endl;
+			m_File.close();
+			return;
+		}
+
+		writeWord(m_File, m_NumFrames);
+
+		// Camera, only written when it moved
+		writeWord(m_File, m_CameraChanged ? 1 : 0);
+		if (m_CameraChanged) {
+			writeMatrix(m_File, m_View);
+			writeMatrix(m_File, m_Projection);
+			m_CameraChanged = false;
+		}
+
+		// Fields, only the xy channels are used by the simulation
+		std::vector<uint32_t> words;
+		for (int i = 0; i < CAPTURE_NUM_FIELDS; i++) {
+			const float* data = hatching.GetFieldData((EHatchingFields)i);
+			words.resize(m_PrevFields[i].size());
+			for (int pixel = 0; pixel < words.size() / 2; pixel++) {
+				words[pixel * 2] = floatToWord(data[pixel * 4]);
+				words[pixel * 2 + 1] = floatToWord(data[pixel * 4 + 1]);
+			}
+			WriteStream(words, m_PrevFields[i]);
+		}
+
+		// Seeds
+		const std::vector<ScreenSpaceSeed>& seeds = hatching.GetScreenSeeds();
+		words.resize(seeds.size() * 3);
+		for (int i = 0; i < seeds.size(); i++) {
+			words[i * 3] = floatToWord(seeds[i].m_Pos.x);
+			words[i * 3 + 1] = floatToWord(seeds[i].m_Pos.y);
+			words[i * 3 + 2] = seeds[i].m_Visible ? 1 : 0;
+		}
+		WriteStream(words, m_PrevSeeds);
+
+		// Contours
+		writeWord(m_File, m_Contours.size());
+		m_File.write((const char*)m_Contours.data(), m_Contours.size() * sizeof(glm::vec2));
+		m_Contours.clear();
+
+		m_NumFrames++;
+	}
+
+	int HatchingCaptureWriter::GetNumFrames() {
+		return m_NumFrames;
+	}
+
+	void HatchingCaptureWriter::WriteStream(const std::vector<uint32_t>& words, std::vector<uint32_t>& previous) {
+		// encoded as pairs of (number of zero words, number of literal words) followed by the literals
+		std::vector<uint32_t> encoded;
+		int i = 0;
+		while (i < words.size()) {
+			uint32_t zeros = 0;
+			while (i < words.size() && (words[i] ^ previous[i]) == 0) {
+				zeros++;
+				i++;
+			}
+			int literalStart = i;
+			while (i < words.size() && (words[i] ^ previous[i]) != 0) {
+				i++;
+			}
+			encoded.push_back(zeros);
+			encoded.push_back(i - literalStart);
+			for (int j = literalStart; j < i; j++) {
+				encoded.push_back(words[j] ^ previous[j]);
+			}
+		}
+		previous = words;
+
+		writeWord(m_File, encoded.size());
+		m_File.write((const char*)encoded.data(), encoded.size() * sizeof(uint32_t));
+	}
+
+	// HATCHING CAPTURE READER IMPLEMENTATION
+	HatchingCaptureReader::HatchingCaptureReader() {
+		m_ViewportSize = glm::ivec2(0);
+		m_Seeds = std::vector<ScreenSpaceSeed>();
+		m_Contours = std::vector<glm::vec2>();
+		m_View = glm::mat4(1.0f);
+		m_Projection = glm::mat4(1.0f);
+	}
+
+	bool HatchingCaptureReader::Open(const std::string& path) {
+		m_Path = path;
+		m_File.open(path, std::ios::binary);
+		if (!m_File.is_open()) {
+			std::cout << "Could not open capture file " << path << std::endl;
+			return false;
+		}
+
+		uint32_t magic, version, width, height, numSeeds;
+		if (!readWord(m_File, magic) || !readWord(m_File, version) || magic != CAPTURE_MAGIC || version != CAPTURE_VERSION) {
+			std::cout << path << " is not a hatching capture of version " << CAPTURE_VERSION << std::endl;
+			return false;
+		}
+		if (!readWord(m_File, width) || !readWord(m_File, height) || !readWord(m_File, numSeeds)) {
+			std::cout << "Capture " << path << " has a broken header" << std::endl;
+			return false;
+		}
+		m_ViewportSize = glm::ivec2(width, height);
+
+		m_Seeds.reserve(numSeeds);
+		for (uint32_t i = 0; i < numSeeds; i++) {
+			uint32_t id, importance;
+			if (!readWord(m_File, id) || !readWord(m_File, importance)) {
+				std::cout << "Capture " << path << " has a broken seed list" << std::endl;
+				return false;
+			}
+			m_Seeds.push_back({ glm::vec2(0.0f), wordToFloat(importance), id, false });
+		}
+
+		for (int i = 0; i < CAPTURE_NUM_FIELDS; i++) {
+			m_Fields[i] = std::vector<uint32_t>(width * height * 2, 0);
+		}
+		m_SeedStates = std::vector<uint32_t>(numSeeds * 3, 0);
+		m_FieldBuffer = std::vector<float>(width * height * 4, 0.0f);
+		return true;
+	}
+
+	Unique<Hatching> HatchingCaptureReader::CreateHatching() {
+		Unique<Hatching> hatching = CreateUnique<Hatching>(m_ViewportSize.x, m_ViewportSize.y);
+		hatching->AddScreenSeeds(m_Seeds);
+		return hatching;
+	}
+
+	bool HatchingCaptureReader::ReadFrame() {
+		uint32_t frameNumber, cameraChanged;
+		if (!readWord(m_File, frameNumber)) return false;
+
+		if (!readWord(m_File, cameraChanged)) return false;
+		if (cameraChanged) {
+			if (!readMatrix(m_File, m_View) || !readMatrix(m_File, m_Projection)) return false;
+		}
+
+		for (int i = 0; i < CAPTURE_NUM_FIELDS; i++) {
+			if (!ReadStream(m_Fields[i])) return false;
+		}
+		if (!ReadStream(m_SeedStates)) return false;
+
+		uint32_t numContourPoints;
+		if (!readWord(m_File, numContourPoints)) return false;
+		m_Contours.resize(numContourPoints);
+		m_File.read((char*)m_Contours.data(), numContourPoints * sizeof(glm::vec2));
+		if (!m_File) {
+			std::cout << "Capture " << m_Path << " ends in the middle of frame " << frameNumber << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	void HatchingCaptureReader::ApplyFrame(Hatching& hatching) {
+		hatching.ResetCollisions();
+
+		for (int i = 0; i < CAPTURE_NUM_FIELDS; i++) {
+			const std::vector<uint32_t>& field = m_Fields[i];
+			for (int pixel = 0; pixel < field.size() / 2; pixel++) {
+				m_FieldBuffer[pixel * 4] = wordToFloat(field[pixel * 2]);
+				m_FieldBuffer[pixel * 4 + 1] = wordToFloat(field[pixel * 2 + 1]);
+			}
+			hatching.SetFieldData((EHatchingFields)i, m_FieldBuffer.data());
+		}
+
+		for (int i = 0; i < m_Seeds.size(); i++) {
+			glm::vec2 pos = glm::vec2(wordToFloat(m_SeedStates[i * 3]), wordToFloat(m_SeedStates[i * 3 + 1]));
+			hatching.SetScreenSeed(i, pos, m_SeedStates[i * 3 + 2] != 0);
+		}
+
+		hatching.AddContourCollision(m_Contours);
+	}
+
+	const glm::mat4& HatchingCaptureReader::GetView() {
+		return m_View;
+	}
+
+	const glm::mat4& HatchingCaptureReader::GetProjection() {
+		return m_Projection;
+	}
+
+	bool HatchingCaptureReader::ReadStream(std::vector<uint32_t>& inOutWords) {
+		uint32_t encodedSize;
+		if (!readWord(m_File, encodedSize)) return false;
+		std::vector<uint32_t> encoded(encodedSize);
+		m_File.read((char*)encoded.data(), encodedSize * sizeof(uint32_t));
+		if (!m_File) return false;
+
+		// undo the run length encoding and the xor with the previous frame
+		int pos = 0;
+		int i = 0;
+		while (i + 1 < encoded.size()) {
+			uint32_t zeros = encoded[i];
+			uint32_t literals = encoded[i + 1];
+			i += 2;
+			pos += zeros;
+			if (pos + literals > inOutWords.size() || i + literals > encoded.size()) {
+				std::cout << "Capture " << m_Path << " contains a corrupt stream" << std::endl;
+				return false;
+			}
+			for (uint32_t j = 0; j < literals; j++) {
+				inOutWords[pos++] ^= encoded[i++];
+			}
+		}
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "hatching.h"
+
+#include <glm/ext/matrix_float4x4.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace Copperplate {
+
+	// Binary capture of everything the stroke simulation gets per frame, so frames rendered by the app
+	// can be replayed without a GL context.
+	// Layout (native byte order): a header with the viewport size and the id and importance of all
+	// screen seeds, then per frame the camera matrices if they changed, the xy channels of the four
+	// fields, position and visibility of all seeds and the contour segments.
+	// Fields and seeds are stored as the xor with the previous frame, encoded in runs of zero words,
+	// so static or empty regions take almost no space.
+	const uint32_t CAPTURE_MAGIC = 0x43485043;	//"CPHC"
+	const uint32_t CAPTURE_VERSION = 1;
+	const int CAPTURE_NUM_FIELDS = 4;
+
+	class HatchingCaptureWriter {
+	public:
+
+		HatchingCaptureWriter();
+
+		bool Open(const std::string& path, Hatching& hatching);
+
+		void AddContours(const std::vector<glm::vec2>& contourSegments);
+		void SetCamera(const glm::mat4& view, const glm::mat4& projection);
+
+		// Call right before Hatching::CreateHatchingLines
+		void WriteFrame(Hatching& hatching);
+
+		int GetNumFrames();
+
+	private:
+
+		void WriteStream(const std::vector<uint32_t>& words, std::vector<uint32_t>& previous);
+
+		std::ofstream m_File;
+		int m_NumFrames;
+
+		std::vector<uint32_t> m_PrevFields[CAPTURE_NUM_FIELDS];
+		std::vector<uint32_t> m_PrevSeeds;
+
+		std::vector<glm::vec2> m_Contours;
+		glm::mat4 m_View;
+		glm::mat4 m_Projection;
+		bool m_CameraChanged;
+	};
+
+	class HatchingCaptureReader {
+	public:
+
+		HatchingCaptureReader();
+
+		bool Open(const std::string& path);
+
+		// A Hatching of the captured viewport size that already contains all captured seeds
+		Unique<Hatching> CreateHatching();
+
+		// Decodes the next frame, returns false at the end of the capture
+		bool ReadFrame();
+		// Feeds the last decoded frame into the hatching, afterwards CreateHatchingLines can be called
+		void ApplyFrame(Hatching& hatching);
+
+		const glm::mat4& GetView();
+		const glm::mat4& GetProjection();
+
+	private:
+
+		bool ReadStream(std::vector<uint32_t>& inOutWords);
+
+		std::ifstream m_File;
+		std::string m_Path;
+		glm::ivec2 m_ViewportSize;
+		std::vector<ScreenSpaceSeed> m_Seeds;
+
+		std::vector<uint32_t> m_Fields[CAPTURE_NUM_FIELDS];
+		std::vector<uint32_t> m_SeedStates;
+		std::vector<glm::vec2> m_Contours;
+		glm::mat4 m_View;
+		glm::mat4 m_Projection;
+
+		std::vector<float> m_FieldBuffer;
+	};
+}
\ No newline at end of file
@@ -3,17 +3,28 @@
 #include "hatching.h"
 #include "statistics.h"
 
+#include <algorithm>
 #include <random>
 #include <queue>
 
 namespace Copperplate {
 
+	// Hatching Debug Settings
+	bool HatchingDebugSettings::RegenerateHatching = false;
+	int HatchingDebugSettings::NumHatchingLines = -1;
+	int HatchingDebugSettings::NumPointsPerHatch = -1;
+
 	HatchingLayer::HatchingLayer(glm::ivec2 gridSize, Hatching& hatching, HatchingSettings settings)
 		: m_GridSize(gridSize)
 		, m_Hatching(hatching)
-		, m_Settings(settings) {
+		, m_Settings(settings)
+		, m_SeedGridMemory(MC_SeedGrids)
+		, m_CollisionMemory(MC_CollisionGrids)
+		, m_LineMemory(MC_Lines) {
+
+		m_NextLineId = 0;
 
-		m_UnusedSeedsGrid = std::vector<std::unordered_set<ScreenSpaceSeed*>>();
+		m_UnusedSeedsGrid = std::vector<ScreenSeedSet>();
 		m_UnusedSeedsGrid.reserve(gridSize.x * gridSize.y);
 
 		m_CollisionPointsGrid = std::vector<std::unordered_set<CollisionPoint>>();
@@ -21,40 +32,10 @@ namespace Copperplate {
 
 		for (int i = 0; i < gridSize.x; i++) {
 			for (int j = 0; j < gridSize.y; j++) {
-				m_UnusedSeedsGrid.push_back(std::unordered_set<ScreenSpaceSeed*>());
+				m_UnusedSeedsGrid.push_back(ScreenSeedSet());
 				m_CollisionPointsGrid.push_back(std::unordered_set<CollisionPoint>());
 			}
 		}
-
-		//setup opengl buffers
-		// Hatching Lines
-		glGenVertexArrays(1, &m_LinesVAO);
-		glGenBuffers(1, &m_LinesVertexBuffer);
-		glGenBuffers(1, &m_LinesIndexBuffer);
-
-		glBindVertexArray(m_LinesVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_LinesVertexBuffer);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_LinesIndexBuffer);
-
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (GLvoid*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (GLvoid*)(2 * sizeof(float)));
-
-		glBindVertexArray(0);
-		glCheckError();
-
-		// Collision Points
-		glGenVertexArrays(1, &m_CollisionVAO);
-		glGenBuffers(1, &m_CollisionVBO);
-
-		glBindVertexArray(m_CollisionVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_CollisionVBO);
-
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (GLvoid*)0);
-
-		glCheckError();
 	}
 
 	void HatchingLayer::ResetCollisions() {
@@ -72,8 +53,7 @@ namespace Copperplate {
 			for (int j = 0; j <= steps; j++) {
 				float p = j / (float)steps;
 				glm::vec2 pos = (1.0f - p) * pos1 + p * pos2;
-				if (m_Hatching.IsInBounds(pos))
-					AddCollisionPoint(pos, true, nullptr);
+				AddCollisionPoint(pos, true, nullptr);
 			}
 		}
 	}
@@ -82,36 +62,50 @@ namespace Copperplate {
 		TIME_FUNCTION(T_UpdateHatch);
 
 		ResetUnusedSeeds();
+		m_LineEvents.clear();
 
-		if (DisplaySettings::RegenerateHatching) {
+		if (HatchingDebugSettings::RegenerateHatching) {
 			m_HatchingLines.clear();
 		}
 
 		UpdateLines();
 
 		STAT_COUNT_LINES(m_HatchingLines.size());
-		FillGLBuffers();
 	}
 
-	void HatchingLayer::Draw(Shared<Shader> shader) {
-		TIME_FUNCTION(T_RenderHatch);
+	void HatchingLayer::ClearLines() {
+		m_HatchingLines.clear();
+		ResetCollisions();
+	}
+
+	void HatchingLayer::RebaseSeeds(const ScreenSpaceSeed* oldSeeds, ScreenSpaceSeed* newSeeds) {
+		for (HatchingLine& line : m_HatchingLines) {
+			line.RebaseSeeds(oldSeeds, newSeeds);
+		}
+	}
+
+	void HatchingLayer::AddPinnedLine(const std::vector<glm::vec2>& points, int strokeId) {
+		// the seeds of a pinned line are found during the next update
+		HatchingLine line(points, std::vector<ScreenSpaceSeed*>(), *this);
+		line.Pin(strokeId);
+		m_HatchingLines.push_back(line);
+	}
 
-		glBindVertexArray(m_LinesVAO);
-		shader->SetFloat("minLineWidth", m_Settings.m_MinLineWidth);
-		shader->SetFloat("maxLineWidth", m_Settings.m_MaxLineWidth);
-		shader->SetFloat("minShade", m_Settings.m_MinShade);
-		shader->SetFloat("maxShade", m_Settings.m_MaxShade);
-		shader->UpdateUniforms();
-		glDrawElements(GL_LINES, m_NumLinesIndices, GL_UNSIGNED_INT, 0);
+	const std::list<HatchingLine>& HatchingLayer::GetLines() {
+		return m_HatchingLines;
 	}
 
-	void HatchingLayer::DrawCollision() {
-		glBindVertexArray(m_CollisionVAO);
-		glDrawArrays(GL_POINTS, 0, m_NumCollisionPoints);
+	const std::vector<LineEvent>& HatchingLayer::GetLineEvents() {
+		return m_LineEvents;
+	}
+
+	int HatchingLayer::CreateLineId() {
+		return m_NextLineId++;
 	}
 
 	bool HatchingLayer::HasCollision(glm::vec2 screenPos, bool onlyContours) {
 		if (!m_Hatching.IsInBounds(screenPos)) return true;
+		m_Hatching.CountCost(HC_CollisionQueries, screenPos);
 		glm::ivec2 gridCenter = m_Hatching.ScreenPosToGridPos(screenPos);
 		for (int x = -1; x <= 1; x++) {
 			for (int y = -1; y <= 1; y++) {
@@ -130,6 +124,26 @@ namespace Copperplate {
 		return false;
 	}
 	
+	void HatchingLayer::UpdateMemoryCounters() {
+		int64_t seedGridBytes = estimateVectorBytes(m_UnusedSeedsGrid);
+		for (const ScreenSeedSet& gridCell : m_UnusedSeedsGrid) {
+			seedGridBytes += estimateHashSetBytes(gridCell);
+		}
+		m_SeedGridMemory.Set(seedGridBytes);
+
+		int64_t collisionBytes = estimateVectorBytes(m_CollisionPointsGrid);
+		for (const std::unordered_set<CollisionPoint>& gridCell : m_CollisionPointsGrid) {
+			collisionBytes += estimateHashSetBytes(gridCell);
+		}
+		m_CollisionMemory.Set(collisionBytes);
+
+		int64_t lineBytes = estimateNodeBytes(m_HatchingLines);
+		for (const HatchingLine& line : m_HatchingLines) {
+			lineBytes += line.EstimateMemoryBytes();
+		}
+		m_LineMemory.Set(lineBytes);
+	}
+
 	int HatchingLayer::CountNearbyColPoints(glm::vec2 screenPos, float radius) {
 		int count = 0;
 		glm::ivec2 gridCenter = m_Hatching.ScreenPosToGridPos(screenPos);
@@ -181,7 +195,7 @@ namespace Copperplate {
 		}
 		//Sanity check
 		for (HatchingLine line : m_HatchingLines) {
-			assert(line.getSeeds().size() > 0);
+			assert(line.IsPinned() || line.getSeeds().size() > 0);
 		}
 	}
 
@@ -189,6 +203,11 @@ namespace Copperplate {
 		TIME_FUNCTION(T_Advect);
 		for (HatchingLine& line : m_HatchingLines) {
 			const std::deque<glm::vec2>& points = line.getPoints();
+			if (line.IsPinned()) {
+				// the collision is rebuilt every frame, so pinned lines have to count as changed even though they stay
+				line.MovePointsTo(points);
+				continue;
+			}
 			std::deque<glm::vec2> newPoints;
 			for (int i = 0; i < points.size(); i++) {
 				glm::vec2 point = points[i];
@@ -202,7 +221,7 @@ namespace Copperplate {
 	void HatchingLayer::SnakesResample() {
 		TIME_FUNCTION(T_Resample);
 		for (HatchingLine& line : m_HatchingLines) {
-			if (line.NeedsResampling()) {
+			if (line.NeedsResampling() && !line.IsPinned()) {
 				line.Resample();
 			}
 			UpdateLineSeeds(line);
@@ -214,6 +233,7 @@ namespace Copperplate {
 		int numSteps = m_Settings.m_NumOptiSteps;
 		float stepSize = m_Settings.m_OptiStepSize;
 		for (HatchingLine& line : m_HatchingLines) {
+			if (line.IsPinned()) continue;
 			const std::deque<glm::vec2>& originalPoints = line.getPoints();
 			std::deque<glm::vec2> currPoints = originalPoints; //Copy of the starting points to be changed
 			for (int iteration = 0; iteration < numSteps; iteration++) {
@@ -245,6 +265,10 @@ namespace Copperplate {
 		TIME_FUNCTION(T_Delete);
 		for (auto it = m_HatchingLines.begin(); it != m_HatchingLines.end(); ) {
 			HatchingLine& line = *it;
+			if (line.IsPinned()) {
+				it++;
+				continue;
+			}
 			bool lineAlive = line.HasVisibleSeeds();
 			if (line.getPoints().size() <= 1) lineAlive = false;
 
@@ -255,13 +279,19 @@ namespace Copperplate {
 
 			if (lineAlive && line.HasMiddleCollision()) {
 				HatchingLine* rest = line.SplitFromCollision();
-				if (rest && rest->getPoints().size() > 1) m_HatchingLines.push_back(*rest);
+				if (rest && rest->getPoints().size() > 1) {
+					m_HatchingLines.push_back(*rest);
+					m_LineEvents.push_back({ LE_Split, { line.GetId(), rest->GetId(), -1 } });
+				}
 				lineAlive = line.HasVisibleSeeds() && line.getPoints().size() > 1;
 			}
 
 			if (lineAlive && line.HasMiddleOcclusion()) {
 				HatchingLine* rest = line.SplitFromOcclusion();
-				if (rest && rest->getPoints().size() > 1) m_HatchingLines.push_back(*rest);
+				if (rest && rest->getPoints().size() > 1) {
+					m_HatchingLines.push_back(*rest);
+					m_LineEvents.push_back({ LE_Split, { line.GetId(), rest->GetId(), -1 } });
+				}
 				lineAlive = line.HasVisibleSeeds() && line.getPoints().size() > 1;
 			}
 
@@ -275,6 +305,7 @@ namespace Copperplate {
 			// Lines with no visible Seeds get removed
 			if (!lineAlive) {
 				RemoveLineCollision(line);
+				m_LineEvents.push_back({ LE_Delete, { line.GetId(), -1, -1 } });
 				it = m_HatchingLines.erase(it);
 				STAT_COUNT_DELETION;
 			}
@@ -288,17 +319,24 @@ namespace Copperplate {
 		TIME_FUNCTION(T_Split);
 		for (auto it = m_HatchingLines.begin(); it != m_HatchingLines.end(); ) {
 			HatchingLine& line = *it;
+			if (line.IsPinned()) {
+				it++;
+				continue;
+			}
 			if (line.HasSharpBend()) {
 				HatchingLine* rest = line.SplitSharpBend();
 				STAT_COUNT_SPLIT;
-				if (rest && rest->HasVisibleSeeds() && rest->getPoints().size() > 1)
+				if (rest && rest->HasVisibleSeeds() && rest->getPoints().size() > 1) {
 					m_HatchingLines.push_back(*rest);
+					m_LineEvents.push_back({ LE_Split, { line.GetId(), rest->GetId(), -1 } });
+				}
 			}
 			if (line.HasVisibleSeeds() && line.getPoints().size() > 1) {
 				it++;
 			}
 			else {
 				RemoveLineCollision(line);
+				m_LineEvents.push_back({ LE_Delete, { line.GetId(), -1, -1 } });
 				it = m_HatchingLines.erase(it);
 			}
 		}
@@ -308,6 +346,11 @@ namespace Copperplate {
 		TIME_FUNCTION(T_Trim);
 		for (auto it = m_HatchingLines.begin(); it != m_HatchingLines.end();) {
 			HatchingLine& line = *it;
+			if (line.IsPinned()) {
+				UpdateLineCollision(line);
+				it++;
+				continue;
+			}
 			const std::deque<glm::vec2>& points = line.getPoints();
 			int count = 0;
 			for (int i = 0; i < points.size() - 1; i++) {
@@ -335,6 +378,7 @@ namespace Copperplate {
 			}
 			else {
 				RemoveLineCollision(line);
+				m_LineEvents.push_back({ LE_Delete, { line.GetId(), -1, -1 } });
 				it = m_HatchingLines.erase(it);
 				STAT_COUNT_DELETION;
 			}
@@ -360,7 +404,7 @@ namespace Copperplate {
 			line.ExtendBack(extensionBack);
 
 			// Update associated Seeds of the line
-			std::unordered_set<ScreenSpaceSeed*> newSeedsUnique;
+			ScreenSeedSet newSeedsUnique;
 			std::vector<ScreenSpaceSeed*> newSeeds;
 			for (glm::vec2 point : extensionFront) {
 				std::vector<ScreenSpaceSeed*> currSeeds = m_Hatching.FindVisibleSeedsInRadius(point, m_Settings.m_CoverRadius);
@@ -398,7 +442,7 @@ namespace Copperplate {
 		std::unordered_set<HatchingLine*> linesToDelete;
 		for (auto it = m_HatchingLines.begin(); it != m_HatchingLines.end(); it++) {
 			HatchingLine& line = *it;
-			if (linesToDelete.count(&line) == 0) {
+			if (linesToDelete.count(&line) == 0 && !line.IsPinned()) {
 				// Find all Candidates for merging
 				std::vector<const CollisionPoint*> mergeCandidates;
 				std::vector<bool> candidatesToFront;
@@ -446,6 +490,7 @@ namespace Copperplate {
 					//Merge the two lines, mark both original lines for removal
 					HatchingLine merged = line.CreateMerged(bestMerge, mergeToFront);
 					m_HatchingLines.push_back(merged);
+					m_LineEvents.push_back({ LE_Merge, { line.GetId(), bestMerge->GetId(), merged.GetId() } });
 					linesToDelete.insert(&line);
 					linesToDelete.insert(bestMerge);
 					STAT_COUNT_MERGE;
@@ -466,7 +511,7 @@ namespace Copperplate {
 	void HatchingLayer::SnakesInsert() {
 		TIME_FUNCTION(T_Insert);
 		//DEBUG DISPLAY
-		int maxLines = DisplaySettings::NumHatchingLines;
+		int maxLines = HatchingDebugSettings::NumHatchingLines;
 		if (maxLines < 0) maxLines = 999999999;
 
 		std::queue<HatchingLine*> lineQueue;
@@ -479,7 +524,7 @@ namespace Copperplate {
 				//Find highest importance unused seed
 				float highestImp = 0.0f;
 				ScreenSpaceSeed* candidate = nullptr;
-				for (std::unordered_set<ScreenSpaceSeed*>& gridCell : m_UnusedSeedsGrid) {
+				for (ScreenSeedSet& gridCell : m_UnusedSeedsGrid) {
 					for (ScreenSpaceSeed* seed : gridCell) {
 						if (seed->m_Importance > highestImp) {
 							highestImp = seed->m_Importance;
@@ -494,6 +539,7 @@ namespace Copperplate {
 				//if (newLine.getPoints().size() > 2) {
 					UpdateLineCollision(newLine);
 					m_HatchingLines.push_back(newLine);
+					m_LineEvents.push_back({ LE_Insert, { newLine.GetId(), -1, -1 } });
 					STAT_COUNT_INSERTION;
 					lineQueue.push(&m_HatchingLines.back());
 				//}
@@ -506,6 +552,7 @@ namespace Copperplate {
 					//if (newLine.getPoints().size() > 2) {
 						UpdateLineCollision(newLine);
 						m_HatchingLines.push_back(newLine);
+						m_LineEvents.push_back({ LE_Insert, { newLine.GetId(), -1, -1 } });
 						STAT_COUNT_INSERTION;
 						lineQueue.push(&m_HatchingLines.back());
 					//}
@@ -524,7 +571,7 @@ namespace Copperplate {
 	}
 
 	HatchingLine HatchingLayer::ConstructLine(ScreenSpaceSeed* seed) {
-		int maxPoints = DisplaySettings::NumPointsPerHatch;
+		int maxPoints = HatchingDebugSettings::NumPointsPerHatch;
 		if (maxPoints <= 0) maxPoints = 999999;
 		int pointsAdded = 0;
 
@@ -553,7 +600,7 @@ namespace Copperplate {
 			}
 		}
 
-		std::unordered_set<ScreenSpaceSeed*> seedsUnique;
+		ScreenSeedSet seedsUnique;
 		std::vector<ScreenSpaceSeed*> associatedSeeds;
 
 		//Find all Seed Points near the line
@@ -575,10 +622,15 @@ namespace Copperplate {
 		std::vector<glm::vec2> newPoints;
 		bool finished = false;
 
+		// the last two points can coincide, without a direction the line cannot be extended
+		if (tip == second)
+			return newPoints;
+
 		glm::vec2 currPos = tip;
 		glm::vec2 dir = glm::normalize(tip - second);
 
 		while (!finished) {
+			m_Hatching.CountCost(HC_ExtendSteps, currPos);
 			float bestScore = 0.0f;
 			glm::vec2 bestCandidate;
 			for (int i = -2; i <= 2; i++) {
@@ -611,7 +663,7 @@ namespace Copperplate {
 
 	void HatchingLayer::UpdateLineSeeds(HatchingLine& line) {
 		// Find the new set of Seeds
-		std::unordered_set<ScreenSpaceSeed*> newSeedsUnique;
+		ScreenSeedSet newSeedsUnique;
 		std::vector<ScreenSpaceSeed*> newSeeds;
 		const std::deque<glm::vec2>& points = line.getPoints();
 		for (glm::vec2 point : points) {
@@ -634,7 +686,7 @@ namespace Copperplate {
 			for (int x = -1; x <= 1; x++) {
 				for (int y = -1; y <= 1; y++) {
 					glm::ivec2 currGridPos = glm::clamp(gridPos + glm::ivec2(x, y), glm::ivec2(0), (m_GridSize - glm::ivec2(1)));
-					std::unordered_set<ScreenSpaceSeed*>& gridCell = *GetUnusedScreenSeeds(currGridPos);
+					ScreenSeedSet& gridCell = *GetUnusedScreenSeeds(currGridPos);
 					for (ScreenSpaceSeed* currSeed : gridCell) {
 						glm::vec2 compCoords = currSeed->m_Pos;
 						float dist = glm::distance(currentPoints[i], compCoords);
@@ -660,7 +712,7 @@ namespace Copperplate {
 					for (auto gridIt = gridCell->begin(); gridIt != gridCell->end(); gridIt++) {
 						const CollisionPoint* colPoint = &(*gridIt);
 						HatchingLine* colLine = colPoint->m_Line;
-						if (!colPoint->m_isContour && colLine != line) {
+						if (!colPoint->m_isContour && colLine != line && !colLine->IsPinned()) {
 							float dist = glm::distance(tip, colPoint->m_Pos);
 
 							glm::vec2 candTip = colPoint->m_Pos;
@@ -723,6 +775,7 @@ namespace Copperplate {
 	}
 
 	float HatchingLayer::EvaluatePointPos(HatchingLine& line, int index, glm::vec2 pointPos, const std::deque<glm::vec2>& points) {
+		m_Hatching.CountCost(HC_RelaxEvaluations, pointPos);
 		const std::deque<glm::vec2>& originalPoints = line.getPoints();
 
 		//Compute Energy for associated Seed Points
@@ -783,7 +836,7 @@ namespace Copperplate {
 		if (line.HasChanged()) {
 			const std::vector<glm::vec2>& points = line.getPointsBeforeChange();
 			for (glm::vec2 point : points) {
-				if (m_Hatching.IsInBounds(point)) {
+				if (m_Hatching.IsInViewport(point)) {
 					glm::ivec2 gridPos = m_Hatching.ScreenPosToGridPos(point);
 					std::unordered_set<CollisionPoint>& gridCell = *GetCollisionPoints(gridPos);
 					for (auto it = gridCell.begin(); it != gridCell.end(); it++) {
@@ -799,7 +852,7 @@ namespace Copperplate {
 		else {
 			const std::deque<glm::vec2>& points = line.getPoints();
 			for (glm::vec2 point : points) {
-				if (m_Hatching.IsInBounds(point)) {
+				if (m_Hatching.IsInViewport(point)) {
 					glm::ivec2 gridPos = m_Hatching.ScreenPosToGridPos(point);
 					std::unordered_set<CollisionPoint>& gridCell = *GetCollisionPoints(gridPos);
 					for (auto it = gridCell.begin(); it != gridCell.end(); it++) {
@@ -828,7 +881,7 @@ namespace Copperplate {
 	}
 
 	void HatchingLayer::AddCollisionPoint(glm::vec2 screenPos, bool isContour, HatchingLine* line) {
-		if (!m_Hatching.IsInBounds(screenPos))
+		if (!m_Hatching.IsInViewport(screenPos))
 			return;
 
 		glm::ivec2 gridPos = m_Hatching.ScreenPosToGridPos(screenPos);
@@ -883,65 +936,48 @@ namespace Copperplate {
 			const std::deque<ScreenSpaceSeed*>& seeds = line.getSeeds();
 			for (ScreenSpaceSeed* seed : seeds) {
 				glm::ivec2 gridPos = m_Hatching.ScreenPosToGridPos(seed->m_Pos);
-				std::unordered_set<ScreenSpaceSeed*>* gridCell = GetUnusedScreenSeeds(gridPos);
+				ScreenSeedSet* gridCell = GetUnusedScreenSeeds(gridPos);
 				m_NumUnusedSeeds -= gridCell->erase(seed);
 			}
 		}
 	}
 
-	void HatchingLayer::FillGLBuffers() {
-		// Fill Buffers for Hatching Lines
-		std::vector<glm::vec2> vertices;
-		std::vector<unsigned int> indices;
-		m_NumLinesIndices = 0;
+	void HatchingLayer::BuildLineBuffers(std::vector<glm::vec2>& outVertices, std::vector<unsigned int>& outIndices) {
+		// every vertex is its position followed by the direction of the segment leading to it
 		unsigned int offset = 0;
-
 		for (auto it = m_HatchingLines.begin(); it != m_HatchingLines.end(); it++) {
 			HatchingLine& line = *it;
 			const std::deque<glm::vec2>& linePoints = line.getPoints();
 
 			// vertex data
-			vertices.push_back(m_Hatching.ScreenToView(linePoints[0]));
-			vertices.push_back(m_Hatching.ScreenToView(linePoints[1]) - m_Hatching.ScreenToView(linePoints[0]));
+			outVertices.push_back(m_Hatching.ScreenToView(linePoints[0]));
+			outVertices.push_back(m_Hatching.ScreenToView(linePoints[1]) - m_Hatching.ScreenToView(linePoints[0]));
 			for (int i = 1; i < linePoints.size(); i++) {
-				vertices.push_back(m_Hatching.ScreenToView(linePoints[i]));
-				vertices.push_back(m_Hatching.ScreenToView(linePoints[i]) - m_Hatching.ScreenToView(linePoints[i - 1]));
+				outVertices.push_back(m_Hatching.ScreenToView(linePoints[i]));
+				outVertices.push_back(m_Hatching.ScreenToView(linePoints[i]) - m_Hatching.ScreenToView(linePoints[i - 1]));
 			}
 			//index data
 			for (int i = 0; i < ((int)linePoints.size() - 1); i++) {
-				indices.push_back(offset + i);
-				indices.push_back(offset + i + 1);
+				outIndices.push_back(offset + i);
+				outIndices.push_back(offset + i + 1);
 			}
 			offset += linePoints.size();
 		}
-		m_NumLinesIndices = indices.size();
-
-		glBindVertexArray(m_LinesVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_LinesVertexBuffer);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * 2 * sizeof(float), vertices.data(), GL_STREAM_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_LinesIndexBuffer);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STREAM_DRAW);
+	}
 
-		// Fill Buffers for Collision Points
-		m_NumCollisionPoints = 0;
-		std::vector<glm::vec2> colPoints;
-		for (std::unordered_set<CollisionPoint> gridCell : m_CollisionPointsGrid) {
+	void HatchingLayer::BuildCollisionBuffer(std::vector<glm::vec2>& outPoints) {
+		for (const std::unordered_set<CollisionPoint>& gridCell : m_CollisionPointsGrid) {
 			for (const CollisionPoint& point : gridCell) {
-				colPoints.push_back(m_Hatching.ScreenToView(point.m_Pos));
-				m_NumCollisionPoints++;
+				outPoints.push_back(m_Hatching.ScreenToView(point.m_Pos));
 			}
 		}
-
-		glBindVertexArray(m_CollisionVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_CollisionVBO);
-		glBufferData(GL_ARRAY_BUFFER, colPoints.size() * 2 * sizeof(float), colPoints.data(), GL_STREAM_DRAW);
 	}
 
 	std::unordered_set<CollisionPoint>* HatchingLayer::GetCollisionPoints(glm::ivec2 gridPos) {
 		return &m_CollisionPointsGrid[gridPos.y * m_GridSize.x + gridPos.x];
 	}
 
-	std::unordered_set<ScreenSpaceSeed*>* HatchingLayer::GetUnusedScreenSeeds(glm::ivec2 gridPos) {
+	ScreenSeedSet* HatchingLayer::GetUnusedScreenSeeds(glm::ivec2 gridPos) {
 		return &m_UnusedSeedsGrid[gridPos.y * m_GridSize.x + gridPos.x];
 	}
 
@@ -1,9 +1,12 @@
 #pragma once
 #include "hatchingline.h"
-#include "mesh.h"
-#include "shader.h"
-#include "rendering.h"
+#include "hatchingsettings.h"
+#include "statistics.h"
 #include "utility.h"
+
+#include <glm/geometric.hpp>
+
+#include <list>
 #include <unordered_set>
 
 
@@ -19,52 +22,32 @@ namespace Copperplate {
 		}
 	};
 
-	struct HatchingSettings {
-		float m_LineDistance =		4.0f;
-		float m_CollisionRadius =	m_LineDistance * 0.7f;
-		float m_CoverRadius =		m_LineDistance * 1.0f;
-		float m_TrimRadius =		m_LineDistance * 0.7f;
-		float m_ExtendRadius =		m_LineDistance * 1.2f;
-		float m_MergeRadius =		m_LineDistance * 1.3f;
-		float m_SplitAngle =		degToRad(20);
-		float m_ParallelAngle =		degToRad(10);
-		float m_ExtendStraightVsCloseWeight = 0.8f;
-		float m_OptiStepSize = 1.0f;
-		int	  m_NumOptiSteps = 4;
-		float m_OptiSeedWeight = 2.0f;
-		float m_OptiSmoothWeight = 5.0f;
-		float m_OptiFieldWeight = 3.0f;
-		float m_OptiSpringWeight = 2.0f;
-
-		float m_MinLineWidth =	1.0f;
-		float m_MaxLineWidth =	3.0f;
-		float m_MinShade =		0.0f;
-		float m_MaxShade =		1.0f;
-		EHatchingDirections m_Direction = EHatchingDirections::HD_LargestCurvature;
-
-		HatchingSettings(float lineDistance, float splitAngleDeg, float parallelAngleDeg, float minWidth, float maxWidth, float minShade, float maxShade, EHatchingDirections direction) {
-			m_LineDistance = lineDistance;
-			m_CollisionRadius = m_LineDistance * 0.7f;
-			m_CoverRadius = m_LineDistance * 1.0f;
-			m_TrimRadius = m_LineDistance * 0.7f;
-			m_ExtendRadius = m_LineDistance * 1.2f;
-			m_MergeRadius = m_LineDistance * 1.3f;
-			m_SplitAngle = degToRad(splitAngleDeg);
-			m_ParallelAngle = degToRad(parallelAngleDeg);
-
-			m_MinLineWidth = minWidth;
-			m_MaxLineWidth = maxWidth;
-			m_MinShade = minShade;
-			m_MaxShade = maxShade;
-			m_Direction = direction;
-		}
+	enum ELineEvents {
+		LE_Insert,		//a line was constructed from a seed
+		LE_Delete,
+		LE_Split,		//the second line was split off the first one
+		LE_Merge,		//the first two lines were joined into the third one
+	};
+
+	// Change of the line topology, the lines are given by their id
+	struct LineEvent {
+		ELineEvents m_Type;
+		int m_Lines[3];
 	};
 
 	//Forward Declarations
 	struct ScreenSpaceSeed;
 	class Hatching;
 
+	// Hashes seeds by their id instead of their address, so iterating over a set of seeds
+	// visits them in the same order in every run
+	struct ScreenSeedHash {
+		size_t operator()(const ScreenSpaceSeed* seed) const;
+	};
+	using ScreenSeedSet = std::unordered_set<ScreenSpaceSeed*, ScreenSeedHash>;
+
 	class HatchingLayer {
+		friend class HatchingFixture;	//microbenchmarks of the private hot paths
 
 	public:
 
@@ -73,9 +56,23 @@ namespace Copperplate {
 		void ResetCollisions();
 		void AddContourCollision(const std::vector<glm::vec2>& contourSegments);
 
-		void Update();		
-		void Draw(Shared<Shader> shader);
-		void DrawCollision();
+		void Update();
+
+		// Removes all lines and their collision, e.g. before the next tile of a tiled render
+		void ClearLines();
+		// Adds a line that keeps its shape and is never deleted, split or merged, only extended at its tips
+		void AddPinnedLine(const std::vector<glm::vec2>& points, int strokeId);
+		// Keeps the lines on their seeds when the screen seeds move to larger storage
+		void RebaseSeeds(const ScreenSpaceSeed* oldSeeds, ScreenSpaceSeed* newSeeds);
+		const std::list<HatchingLine>& GetLines();
+		// Topology changes of the last update in the order they happened, lines that were removed by
+		// ClearLines or a regeneration do not get an event
+		const std::vector<LineEvent>& GetLineEvents();
+		int CreateLineId();
+
+		// Vertex and index data for drawing the lines and collision points, in view coordinates
+		void BuildLineBuffers(std::vector<glm::vec2>& outVertices, std::vector<unsigned int>& outIndices);
+		void BuildCollisionBuffer(std::vector<glm::vec2>& outPoints);
 		
 		bool HasCollision(glm::vec2 screenPos, bool onlyContours);
 		
@@ -83,6 +80,7 @@ namespace Copperplate {
 
 		//For Statistics
 		int CountNearbyColPoints(glm::vec2 screenPos, float radius);
+		void UpdateMemoryCounters();
 
 	private:
 
@@ -118,30 +116,25 @@ namespace Copperplate {
 		void ResetUnusedSeeds();
 		void UpdateUnusedSeeds();
 
-		void FillGLBuffers();
-
 		std::unordered_set<CollisionPoint>* GetCollisionPoints(glm::ivec2 gridPos);
-		std::unordered_set<ScreenSpaceSeed*>* GetUnusedScreenSeeds(glm::ivec2 gridPos);
+		ScreenSeedSet* GetUnusedScreenSeeds(glm::ivec2 gridPos);
 
 
 		//Member Variables
 
 		Hatching& m_Hatching;
 		std::list<HatchingLine> m_HatchingLines;
+		std::vector<LineEvent> m_LineEvents;
+		int m_NextLineId;
 		
 		glm::ivec2 m_GridSize;
-		std::vector<std::unordered_set<ScreenSpaceSeed*>> m_UnusedSeedsGrid;
+		std::vector<ScreenSeedSet> m_UnusedSeedsGrid;
 		std::vector<std::unordered_set<CollisionPoint>> m_CollisionPointsGrid;
 		int m_NumUnusedSeeds;
 
-		unsigned int m_LinesVAO;
-		unsigned int m_LinesVertexBuffer;
-		unsigned int m_LinesIndexBuffer;
-		int m_NumLinesIndices;
-
-		unsigned int m_CollisionVAO;
-		unsigned int m_CollisionVBO;
-		int m_NumCollisionPoints;
+		MemoryCounter m_SeedGridMemory;
+		MemoryCounter m_CollisionMemory;
+		MemoryCounter m_LineMemory;
 
 
 		
@@ -1,6 +1,7 @@
 #pragma once
 #include "hatchingline.h"
 #include "hatching.h"
+#include "statistics.h"
 
 
 namespace Copperplate {
@@ -12,6 +13,8 @@ namespace Copperplate {
 		m_Seeds = std::deque<ScreenSpaceSeed*>();
 		m_SeedPlacements = std::deque<int>();
 		m_HasChanged = true;
+		m_LineId = m_Layer.CreateLineId();
+		m_StrokeId = -1;
 		m_PointsBeforeChange = std::vector<glm::vec2>();
 
 		for (int i = 0; i < m_NumPoints; i++) {
@@ -383,6 +386,12 @@ namespace Copperplate {
 		}
 	}
 
+	void HatchingLine::RebaseSeeds(const ScreenSpaceSeed* oldSeeds, ScreenSpaceSeed* newSeeds) {
+		for (ScreenSpaceSeed*& seed : m_Seeds) {
+			seed = newSeeds + (seed - oldSeeds);
+		}
+	}
+
 	void HatchingLine::ReplaceSeeds(const std::vector<ScreenSpaceSeed*>& newSeeds) {
 		m_Seeds.clear();
 		m_SeedPlacements.clear();
@@ -464,6 +473,10 @@ namespace Copperplate {
 		m_HasChanged = false;
 	}
 
+	void HatchingLine::Pin(int strokeId) {
+		m_StrokeId = strokeId;
+	}
+
 	// PRIVATE FUNCTIONS
 
 	void HatchingLine::SetChangedFlag() {
@@ -477,6 +490,10 @@ namespace Copperplate {
 		}
 	}
 
+	int64_t HatchingLine::EstimateMemoryBytes() const {
+		return estimateDequeBytes(m_Points) + estimateDequeBytes(m_Seeds) + estimateDequeBytes(m_SeedPlacements) + estimateVectorBytes(m_PointsBeforeChange);
+	}
+
 	void HatchingLine::SetPointsBeforeChange(const std::vector<glm::vec2>& points) {
 		m_PointsBeforeChange = points;
 		m_HasChanged = true;
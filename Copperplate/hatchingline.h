@@ -2,7 +2,7 @@
 #include "core.h"
 #include <vector>
 #include <deque>
-#include <glm\ext\vector_float2.hpp>
+#include <glm/ext/vector_float2.hpp>
 
 namespace Copperplate {
 
@@ -34,6 +34,8 @@ namespace Copperplate {
 		void ExtendBack(const std::vector<glm::vec2>& newPoints);
 
 		void ReplaceSeeds(const std::vector<ScreenSpaceSeed*>& newSeeds);
+		// Moves the seed pointers along when the screen seeds move to larger storage
+		void RebaseSeeds(const ScreenSpaceSeed* oldSeeds, ScreenSpaceSeed* newSeeds);
 
 		bool NeedsResampling();
 		bool HasVisibleSeeds();
@@ -41,9 +43,17 @@ namespace Copperplate {
 		bool HasMiddleOcclusion();
 		bool HasSharpBend();
 		
+		// Unique within the layer and kept while the line is advected, split and merged lines get a new one
+		int GetId() const { return m_LineId; };
+
 		bool HasChanged() const { return m_HasChanged; };
 		void ResetChangedFlag();
 
+		// Pinned lines were finished in another tile, they only grow at their tips
+		void Pin(int strokeId);
+		bool IsPinned() const { return m_StrokeId >= 0; };
+		int GetStrokeId() const { return m_StrokeId; };
+
 		glm::vec2 getDirAt(glm::vec2 pos);
 		std::vector<ScreenSpaceSeed*> getSeedsForPoint(int index);
 		glm::vec2 getSegmentDir(int index);
@@ -52,6 +62,9 @@ namespace Copperplate {
 		const std::deque<ScreenSpaceSeed*>& getSeeds() const { return m_Seeds; };
 		const std::vector<glm::vec2> getPointsBeforeChange() const { return m_PointsBeforeChange; };
 
+		// Heap bytes of the point and seed storage, without the line itself
+		int64_t EstimateMemoryBytes() const;
+
 
 	private:
 		
@@ -60,6 +73,8 @@ namespace Copperplate {
 		std::deque<ScreenSpaceSeed*> m_Seeds;
 		std::deque<int> m_SeedPlacements;
 		bool m_HasChanged;
+		int m_LineId;
+		int m_StrokeId;
 		std::vector<glm::vec2> m_PointsBeforeChange;
 		HatchingLayer& m_Layer;
 		
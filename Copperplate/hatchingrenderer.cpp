@@ -0,0 +1,170 @@
+#pragma once
+
+#include "hatchingrenderer.h"
+#include "statistics.h"
+
+namespace Copperplate {
+
+	HatchingRenderer::HatchingRenderer(Shared<Hatching> hatching)
+		: m_BufferMemory(MC_GLBuffers)
+		, m_TextureMemory(MC_GLTextures) {
+		m_Hatching = hatching;
+		m_NumVisibleScreenSeeds = 0;
+
+		// Screen Space Seed Points
+		glGenVertexArrays(1, &m_ScreenSeedsVAO);
+		glGenBuffers(1, &m_ScreenSeedsVBO);
+
+		glBindVertexArray(m_ScreenSeedsVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_ScreenSeedsVBO);
+
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (GLvoid*)0);
+
+		glCheckError();
+
+		// one set of buffers per hatching layer
+		m_LayerBuffers = std::vector<LayerBuffers>(m_Hatching->GetLayers().size());
+		for (LayerBuffers& buffers : m_LayerBuffers) {
+			// Hatching Lines
+			glGenVertexArrays(1, &buffers.m_LinesVAO);
+			glGenBuffers(1, &buffers.m_LinesVertexBuffer);
+			glGenBuffers(1, &buffers.m_LinesIndexBuffer);
+
+			glBindVertexArray(buffers.m_LinesVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers.m_LinesVertexBuffer);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.m_LinesIndexBuffer);
+
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (GLvoid*)0);
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (GLvoid*)(2 * sizeof(float)));
+
+			glBindVertexArray(0);
+			glCheckError();
+
+			// Collision Points
+			glGenVertexArrays(1, &buffers.m_CollisionVAO);
+			glGenBuffers(1, &buffers.m_CollisionVBO);
+
+			glBindVertexArray(buffers.m_CollisionVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers.m_CollisionVBO);
+
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (GLvoid*)0);
+
+			glCheckError();
+
+			buffers.m_NumLinesIndices = 0;
+			buffers.m_NumCollisionPoints = 0;
+		}
+
+		// Cost Heatmap, stretched over the screen without filtering so the grid cells stay visible
+		glm::ivec2 gridSize = m_Hatching->GetGridSize();
+		glGenTextures(1, &m_CostHeatmapTexture);
+		glBindTexture(GL_TEXTURE_2D, m_CostHeatmapTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, gridSize.x, gridSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glCheckError();
+		m_TextureMemory.Set(getGLTextureBytes(m_CostHeatmapTexture));
+	}
+
+	void HatchingRenderer::GrabField(EHatchingFields field) {
+		TIME_FUNCTION(T_Readback);
+		glm::ivec2 size = glm::ivec2(m_Hatching->GetViewportSize());
+		glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_FLOAT, m_Hatching->GetFieldData(field));
+	}
+
+	void HatchingRenderer::UpdateBuffers() {
+		// Fill Buffers for Screen Space Seeds
+		std::vector<glm::vec2> screenSeedPos;
+		for (const ScreenSpaceSeed& seed : m_Hatching->GetScreenSeeds()) {
+			if (seed.m_Visible) {
+				screenSeedPos.push_back(m_Hatching->ScreenToView(seed.m_Pos));
+			}
+		}
+		m_NumVisibleScreenSeeds = screenSeedPos.size();
+
+		glBindVertexArray(m_ScreenSeedsVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_ScreenSeedsVBO);
+		glBufferData(GL_ARRAY_BUFFER, screenSeedPos.size() * 2 * sizeof(float), screenSeedPos.data(), GL_DYNAMIC_DRAW);
+		int64_t bufferBytes = screenSeedPos.size() * 2 * sizeof(float);
+
+		const std::vector<Unique<HatchingLayer>>& layers = m_Hatching->GetLayers();
+		for (int i = 0; i < layers.size(); i++) {
+			LayerBuffers& buffers = m_LayerBuffers[i];
+
+			// Fill Buffers for Hatching Lines
+			std::vector<glm::vec2> vertices;
+			std::vector<unsigned int> indices;
+			layers[i]->BuildLineBuffers(vertices, indices);
+			buffers.m_NumLinesIndices = indices.size();
+
+			glBindVertexArray(buffers.m_LinesVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers.m_LinesVertexBuffer);
+			glBufferData(GL_ARRAY_BUFFER, vertices.size() * 2 * sizeof(float), vertices.data(), GL_STREAM_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.m_LinesIndexBuffer);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STREAM_DRAW);
+
+			// Fill Buffers for Collision Points
+			std::vector<glm::vec2> colPoints;
+			layers[i]->BuildCollisionBuffer(colPoints);
+			buffers.m_NumCollisionPoints = colPoints.size();
+
+			glBindVertexArray(buffers.m_CollisionVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers.m_CollisionVBO);
+			glBufferData(GL_ARRAY_BUFFER, colPoints.size() * 2 * sizeof(float), colPoints.data(), GL_STREAM_DRAW);
+			bufferBytes += (vertices.size() + colPoints.size()) * 2 * sizeof(float) + indices.size() * sizeof(unsigned int);
+		}
+		glBindVertexArray(0);
+		m_BufferMemory.Set(bufferBytes);
+	}
+
+	void HatchingRenderer::DrawScreenSeeds() {
+		glBindVertexArray(m_ScreenSeedsVAO);
+		glDrawArrays(GL_POINTS, 0, m_NumVisibleScreenSeeds);
+	}
+
+	int HatchingRenderer::GetNumVisibleScreenSeeds() {
+		return m_NumVisibleScreenSeeds;
+	}
+
+	void HatchingRenderer::DrawHatchingLines(Shared<Shader> shader) {
+		TIME_FUNCTION(T_RenderHatch);
+
+		const std::vector<Unique<HatchingLayer>>& layers = m_Hatching->GetLayers();
+		for (int i = 0; i < layers.size(); i++) {
+			const HatchingSettings& settings = layers[i]->m_Settings;
+			glBindVertexArray(m_LayerBuffers[i].m_LinesVAO);
+			shader->SetFloat("minLineWidth", settings.m_MinLineWidth);
+			shader->SetFloat("maxLineWidth", settings.m_MaxLineWidth);
+			shader->SetFloat("minShade", settings.m_MinShade);
+			shader->SetFloat("maxShade", settings.m_MaxShade);
+			shader->UpdateUniforms();
+			glDrawElements(GL_LINES, m_LayerBuffers[i].m_NumLinesIndices, GL_UNSIGNED_INT, 0);
+		}
+	}
+
+	void HatchingRenderer::DrawCollisionPoints() {
+		for (LayerBuffers& buffers : m_LayerBuffers) {
+			glBindVertexArray(buffers.m_CollisionVAO);
+			glDrawArrays(GL_POINTS, 0, buffers.m_NumCollisionPoints);
+		}
+	}
+
+	void HatchingRenderer::UpdateCostHeatmap(EHatchingCosts type) {
+		m_Hatching->BuildCostHeatmap(type, m_CostHeatmapPixels);
+		glm::ivec2 gridSize = m_Hatching->GetGridSize();
+		glBindTexture(GL_TEXTURE_2D, m_CostHeatmapTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gridSize.x, gridSize.y, GL_RGBA, GL_UNSIGNED_BYTE, m_CostHeatmapPixels.data());
+		glCheckError();
+	}
+
+	unsigned int HatchingRenderer::GetCostHeatmapTexture() {
+		return m_CostHeatmapTexture;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "gldebug.h"
+#include "hatching.h"
+#include "shader.h"
+
+#include <vector>
+
+namespace Copperplate {
+
+	// Connects the GL free stroke simulation to OpenGL: reads the guiding fields back from the
+	// framebuffers and uploads the resulting lines, seeds and collision points for drawing
+	class HatchingRenderer {
+	public:
+
+		HatchingRenderer(Shared<Hatching> hatching);
+
+		// Reads the currently bound framebuffer into the field
+		void GrabField(EHatchingFields field);
+
+		// Call after Hatching::CreateHatchingLines
+		void UpdateBuffers();
+
+		void DrawScreenSeeds();
+		int GetNumVisibleScreenSeeds();
+		void DrawHatchingLines(Shared<Shader> shader);
+		void DrawCollisionPoints();
+
+		// Uploads the cost heatmap of the last CreateHatchingLines, one texel per grid cell
+		void UpdateCostHeatmap(EHatchingCosts type);
+		unsigned int GetCostHeatmapTexture();
+
+	private:
+
+		struct LayerBuffers {
+			unsigned int m_LinesVAO;
+			unsigned int m_LinesVertexBuffer;
+			unsigned int m_LinesIndexBuffer;
+			int m_NumLinesIndices;
+
+			unsigned int m_CollisionVAO;
+			unsigned int m_CollisionVBO;
+			int m_NumCollisionPoints;
+		};
+
+		Shared<Hatching> m_Hatching;
+		std::vector<LayerBuffers> m_LayerBuffers;
+
+		unsigned int m_ScreenSeedsVAO;
+		unsigned int m_ScreenSeedsVBO;
+		int m_NumVisibleScreenSeeds;
+
+		unsigned int m_CostHeatmapTexture;
+		std::vector<unsigned char> m_CostHeatmapPixels;
+
+		MemoryCounter m_BufferMemory;
+		MemoryCounter m_TextureMemory;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "utility.h"
+
+namespace Copperplate {
+
+	enum EHatchingDirections {
+		HD_LargestCurvature,
+		HD_SmallestCurvature,
+		HD_Normal,
+		HD_Tangent,
+		HD_ShadeGradient,
+		HD_ShadeNormal,
+	};
+
+	// Work of the stroke simulation that is counted per grid cell for the cost heatmap
+	enum EHatchingCosts {
+		HC_CollisionQueries,
+		HC_SeedScans,
+		HC_RelaxEvaluations,
+		HC_ExtendSteps,
+		HC_NumCosts,		//as a heatmap type the sum of all costs
+	};
+
+	const char* getHatchingCostName(EHatchingCosts type);
+
+	struct HatchingSettings {
+		float m_LineDistance =		4.0f;
+		float m_CollisionRadius =	m_LineDistance * 0.7f;
+		float m_CoverRadius =		m_LineDistance * 1.0f;
+		float m_TrimRadius =		m_LineDistance * 0.7f;
+		float m_ExtendRadius =		m_LineDistance * 1.2f;
+		float m_MergeRadius =		m_LineDistance * 1.3f;
+		float m_SplitAngle =		degToRad(20);
+		float m_ParallelAngle =		degToRad(10);
+		float m_ExtendStraightVsCloseWeight = 0.8f;
+		float m_OptiStepSize = 1.0f;
+		int	  m_NumOptiSteps = 4;
+		float m_OptiSeedWeight = 2.0f;
+		float m_OptiSmoothWeight = 5.0f;
+		float m_OptiFieldWeight = 3.0f;
+		float m_OptiSpringWeight = 2.0f;
+
+		float m_MinLineWidth =	1.0f;
+		float m_MaxLineWidth =	3.0f;
+		float m_MinShade =		0.0f;
+		float m_MaxShade =		1.0f;
+		EHatchingDirections m_Direction = EHatchingDirections::HD_LargestCurvature;
+
+		HatchingSettings(float lineDistance, float splitAngleDeg, float parallelAngleDeg, float minWidth, float maxWidth, float minShade, float maxShade, EHatchingDirections direction) {
+			m_LineDistance = lineDistance;
+			m_CollisionRadius = m_LineDistance * 0.7f;
+			m_CoverRadius = m_LineDistance * 1.0f;
+			m_TrimRadius = m_LineDistance * 0.7f;
+			m_ExtendRadius = m_LineDistance * 1.2f;
+			m_MergeRadius = m_LineDistance * 1.3f;
+			m_SplitAngle = degToRad(splitAngleDeg);
+			m_ParallelAngle = degToRad(parallelAngleDeg);
+
+			m_MinLineWidth = minWidth;
+			m_MaxLineWidth = maxWidth;
+			m_MinShade = minShade;
+			m_MaxShade = maxShade;
+			m_Direction = direction;
+		}
+	};
+
+	// Debug switches for the stroke simulation, toggled from the keyboard
+	class HatchingDebugSettings {
+	public:
+		static bool RegenerateHatching;
+		static int NumHatchingLines;
+		static int NumPointsPerHatch;
+	};
+}
\ No newline at end of file
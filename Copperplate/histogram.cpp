@@ -0,0 +1,96 @@
+#pragma once
+
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Copperplate {
+
+	Histogram::Histogram() {
+		Reset();
+	}
+
+	void Histogram::Record(float value) {
+		value = std::max(value, 0.0f);
+		m_Buckets[GetBucketIndex(value)]++;
+		if (m_Count == 0) {
+			m_Min = value;
+			m_Max = value;
+		}
+		m_Min = std::min(m_Min, value);
+		m_Max = std::max(m_Max, value);
+		m_Sum += value;
+		m_Count++;
+	}
+
+	void Histogram::Reset() {
+		m_Buckets.fill(0);
+		m_Count = 0;
+		m_Sum = 0.0;
+		m_Min = 0.0f;
+		m_Max = 0.0f;
+	}
+
+	uint64_t Histogram::GetCount() const {
+		return m_Count;
+	}
+
+	float Histogram::GetMin() const {
+		return m_Min;
+	}
+
+	float Histogram::GetMax() const {
+		return m_Max;
+	}
+
+	float Histogram::GetMean() const {
+		if (m_Count == 0) return 0.0f;
+		return (float)(m_Sum / m_Count);
+	}
+
+	float Histogram::GetPercentile(float percentile) const {
+		if (m_Count == 0) return 0.0f;
+		if (percentile >= 1.0f) return m_Max;
+		// nearest rank, the tolerance keeps float percentiles like 0.99f from rounding up a whole rank
+		double position = (double)percentile * m_Count;
+		uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(position - position * 1e-6));
+		uint64_t seen = 0;
+		for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+			seen += m_Buckets[i];
+			if (seen >= rank) {
+				return std::clamp(GetBucketValue(i), m_Min, m_Max);
+			}
+		}
+		return m_Max;
+	}
+
+	uint64_t Histogram::GetBucketCount(int index) const {
+		return m_Buckets[index];
+	}
+
+	int Histogram::GetBucketIndex(float value) {
+		uint64_t scaled = (uint64_t)(value * HISTOGRAM_SCALE + 0.5f);
+		if (scaled < HISTOGRAM_SUB_BUCKETS) return (int)scaled;
+
+		// position of the highest bit decides the octave, the bits below it the linear bucket
+		int highestBit = 0;
+		while ((scaled >> (highestBit + 1)) != 0) {
+			highestBit++;
+		}
+		const int subBits = 5;	//log2(HISTOGRAM_SUB_BUCKETS / 2)
+		int shift = highestBit - subBits;
+		int index = HISTOGRAM_SUB_BUCKETS + (shift - 1) * HISTOGRAM_SUB_BUCKETS / 2 + (int)(scaled >> shift) - HISTOGRAM_SUB_BUCKETS / 2;
+		return std::min(index, HISTOGRAM_BUCKETS - 1);
+	}
+
+	float Histogram::GetBucketValue(int index) {
+		if (index < HISTOGRAM_SUB_BUCKETS) return index / HISTOGRAM_SCALE;
+
+		int shift = (index - HISTOGRAM_SUB_BUCKETS) / (HISTOGRAM_SUB_BUCKETS / 2) + 1;
+		uint64_t sub = (index - HISTOGRAM_SUB_BUCKETS) % (HISTOGRAM_SUB_BUCKETS / 2) + HISTOGRAM_SUB_BUCKETS / 2;
+		double lower = (double)(sub << shift);
+		double width = (double)(1ull << shift);
+		return (float)((lower + 0.5 * width) / HISTOGRAM_SCALE);
+	}
+}
\ No newline at end of file
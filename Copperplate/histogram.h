@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace Copperplate {
+
+	// Values are resolved to 1/1000 of their unit, so 1us for times in ms
+	const float HISTOGRAM_SCALE = 1000.0f;
+	// Buckets per power of two, the relative error of percentiles stays below 1/32
+	const int HISTOGRAM_SUB_BUCKETS = 64;
+	const int HISTOGRAM_OCTAVES = 42;
+	const int HISTOGRAM_BUCKETS = HISTOGRAM_SUB_BUCKETS + HISTOGRAM_OCTAVES * HISTOGRAM_SUB_BUCKETS / 2;
+
+	// Log-linear histogram of non-negative values with a fixed size, recording never allocates.
+	// Small values up to HISTOGRAM_SUB_BUCKETS / HISTOGRAM_SCALE are stored exactly, above that every
+	// power of two is split into HISTOGRAM_SUB_BUCKETS / 2 linear buckets.
+	class Histogram {
+	public:
+
+		Histogram();
+
+		void Record(float value);
+		void Reset();
+
+		uint64_t GetCount() const;
+		float GetMin() const;
+		float GetMax() const;
+		float GetMean() const;
+		// percentile in [0, 1]
+		float GetPercentile(float percentile) const;
+
+		// Raw access for writing dumps
+		uint64_t GetBucketCount(int index) const;
+
+		static int GetBucketIndex(float value);
+		// middle of the value range a bucket covers
+		static float GetBucketValue(int index);
+
+	private:
+
+		std::array<uint64_t, HISTOGRAM_BUCKETS> m_Buckets;
+		uint64_t m_Count;
+		double m_Sum;
+		float m_Min;
+		float m_Max;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,397 @@
+#pragma once
+
+#include "hud.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+
+namespace Copperplate {
+
+	const int HUD_FONT_FIRST = 32;
+	const int HUD_FONT_GLYPHS = 96;		//printable ascii, the last glyph is a solid block for rects
+	const int HUD_GLYPH_WIDTH = 5;
+	const int HUD_GLYPH_HEIGHT = 7;
+	const int HUD_GLYPH_STRIDE = 6;		//glyphs are one texel apart in the font texture
+	const float HUD_SCALE = 2.0f;		//screen pixels per font texel
+	const float HUD_ADVANCE = HUD_GLYPH_STRIDE * HUD_SCALE;
+	const float HUD_LINE_HEIGHT = 9.0f * HUD_SCALE;
+	const float HUD_MARGIN = 8.0f;
+	const float HUD_PADDING = 8.0f;
+	const int HUD_COLUMNS = 40;			//characters per line
+	const float HUD_BAR_WIDTH = 4.0f;	//per frame in the graphs
+	const float HUD_GRAPH_HEIGHT = 64.0f;
+	// a layer shows up red in the tables once it takes this much longer than on average
+	const float HUD_SPIKE_FACTOR = 1.5f;
+	const float HUD_SPIKE_MIN = 0.1f;	//ms
+
+	// Columns of each glyph from left to right, the lowest bit is the top row
+	const unsigned char HUD_FONT[HUD_FONT_GLYPHS][HUD_GLYPH_WIDTH] = {
+		{ 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 }, { 0x14, 0x7F, 0x14, 0x7F, 0x14 },
+		{ 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 }, { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 },
+		{ 0x00, 0x1C, 0x22, 0x41, 0x00 }, { 0x00, 0x41, 0x22, 0x1C, 0x00 }, { 0x08, 0x2A, 0x1C, 0x2A, 0x08 }, { 0x08, 0x08, 0x3E, 0x08, 0x08 },
+		{ 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 }, { 0x20, 0x10, 0x08, 0x04, 0x02 },
+		{ 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 }, { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4B, 0x31 },
+		{ 0x18, 0x14, 0x12, 0x7F, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },
+		{ 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1E }, { 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 },
+		{ 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 }, { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 },
+		{ 0x32, 0x49, 0x79, 0x41, 0x3E }, { 0x7E, 0x11, 0x11, 0x11, 0x7E }, { 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 },
+		{ 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 }, { 0x7F, 0x09, 0x09, 0x01, 0x01 }, { 0x3E, 0x41, 0x41, 0x51, 0x32 },
+		{ 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 }, { 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 },
+		{ 0x7F, 0x40, 0x40, 0x40, 0x40 }, { 0x7F, 0x02, 0x04, 0x02, 0x7F }, { 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E },
+		{ 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E }, { 0x7F, 0x09, 0x19, 0x29, 0x46 }, { 0x46, 0x49, 0x49, 0x49, 0x31 },
+		{ 0x01, 0x01, 0x7F, 0x01, 0x01 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F }, { 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x7F, 0x20, 0x18, 0x20, 0x7F },
+		{ 0x63, 0x14, 0x08, 0x14, 0x63 }, { 0x03, 0x04, 0x78, 0x04, 0x03 }, { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7F, 0x41, 0x41, 0x00 },
+		{ 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7F, 0x00 }, { 0x04, 0x02, 0x01, 0x02, 0x04 }, { 0x40, 0x40, 0x40, 0x40, 0x40 },
+		{ 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 }, { 0x7F, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 },
+		{ 0x38, 0x44, 0x44, 0x48, 0x7F }, { 0x38, 0x54, 0x54, 0x54, 0x18 }, { 0x08, 0x7E, 0x09, 0x01, 0x02 }, { 0x08, 0x14, 0x54, 0x54, 0x3C },
+		{ 0x7F, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7D, 0x40, 0x00 }, { 0x20, 0x40, 0x44, 0x3D, 0x00 }, { 0x00, 0x7F, 0x10, 0x28, 0x44 },
+		{ 0x00, 0x41, 0x7F, 0x40, 0x00 }, { 0x7C, 0x04, 0x18, 0x04, 0x78 }, { 0x7C, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 },
+		{ 0x7C, 0x14, 0x14, 0x14, 0x08 }, { 0x08, 0x14, 0x14, 0x18, 0x7C }, { 0x7C, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },
+		{ 0x04, 0x3F, 0x44, 0x40, 0x20 }, { 0x3C, 0x40, 0x40, 0x20, 0x7C }, { 0x1C, 0x20, 0x40, 0x20, 0x1C }, { 0x3C, 0x40, 0x30, 0x40, 0x3C },
+		{ 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0C, 0x50, 0x50, 0x50, 0x3C }, { 0x44, 0x64, 0x54, 0x4C, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 },
+		{ 0x00, 0x00, 0x7F, 0x00, 0x00 }, { 0x00, 0x41, 0x36, 0x08, 0x00 }, { 0x02, 0x01, 0x02, 0x04, 0x02 }, { 0x7F, 0x7F, 0x7F, 0x7F, 0x7F },
+	};
+
+	const unsigned char HUD_BACKGROUND[4] = { 16, 16, 20, 200 };
+	const unsigned char HUD_GRAPH_BACKGROUND[4] = { 40, 40, 48, 200 };
+	const unsigned char HUD_TEXT[4] = { 230, 230, 230, 255 };
+	const unsigned char HUD_TITLE[4] = { 150, 170, 200, 255 };
+	const unsigned char HUD_WARNING[4] = { 255, 80, 60, 255 };
+	const unsigned char HUD_BUDGET[4] = { 255, 80, 60, 160 };
+	const unsigned char HUD_PALETTE[][4] = {
+		{ 78, 121, 167, 255 }, { 242, 142, 43, 255 }, { 89, 161, 79, 255 }, { 176, 122, 161, 255 }, { 237, 201, 72, 255 },
+		{ 118, 183, 178, 255 }, { 255, 157, 167, 255 }, { 156, 117, 95, 255 }, { 225, 87, 89, 255 }, { 186, 176, 172, 255 },
+	};
+	const int HUD_PALETTE_SIZE = sizeof(HUD_PALETTE) / sizeof(HUD_PALETTE[0]);
+
+	// Top level CPU timers, the hatching stages are nested inside T_UpdateHatch
+	const ETimerType HUD_CPU_TIMERS[] = { T_RenderContour, T_UpdateHatch, T_RenderHatch, T_Readback, T_DrawHud, T_SaveFrame };
+	const int HUD_NUM_CPU_TIMERS = sizeof(HUD_CPU_TIMERS) / sizeof(HUD_CPU_TIMERS[0]);
+	const ETimerType HUD_HATCH_TIMERS[] = { T_Advect, T_Resample, T_Relax, T_Topology, T_Delete, T_Split, T_Trim, T_Extend, T_Merge, T_Insert };
+	const int HUD_NUM_HATCH_TIMERS = sizeof(HUD_HATCH_TIMERS) / sizeof(HUD_HATCH_TIMERS[0]);
+
+	PerformanceHud::PerformanceHud()
+		: m_BufferMemory(MC_GLBuffers)
+		, m_TextureMemory(MC_GLTextures) {
+		m_LastFrameNumber = -1;
+		for (StatFrame& frame : m_History) {
+			frame = StatFrame();
+			frame.number = -1;
+		}
+		m_Vertices.reserve(HUD_MAX_QUADS * 4);
+
+		// Font texture, one row of glyphs with a blank column between them
+		int textureWidth = HUD_FONT_GLYPHS * HUD_GLYPH_STRIDE;
+		std::vector<unsigned char> texels(textureWidth * HUD_GLYPH_HEIGHT, 0);
+		for (int glyph = 0; glyph < HUD_FONT_GLYPHS; glyph++) {
+			for (int column = 0; column < HUD_GLYPH_WIDTH; column++) {
+				for (int row = 0; row < HUD_GLYPH_HEIGHT; row++) {
+					if (HUD_FONT[glyph][column] & (1 << row))
+						texels[row * textureWidth + glyph * HUD_GLYPH_STRIDE + column] = 255;
+				}
+			}
+		}
+		glGenTextures(1, &m_FontTexture);
+		glBindTexture(GL_TEXTURE_2D, m_FontTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, textureWidth, HUD_GLYPH_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, texels.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		m_TextureMemory.Set(getGLTextureBytes(m_FontTexture));
+
+		// All quads share one static index buffer
+		std::vector<unsigned short> indices(HUD_MAX_QUADS * 6);
+		for (int quad = 0; quad < HUD_MAX_QUADS; quad++) {
+			unsigned short first = (unsigned short)(quad * 4);
+			unsigned short quadIndices[6] = { first, (unsigned short)(first + 1), (unsigned short)(first + 2), first, (unsigned short)(first + 2), (unsigned short)(first + 3) };
+			std::copy(quadIndices, quadIndices + 6, indices.begin() + quad * 6);
+		}
+
+		glGenVertexArrays(1, &m_VAO);
+		glGenBuffers(1, &m_VBO);
+		glGenBuffers(1, &m_EBO);
+
+		glBindVertexArray(m_VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+		glBufferData(GL_ARRAY_BUFFER, HUD_MAX_QUADS * 4 * sizeof(HudVertex), nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STATIC_DRAW);
+		m_BufferMemory.Set(HUD_MAX_QUADS * 4 * sizeof(HudVertex) + indices.size() * sizeof(unsigned short));
+
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (GLvoid*)offsetof(HudVertex, m_Pos));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(HudVertex), (GLvoid*)offsetof(HudVertex, m_TexCoords));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HudVertex), (GLvoid*)offsetof(HudVertex, m_Color));
+
+		glBindVertexArray(0);
+		glCheckError();
+	}
+
+	void PerformanceHud::Draw(Shared<Shader> shader, glm::ivec2 viewportSize, int numVisibleSeeds, int numSeeds) {
+		TIME_FUNCTION(T_DrawHud);
+		UpdateHistory();
+		const StatFrame* lastFrame = GetHistoryFrame(0);
+		if (!lastFrame)
+			return;
+
+		m_Vertices.clear();
+		// the background is sized once everything else is in place
+		AddRect(0.0f, 0.0f, 0.0f, 0.0f, HUD_BACKGROUND);
+
+		char text[HUD_COLUMNS + 1];
+		float x = HUD_MARGIN + HUD_PADDING;
+		float y = HUD_MARGIN + HUD_PADDING;
+
+		std::snprintf(text, sizeof(text), "frame %d  %.2f ms  %.0f fps", lastFrame->number, lastFrame->totalTime, 1000.0f / std::max(lastFrame->totalTime, 0.001f));
+		AddText(x, y, text, (lastFrame->totalTime > HUD_FRAME_BUDGET) ? HUD_WARNING : HUD_TEXT);
+		y += HUD_LINE_HEIGHT * 1.5f;
+
+		y += AddGraph(x, y, HG_Cpu);
+		y += AddLegend(x, y, HG_Cpu);
+		y += HUD_LINE_HEIGHT * 0.5f;
+		y += AddGraph(x, y, HG_Gpu);
+		y += AddLegend(x, y, HG_Gpu);
+		y += HUD_LINE_HEIGHT * 0.5f;
+		AddText(x, y, "Hatching stages, ms", HUD_TITLE);
+		y += HUD_LINE_HEIGHT;
+		y += AddLegend(x, y, HG_Hatch);
+		y += HUD_LINE_HEIGHT * 0.5f;
+
+		std::snprintf(text, sizeof(text), "lines %d  insert %d  delete %d", lastFrame->counts[C_Lines], lastFrame->counts[C_Insertions], lastFrame->counts[C_Deletions]);
+		AddText(x, y, text, HUD_TEXT);
+		y += HUD_LINE_HEIGHT;
+		std::snprintf(text, sizeof(text), "merge %d  split %d", lastFrame->counts[C_Merges], lastFrame->counts[C_Splits]);
+		AddText(x, y, text, HUD_TEXT);
+		y += HUD_LINE_HEIGHT;
+		std::snprintf(text, sizeof(text), "seeds %d of %d visible", numVisibleSeeds, numSeeds);
+		AddText(x, y, text, HUD_TEXT);
+		y += HUD_LINE_HEIGHT;
+		std::snprintf(text, sizeof(text), "memory %.1f MB resident, %.1f tracked", getResidentMemory() / (1024.0f * 1024.0f),
+			Statistics::Get().getTotalLiveMemory() / (1024.0f * 1024.0f));
+		AddText(x, y, text, HUD_TEXT);
+		y += HUD_LINE_HEIGHT;
+#ifdef COPPERPLATE_ALLOC_TRACKING
+		int allocations = 0;
+		int64_t allocatedBytes = 0;
+		for (int i = 0; i <= T_NumTimers; i++) {
+			allocations += lastFrame->allocations[i];
+			allocatedBytes += lastFrame->allocatedBytes[i];
+		}
+		std::snprintf(text, sizeof(text), "heap %d allocs  %.1f KB", allocations, allocatedBytes / 1024.0f);
+		AddText(x, y, text, HUD_TEXT);
+		y += HUD_LINE_HEIGHT;
+#endif
+
+		// Size the background to the content
+		float width = HUD_COLUMNS * HUD_ADVANCE + 2.0f * HUD_PADDING;
+		float height = y - HUD_MARGIN + HUD_PADDING - (HUD_LINE_HEIGHT - HUD_GLYPH_HEIGHT * HUD_SCALE);
+		for (int i = 0; i < 4; i++) {
+			m_Vertices[i].m_Pos[0] = HUD_MARGIN + ((i == 1 || i == 2) ? width : 0.0f);
+			m_Vertices[i].m_Pos[1] = HUD_MARGIN + ((i >= 2) ? height : 0.0f);
+		}
+
+		// Upload into a fresh buffer so the driver does not have to wait for the last frame
+		glBindVertexArray(m_VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+		glBufferData(GL_ARRAY_BUFFER, HUD_MAX_QUADS * 4 * sizeof(HudVertex), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, m_Vertices.size() * sizeof(HudVertex), m_Vertices.data());
+
+		shader->SetVec3("viewportSize", glm::vec3(viewportSize.x, viewportSize.y, 0.0f));
+		shader->Use();
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, m_FontTexture);
+		glDrawElements(GL_TRIANGLES, (GLsizei)(m_Vertices.size() / 4 * 6), GL_UNSIGNED_SHORT, (GLvoid*)0);
+		glDisable(GL_BLEND);
+		glBindVertexArray(0);
+	}
+
+	void PerformanceHud::UpdateHistory() {
+		for (int age = 19; age >= 0; age--) {
+			StatFrame frame = Statistics::Get().getRecentFrame(age);
+			if (frame.number < 0)
+				continue;
+			m_History[frame.number % HUD_HISTORY] = frame;
+			m_LastFrameNumber = std::max(m_LastFrameNumber, frame.number);
+		}
+	}
+
+	const StatFrame* PerformanceHud::GetHistoryFrame(int age) {
+		int number = m_LastFrameNumber - age;
+		if (number < 0 || age >= HUD_HISTORY)
+			return nullptr;
+		const StatFrame& frame = m_History[number % HUD_HISTORY];
+		return (frame.number == number) ? &frame : nullptr;
+	}
+
+	int PerformanceHud::GetNumLayers(EHudGraphs graph) {
+		switch (graph) {
+		case HG_Cpu: return HUD_NUM_CPU_TIMERS + 1;
+		case HG_Gpu: return GT_NumGpuTimers;
+		case HG_Hatch: return HUD_NUM_HATCH_TIMERS;
+		}
+		return 0;
+	}
+
+	const char* PerformanceHud::GetLayerName(EHudGraphs graph, int layer) {
+		switch (graph) {
+		case HG_Cpu: return (layer < HUD_NUM_CPU_TIMERS) ? getTimerName(HUD_CPU_TIMERS[layer]) : "Other";
+		case HG_Gpu: return getGpuTimerName((EGpuTimerType)layer);
+		case HG_Hatch: return getTimerName(HUD_HATCH_TIMERS[layer]);
+		}
+		return "Unknown";
+	}
+
+	float PerformanceHud::GetLayerTime(EHudGraphs graph, int layer, const StatFrame& frame) {
+		switch (graph) {
+		case HG_Cpu:
+			if (layer < HUD_NUM_CPU_TIMERS)
+				return frame.times[HUD_CPU_TIMERS[layer]];
+			else {
+				// the hatching layers may run in parallel, then their summed time exceeds the frame
+				float other = frame.totalTime;
+				for (ETimerType timer : HUD_CPU_TIMERS) {
+					other -= frame.times[timer];
+				}
+				return std::max(other, 0.0f);
+			}
+		case HG_Gpu: return frame.gpuTimes[layer];
+		case HG_Hatch: return frame.times[HUD_HATCH_TIMERS[layer]];
+		}
+		return 0.0f;
+	}
+
+	float PerformanceHud::GetLayerMean(EHudGraphs graph, int layer) {
+		float sum = 0.0f;
+		int count = 0;
+		for (int age = 0; age < HUD_HISTORY; age++) {
+			const StatFrame* frame = GetHistoryFrame(age);
+			if (!frame)
+				continue;
+			sum += GetLayerTime(graph, layer, *frame);
+			count++;
+		}
+		return (count > 0) ? sum / count : 0.0f;
+	}
+
+	void PerformanceHud::AddRect(float x, float y, float width, float height, const unsigned char color[4]) {
+		if (m_Vertices.size() >= HUD_MAX_QUADS * 4)
+			return;
+		// the solid glyph at the end of the font
+		unsigned short u = (unsigned short)((HUD_FONT_GLYPHS - 1) * HUD_GLYPH_STRIDE + HUD_GLYPH_WIDTH / 2);
+		unsigned short v = (unsigned short)(HUD_GLYPH_HEIGHT / 2);
+		m_Vertices.push_back({ { x, y }, { u, v }, { color[0], color[1], color[2], color[3] } });
+		m_Vertices.push_back({ { x + width, y }, { u, v }, { color[0], color[1], color[2], color[3] } });
+		m_Vertices.push_back({ { x + width, y + height }, { u, v }, { color[0], color[1], color[2], color[3] } });
+		m_Vertices.push_back({ { x, y + height }, { u, v }, { color[0], color[1], color[2], color[3] } });
+	}
+
+	void PerformanceHud::AddText(float x, float y, const char* text, const unsigned char color[4]) {
+		float glyphWidth = HUD_GLYPH_WIDTH * HUD_SCALE;
+		float glyphHeight = HUD_GLYPH_HEIGHT * HUD_SCALE;
+		for (const char* c = text; *c != '\0' && m_Vertices.size() < HUD_MAX_QUADS * 4; c++, x += HUD_ADVANCE) {
+			int glyph = (unsigned char)*c - HUD_FONT_FIRST;
+			if (glyph <= 0 || glyph >= HUD_FONT_GLYPHS - 1)
+				continue;
+			unsigned short u0 = (unsigned short)(glyph * HUD_GLYPH_STRIDE);
+			unsigned short u1 = (unsigned short)(u0 + HUD_GLYPH_WIDTH);
+			unsigned short v1 = (unsigned short)HUD_GLYPH_HEIGHT;
+			m_Vertices.push_back({ { x, y }, { u0, 0 }, { color[0], color[1], color[2], color[3] } });
+			m_Vertices.push_back({ { x + glyphWidth, y }, { u1, 0 }, { color[0], color[1], color[2], color[3] } });
+			m_Vertices.push_back({ { x + glyphWidth, y + glyphHeight }, { u1, v1 }, { color[0], color[1], color[2], color[3] } });
+			m_Vertices.push_back({ { x, y + glyphHeight }, { u0, v1 }, { color[0], color[1], color[2], color[3] } });
+		}
+	}
+
+	float PerformanceHud::AddGraph(float x, float y, EHudGraphs graph) {
+		int numLayers = GetNumLayers(graph);
+		float peak = 0.0f;
+		for (int age = 0; age < HUD_HISTORY; age++) {
+			const StatFrame* frame = GetHistoryFrame(age);
+			if (!frame)
+				continue;
+			float total = 0.0f;
+			for (int layer = 0; layer < numLayers; layer++) {
+				total += GetLayerTime(graph, layer, *frame);
+			}
+			peak = std::max(peak, total);
+		}
+		// round the scale up to 1, 2 or 5 times a power of ten so it does not jump every frame
+		float scale = 1.0f;
+		while (scale < peak) {
+			float decade = scale;
+			while (decade >= 10.0f) decade /= 10.0f;
+			scale *= (decade < 1.5f || decade >= 4.5f) ? 2.0f : 2.5f;
+		}
+
+		char text[HUD_COLUMNS + 1];
+		std::snprintf(text, sizeof(text), "%s ms, scale %g", (graph == HG_Gpu) ? "GPU" : "CPU", scale);
+		AddText(x, y, text, HUD_TITLE);
+		y += HUD_LINE_HEIGHT;
+
+		float width = HUD_HISTORY * HUD_BAR_WIDTH;
+		AddRect(x, y, width, HUD_GRAPH_HEIGHT, HUD_GRAPH_BACKGROUND);
+		for (int age = 0; age < HUD_HISTORY; age++) {
+			const StatFrame* frame = GetHistoryFrame(age);
+			if (!frame)
+				continue;
+			// newest frame on the right
+			float barX = x + width - (age + 1) * HUD_BAR_WIDTH;
+			float barBottom = y + HUD_GRAPH_HEIGHT;
+			for (int layer = 0; layer < numLayers; layer++) {
+				float height = std::min(GetLayerTime(graph, layer, *frame) / scale * HUD_GRAPH_HEIGHT, barBottom - y);
+				if (height < 0.5f)
+					continue;
+				AddRect(barX, barBottom - height, HUD_BAR_WIDTH - 1.0f, height, HUD_PALETTE[layer % HUD_PALETTE_SIZE]);
+				barBottom -= height;
+			}
+		}
+		if (HUD_FRAME_BUDGET <= scale)
+			AddRect(x, y + HUD_GRAPH_HEIGHT * (1.0f - HUD_FRAME_BUDGET / scale), width, 1.0f, HUD_BUDGET);
+
+		return HUD_LINE_HEIGHT + HUD_GRAPH_HEIGHT + HUD_LINE_HEIGHT * 0.5f;
+	}
+
+	float PerformanceHud::AddLegend(float x, float y, EHudGraphs graph) {
+		// GPU times of the newest frames are still in flight, show the last frame that has them
+		const StatFrame* frame = nullptr;
+		for (int age = 0; age < HUD_HISTORY && !frame; age++) {
+			frame = GetHistoryFrame(age);
+			if (frame && graph == HG_Gpu) {
+				float total = 0.0f;
+				for (int layer = 0; layer < GT_NumGpuTimers; layer++) {
+					total += frame->gpuTimes[layer];
+				}
+				if (total <= 0.0f)
+					frame = nullptr;
+			}
+		}
+
+		int numLayers = GetNumLayers(graph);
+		float columnWidth = HUD_COLUMNS / 2 * HUD_ADVANCE;
+		float swatchSize = HUD_GLYPH_HEIGHT * HUD_SCALE;
+		char text[HUD_COLUMNS + 1];
+		for (int layer = 0; layer < numLayers; layer++) {
+			float layerX = x + (layer % 2) * columnWidth;
+			float layerY = y + (layer / 2) * HUD_LINE_HEIGHT;
+			float time = frame ? GetLayerTime(graph, layer, *frame) : 0.0f;
+			float mean = GetLayerMean(graph, layer);
+			bool spike = time > mean * HUD_SPIKE_FACTOR && time - mean > HUD_SPIKE_MIN;
+
+			if (graph != HG_Hatch)
+				AddRect(layerX, layerY, swatchSize, swatchSize, HUD_PALETTE[layer % HUD_PALETTE_SIZE]);
+			// fewer decimals for slow stages so the value keeps its six characters
+			int decimals = (time >= 1000.0f) ? 0 : (time >= 100.0f) ? 1 : 2;
+			std::snprintf(text, sizeof(text), "%-11.11s %6.*f", GetLayerName(graph, layer), decimals, time);
+			AddText(layerX + swatchSize + HUD_ADVANCE * 0.5f, layerY, text, spike ? HUD_WARNING : HUD_TEXT);
+		}
+		return (numLayers + 1) / 2 * HUD_LINE_HEIGHT;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "gldebug.h"
+#include "shader.h"
+#include "statistics.h"
+
+#include <glm/ext/vector_int2.hpp>
+
+#include <vector>
+
+namespace Copperplate {
+
+	const int HUD_HISTORY = 120;			//frames shown in the graphs
+	const int HUD_MAX_QUADS = 8192;			//indices are 16 bit, so at most 16384
+	const float HUD_FRAME_BUDGET = 1000.0f / 60.0f;	//ms, drawn as a line into the graphs
+
+	enum EHudGraphs {
+		HG_Cpu,		//top level timers and everything else in the frame
+		HG_Gpu,		//all GPU passes
+		HG_Hatch,	//stages of the hatching update, only as a table
+	};
+
+	// Performance overlay in the top left corner: rolling graphs of the CPU stages and GPU passes, the hatching
+	// counters, seed visibility and memory usage. Text uses a built in 5x7 bitmap font, all glyphs and graph
+	// bars are quads in one vertex buffer that is drawn with a single call.
+	class PerformanceHud {
+	public:
+
+		PerformanceHud();
+
+		// Draws the last finished frames of the statistics on top of the current framebuffer
+		void Draw(Shared<Shader> shader, glm::ivec2 viewportSize, int numVisibleSeeds, int numSeeds);
+
+	private:
+
+		struct HudVertex {
+			float m_Pos[2];					//pixels from the top left corner
+			unsigned short m_TexCoords[2];	//texel in the font texture
+			unsigned char m_Color[4];
+		};
+
+		// Copies the frames of the statistics ring, GPU times arrive a few frames late
+		void UpdateHistory();
+		const StatFrame* GetHistoryFrame(int age);
+
+		int GetNumLayers(EHudGraphs graph);
+		const char* GetLayerName(EHudGraphs graph, int layer);
+		float GetLayerTime(EHudGraphs graph, int layer, const StatFrame& frame);
+		float GetLayerMean(EHudGraphs graph, int layer);
+
+		void AddRect(float x, float y, float width, float height, const unsigned char color[4]);
+		void AddText(float x, float y, const char* text, const unsigned char color[4]);
+		// Stacked bars of all layers over the history, returns the height used
+		float AddGraph(float x, float y, EHudGraphs graph);
+		// Two columns with the value of every layer in the last frame, returns the height used
+		float AddLegend(float x, float y, EHudGraphs graph);
+
+		int m_LastFrameNumber;
+		StatFrame m_History[HUD_HISTORY];	//indexed by frame number modulo the size
+
+		std::vector<HudVertex> m_Vertices;
+		unsigned int m_VAO;
+		unsigned int m_VBO;
+		unsigned int m_EBO;
+		unsigned int m_FontTexture;
+
+		MemoryCounter m_BufferMemory;
+		MemoryCounter m_TextureMemory;
+	};
+}
\ No newline at end of file
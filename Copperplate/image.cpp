@@ -1,13 +1,17 @@
 #pragma once
 
 #include "image.h"
-#include <glm\common.hpp>
+#include <glm/common.hpp>
+
+#include <algorithm>
 
 namespace Copperplate {
 
-	Image::Image(int width, int height) {
+	Image::Image(int width, int height)
+		: m_Memory(MC_Images) {
 		m_Size = glm::ivec2(width, height);
 		m_Data = new glm::vec4[width * height];
+		m_Memory.Set((int64_t)width * height * sizeof(glm::vec4));
 	}
 
 	Image::~Image() {
@@ -44,8 +48,16 @@ namespace Copperplate {
 		return m_Data[pixelPos.y * m_Size.x + pixelPos.x];
 	}
 
-	void Image::CopyFrameBuffer() {
-		glReadPixels(0, 0, m_Size.x, m_Size.y, GL_RGBA, GL_FLOAT, m_Data);
+	float* Image::GetData() {
+		return &m_Data[0].x;
+	}
+
+	void Image::SetData(const float* data) {
+		std::copy(data, data + m_Size.x * m_Size.y * 4, GetData());
+	}
+
+	glm::ivec2 Image::GetSize() {
+		return m_Size;
 	}
 
 }
\ No newline at end of file
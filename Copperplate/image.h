@@ -1,10 +1,11 @@
 #pragma once
 
 #include "core.h"
+#include "statistics.h"
 
-#include <glm\ext\vector_float2.hpp>
-#include <glm\ext\vector_float4.hpp>
-#include <glm\ext\vector_int2.hpp>
+#include <glm/ext/vector_float2.hpp>
+#include <glm/ext/vector_float4.hpp>
+#include <glm/ext/vector_int2.hpp>
 
 
 namespace Copperplate {	
@@ -19,12 +20,16 @@ namespace Copperplate {
 		glm::vec4 Sample(glm::vec2 screenPos);
 		glm::vec4 Sample(glm::ivec2 pixelPos);
 
-		void CopyFrameBuffer();
+		// RGBA floats, row by row starting at the bottom like glReadPixels
+		float* GetData();
+		void SetData(const float* data);
+		glm::ivec2 GetSize();
 
 	private:
 
 		glm::ivec2 m_Size;
 		glm::vec4* m_Data;
+		MemoryCounter m_Memory;
 
 	};
 }
\ No newline at end of file
@@ -1,8 +1,9 @@
 #pragma once
 
 #include "application.h"
+#include "statistics.h"
 
-#include <glm\gtc\type_ptr.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <stdio.h>
 
@@ -10,12 +11,24 @@ using namespace Copperplate;
 
 int main(int argc, char* argv[]) {
 	// Setup
-	Application::Init();
+	LaunchSettings settings;
+	if (!LaunchSettings::Parse(argc, argv, settings)) {
+		LaunchSettings::PrintUsage();
+		return 1;
+	}
+	if (!settings.m_CompareBase.empty()) {
+		bool regressed = false;
+		if (!compareHistogramDumps(settings.m_CompareBase, settings.m_CompareNew, settings.m_Tolerance, regressed))
+			return 1;
+		return regressed ? 1 : 0;
+	}
+	if (!Application::Init(settings))
+		return 1;
 
 	
 	// Main Loop
-	Application::Run();
+	bool success = Application::Run();
 	
 	// Shutdown
-	return 0;
+	return success ? 0 : 1;
 }
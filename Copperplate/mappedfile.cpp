@@ -0,0 +1,127 @@
+#pragma once
+
+#include "mappedfile.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Copperplate {
+
+	MappedFile::MappedFile()
+		: m_Data(nullptr)
+		, m_Size(0)
+#ifdef _WIN32
+		, m_File(INVALID_HANDLE_VALUE)
+		, m_Mapping(nullptr) {
+#else
+		, m_File(-1) {
+#endif
+	}
+
+	MappedFile::~MappedFile() {
+		Close();
+	}
+
+	bool MappedFile::Open(const std::string& path) {
+		Close();
+#ifdef _WIN32
+		m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (m_File == INVALID_HANDLE_VALUE) {
+			std::cout << "Could not open " << path << std::endl;
+			return false;
+		}
+		LARGE_INTEGER size;
+		GetFileSizeEx(m_File, &size);
+		m_Size = size.QuadPart;
+		// empty files cannot be mapped, they are open with a null pointer
+		if (m_Size == 0)
+			return true;
+		m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_Mapping)
+			m_Data = (const uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		m_File = open(path.c_str(), O_RDONLY);
+		if (m_File < 0) {
+			std::cout << "Could not open " << path << std::endl;
+			return false;
+		}
+		struct stat status;
+		fstat(m_File, &status);
+		m_Size = status.st_size;
+		if (m_Size == 0)
+			return true;
+		void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0);
+		if (data != MAP_FAILED) {
+			m_Data = (const uint8_t*)data;
+			// the files are read front to back, let the kernel read ahead aggressively
+			madvise(data, m_Size, MADV_SEQUENTIAL);
+		}
+#endif
+		if (!m_Data) {
+			std::cout << "Could not map " << path << std::endl;
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::Close() {
+#ifdef _WIN32
+		if (m_Data)
+			UnmapViewOfFile(m_Data);
+		if (m_Mapping)
+			CloseHandle(m_Mapping);
+		if (m_File != INVALID_HANDLE_VALUE)
+			CloseHandle(m_File);
+		m_Mapping = nullptr;
+		m_File = INVALID_HANDLE_VALUE;
+#else
+		if (m_Data)
+			munmap((void*)m_Data, m_Size);
+		if (m_File >= 0)
+			close(m_File);
+		m_File = -1;
+#endif
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+
+	bool MappedFile::IsOpen() {
+#ifdef _WIN32
+		return m_File != INVALID_HANDLE_VALUE;
+#else
+		return m_File >= 0;
+#endif
+	}
+
+	void MappedFile::Prefetch(int64_t offset, int64_t size) {
+		if (!m_Data || size <= 0)
+			return;
+#ifdef _WIN32
+		WIN32_MEMORY_RANGE_ENTRY range = { (void*)(m_Data + offset), (SIZE_T)size };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+		// madvise wants a page aligned start
+		int64_t pageSize = sysconf(_SC_PAGESIZE);
+		int64_t start = offset - offset % pageSize;
+		madvise((void*)(m_Data + start), offset + size - start, MADV_WILLNEED);
+#endif
+	}
+
+	const uint8_t* MappedFile::GetData() {
+		return m_Data;
+	}
+
+	int64_t MappedFile::GetSize() {
+		return m_Size;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Copperplate {
+
+	// Read-only memory mapping of a whole file, pages are only read from disk when they are touched
+	class MappedFile {
+	public:
+
+		MappedFile();
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::string& path);
+		void Close();
+
+		bool IsOpen();
+		// Asks the system to read the range from disk in the background, before it is touched
+		void Prefetch(int64_t offset, int64_t size);
+		const uint8_t* GetData();
+		int64_t GetSize();
+
+	private:
+
+		const uint8_t* m_Data;
+		int64_t m_Size;
+#ifdef _WIN32
+		void* m_File;
+		void* m_Mapping;
+#else
+		int m_File;
+#endif
+	};
+}
\ No newline at end of file
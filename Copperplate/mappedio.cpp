@@ -0,0 +1,113 @@
+#pragma once
+
+#include "mappedio.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+namespace Copperplate {
+
+	//MAPPEDIOSTREAM IMPLEMENTATION
+	MappedIOStream::MappedIOStream(Unique<MappedFile> file) {
+		m_File = std::move(file);
+		m_Data = m_File->GetData();
+		m_Size = m_File->GetSize();
+		m_Position = 0;
+		m_PrefetchedUntil = 0;
+		m_BytesRead = 0;
+	}
+
+	size_t MappedIOStream::Read(void* buffer, size_t size, size_t count) {
+		if (size == 0 || count == 0 || m_Position >= m_Size)
+			return 0;
+		// like fread only whole elements are read
+		int64_t numElements = std::min<int64_t>(count, (m_Size - m_Position) / size);
+		int64_t bytes = numElements * size;
+		// a window ahead is requested once the reads get close to the end of the last one, the sequential
+		// advice of the mapping alone only reads ahead a few pages
+		if (m_Position + bytes + MAPPEDIO_READ_AHEAD / 2 > m_PrefetchedUntil && m_PrefetchedUntil < m_Size) {
+			int64_t start = std::max(m_Position, m_PrefetchedUntil);
+			m_PrefetchedUntil = std::min(m_Size, m_Position + bytes + MAPPEDIO_READ_AHEAD);
+			m_File->Prefetch(start, m_PrefetchedUntil - start);
+		}
+		memcpy(buffer, m_Data + m_Position, bytes);
+		m_Position += bytes;
+		m_BytesRead += bytes;
+		return numElements;
+	}
+
+	size_t MappedIOStream::Write(const void* /*buffer*/, size_t /*size*/, size_t /*count*/) {
+		return 0;
+	}
+
+	aiReturn MappedIOStream::Seek(size_t offset, aiOrigin origin) {
+		int64_t position;
+		if (origin == aiOrigin_SET)
+			position = offset;
+		else if (origin == aiOrigin_CUR)
+			position = m_Position + offset;
+		else if (origin == aiOrigin_END)
+			position = m_Size - offset;
+		else
+			return aiReturn_FAILURE;
+		if (position < 0 || position > m_Size)
+			return aiReturn_FAILURE;
+		m_Position = position;
+		return aiReturn_SUCCESS;
+	}
+
+	size_t MappedIOStream::Tell() const {
+		return m_Position;
+	}
+
+	size_t MappedIOStream::FileSize() const {
+		return m_Size;
+	}
+
+	void MappedIOStream::Flush() {
+	}
+
+	int64_t MappedIOStream::GetBytesRead() {
+		return m_BytesRead;
+	}
+
+	//MAPPEDIOSYSTEM IMPLEMENTATION
+	MappedIOSystem::MappedIOSystem() {
+		m_BytesRead = 0;
+	}
+
+	bool MappedIOSystem::Exists(const char* file) const {
+		std::error_code error;
+		return std::filesystem::is_regular_file(file, error);
+	}
+
+	char MappedIOSystem::getOsSeparator() const {
+#ifdef _WIN32
+		return '\\';
+#else
+		return '/';
+#endif
+	}
+
+	Assimp::IOStream* MappedIOSystem::Open(const char* file, const char* mode) {
+		if (strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+'))
+			return nullptr;
+		// optional files like materials are probed by opening them, so a missing file is not reported here
+		if (!Exists(file))
+			return nullptr;
+		Unique<MappedFile> mapped = CreateUnique<MappedFile>();
+		if (!mapped->Open(file))
+			return nullptr;
+		return new MappedIOStream(std::move(mapped));
+	}
+
+	void MappedIOSystem::Close(Assimp::IOStream* file) {
+		m_BytesRead += static_cast<MappedIOStream*>(file)->GetBytesRead();
+		delete file;
+	}
+
+	int64_t MappedIOSystem::GetBytesRead() {
+		return m_BytesRead;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "core.h"
+#include "mappedfile.h"
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <cstdint>
+
+namespace Copperplate {
+
+	const int64_t MAPPEDIO_READ_AHEAD = 16 * 1024 * 1024;	//bytes requested from the disk ahead of the read position
+
+	// Assimp stream over a read-only file mapping. Reads copy straight out of the mapped pages and the kernel is asked
+	// to fetch the next window before the importer gets there, instead of pulling the file through stdio buffers.
+	class MappedIOStream : public Assimp::IOStream {
+	public:
+
+		MappedIOStream(Unique<MappedFile> file);
+
+		size_t Read(void* buffer, size_t size, size_t count) override;
+		// The mapping is read-only, nothing is ever written
+		size_t Write(const void* buffer, size_t size, size_t count) override;
+		aiReturn Seek(size_t offset, aiOrigin origin) override;
+		size_t Tell() const override;
+		size_t FileSize() const override;
+		void Flush() override;
+
+		int64_t GetBytesRead();
+
+	private:
+
+		Unique<MappedFile> m_File;
+		const uint8_t* m_Data;
+		int64_t m_Size;
+		int64_t m_Position;
+		int64_t m_PrefetchedUntil;
+		int64_t m_BytesRead;
+	};
+
+	// Opens every file the importer asks for, the mesh and e.g. its materials, as a MappedIOStream. Only for reading,
+	// the importer owns it and one importer is used by one thread at a time.
+	class MappedIOSystem : public Assimp::IOSystem {
+	public:
+
+		MappedIOSystem();
+
+		bool Exists(const char* file) const override;
+		char getOsSeparator() const override;
+		Assimp::IOStream* Open(const char* file, const char* mode = "rb") override;
+		void Close(Assimp::IOStream* file) override;
+
+		// Over all streams that were closed so far
+		int64_t GetBytesRead();
+
+	private:
+
+		int64_t m_BytesRead;
+	};
+}
\ No newline at end of file
@@ -1,14 +1,14 @@
 #pragma once
 
 #include "mesh.h"
+#include "mappedio.h"
+#include "utility.h"
 
 #include <assimp/postprocess.h>
 #include <glad/glad.h>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include <map>
-
 namespace Copperplate {
 
 	float testVertices[] = { 0.5f,  0.5f,  0.5f,
@@ -33,7 +33,42 @@ namespace Copperplate {
 									6, 5, 7,
 									5, 4, 7	};
 
+	int64_t createGeometryBuffers(uint32_t flags, int numVertices, int numFaces, const uint8_t* vertexData, const uint8_t* indexData,
+		unsigned int& outVertexArray, unsigned int& outVertexBuffer, unsigned int& outElementBuffer) {
+		int stride = MeshBuffers::GetVertexStride(flags);
+		int64_t vertexBytes = MeshBuffers::GetVertexBytes(flags, numVertices);
+		int64_t indexBytes = MeshBuffers::GetIndexBytes(flags, numFaces);
+
+		// setup opengl buffers
+		glGenVertexArrays(1, &outVertexArray);
+		glGenBuffers(1, &outVertexBuffer);
+		glGenBuffers(1, &outElementBuffer);
+
+		glBindVertexArray(outVertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, outVertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, outElementBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexData, GL_STATIC_DRAW);
+
+		// configure vertex attributes, the shaders decode the octahedral normals
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, (flags & MB_HalfPositions) ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (GLvoid*)(stride - 2 * sizeof(GLshort)));
+		glEnableVertexAttribArray(0);
+
+		return vertexBytes + indexBytes;
+	}
+
+	void drawGeometryBuffers(const MeshBuffers& buffers, unsigned int vertexArray) {
+		glBindVertexArray(vertexArray);
+		glDrawElements(GL_TRIANGLES_ADJACENCY, 6 * buffers.m_NumFaces, (buffers.m_Flags & MB_ShortIndices) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, 0);
+	}
+
 	//MESHCREATOR IMPLEMENTATION
+	std::string MeshCreator::CacheDirectory = "";
+
 	Unique<Mesh> MeshCreator::CreateTestMesh() {		
 		/*
 		std::unique_ptr<Mesh> testMesh = std::make_unique<Mesh>(testVertices, 24, testIndices, 36);
@@ -48,175 +83,503 @@ namespace Copperplate {
 		return nullptr;
 	}
 
-	Unique<Mesh> MeshCreator::ImportMesh(const std::string& fileName) {
+	Shared<MeshAsset> MeshCreator::ImportAsset(const std::string& fileName, bool upload) {
 		Assimp::Importer importer;
+		// the importer owns the io system and deletes it with itself
+		MappedIOSystem* ioSystem = new MappedIOSystem();
+		importer.SetIOHandler(ioSystem);
 
+		auto start = std::chrono::steady_clock::now();
 		const aiScene* scene = importer.ReadFile(fileName, 
 			aiProcess_Triangulate			|
 			aiProcess_JoinIdenticalVertices |
 			aiProcess_SortByPType			|
 			aiProcess_GenSmoothNormals);
+		float parseTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		Statistics::Get().recordImport(ioSystem->GetBytesRead(), parseTime);
 
-		if (!scene) {
+		if (!scene || !scene->mRootNode) {
 			std::cout << "Asset Import Failed:" << importer.GetErrorString() << "\n";
 			return nullptr;
 		}
 
-		Unique<Mesh> mesh = CreateUnique<Mesh>();
+		Shared<MeshAsset> asset = CreateShared<MeshAsset>();
+		asset->m_FileName = fileName;
+
+		// points and lines were sorted into meshes of their own, they have no faces to hatch
+		std::vector<int> meshIndices(scene->mNumMeshes, -1);
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+			const aiMesh* importedMesh = scene->mMeshes[i];
+			if (importedMesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE || importedMesh->mNumFaces == 0)
+				continue;
+			meshIndices[i] = asset->m_Meshes.size();
+			asset->m_Meshes.push_back(BuildMesh(importedMesh, upload));
+			// the same index the mesh gets in the cache, it is part of the seed cache key
+			asset->m_Meshes.back()->m_MeshIndex = meshIndices[i];
+		}
+		if (asset->m_Meshes.empty()) {
+			std::cout << "Asset Import Failed: " << fileName << " contains no triangles\n";
+			return nullptr;
+		}
+
+		// flatten the node tree depth first, so parents come before their children
+		std::vector<std::pair<const aiNode*, int>> stack = { { scene->mRootNode, -1 } };
+		while (!stack.empty()) {
+			const aiNode* node = stack.back().first;
+			MeshNode meshNode;
+			meshNode.m_Parent = stack.back().second;
+			stack.pop_back();
+			// assimp matrices are row major
+			const aiMatrix4x4& m = node->mTransformation;
+			meshNode.m_Transform = glm::mat4(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+			for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+				int mesh = meshIndices[node->mMeshes[i]];
+				if (mesh >= 0)
+					meshNode.m_Meshes.push_back(mesh);
+			}
+			int index = asset->m_Nodes.size();
+			asset->m_Nodes.push_back(meshNode);
+			for (int i = node->mNumChildren - 1; i >= 0; i--) {
+				stack.push_back({ node->mChildren[i], index });
+			}
+		}
 
-		aiMesh* importedMesh = scene->mMeshes[0];
+		return asset;
+	}
+
+	Shared<MeshAsset> MeshCreator::LoadAsset(const std::string& fileName, bool upload) {
+		uint64_t sourceHash;
+		if (CacheDirectory.empty() || !MeshCache::HashFile(fileName, sourceHash))
+			return ImportAsset(fileName, upload);
+
+		Shared<MeshAsset> asset;
+		std::string cachePath = MeshCache::GetMeshPath(CacheDirectory, sourceHash);
+		Shared<MeshCache> cache = CreateShared<MeshCache>();
+		if (cache->Open(cachePath, sourceHash)) {
+			std::cout << "Loading " << fileName << " from " << cachePath << "\n";
+			asset = LoadCachedAsset(cache, upload);
+			asset->m_FileName = fileName;
+		}
+		else {
+			asset = ImportAsset(fileName, upload);
+			if (!asset)
+				return nullptr;
+			std::vector<MeshCacheInput> meshes;
+			for (const Shared<Mesh>& mesh : asset->m_Meshes) {
+				MeshCacheInput input = { &mesh->m_HalfEdgeMesh, &mesh->m_Buffers, &mesh->m_AreaSums, {} };
+				for (const MeshLod& lod : mesh->m_Lods) {
+					input.m_Lods.push_back({ lod.m_Error, &lod.m_Buffers });
+				}
+				meshes.push_back(input);
+			}
+			MeshCache::WriteMeshes(cachePath, sourceHash, meshes, asset->m_Nodes);
+		}
+		for (const Shared<Mesh>& mesh : asset->m_Meshes) {
+			mesh->m_CacheDirectory = CacheDirectory;
+			mesh->m_SourceHash = sourceHash;
+		}
+		return asset;
+	}
+
+	Shared<Mesh> MeshCreator::BuildMesh(const aiMesh* importedMesh, bool upload) {
+		Shared<Mesh> mesh = CreateShared<Mesh>();
 		std::cout << "Importing Mesh with " << importedMesh->mNumVertices << " Verts and " << importedMesh->mNumFaces << " Faces \n";
 
 		// Construct Halfedge data structure
 		// Vertices
+		HalfEdgeMesh& halfEdgeMesh = mesh->m_HalfEdgeMesh;
 		int numVerts = importedMesh->mNumVertices;
-		mesh->m_Vertices.reserve(numVerts);
-		for (int i = 0; i < numVerts; i++) {
-			mesh->m_Vertices.emplace_back();
-			glm::vec3 pos = glm::vec3(importedMesh->mVertices[i].x, importedMesh->mVertices[i].y, importedMesh->mVertices[i].z);
-			glm::vec3 norm = glm::vec3(importedMesh->mNormals[i].x, importedMesh->mNormals[i].y, importedMesh->mNormals[i].z);
-			mesh->m_Vertices[i].position = pos;
-			mesh->m_Vertices[i].normal = norm;
-			mesh->m_Vertices[i].index = i;
-		}
-		// Faces and Halfedges
+		halfEdgeMesh.vertices.resize(numVerts);
+		parallelFor(numVerts, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				Vertex& vertex = halfEdgeMesh.vertices[i];
+				vertex.position = glm::vec3(importedMesh->mVertices[i].x, importedMesh->mVertices[i].y, importedMesh->mVertices[i].z);
+				vertex.normal = glm::vec3(importedMesh->mNormals[i].x, importedMesh->mNormals[i].y, importedMesh->mNormals[i].z);
+			}
+		});
+		// Faces and Halfedges, the three halfedges of a face follow each other
 		int numFaces = importedMesh->mNumFaces;
-		mesh->m_HalfEdges.reserve(numFaces * 3);
-		mesh->m_Faces.reserve(numFaces);
+		halfEdgeMesh.halfEdges.resize(numFaces * 3);
+		parallelFor(numFaces, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				for (int j = 0; j < 3; j++) {
+					halfEdgeMesh.halfEdges[3 * i + j].origin = importedMesh->mFaces[i].mIndices[j];
+				}
+			}
+		});
+		halfEdgeMesh.ConnectHalfEdges();
+		mesh->ComputeBounds();
+		mesh->BuildBufferData();
+		halfEdgeMesh.ComputeAreaSums(mesh->m_AreaSums);
+		mesh->m_HalfEdgeMemory.Set(halfEdgeMesh.EstimateMemoryBytes() + estimateVectorBytes(mesh->m_AreaSums)
+			+ estimateVectorBytes(mesh->m_Buffers.m_VertexData) + estimateVectorBytes(mesh->m_Buffers.m_IndexData));
+		mesh->BuildLods();
+		if (upload)
+			mesh->Upload();
 
-		std::map<std::pair<int, int>, HalfEdge*> edgeMap; //map ensures halfedge uniqueness for connecting twins later
+		return mesh;
+	}
 
-		for (int i = 0; i < numFaces; i++) {
-			Face* face = &mesh->m_Faces.emplace_back();
+	Shared<MeshAsset> MeshCreator::LoadCachedAsset(Shared<MeshCache> cache, bool upload) {
+		Shared<MeshAsset> asset = CreateShared<MeshAsset>();
+		cache->GetNodes(asset->m_Nodes);
+		for (int m = 0; m < cache->GetNumMeshes(); m++) {
+			Shared<Mesh> mesh = CreateShared<Mesh>();
+			HalfEdgeMesh& halfEdgeMesh = mesh->m_HalfEdgeMesh;
+			int numVerts = cache->GetNumVertices(m);
+			int numFaces = cache->GetNumFaces(m);
+			std::cout << "Loading Mesh with " << numVerts << " Verts and " << numFaces << " Faces \n";
+
+			// positions and normals are decoded from the vertex buffer data, so they are only stored once
+			const uint32_t* vertexEdges = cache->GetVertexEdges(m);
+			halfEdgeMesh.vertices.resize(numVerts);
+			MeshBuffers::DecodeVertices(cache->GetVertexData(m), cache->GetBufferFlags(m), halfEdgeMesh.vertices);
+			for (int i = 0; i < numVerts; i++) {
+				halfEdgeMesh.vertices[i].edge = vertexEdges[i];
+			}
+			halfEdgeMesh.halfEdges.assign(cache->GetHalfEdges(m), cache->GetHalfEdges(m) + 3 * numFaces);
+			mesh->m_AreaSums.assign(cache->GetAreaSums(m), cache->GetAreaSums(m) + numFaces);
+			mesh->m_Buffers.m_Flags = cache->GetBufferFlags(m);
+			mesh->m_Buffers.m_NumVertices = numVerts;
+			mesh->m_Buffers.m_NumFaces = numFaces;
+			mesh->m_HalfEdgeMemory.Set(halfEdgeMesh.EstimateMemoryBytes() + estimateVectorBytes(mesh->m_AreaSums));
+			mesh->ComputeBounds();
+
+			// the level data stays in the cache until the upload
+			mesh->m_Lods.resize(cache->GetNumLods(m));
+			for (int l = 0; l < mesh->m_Lods.size(); l++) {
+				MeshLod& lod = mesh->m_Lods[l];
+				lod.m_Buffers.m_Flags = cache->GetLodBufferFlags(m, l);
+				lod.m_Buffers.m_NumVertices = cache->GetLodNumVertices(m, l);
+				lod.m_Buffers.m_NumFaces = cache->GetLodNumFaces(m, l);
+				lod.m_Error = cache->GetLodError(m, l);
+				lod.m_VertexArrayObject = lod.m_VertexBuffer = lod.m_ElementBuffer = 0;
+			}
 
-			int indices[3];
-			Vertex* vertices[3];
-			HalfEdge* halfEdges[3];
+			mesh->m_Cache = cache;
+			mesh->m_MeshIndex = m;
+			if (upload)
+				mesh->Upload();
+			asset->m_Meshes.push_back(mesh);
+		}
+		return asset;
+	}
 
-			// create the halfedges
-			for (int j = 0; j < 3; j++) {
-				indices[j] = importedMesh->mFaces[i].mIndices[j];
-				vertices[j] = &mesh->m_Vertices[indices[j]];
-				halfEdges[j] = &mesh->m_HalfEdges.emplace_back();
-			}
-			face->outer = halfEdges[0];
-
-			// connect the halfedges
-			for (int j = 0; j < 3; j++) {
-				int next = (j + 1) % 3;
-				halfEdges[j]->face = face;
-				halfEdges[j]->origin = vertices[j];
-				if (!vertices[j]->edge) vertices[j]->edge = halfEdges[j];
-				halfEdges[j]->next = halfEdges[next];
-				
-				// connection to twin
-				int in1 = indices[j];
-				int in2 = indices[next];
-				edgeMap[std::pair(in1, in2)] = halfEdges[j];
-				if (edgeMap.find(std::pair(in2, in1)) != edgeMap.end()) {
-					edgeMap[std::pair(in1, in2)]->twin = edgeMap[std::pair(in2, in1)];
-					edgeMap[std::pair(in2, in1)]->twin = edgeMap[std::pair(in1, in2)];
+	//MESH ASSET IMPLEMENTATION
+	int MeshAsset::GetNumInstances() {
+		int numInstances = 0;
+		for (const MeshNode& node : m_Nodes) {
+			numInstances += node.m_Meshes.size();
+		}
+		return numInstances;
+	}
+
+	//MESH LIBRARY IMPLEMENTATION
+	int MeshLibrary::LoaderThreads = 0;
+
+	MeshLibrary::MeshLibrary(Shared<Hatching> hatching, int seedsPerMesh, int numThreads) {
+		m_Hatching = hatching;
+		m_SeedsPerMesh = seedsPerMesh;
+		m_Assets = std::map<std::string, Shared<MeshAsset>>();
+		m_Pending = std::set<std::string>();
+		m_Stopping = false;
+
+		// the render thread keeps one core, it only waits for the loaders before the first frame
+		if (numThreads <= 0)
+			numThreads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+		numThreads = std::min(numThreads, MESHLIBRARY_MAX_THREADS);
+		for (int i = 0; i < numThreads; i++) {
+			m_Threads.emplace_back(&MeshLibrary::LoaderLoop, this);
+		}
+	}
+
+	MeshLibrary::~MeshLibrary() {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+			m_Queue.clear();
+		}
+		m_QueueChanged.notify_all();
+		for (std::thread& thread : m_Threads) {
+			thread.join();
+		}
+	}
+
+	void MeshLibrary::Request(const std::string& fileName, unsigned int seedKey) {
+		if (m_Assets.find(fileName) != m_Assets.end() || m_Pending.find(fileName) != m_Pending.end())
+			return;
+		m_Pending.insert(fileName);
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Queue.push_back({ fileName, seedKey, nullptr });
+		}
+		m_QueueChanged.notify_one();
+	}
+
+	void MeshLibrary::Update() {
+		std::deque<LoadJob> finished;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			finished.swap(m_Finished);
+		}
+		for (LoadJob& job : finished) {
+			if (job.m_Asset) {
+				for (const Shared<Mesh>& mesh : job.m_Asset->m_Meshes) {
+					mesh->Upload();
 				}
-			}			
+			}
+			// failed imports are remembered too, so they are only reported once
+			m_Assets[job.m_FileName] = job.m_Asset;
+			m_Pending.erase(job.m_FileName);
 		}
-		
-		mesh->Initialize();
+	}
 
-		return mesh;
+	void MeshLibrary::Finish() {
+		while (!m_Pending.empty()) {
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_JobFinished.wait(lock, [this] { return !m_Finished.empty(); });
+			}
+			Update();
+		}
+	}
+
+	Shared<MeshAsset> MeshLibrary::Get(const std::string& fileName) {
+		auto asset = m_Assets.find(fileName);
+		return (asset != m_Assets.end()) ? asset->second : nullptr;
+	}
+
+	bool MeshLibrary::IsLoading(const std::string& fileName) {
+		return m_Pending.find(fileName) != m_Pending.end();
+	}
+
+	int MeshLibrary::GetNumAssets() {
+		return m_Assets.size();
+	}
+
+	void MeshLibrary::LoaderLoop() {
+		while (true) {
+			LoadJob job;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_QueueChanged.wait(lock, [this] { return m_Stopping || !m_Queue.empty(); });
+				if (m_Stopping)
+					return;
+				job = std::move(m_Queue.front());
+				m_Queue.pop_front();
+			}
+
+			{
+				// busy loaders keep a core each, parallelFor only spreads a file over the cores that are left
+				CoreReservation core;
+				job.m_Asset = MeshCreator::LoadAsset(job.m_FileName, false);
+				if (job.m_Asset) {
+					for (int m = 0; m < job.m_Asset->m_Meshes.size(); m++) {
+						job.m_Asset->m_Meshes[m]->CreateSeedPoints(*m_Hatching, job.m_SeedKey + (m << 16), m_SeedsPerMesh);
+					}
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Finished.push_back(std::move(job));
+			}
+			m_JobFinished.notify_all();
+		}
 	}
 
 	//MESH IMPLEMENTATION
-	Mesh::Mesh() {
-		m_Vertices = std::vector<Vertex>();
-		m_Faces = std::vector<Face>();
-		m_HalfEdges = std::vector<HalfEdge>();
+	Mesh::Mesh()
+		: m_HalfEdgeMemory(MC_Meshes)
+		, m_BufferMemory(MC_GLBuffers)
+		, m_SeedMemory(MC_Seeds)
+		, m_SeedBufferMemory(MC_GLBuffers) {
+		m_SourceHash = 0;
+		m_MeshIndex = 0;
+		m_Lods = std::vector<MeshLod>();
+		m_BoundsCenter = glm::vec3(0.0f);
+		m_BoundsRadius = 0.0f;
+		m_SeedPoints = std::vector<SeedPoint>();
+		m_SeedsVAO = 0;
+		m_SeedsVertexBuffer = 0;
+	}
 
-		m_VertexData = std::vector<float>();
-		m_IndexData = std::vector<unsigned int>();
+	void Mesh::BuildBufferData() {
+		m_Buffers.Encode(m_HalfEdgeMesh, m_BoundsRadius);
 	}
 
-	void Mesh::Initialize() {
-		const int floatsPerVert = 6;
-		const int indsPerFace = 6;
-		int numVerts = m_Vertices.size();
-		int numFaces = m_Faces.size();
-		
-		// setup raw data for vertex and index buffers
-		m_VertexData.reserve(numVerts * floatsPerVert);
-		for (int i = 0; i < numVerts; i++) {
-			m_VertexData.push_back(m_Vertices[i].position.x);
-			m_VertexData.push_back(m_Vertices[i].position.y);
-			m_VertexData.push_back(m_Vertices[i].position.z);
-			m_VertexData.push_back(m_Vertices[i].normal.x);
-			m_VertexData.push_back(m_Vertices[i].normal.y);
-			m_VertexData.push_back(m_Vertices[i].normal.z);
-		}
-		m_IndexData.reserve(numFaces * indsPerFace);
-		for (int i = 0; i < numFaces; i++) {
-			// this currently sets any missing neighbor triangles to be the backside of the current triangle
-			// i think this is the most elegant solution, but might be subject to change
-			HalfEdge* he1 = m_Faces[i].outer;
-			HalfEdge* he2 = he1->next;
-			HalfEdge* he3 = he2->next;
-			m_IndexData.push_back(he1->origin->index);
-			if (he1->twin) m_IndexData.push_back(he1->twin->next->next->origin->index);
-			else m_IndexData.push_back(he1->next->next->origin->index);
-
-			m_IndexData.push_back(he2->origin->index);
-			if (he2->twin) m_IndexData.push_back(he2->twin->next->next->origin->index);
-			else m_IndexData.push_back(he2->next->next->origin->index);
-
-			m_IndexData.push_back(he3->origin->index);
-			if (he3->twin) m_IndexData.push_back(he3->twin->next->next->origin->index);
-			else m_IndexData.push_back(he3->next->next->origin->index);
+	void Mesh::BuildLods() {
+		// every level is simplified from the one before, so the collapses stay cheap and the errors add up
+		const HalfEdgeMesh* source = &m_HalfEdgeMesh;
+		HalfEdgeMesh previous;
+		float error = 0.0f;
+		int64_t lodBytes = 0;
+		while (m_Lods.size() + 1 < MESH_MAX_LODS && source->GetNumFaces() / 2 >= MESH_MIN_LOD_FACES) {
+			HalfEdgeMesh simplified;
+			float levelError;
+			source->Simplify(source->GetNumFaces() / 2, simplified, levelError);
+			// borders and folds can stop the collapses early, a level that barely shrinks is not worth its buffers
+			if (simplified.GetNumFaces() > 0.8f * source->GetNumFaces())
+				break;
+
+			error += levelError;
+			MeshLod lod;
+			lod.m_Error = error;
+			lod.m_VertexArrayObject = lod.m_VertexBuffer = lod.m_ElementBuffer = 0;
+			lod.m_Buffers.Encode(simplified, m_BoundsRadius);
+			lodBytes += estimateVectorBytes(lod.m_Buffers.m_VertexData) + estimateVectorBytes(lod.m_Buffers.m_IndexData);
+			m_Lods.push_back(std::move(lod));
+
+			previous = std::move(simplified);
+			source = &previous;
 		}
+		m_HalfEdgeMemory.Set(m_HalfEdgeMemory.Get() + lodBytes);
+	}
 
-		// setup opengl buffers
-		glGenVertexArrays(1, &m_VertexArrayObject);
-		glGenBuffers(1, &m_VertexBuffer);
-		glGenBuffers(1, &m_ElementBuffer);
+	void Mesh::ComputeBounds() {
+		const std::vector<Vertex>& vertices = m_HalfEdgeMesh.vertices;
+		glm::vec3 minPos = vertices.empty() ? glm::vec3(0.0f) : vertices[0].position;
+		glm::vec3 maxPos = minPos;
+		for (const Vertex& vertex : vertices) {
+			minPos = glm::min(minPos, vertex.position);
+			maxPos = glm::max(maxPos, vertex.position);
+		}
+		m_BoundsCenter = 0.5f * (minPos + maxPos);
+		m_BoundsRadius = 0.0f;
+		for (const Vertex& vertex : vertices) {
+			m_BoundsRadius = std::max(m_BoundsRadius, glm::length(vertex.position - m_BoundsCenter));
+		}
+	}
 
-		glBindVertexArray(m_VertexArrayObject);
-		glBindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
-		glBufferData(GL_ARRAY_BUFFER, numVerts * floatsPerVert * sizeof(float), m_VertexData.data(), GL_STATIC_DRAW);
+	void Mesh::Upload() {
+		// a cached mesh is uploaded straight from the mapped file
+		const uint8_t* vertexData = m_Cache ? m_Cache->GetVertexData(m_MeshIndex) : m_Buffers.m_VertexData.data();
+		const uint8_t* indexData = m_Cache ? m_Cache->GetIndexData(m_MeshIndex) : m_Buffers.m_IndexData.data();
+		int64_t bufferBytes = createGeometryBuffers(m_Buffers.m_Flags, m_Buffers.m_NumVertices, m_Buffers.m_NumFaces, vertexData, indexData,
+			m_VertexArrayObject, m_VertexBuffer, m_ElementBuffer);
+
+		for (int l = 0; l < m_Lods.size(); l++) {
+			MeshLod& lod = m_Lods[l];
+			const uint8_t* lodVertexData = m_Cache ? m_Cache->GetLodVertexData(m_MeshIndex, l) : lod.m_Buffers.m_VertexData.data();
+			const uint8_t* lodIndexData = m_Cache ? m_Cache->GetLodIndexData(m_MeshIndex, l) : lod.m_Buffers.m_IndexData.data();
+			bufferBytes += createGeometryBuffers(lod.m_Buffers.m_Flags, lod.m_Buffers.m_NumVertices, lod.m_Buffers.m_NumFaces, lodVertexData, lodIndexData,
+				lod.m_VertexArrayObject, lod.m_VertexBuffer, lod.m_ElementBuffer);
+		}
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ElementBuffer);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, numFaces * indsPerFace * sizeof(unsigned int), m_IndexData.data(), GL_STATIC_DRAW);
+		//Transform Feedback Buffer for Contour Segments, at most one segment per face of the full resolution
+		int64_t feedbackBytes = m_HalfEdgeMesh.GetNumFaces() * 3 * 2 * 2 * sizeof(float);
+		glGenBuffers(1, &m_ContoursFeedbackBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, m_ContoursFeedbackBuffer);
+		glBufferData(GL_ARRAY_BUFFER, feedbackBytes, nullptr, GL_DYNAMIC_READ);
+		m_BufferMemory.Set(bufferBytes + feedbackBytes);
+
+		if (!m_SeedPoints.empty()) {
+			std::vector<float> seedsData;
+			seedsData.reserve(8 * m_SeedPoints.size());
+			for (SeedPoint sp : m_SeedPoints) {
+				seedsData.push_back(sp.m_Pos.x);
+				seedsData.push_back(sp.m_Pos.y);
+				seedsData.push_back(sp.m_Pos.z);
+				seedsData.push_back(1.0f);	//padding
+				seedsData.push_back(sp.m_Importance);
+				seedsData.push_back(sp.m_Id);
+				seedsData.push_back(1.0f);	//padding
+				seedsData.push_back(1.0f);	//padding
+			}
 
-		// configure vertex attributes
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, floatsPerVert * sizeof(float), (GLvoid*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, floatsPerVert * sizeof(float), (GLvoid*)(3 * sizeof(GLfloat)));
-		glEnableVertexAttribArray(0);
+			glGenVertexArrays(1, &m_SeedsVAO);
+			glGenBuffers(1, &m_SeedsVertexBuffer);
+
+			glBindVertexArray(m_SeedsVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, m_SeedsVertexBuffer);
+			glBufferData(GL_ARRAY_BUFFER, seedsData.size() * sizeof(float), seedsData.data(), GL_STATIC_DRAW);
+
+			int stride = 8 * sizeof(float);
+
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(4 * sizeof(float)));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(5 * sizeof(float)));
+			glEnableVertexAttribArray(0);
+			m_SeedBufferMemory.Set(seedsData.size() * sizeof(float));
+		}
 
 		glCheckError();
+
+		// the GL buffers hold the data now, the mapping goes away with the last mesh
+		m_Cache = nullptr;
 	}
 	
-	void Mesh::Draw() {
-		glBindVertexArray(m_VertexArrayObject);
-		glDrawElements(GL_TRIANGLES_ADJACENCY, m_IndexData.size(), GL_UNSIGNED_INT, 0);
+	void Mesh::Draw(int lod) {
+		if (lod <= 0 || lod > m_Lods.size())
+			drawGeometryBuffers(m_Buffers, m_VertexArrayObject);
+		else
+			drawGeometryBuffers(m_Lods[lod - 1].m_Buffers, m_Lods[lod - 1].m_VertexArrayObject);
 	}
 
 	void Mesh::Bind() {
 		glBindVertexArray(m_VertexArrayObject);
 	}
 
+	int Mesh::GetNumLods() {
+		return m_Lods.size() + 1;
+	}
+
+	float Mesh::GetLodError(int lod) {
+		return (lod <= 0 || lod > m_Lods.size()) ? 0.0f : m_Lods[lod - 1].m_Error;
+	}
+
+	glm::vec3 Mesh::GetBoundsCenter() {
+		return m_BoundsCenter;
+	}
+
+	float Mesh::GetBoundsRadius() {
+		return m_BoundsRadius;
+	}
+
 	float Mesh::GetTotalArea() {
-		float area = 0;
-		for (Face face : m_Faces) {
-			glm::vec3 a = face.outer->origin->position;
-			glm::vec3 b = face.outer->next->origin->position;
-			glm::vec3 c = face.outer->next->next->origin->position;
+		return m_AreaSums.empty() ? 0.0f : m_AreaSums.back();
+	}
+
+	const std::vector<float>& Mesh::GetAreaSums() {
+		return m_AreaSums;
+	}
+
+	const HalfEdgeMesh& Mesh::GetHalfEdgeMesh() {
+		return m_HalfEdgeMesh;
+	}
 
-			glm::vec3 ab = b - a;
-			glm::vec3 ac = c - a;
-			area += glm::length(glm::cross(ab, ac)) * 0.5f;
+	void Mesh::CreateSeedPoints(Hatching& hatching, unsigned int seedKey, int numSeeds) {
+		// seeds from a random device differ every run, only fixed seeds are worth caching
+		int randomSeed = hatching.GetRandomSeed();
+		std::string seedCache;
+		if (randomSeed >= 0 && !m_CacheDirectory.empty())
+			seedCache = MeshCache::GetSeedPath(m_CacheDirectory, m_SourceHash, m_MeshIndex, randomSeed, seedKey, numSeeds);
+		m_SeedPoints.reserve(numSeeds);
+		if (seedCache.empty() || !MeshCache::ReadSeeds(seedCache, m_SourceHash, randomSeed, seedKey, numSeeds, m_SeedPoints)) {
+			hatching.CreateSeedPoints(m_SeedPoints, m_HalfEdgeMesh, m_AreaSums, seedKey, numSeeds);
+			if (!seedCache.empty())
+				MeshCache::WriteSeeds(seedCache, m_SourceHash, randomSeed, seedKey, m_SeedPoints);
 		}
-		return area;
+		m_SeedMemory.Set(estimateVectorBytes(m_SeedPoints));
+	}
+
+	const std::vector<SeedPoint>& Mesh::GetSeedPoints() {
+		return m_SeedPoints;
+	}
+
+	void Mesh::DrawSeedPoints() {
+		glBindVertexArray(m_SeedsVAO);
+		glDrawArrays(GL_POINTS, 0, m_SeedPoints.size());
+	}
+
+	unsigned int Mesh::GetSeedBuffer() {
+		return m_SeedsVertexBuffer;
 	}
 
-	std::vector<Face>& Mesh::GetFaces(){
-		return m_Faces;
+	unsigned int Mesh::GetContourFeedbackBuffer() {
+		return m_ContoursFeedbackBuffer;
 	}
 }
\ No newline at end of file
@@ -1,82 +1,193 @@
 #pragma once
 
-#include "core.h"
+#include "gldebug.h"
+#include "halfedge.h"
+#include "hatching.h"
+#include "meshbuffers.h"
+#include "meshcache.h"
+#include "statistics.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <glm/ext/matrix_float4x4.hpp>
 
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace Copperplate {
-	class Vertex;
-	class Face;
-	class HalfEdge;
-
 	class MeshCreator;
 
+	const int MESHLIBRARY_MAX_THREADS = 8;
+	const int MESH_MAX_LODS = 5;			//counting the full resolution
+	const int MESH_MIN_LOD_FACES = 256;
+
+	// A simplified version of a mesh that is drawn in place of it while the object is small on screen
+	struct MeshLod {
+		float m_Error;		//estimated distance to the full resolution, in object space
+		MeshBuffers m_Buffers;		//without data if it is mapped from the cache until the mesh is uploaded
+		unsigned int m_VertexArrayObject;
+		unsigned int m_VertexBuffer;
+		unsigned int m_ElementBuffer;
+	};
+
+	// Geometry shared by all scene objects that place it, together with the seeds on its surface
 	class Mesh {
 		friend class MeshCreator;
 	public:	
 		//Mesh(float* verts, int numVerts, unsigned int* inds, int numInds);
 		Mesh();
 
-		void Draw();
+		// Level 0 is the full resolution, the half edges and the seeds always belong to it
+		void Draw(int lod = 0);
 		void Bind();
 
+		int GetNumLods();		//counting the full resolution
+		float GetLodError(int lod);
+		glm::vec3 GetBoundsCenter();
+		float GetBoundsRadius();
+
 		float GetTotalArea();
+		// Running sums of the face areas the seeds are placed with
+		const std::vector<float>& GetAreaSums();
 
-		std::vector<Face>& GetFaces();
+		const HalfEdgeMesh& GetHalfEdgeMesh();
 
-		
+		// Seeds are created once for the mesh, every object placing it registers them as its own screen seeds.
+		// Only reads the random seed of the hatching, so it can run on a loader thread.
+		void CreateSeedPoints(Hatching& hatching, unsigned int seedKey, int numSeeds);
+		const std::vector<SeedPoint>& GetSeedPoints();
+		void DrawSeedPoints();
+		unsigned int GetSeedBuffer();
+		// Transform feedback target of the contour extraction, the objects extract one after another
+		unsigned int GetContourFeedbackBuffer();
+
+		// Creates the GL buffers of the geometry and of the seeds created so far, render thread only
+		void Upload();
 
 	private:	
 		
-		void Initialize();
+		// Vertex and adjacency index data from the halfedges, no GL calls. Snaps the vertices to what the
+		// buffers hold, so it runs before anything else is derived from them.
+		void BuildBufferData();
+		// Coarser levels by repeated edge collapse, each about half the faces of the one before
+		void BuildLods();
+		void ComputeBounds();
 
-		std::vector<Vertex> m_Vertices;
-		std::vector<HalfEdge> m_HalfEdges;
-		std::vector<Face> m_Faces;
+		HalfEdgeMesh m_HalfEdgeMesh;
+		std::vector<float> m_AreaSums;
 
-		std::vector<float> m_VertexData;
-		std::vector<unsigned int> m_IndexData;
+		// Buffer data is either built from the half edges or mapped from the cache until it is uploaded
+		MeshBuffers m_Buffers;
+		Shared<MeshCache> m_Cache;
+		std::vector<MeshLod> m_Lods;		//from level 1 on
+		glm::vec3 m_BoundsCenter;
+		float m_BoundsRadius;
+
+		std::string m_CacheDirectory;
+		uint64_t m_SourceHash;
+		int m_MeshIndex;		//within the source file
+
+		std::vector<SeedPoint> m_SeedPoints;
 
 		unsigned int m_VertexArrayObject;
 		unsigned int m_VertexBuffer;
 		unsigned int m_ElementBuffer;		
+		unsigned int m_SeedsVAO;
+		unsigned int m_SeedsVertexBuffer;
+		unsigned int m_ContoursFeedbackBuffer;
+
+		MemoryCounter m_HalfEdgeMemory;
+		MemoryCounter m_BufferMemory;
+		MemoryCounter m_SeedMemory;
+		MemoryCounter m_SeedBufferMemory;
+	};
+
+	// All meshes and the node hierarchy of one file
+	struct MeshAsset {
+		std::string m_FileName;
+		std::vector<Shared<Mesh>> m_Meshes;
+		std::vector<MeshNode> m_Nodes;
+
+		int GetNumInstances();		//meshes referenced by the nodes, counting repeats
 	};
 
 	class MeshCreator {
 	public:
 		static Unique<Mesh> CreateTestMesh();
-		static Unique<Mesh> ImportMesh(const std::string& fileName);
+		// Every triangle mesh and the node hierarchy of the file, without upload no GL context is needed
+		// but the meshes cannot be drawn
+		static Shared<MeshAsset> ImportAsset(const std::string& fileName, bool upload = true);
+		// Maps the baked cache of the file if there is one for its content, otherwise imports it and bakes the cache
+		static Shared<MeshAsset> LoadAsset(const std::string& fileName, bool upload = true);
+
+		// Where the baked meshes and seeds are kept, empty always imports
+		static std::string CacheDirectory;
 
 	private:
 
+		static Shared<Mesh> BuildMesh(const aiMesh* importedMesh, bool upload);
+		static Shared<MeshAsset> LoadCachedAsset(Shared<MeshCache> cache, bool upload);
 	};
 
-	// Half Edge data structure
-	class HalfEdge {
+	// Loads every file once for a scene, its meshes are shared by reference counting between all objects
+	// placing the file, so repeated props cost no extra buffers, half edges or seeds. The import, the half
+	// edges and the seeds are built by a pool of loader threads, only the GL buffers are created on the
+	// render thread once a file is complete.
+	class MeshLibrary {
 	public:
-		Vertex* origin;
-		HalfEdge* twin;
-		HalfEdge* next;
-		Face* face;
-	};
 
-	class Vertex {
-	public:
-		glm::vec3 position;
-		glm::vec3 normal;
-		unsigned int index;
-		HalfEdge* edge;
-	};
+		// 0 threads picks a count from the available cores, see LoaderThreads
+		MeshLibrary(Shared<Hatching> hatching, int seedsPerMesh, int numThreads);
+		// Waits for the files being loaded, files still queued are dropped
+		~MeshLibrary();
 
-	class Face {
-	public:
-		HalfEdge* outer;
+		// Queues the file unless it was requested before. Its meshes are seeded with seedKey plus the mesh
+		// index in the upper 16 bits, so the seeds only depend on the order the files are requested in.
+		void Request(const std::string& fileName, unsigned int seedKey);
+		// Uploads the files that finished loading, render thread only
+		void Update();
+		// Blocks until every requested file is loaded and uploaded
+		void Finish();
+
+		// Null while the file is loading and when it failed to load
+		Shared<MeshAsset> Get(const std::string& fileName);
+		bool IsLoading(const std::string& fileName);
+		int GetNumAssets();
+
+		static int LoaderThreads;
+
+	private:
+
+		struct LoadJob {
+			std::string m_FileName;
+			unsigned int m_SeedKey;
+			Shared<MeshAsset> m_Asset;
+		};
+
+		void LoaderLoop();
+
+		// Render thread only
+		Shared<Hatching> m_Hatching;
+		int m_SeedsPerMesh;
+		std::map<std::string, Shared<MeshAsset>> m_Assets;
+		std::set<std::string> m_Pending;
+
+		// Shared with the loaders, guarded by the mutex
+		std::mutex m_Mutex;
+		std::condition_variable m_QueueChanged;
+		std::condition_variable m_JobFinished;
+		std::deque<LoadJob> m_Queue;
+		std::deque<LoadJob> m_Finished;
+		bool m_Stopping;
+
+		std::vector<std::thread> m_Threads;
 	};
 	 
 }
\ No newline at end of file
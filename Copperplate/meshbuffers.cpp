@@ -0,0 +1,270 @@
+#pragma once
+
+#include "meshbuffers.h"
+#include "utility.h"
+
+#include <glm/gtc/packing.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Copperplate {
+
+	// Octahedral normal encoding, the unit sphere is folded onto the square [-1, 1]^2 which is then stored as snorm16
+	glm::vec2 encodeOctahedral(glm::vec3 normal) {
+		normal /= std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+		glm::vec2 encoded = glm::vec2(normal.x, normal.y);
+		if (normal.z < 0.0f) {
+			encoded.x = (1.0f - std::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+			encoded.y = (1.0f - std::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		return encoded;
+	}
+
+	glm::vec3 decodeOctahedral(glm::vec2 encoded) {
+		glm::vec3 normal = glm::vec3(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+		float fold = std::max(-normal.z, 0.0f);
+		normal.x += (normal.x >= 0.0f) ? -fold : fold;
+		normal.y += (normal.y >= 0.0f) ? -fold : fold;
+		return glm::normalize(normal);
+	}
+
+	glm::vec3 roundToHalf(glm::vec3 position) {
+		return glm::vec3(glm::unpackHalf1x16(glm::packHalf1x16(position.x)), glm::unpackHalf1x16(glm::packHalf1x16(position.y)),
+			glm::unpackHalf1x16(glm::packHalf1x16(position.z)));
+	}
+
+	// Forsyth's vertex score, the vertices of the face just emitted get a fixed score so strips are not favoured
+	float scoreCacheVertex(int cachePosition, int activeFaces, int lastFaceSize) {
+		if (activeFaces == 0)
+			return 0.0f;
+		float score = 0.0f;
+		if (cachePosition >= 0 && cachePosition < lastFaceSize)
+			score = 0.75f;
+		else if (cachePosition >= 0)
+			score = std::pow(1.0f - (float)(cachePosition - lastFaceSize) / (MESHBUFFERS_CACHE_SIZE - lastFaceSize), 1.5f);
+		// vertices with few faces left are finished first, so no lonely faces remain behind
+		return score + 2.0f / std::sqrt((float)activeFaces);
+	}
+
+	int MeshBuffers::GetVertexStride(uint32_t flags) {
+		return (flags & MB_HalfPositions) ? 4 * sizeof(uint16_t) + 2 * sizeof(int16_t) : 3 * sizeof(float) + 2 * sizeof(int16_t);
+	}
+
+	int MeshBuffers::GetIndexSize(uint32_t flags) {
+		return (flags & MB_ShortIndices) ? sizeof(uint16_t) : sizeof(uint32_t);
+	}
+
+	int64_t MeshBuffers::GetVertexBytes(uint32_t flags, int numVertices) {
+		return (int64_t)numVertices * GetVertexStride(flags);
+	}
+
+	int64_t MeshBuffers::GetIndexBytes(uint32_t flags, int numFaces) {
+		return (int64_t)numFaces * 6 * GetIndexSize(flags);
+	}
+
+	void MeshBuffers::Encode(HalfEdgeMesh& mesh, float boundsRadius) {
+		std::vector<Vertex>& vertices = mesh.vertices;
+		const std::vector<HalfEdge>& halfEdges = mesh.halfEdges;
+		m_NumVertices = vertices.size();
+		m_NumFaces = mesh.GetNumFaces();
+
+		// half floats only where no vertex moves noticeably, regular models often fit exactly
+		float maxError = 0.0f;
+		for (const Vertex& vertex : vertices) {
+			maxError = std::max(maxError, glm::length(roundToHalf(vertex.position) - vertex.position));
+		}
+		m_Flags = 0;
+		if (maxError <= MESHBUFFERS_HALF_TOLERANCE * boundsRadius)
+			m_Flags |= MB_HalfPositions;
+		if (m_NumVertices <= MESHBUFFERS_MAX_SHORT_VERTICES)
+			m_Flags |= MB_ShortIndices;
+
+		int stride = GetVertexStride(m_Flags);
+		m_VertexData.assign(GetVertexBytes(m_Flags, m_NumVertices), 0);
+		parallelFor(m_NumVertices, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				const Vertex& vertex = vertices[i];
+				uint8_t* data = &m_VertexData[(int64_t)i * stride];
+				if (m_Flags & MB_HalfPositions) {
+					uint16_t position[3] = { glm::packHalf1x16(vertex.position.x), glm::packHalf1x16(vertex.position.y), glm::packHalf1x16(vertex.position.z) };
+					memcpy(data, position, sizeof(position));
+				}
+				else {
+					float position[3] = { vertex.position.x, vertex.position.y, vertex.position.z };
+					memcpy(data, position, sizeof(position));
+				}
+				glm::vec2 encoded = encodeOctahedral(vertex.normal);
+				int16_t normal[2] = { (int16_t)glm::packSnorm1x16(encoded.x), (int16_t)glm::packSnorm1x16(encoded.y) };
+				memcpy(data + stride - sizeof(normal), normal, sizeof(normal));
+			}
+		});
+		DecodeVertices(m_VertexData.data(), m_Flags, vertices);
+
+		// this currently sets any missing neighbor triangles to be the backside of the current triangle
+		// i think this is the most elegant solution, but might be subject to change
+		std::vector<uint32_t> indices(m_NumFaces * 6);
+		parallelFor(m_NumFaces, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				for (int j = 0; j < 3; j++) {
+					uint32_t halfEdge = 3 * i + j;
+					uint32_t twin = halfEdges[halfEdge].twin;
+					uint32_t opposite = (twin != NO_HALFEDGE) ? HalfEdgeMesh::Prev(twin) : HalfEdgeMesh::Prev(halfEdge);
+					indices[i * 6 + 2 * j] = halfEdges[halfEdge].origin;
+					indices[i * 6 + 2 * j + 1] = halfEdges[opposite].origin;
+				}
+			}
+		});
+		std::vector<uint32_t> order;
+		OptimizeFaceOrder(indices, 6, m_NumVertices, order);
+
+		int indexSize = GetIndexSize(m_Flags);
+		m_IndexData.resize(GetIndexBytes(m_Flags, m_NumFaces));
+		parallelFor(m_NumFaces, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				const uint32_t* face = &indices[order[i] * 6];
+				uint8_t* data = &m_IndexData[(int64_t)i * 6 * indexSize];
+				if (m_Flags & MB_ShortIndices) {
+					uint16_t shortFace[6];
+					std::copy(face, face + 6, shortFace);
+					memcpy(data, shortFace, sizeof(shortFace));
+				}
+				else {
+					memcpy(data, face, 6 * sizeof(uint32_t));
+				}
+			}
+		});
+	}
+
+	void MeshBuffers::DecodeVertices(const uint8_t* vertexData, uint32_t flags, std::vector<Vertex>& outVertices) {
+		int stride = GetVertexStride(flags);
+		parallelFor(outVertices.size(), [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				const uint8_t* data = vertexData + (int64_t)i * stride;
+				Vertex& vertex = outVertices[i];
+				if (flags & MB_HalfPositions) {
+					uint16_t position[3];
+					memcpy(position, data, sizeof(position));
+					vertex.position = glm::vec3(glm::unpackHalf1x16(position[0]), glm::unpackHalf1x16(position[1]), glm::unpackHalf1x16(position[2]));
+				}
+				else {
+					float position[3];
+					memcpy(position, data, sizeof(position));
+					vertex.position = glm::vec3(position[0], position[1], position[2]);
+				}
+				int16_t normal[2];
+				memcpy(normal, data + stride - sizeof(normal), sizeof(normal));
+				vertex.normal = decodeOctahedral(glm::vec2(glm::unpackSnorm1x16(normal[0]), glm::unpackSnorm1x16(normal[1])));
+			}
+		});
+	}
+
+	void OptimizeFaceOrder(const std::vector<uint32_t>& indices, int indicesPerFace, int numVertices, std::vector<uint32_t>& outOrder) {
+		int numFaces = indices.size() / indicesPerFace;
+
+		// the distinct vertices of every face, adjacency indices repeat corners on borders
+		std::vector<uint32_t> faceVertices(indices.size());
+		std::vector<uint8_t> faceSizes(numFaces, 0);
+		for (int f = 0; f < numFaces; f++) {
+			uint32_t* vertices = &faceVertices[f * indicesPerFace];
+			for (int i = 0; i < indicesPerFace; i++) {
+				uint32_t vertex = indices[f * indicesPerFace + i];
+				if (std::find(vertices, vertices + faceSizes[f], vertex) == vertices + faceSizes[f])
+					vertices[faceSizes[f]++] = vertex;
+			}
+		}
+
+		// the faces around every vertex, the ones not emitted yet are kept in front
+		std::vector<uint32_t> vertexOffsets(numVertices + 1, 0);
+		for (int f = 0; f < numFaces; f++) {
+			for (int i = 0; i < faceSizes[f]; i++) {
+				vertexOffsets[faceVertices[f * indicesPerFace + i] + 1]++;
+			}
+		}
+		for (int v = 0; v < numVertices; v++) {
+			vertexOffsets[v + 1] += vertexOffsets[v];
+		}
+		std::vector<uint32_t> vertexFaces(vertexOffsets.back());
+		std::vector<int> activeFaces(numVertices, 0);
+		for (int f = 0; f < numFaces; f++) {
+			for (int i = 0; i < faceSizes[f]; i++) {
+				uint32_t vertex = faceVertices[f * indicesPerFace + i];
+				vertexFaces[vertexOffsets[vertex] + activeFaces[vertex]++] = f;
+			}
+		}
+
+		std::vector<int> cachePositions(numVertices, -1);
+		std::vector<float> vertexScores(numVertices);
+		for (int v = 0; v < numVertices; v++) {
+			vertexScores[v] = scoreCacheVertex(-1, activeFaces[v], 0);
+		}
+		std::vector<float> faceScores(numFaces, 0.0f);
+		int bestFace = -1;
+		for (int f = 0; f < numFaces; f++) {
+			for (int i = 0; i < faceSizes[f]; i++) {
+				faceScores[f] += vertexScores[faceVertices[f * indicesPerFace + i]];
+			}
+			if (bestFace < 0 || faceScores[f] > faceScores[bestFace])
+				bestFace = f;
+		}
+
+		std::vector<bool> emitted(numFaces, false);
+		std::vector<uint32_t> cache;
+		std::vector<uint32_t> nextCache;
+		cache.reserve(MESHBUFFERS_CACHE_SIZE + indicesPerFace);
+		nextCache.reserve(MESHBUFFERS_CACHE_SIZE + indicesPerFace);
+		outOrder.clear();
+		outOrder.reserve(numFaces);
+		int firstOpen = 0;
+		while (outOrder.size() < numFaces) {
+			// nothing left around the cache, continue with the first face not emitted yet
+			if (bestFace < 0) {
+				while (emitted[firstOpen])
+					firstOpen++;
+				bestFace = firstOpen;
+			}
+			emitted[bestFace] = true;
+			outOrder.push_back(bestFace);
+
+			// the vertices of the face move to the front of the cache and lose it from their faces
+			const uint32_t* vertices = &faceVertices[bestFace * indicesPerFace];
+			int faceSize = faceSizes[bestFace];
+			nextCache.assign(vertices, vertices + faceSize);
+			for (uint32_t vertex : cache) {
+				if (std::find(vertices, vertices + faceSize, vertex) == vertices + faceSize)
+					nextCache.push_back(vertex);
+			}
+			for (int i = 0; i < faceSize; i++) {
+				uint32_t* faces = &vertexFaces[vertexOffsets[vertices[i]]];
+				int& numActive = activeFaces[vertices[i]];
+				std::swap(*std::find(faces, faces + numActive, (uint32_t)bestFace), faces[numActive - 1]);
+				numActive--;
+			}
+
+			// rescore everything that moved within or out of the cache
+			for (int i = 0; i < nextCache.size(); i++) {
+				uint32_t vertex = nextCache[i];
+				cachePositions[vertex] = (i < MESHBUFFERS_CACHE_SIZE) ? i : -1;
+				float score = scoreCacheVertex(cachePositions[vertex], activeFaces[vertex], faceSize);
+				float delta = score - vertexScores[vertex];
+				vertexScores[vertex] = score;
+				for (int j = 0; j < activeFaces[vertex]; j++) {
+					faceScores[vertexFaces[vertexOffsets[vertex] + j]] += delta;
+				}
+			}
+			nextCache.resize(std::min((int)nextCache.size(), MESHBUFFERS_CACHE_SIZE));
+			cache.swap(nextCache);
+
+			bestFace = -1;
+			for (uint32_t vertex : cache) {
+				for (int j = 0; j < activeFaces[vertex]; j++) {
+					uint32_t face = vertexFaces[vertexOffsets[vertex] + j];
+					if (bestFace < 0 || faceScores[face] > faceScores[bestFace])
+						bestFace = face;
+				}
+			}
+		}
+	}
+}
\ No newline at end of file
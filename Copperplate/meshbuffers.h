@@ -0,0 +1,45 @@
+#pragma once
+
+#include "halfedge.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Copperplate {
+
+	const int MESHBUFFERS_CACHE_SIZE = 32;				//post transform cache the face order is optimized for
+	const int MESHBUFFERS_MAX_SHORT_VERTICES = 65535;	//0xffff stays free as the restart index
+	// positions are stored as half floats if that moves no vertex further than this, relative to the bounding radius
+	const float MESHBUFFERS_HALF_TOLERANCE = 1e-4f;
+
+	enum EMeshBufferFlags {
+		MB_HalfPositions = 1,		//otherwise three floats
+		MB_ShortIndices = 2,		//otherwise 32 bit
+	};
+
+	// Vertex and adjacency index data of a mesh in the layout it is uploaded with. A vertex is its position, padded
+	// to 8 bytes if stored as half floats, followed by its normal in octahedral encoding as two snorm16. A face is its
+	// corners with the opposite corners of the neighbors in between, as GL_TRIANGLES_ADJACENCY expects them.
+	struct MeshBuffers {
+		uint32_t m_Flags = 0;
+		int m_NumVertices = 0;
+		int m_NumFaces = 0;
+		std::vector<uint8_t> m_VertexData;
+		std::vector<uint8_t> m_IndexData;
+
+		static int GetVertexStride(uint32_t flags);
+		static int GetIndexSize(uint32_t flags);
+		static int64_t GetVertexBytes(uint32_t flags, int numVertices);
+		static int64_t GetIndexBytes(uint32_t flags, int numFaces);
+
+		// Picks the most compact layout that keeps the precision and orders the faces for the post transform cache.
+		// The vertices of the mesh are snapped to the encoded values, so decoding the buffers restores them exactly.
+		void Encode(HalfEdgeMesh& mesh, float boundsRadius);
+		// Positions and normals of the encoded vertices, the outgoing edges are left as they are
+		static void DecodeVertices(const uint8_t* vertexData, uint32_t flags, std::vector<Vertex>& outVertices);
+	};
+
+	// Greedy face order after Forsyth, every face scores the vertices it shares with the simulated cache and the
+	// vertices with few faces left, so the mesh is emitted in compact patches instead of long strips.
+	void OptimizeFaceOrder(const std::vector<uint32_t>& indices, int indicesPerFace, int numVertices, std::vector<uint32_t>& outOrder);
+}
\ No newline at end of file
@@ -0,0 +1,400 @@
+#pragma once
+
+#include "meshcache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace Copperplate {
+
+	// FNV-1a over 64 bit words with an extra shift so the high bytes reach the low bits, about as fast as
+	// the file can be read. Not meant to withstand deliberate collisions, only to notice edited sources.
+	uint64_t hashContent(const uint8_t* data, int64_t size) {
+		const uint64_t prime = 1099511628211ull;
+		uint64_t hash = 14695981039346656037ull;
+		int64_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			memcpy(&word, data + i, sizeof(word));
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 29;
+		}
+		for (; i < size; i++) {
+			hash = (hash ^ data[i]) * prime;
+		}
+		return hash ^ (uint64_t)size;
+	}
+
+	uint64_t alignCacheOffset(uint64_t offset) {
+		return (offset + MESHCACHE_ALIGNMENT - 1) / MESHCACHE_ALIGNMENT * MESHCACHE_ALIGNMENT;
+	}
+
+	std::string hashToString(uint64_t hash) {
+		std::ostringstream stream;
+		stream << std::hex << std::setfill('0') << std::setw(16) << hash;
+		return stream.str();
+	}
+
+	// Loader threads and render nodes sharing the cache directory may write the same entry at once,
+	// every writer gets its own temporary file and the last rename wins
+	std::string getTempCachePath(const std::string& path) {
+#ifdef _WIN32
+		int pid = _getpid();
+#else
+		int pid = getpid();
+#endif
+		std::ostringstream stream;
+		stream << path << "." << pid << "." << std::hex << std::hash<std::thread::id>()(std::this_thread::get_id())
+			<< "." << std::random_device()() << ".tmp";
+		return stream.str();
+	}
+
+	// Opens a temporary file next to path, the directory is created if needed
+	bool openCacheFile(const std::string& path, std::string& outTempPath, std::ofstream& outFile) {
+		std::error_code error;
+		std::filesystem::path directory = std::filesystem::path(path).parent_path();
+		if (!directory.empty())
+			std::filesystem::create_directories(directory, error);
+		outTempPath = getTempCachePath(path);
+		outFile.open(outTempPath, std::ios::binary | std::ios::trunc);
+		if (!outFile) {
+			std::cout << "Could not write cache " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool finishCacheFile(const std::string& path, const std::string& tempPath, std::ofstream& file) {
+		file.close();
+		std::error_code error;
+		if (file.fail()) {
+			std::cout << "Writing cache " << path << " failed" << std::endl;
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		std::filesystem::rename(tempPath, path, error);
+		if (error) {
+			std::cout << "Could not write cache " << path << ": " << error.message() << std::endl;
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		return true;
+	}
+
+	MeshCache::MeshCache()
+		: m_Header(nullptr)
+		, m_Entries(nullptr)
+		, m_Lods(nullptr) {
+	}
+
+	bool MeshCache::HashFile(const std::string& path, uint64_t& outHash) {
+		MappedFile file;
+		if (!file.Open(path))
+			return false;
+		outHash = hashContent(file.GetData(), file.GetSize());
+		return true;
+	}
+
+	std::string MeshCache::GetMeshPath(const std::string& directory, uint64_t sourceHash) {
+		return (std::filesystem::path(directory) / (hashToString(sourceHash) + ".cpmesh")).string();
+	}
+
+	std::string MeshCache::GetSeedPath(const std::string& directory, uint64_t sourceHash, int meshIndex, int randomSeed, unsigned int objectId, int numSeeds) {
+		std::ostringstream name;
+		name << hashToString(sourceHash) << "_" << meshIndex << "_" << randomSeed << "_" << objectId << "_" << numSeeds << ".cpseeds";
+		return (std::filesystem::path(directory) / name.str()).string();
+	}
+
+	bool MeshCache::WriteMeshes(const std::string& path, uint64_t sourceHash, const std::vector<MeshCacheInput>& meshes, const std::vector<MeshNode>& nodes) {
+		MeshCacheHeader header = {};
+		header.m_Magic = MESHCACHE_MAGIC;
+		header.m_Version = MESHCACHE_VERSION;
+		header.m_SourceHash = sourceHash;
+		header.m_NumMeshes = meshes.size();
+		header.m_NumNodes = nodes.size();
+
+		std::vector<MeshCacheNode> cacheNodes(nodes.size());
+		std::vector<uint32_t> nodeMeshes;
+		for (int i = 0; i < nodes.size(); i++) {
+			MeshCacheNode& node = cacheNodes[i];
+			memcpy(node.m_Transform, &nodes[i].m_Transform[0][0], sizeof(node.m_Transform));
+			node.m_Parent = nodes[i].m_Parent;
+			node.m_FirstMesh = nodeMeshes.size();
+			node.m_NumMeshes = nodes[i].m_Meshes.size();
+			node.m_Padding = 0;
+			nodeMeshes.insert(nodeMeshes.end(), nodes[i].m_Meshes.begin(), nodes[i].m_Meshes.end());
+		}
+		header.m_NumNodeMeshes = nodeMeshes.size();
+
+		// the levels of detail follow the nodes, then the sections of every mesh with its levels
+		std::vector<MeshCacheEntry> entries(meshes.size());
+		std::vector<MeshCacheLod> lods;
+		std::vector<std::vector<uint32_t>> vertexEdges(meshes.size());
+		for (const MeshCacheInput& mesh : meshes) {
+			header.m_NumLods += mesh.m_Lods.size();
+		}
+		header.m_NodesOffset = sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCacheEntry);
+		header.m_LodsOffset = alignCacheOffset(header.m_NodesOffset + cacheNodes.size() * sizeof(MeshCacheNode) + nodeMeshes.size() * sizeof(uint32_t));
+		uint64_t offset = alignCacheOffset(header.m_LodsOffset + header.m_NumLods * sizeof(MeshCacheLod));
+		for (int m = 0; m < meshes.size(); m++) {
+			const HalfEdgeMesh& mesh = *meshes[m].m_HalfEdgeMesh;
+			vertexEdges[m].resize(mesh.vertices.size());
+			for (int i = 0; i < mesh.vertices.size(); i++) {
+				vertexEdges[m][i] = mesh.vertices[i].edge;
+			}
+			MeshCacheEntry& entry = entries[m];
+			entry.m_NumVertices = mesh.vertices.size();
+			entry.m_NumFaces = mesh.GetNumFaces();
+			entry.m_BufferFlags = meshes[m].m_Buffers->m_Flags;
+			entry.m_Sizes[MS_VertexData] = meshes[m].m_Buffers->m_VertexData.size();
+			entry.m_Sizes[MS_IndexData] = meshes[m].m_Buffers->m_IndexData.size();
+			entry.m_Sizes[MS_HalfEdges] = mesh.halfEdges.size() * sizeof(HalfEdge);
+			entry.m_Sizes[MS_VertexEdges] = vertexEdges[m].size() * sizeof(uint32_t);
+			entry.m_Sizes[MS_AreaSums] = meshes[m].m_AreaSums->size() * sizeof(float);
+			for (int i = 0; i < MS_NumSections; i++) {
+				entry.m_Offsets[i] = offset;
+				offset = alignCacheOffset(offset + entry.m_Sizes[i]);
+			}
+			entry.m_FirstLod = lods.size();
+			entry.m_NumLods = meshes[m].m_Lods.size();
+			for (const MeshCacheLodInput& input : meshes[m].m_Lods) {
+				MeshCacheLod lod = {};
+				lod.m_NumVertices = input.m_Buffers->m_NumVertices;
+				lod.m_NumFaces = input.m_Buffers->m_NumFaces;
+				lod.m_Error = input.m_Error;
+				lod.m_BufferFlags = input.m_Buffers->m_Flags;
+				lod.m_VertexOffset = offset;
+				offset = alignCacheOffset(offset + input.m_Buffers->m_VertexData.size());
+				lod.m_IndexOffset = offset;
+				offset = alignCacheOffset(offset + input.m_Buffers->m_IndexData.size());
+				lods.push_back(lod);
+			}
+		}
+
+		std::string tempPath;
+		std::ofstream file;
+		if (!openCacheFile(path, tempPath, file))
+			return false;
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)entries.data(), entries.size() * sizeof(MeshCacheEntry));
+		file.write((const char*)cacheNodes.data(), cacheNodes.size() * sizeof(MeshCacheNode));
+		file.write((const char*)nodeMeshes.data(), nodeMeshes.size() * sizeof(uint32_t));
+		uint64_t written = header.m_NodesOffset + cacheNodes.size() * sizeof(MeshCacheNode) + nodeMeshes.size() * sizeof(uint32_t);
+		const char padding[MESHCACHE_ALIGNMENT] = {};
+		auto writeAt = [&](uint64_t at, const void* data, uint64_t size) {
+			file.write(padding, at - written);
+			file.write((const char*)data, size);
+			written = at + size;
+		};
+		writeAt(header.m_LodsOffset, lods.data(), lods.size() * sizeof(MeshCacheLod));
+		for (int m = 0; m < meshes.size(); m++) {
+			const void* sections[MS_NumSections] = { meshes[m].m_Buffers->m_VertexData.data(), meshes[m].m_Buffers->m_IndexData.data(),
+				meshes[m].m_HalfEdgeMesh->halfEdges.data(), vertexEdges[m].data(), meshes[m].m_AreaSums->data() };
+			for (int i = 0; i < MS_NumSections; i++) {
+				writeAt(entries[m].m_Offsets[i], sections[i], entries[m].m_Sizes[i]);
+			}
+			for (int l = 0; l < entries[m].m_NumLods; l++) {
+				const MeshCacheLodInput& input = meshes[m].m_Lods[l];
+				const MeshCacheLod& lod = lods[entries[m].m_FirstLod + l];
+				writeAt(lod.m_VertexOffset, input.m_Buffers->m_VertexData.data(), input.m_Buffers->m_VertexData.size());
+				writeAt(lod.m_IndexOffset, input.m_Buffers->m_IndexData.data(), input.m_Buffers->m_IndexData.size());
+			}
+		}
+		return finishCacheFile(path, tempPath, file);
+	}
+
+	bool MeshCache::WriteSeeds(const std::string& path, uint64_t sourceHash, int randomSeed, unsigned int objectId, const std::vector<SeedPoint>& seedPoints) {
+		SeedCacheHeader header = {};
+		header.m_Magic = SEEDCACHE_MAGIC;
+		header.m_Version = SEEDCACHE_VERSION;
+		header.m_SourceHash = sourceHash;
+		header.m_RandomSeed = randomSeed;
+		header.m_ObjectId = objectId;
+		header.m_NumSeeds = seedPoints.size();
+
+		std::string tempPath;
+		std::ofstream file;
+		if (!openCacheFile(path, tempPath, file))
+			return false;
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)seedPoints.data(), seedPoints.size() * sizeof(SeedPoint));
+		return finishCacheFile(path, tempPath, file);
+	}
+
+	bool MeshCache::ReadSeeds(const std::string& path, uint64_t sourceHash, int randomSeed, unsigned int objectId, int numSeeds, std::vector<SeedPoint>& outSeedPoints) {
+		std::error_code error;
+		if (!std::filesystem::exists(path, error))
+			return false;
+		MappedFile file;
+		if (!file.Open(path) || file.GetSize() < sizeof(SeedCacheHeader))
+			return false;
+		const SeedCacheHeader* header = (const SeedCacheHeader*)file.GetData();
+		if (header->m_Magic != SEEDCACHE_MAGIC || header->m_Version != SEEDCACHE_VERSION || header->m_SourceHash != sourceHash
+			|| header->m_RandomSeed != randomSeed || header->m_ObjectId != objectId || header->m_NumSeeds != numSeeds
+			|| file.GetSize() != sizeof(SeedCacheHeader) + numSeeds * sizeof(SeedPoint))
+			return false;
+		const SeedPoint* seeds = (const SeedPoint*)(file.GetData() + sizeof(SeedCacheHeader));
+		outSeedPoints.insert(outSeedPoints.end(), seeds, seeds + numSeeds);
+		return true;
+	}
+
+	bool MeshCache::Open(const std::string& path, uint64_t sourceHash) {
+		Close();
+		std::error_code error;
+		if (!std::filesystem::exists(path, error))
+			return false;
+		if (!m_File.Open(path))
+			return false;
+		uint64_t size = m_File.GetSize();
+		const MeshCacheHeader* header = (const MeshCacheHeader*)m_File.GetData();
+		const MeshCacheEntry* entries = (const MeshCacheEntry*)(m_File.GetData() + sizeof(MeshCacheHeader));
+		bool valid = size >= sizeof(MeshCacheHeader) && header->m_Magic == MESHCACHE_MAGIC
+			&& header->m_Version == MESHCACHE_VERSION && header->m_SourceHash == sourceHash
+			&& header->m_NodesOffset == sizeof(MeshCacheHeader) + (uint64_t)header->m_NumMeshes * sizeof(MeshCacheEntry)
+			&& header->m_NodesOffset + (uint64_t)header->m_NumNodes * sizeof(MeshCacheNode) + (uint64_t)header->m_NumNodeMeshes * sizeof(uint32_t) <= header->m_LodsOffset
+			&& header->m_LodsOffset + (uint64_t)header->m_NumLods * sizeof(MeshCacheLod) <= size;
+		const MeshCacheLod* lods = valid ? (const MeshCacheLod*)(m_File.GetData() + header->m_LodsOffset) : nullptr;
+		for (int m = 0; valid && m < header->m_NumMeshes; m++) {
+			const MeshCacheEntry& entry = entries[m];
+			uint64_t expectedSizes[MS_NumSections] = {
+				(uint64_t)MeshBuffers::GetVertexBytes(entry.m_BufferFlags, entry.m_NumVertices),
+				(uint64_t)MeshBuffers::GetIndexBytes(entry.m_BufferFlags, entry.m_NumFaces),
+				(uint64_t)entry.m_NumFaces * 3 * sizeof(HalfEdge),
+				(uint64_t)entry.m_NumVertices * sizeof(uint32_t),
+				(uint64_t)entry.m_NumFaces * sizeof(float) };
+			for (int i = 0; i < MS_NumSections; i++) {
+				valid = valid && entry.m_Sizes[i] == expectedSizes[i] && entry.m_Offsets[i] % MESHCACHE_ALIGNMENT == 0
+					&& entry.m_Offsets[i] + entry.m_Sizes[i] <= size;
+			}
+			valid = valid && (uint64_t)entry.m_FirstLod + entry.m_NumLods <= header->m_NumLods;
+			for (int l = 0; valid && l < entry.m_NumLods; l++) {
+				const MeshCacheLod& lod = lods[entry.m_FirstLod + l];
+				valid = lod.m_VertexOffset % MESHCACHE_ALIGNMENT == 0 && lod.m_IndexOffset % MESHCACHE_ALIGNMENT == 0
+					&& lod.m_VertexOffset + MeshBuffers::GetVertexBytes(lod.m_BufferFlags, lod.m_NumVertices) <= size
+					&& lod.m_IndexOffset + MeshBuffers::GetIndexBytes(lod.m_BufferFlags, lod.m_NumFaces) <= size;
+			}
+		}
+		if (!valid) {
+			std::cout << "Ignoring outdated mesh cache " << path << std::endl;
+			m_File.Close();
+			return false;
+		}
+		m_Header = header;
+		m_Entries = entries;
+		m_Lods = lods;
+		return true;
+	}
+
+	void MeshCache::Close() {
+		m_File.Close();
+		m_Header = nullptr;
+		m_Entries = nullptr;
+		m_Lods = nullptr;
+	}
+
+	int MeshCache::GetNumMeshes() {
+		return m_Header ? m_Header->m_NumMeshes : 0;
+	}
+
+	int MeshCache::GetNumVertices(int mesh) {
+		return m_Entries[mesh].m_NumVertices;
+	}
+
+	int MeshCache::GetNumFaces(int mesh) {
+		return m_Entries[mesh].m_NumFaces;
+	}
+
+	void MeshCache::GetNodes(std::vector<MeshNode>& outNodes) {
+		outNodes.clear();
+		if (!m_Header)
+			return;
+		const MeshCacheNode* nodes = (const MeshCacheNode*)(m_File.GetData() + m_Header->m_NodesOffset);
+		const uint32_t* nodeMeshes = (const uint32_t*)(nodes + m_Header->m_NumNodes);
+		outNodes.resize(m_Header->m_NumNodes);
+		for (int i = 0; i < outNodes.size(); i++) {
+			memcpy(&outNodes[i].m_Transform[0][0], nodes[i].m_Transform, sizeof(nodes[i].m_Transform));
+			outNodes[i].m_Parent = nodes[i].m_Parent;
+			for (uint32_t j = 0; j < nodes[i].m_NumMeshes && nodes[i].m_FirstMesh + j < m_Header->m_NumNodeMeshes; j++) {
+				uint32_t mesh = nodeMeshes[nodes[i].m_FirstMesh + j];
+				if (mesh < m_Header->m_NumMeshes)
+					outNodes[i].m_Meshes.push_back(mesh);
+			}
+		}
+	}
+
+	int64_t MeshCache::GetSize() {
+		return m_File.GetSize();
+	}
+
+	uint32_t MeshCache::GetBufferFlags(int mesh) {
+		return m_Entries[mesh].m_BufferFlags;
+	}
+
+	const uint8_t* MeshCache::GetVertexData(int mesh) {
+		return GetSection(mesh, MS_VertexData);
+	}
+
+	const uint8_t* MeshCache::GetIndexData(int mesh) {
+		return GetSection(mesh, MS_IndexData);
+	}
+
+	const HalfEdge* MeshCache::GetHalfEdges(int mesh) {
+		return (const HalfEdge*)GetSection(mesh, MS_HalfEdges);
+	}
+
+	const uint32_t* MeshCache::GetVertexEdges(int mesh) {
+		return (const uint32_t*)GetSection(mesh, MS_VertexEdges);
+	}
+
+	const float* MeshCache::GetAreaSums(int mesh) {
+		return (const float*)GetSection(mesh, MS_AreaSums);
+	}
+
+	int MeshCache::GetNumLods(int mesh) {
+		return m_Entries[mesh].m_NumLods;
+	}
+
+	int MeshCache::GetLodNumVertices(int mesh, int lod) {
+		return GetLod(mesh, lod).m_NumVertices;
+	}
+
+	int MeshCache::GetLodNumFaces(int mesh, int lod) {
+		return GetLod(mesh, lod).m_NumFaces;
+	}
+
+	float MeshCache::GetLodError(int mesh, int lod) {
+		return GetLod(mesh, lod).m_Error;
+	}
+
+	uint32_t MeshCache::GetLodBufferFlags(int mesh, int lod) {
+		return GetLod(mesh, lod).m_BufferFlags;
+	}
+
+	const uint8_t* MeshCache::GetLodVertexData(int mesh, int lod) {
+		return m_File.GetData() + GetLod(mesh, lod).m_VertexOffset;
+	}
+
+	const uint8_t* MeshCache::GetLodIndexData(int mesh, int lod) {
+		return m_File.GetData() + GetLod(mesh, lod).m_IndexOffset;
+	}
+
+	const MeshCacheLod& MeshCache::GetLod(int mesh, int lod) {
+		return m_Lods[m_Entries[mesh].m_FirstLod + lod];
+	}
+
+	const uint8_t* MeshCache::GetSection(int mesh, EMeshCacheSections section) {
+		return m_Header ? m_File.GetData() + m_Entries[mesh].m_Offsets[section] : nullptr;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "halfedge.h"
+#include "hatching.h"
+#include "mappedfile.h"
+#include "meshbuffers.h"
+
+#include <glm/ext/matrix_float4x4.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Copperplate {
+
+	// Baked meshes, so a start does not have to parse the source file through Assimp and rebuild the half
+	// edges, the adjacency indices and the seeds. Caches are named after a hash of the source content, an
+	// edited source simply misses the cache. A cache holds all meshes of the file and its node hierarchy, the
+	// sections of every mesh are aligned and stored in the layout the GL buffers and the HalfEdgeMesh use,
+	// loading maps the file and uploads straight from the mapping.
+	// The simplified levels of detail of every mesh follow its sections, only with the buffer data they are drawn from.
+	// Seeds go into a file of their own per mesh, they depend on the random seed of the scene.
+	// Bump the versions whenever the import, the buffer layout or the seed generation changes.
+	const uint32_t MESHCACHE_MAGIC = 0x434D5043;	//"CPMC"
+	const uint32_t MESHCACHE_VERSION = 4;
+	const uint32_t SEEDCACHE_MAGIC = 0x44535043;	//"CPSD"
+	const uint32_t SEEDCACHE_VERSION = 3;
+	const int MESHCACHE_ALIGNMENT = 64;
+
+	enum EMeshCacheSections {
+		MS_VertexData,		//position and octahedral normal per vertex, see MeshBuffers
+		MS_IndexData,		//6 indices of 16 or 32 bit per face for GL_TRIANGLES_ADJACENCY
+		MS_HalfEdges,		//3 per face
+		MS_VertexEdges,		//outgoing half edge of every vertex
+		MS_AreaSums,		//prefix sums of the face areas
+		MS_NumSections
+	};
+
+	// Node of the hierarchy of an imported file, parents come before their children
+	struct MeshNode {
+		glm::mat4 m_Transform = glm::mat4(1.0f);	//relative to the parent node
+		int m_Parent = -1;							//-1 for the root
+		std::vector<int> m_Meshes;					//indices into the meshes of the file
+	};
+
+	// A simplified level of a mesh as it is written to the cache, only its buffers are kept
+	struct MeshCacheLodInput {
+		float m_Error;
+		const MeshBuffers* m_Buffers;
+	};
+
+	// The data of one mesh as it is written to the cache
+	struct MeshCacheInput {
+		const HalfEdgeMesh* m_HalfEdgeMesh;
+		const MeshBuffers* m_Buffers;
+		const std::vector<float>* m_AreaSums;
+		std::vector<MeshCacheLodInput> m_Lods;		//coarser with every level
+	};
+
+	struct MeshCacheHeader {
+		uint32_t m_Magic;
+		uint32_t m_Version;
+		uint64_t m_SourceHash;
+		uint32_t m_NumMeshes;
+		uint32_t m_NumNodes;
+		uint32_t m_NumNodeMeshes;
+		uint32_t m_NumLods;
+		uint64_t m_NodesOffset;		//followed by the mesh indices of all nodes
+		uint64_t m_LodsOffset;
+	};
+
+	// One per mesh right after the header
+	struct MeshCacheEntry {
+		uint32_t m_NumVertices;
+		uint32_t m_NumFaces;
+		uint32_t m_FirstLod;		//into the levels of all meshes
+		uint32_t m_NumLods;
+		uint32_t m_BufferFlags;		//EMeshBufferFlags of the vertex and index data
+		uint32_t m_Padding;
+		uint64_t m_Offsets[MS_NumSections];
+		uint64_t m_Sizes[MS_NumSections];
+	};
+
+	struct MeshCacheLod {
+		uint32_t m_NumVertices;
+		uint32_t m_NumFaces;
+		float m_Error;
+		uint32_t m_BufferFlags;
+		uint64_t m_VertexOffset;
+		uint64_t m_IndexOffset;
+	};
+
+	struct MeshCacheNode {
+		float m_Transform[16];		//column major
+		int32_t m_Parent;
+		uint32_t m_FirstMesh;		//into the mesh indices of the nodes
+		uint32_t m_NumMeshes;
+		uint32_t m_Padding;
+	};
+
+	struct SeedCacheHeader {
+		uint32_t m_Magic;
+		uint32_t m_Version;
+		uint64_t m_SourceHash;
+		int32_t m_RandomSeed;
+		uint32_t m_ObjectId;
+		uint32_t m_NumSeeds;
+		uint32_t m_Padding;
+	};
+
+	class MeshCache {
+	public:
+
+		MeshCache();
+
+		// Content hash the caches are keyed by, false if the file cannot be read
+		static bool HashFile(const std::string& path, uint64_t& outHash);
+		static std::string GetMeshPath(const std::string& directory, uint64_t sourceHash);
+		static std::string GetSeedPath(const std::string& directory, uint64_t sourceHash, int meshIndex, int randomSeed, unsigned int objectId, int numSeeds);
+
+		// Both are written to a temporary file that is renamed when complete, a crashed run leaves no half cache
+		static bool WriteMeshes(const std::string& path, uint64_t sourceHash, const std::vector<MeshCacheInput>& meshes, const std::vector<MeshNode>& nodes);
+		static bool WriteSeeds(const std::string& path, uint64_t sourceHash, int randomSeed, unsigned int objectId, const std::vector<SeedPoint>& seedPoints);
+		// Appends the seeds, false if there is no cache for exactly these parameters
+		static bool ReadSeeds(const std::string& path, uint64_t sourceHash, int randomSeed, unsigned int objectId, int numSeeds, std::vector<SeedPoint>& outSeedPoints);
+
+		// Maps the mesh cache, false if it is missing or was written for other content or by another version
+		bool Open(const std::string& path, uint64_t sourceHash);
+		void Close();
+
+		int GetNumMeshes();
+		int GetNumVertices(int mesh);
+		int GetNumFaces(int mesh);
+		void GetNodes(std::vector<MeshNode>& outNodes);
+		int64_t GetSize();
+
+		// Pointers into the mapping, valid until the cache is closed
+		uint32_t GetBufferFlags(int mesh);
+		const uint8_t* GetVertexData(int mesh);
+		const uint8_t* GetIndexData(int mesh);
+		const HalfEdge* GetHalfEdges(int mesh);
+		const uint32_t* GetVertexEdges(int mesh);
+		const float* GetAreaSums(int mesh);
+
+		// Simplified levels of a mesh, the full resolution is not counted
+		int GetNumLods(int mesh);
+		int GetLodNumVertices(int mesh, int lod);
+		int GetLodNumFaces(int mesh, int lod);
+		float GetLodError(int mesh, int lod);
+		uint32_t GetLodBufferFlags(int mesh, int lod);
+		const uint8_t* GetLodVertexData(int mesh, int lod);
+		const uint8_t* GetLodIndexData(int mesh, int lod);
+
+	private:
+
+		const uint8_t* GetSection(int mesh, EMeshCacheSections section);
+		const MeshCacheLod& GetLod(int mesh, int lod);
+
+		MappedFile m_File;
+		const MeshCacheHeader* m_Header;
+		const MeshCacheEntry* m_Entries;
+		const MeshCacheLod* m_Lods;
+	};
+}
\ No newline at end of file
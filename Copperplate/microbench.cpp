@@ -0,0 +1,547 @@
+#pragma once
+
+#include "hatching.h"
+#include "image.h"
+#include "mesh.h"
+#include "utility.h"
+
+#include <rapidjson/document.h>
+#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <random>
+
+// Microbenchmarks of the functions that show up in profiles of the stroke simulation. The fields, seeds
+// and lines are synthetic, so the numbers only depend on the parameters and can be compared between
+// builds, e.g. before and after reworking a data structure.
+
+// Results of the benchmarked calls are accumulated here, so the compiler cannot drop them
+float g_Sink = 0.0f;
+
+namespace Copperplate {
+
+	const int MIN_SAMPLES = 5;
+	const int MAX_SAMPLES = 10000;
+	const int NUM_QUERY_POINTS = 4096;
+
+	struct MicroBenchmark {
+		std::string m_Name;
+		int m_OpsPerSample;
+		std::function<void()> m_Setup;				//untimed, runs before every sample
+		std::function<void(int numOps)> m_Run;		//runs the benchmarked operation numOps times
+	};
+
+	struct MicroResult {
+		std::string m_Name;
+		int m_Samples;
+		int m_OpsPerSample;
+		// nanoseconds per operation
+		double m_Median;
+		double m_Mean;
+		double m_Min;
+		double m_Stddev;
+	};
+
+	struct FixtureParams {
+		glm::ivec2 m_ViewportSize = glm::ivec2(1280, 720);
+		float m_SeedDensity = 40.0f;	//visible seeds per 100x100 pixels
+		int m_NumLines = 1000;
+		int m_RandomSeed = 1;
+	};
+
+	// A Hatching with smooth synthetic fields, uniformly distributed seeds and lines that follow the
+	// field of the first layer. Friend of Hatching and HatchingLayer to reach the private hot paths.
+	class HatchingFixture {
+	public:
+
+		HatchingFixture(const FixtureParams& params);
+
+		void AddBenchmarks(std::vector<MicroBenchmark>& outBenchmarks);
+
+		int GetNumSeeds();
+		int GetNumCollisionPoints();
+
+	private:
+
+		void CreateFields();
+		void CreateSeeds();
+		void CreateLines();
+
+		FixtureParams m_Params;
+		std::mt19937 m_Random;
+		Unique<Hatching> m_Hatching;
+		HatchingLayer* m_Layer;
+
+		std::vector<HatchingLine*> m_Lines;
+		std::vector<std::vector<ScreenSpaceSeed*>> m_LineSeeds;
+		std::vector<HatchingLine> m_LineCopies;
+		std::vector<glm::vec2> m_QueryPoints;
+		Unique<HaltonSequence> m_Halton;
+	};
+
+	HatchingFixture::HatchingFixture(const FixtureParams& params) {
+		m_Params = params;
+		m_Random = std::mt19937(params.m_RandomSeed);
+		m_Hatching = CreateUnique<Hatching>(params.m_ViewportSize.x, params.m_ViewportSize.y);
+		m_Layer = m_Hatching->m_Layers[0].get();
+
+		std::uniform_real_distribution<float> randomX(1.0f, params.m_ViewportSize.x - 1.0f);
+		std::uniform_real_distribution<float> randomY(1.0f, params.m_ViewportSize.y - 1.0f);
+		for (int i = 0; i < NUM_QUERY_POINTS; i++) {
+			m_QueryPoints.push_back(glm::vec2(randomX(m_Random), randomY(m_Random)));
+		}
+
+		CreateFields();
+		CreateSeeds();
+		CreateLines();
+	}
+
+	void HatchingFixture::CreateFields() {
+		glm::ivec2 size = m_Params.m_ViewportSize;
+		glm::vec2 center = glm::vec2(size) * 0.5f;
+		std::vector<float> normals(size.x * size.y * 4, 0.0f);
+		std::vector<float> curvature(size.x * size.y * 4, 0.0f);
+		std::vector<float> gradient(size.x * size.y * 4, 0.0f);
+		std::vector<float> movement(size.x * size.y * 4, 0.0f);
+		for (int y = 0; y < size.y; y++) {
+			for (int x = 0; x < size.x; x++) {
+				int i = (y * size.x + x) * 4;
+				glm::vec2 offset = (glm::vec2(x, y) - center) / glm::vec2(size);
+				// normals of a sphere filling the viewport
+				normals[i] = offset.x * 2.0f;
+				normals[i + 1] = offset.y * 2.0f;
+				// curvature directions swirling around the center with some waviness
+				float angle = atan2(offset.y, offset.x) + 1.57f + 0.4f * sin(x * 0.03f);
+				curvature[i] = cos(angle);
+				curvature[i + 1] = sin(angle);
+				// shading gradient slowly rotating over the image
+				float shadeAngle = 0.3f + 2.0f * y / size.y;
+				gradient[i] = cos(shadeAngle);
+				gradient[i + 1] = sin(shadeAngle);
+			}
+		}
+		m_Hatching->SetFieldData(HF_Normals, normals.data());
+		m_Hatching->SetFieldData(HF_Curvature, curvature.data());
+		m_Hatching->SetFieldData(HF_ShadingGradient, gradient.data());
+		m_Hatching->SetFieldData(HF_Movement, movement.data());
+	}
+
+	void HatchingFixture::CreateSeeds() {
+		glm::ivec2 size = m_Params.m_ViewportSize;
+		int numSeeds = (int)(m_Params.m_SeedDensity * size.x * size.y / 10000.0f);
+		std::uniform_real_distribution<float> randomX(1.0f, size.x - 1.0f);
+		std::uniform_real_distribution<float> randomY(1.0f, size.y - 1.0f);
+		std::uniform_real_distribution<float> randomImportance(0.0f, 1.0f);
+
+		std::vector<ScreenSpaceSeed> seeds;
+		seeds.reserve(numSeeds);
+		for (int i = 0; i < numSeeds; i++) {
+			seeds.push_back({ glm::vec2(randomX(m_Random), randomY(m_Random)), randomImportance(m_Random), (unsigned int)i, true });
+		}
+		m_Hatching->AddScreenSeeds(seeds);
+		m_Hatching->PrepareForHatching();
+	}
+
+	void HatchingFixture::CreateLines() {
+		const HatchingSettings& settings = m_Layer->m_Settings;
+		std::uniform_int_distribution<int> randomLength(4, 24);
+		// uneven spacing, so resampling has to both insert and remove points
+		std::uniform_real_distribution<float> randomSpacing(0.4f, 1.8f);
+
+		for (int i = 0; i < m_Params.m_NumLines; i++) {
+			glm::vec2 pos = m_QueryPoints[i % NUM_QUERY_POINTS] + glm::vec2(i / NUM_QUERY_POINTS);
+			int length = randomLength(m_Random);
+			std::vector<glm::vec2> points;
+			for (int j = 0; j < length && m_Hatching->IsInBounds(pos); j++) {
+				points.push_back(pos);
+				glm::vec2 dir = m_Hatching->GetHatchingDir(pos, settings.m_Direction);
+				if (glm::length(dir) < 1e-4f) dir = glm::vec2(1.0f, 0.0f);
+				pos += dir * settings.m_ExtendRadius * randomSpacing(m_Random);
+			}
+			if (points.size() < 3) continue;
+
+			ScreenSeedSet seedsUnique;
+			std::vector<ScreenSpaceSeed*> seeds;
+			for (glm::vec2 point : points) {
+				for (ScreenSpaceSeed* seed : m_Hatching->FindVisibleSeedsInRadius(point, settings.m_CoverRadius)) {
+					if (seedsUnique.insert(seed).second)
+						seeds.push_back(seed);
+				}
+			}
+
+			HatchingLine& line = m_Layer->m_HatchingLines.emplace_back(points, seeds, *m_Layer);
+			m_Layer->UpdateLineCollision(line);
+			m_Lines.push_back(&line);
+			m_LineSeeds.push_back(seeds);
+		}
+	}
+
+	int HatchingFixture::GetNumSeeds() {
+		return m_Hatching->GetScreenSeeds().size();
+	}
+
+	int HatchingFixture::GetNumCollisionPoints() {
+		std::vector<glm::vec2> points;
+		m_Layer->BuildCollisionBuffer(points);
+		return points.size();
+	}
+
+	void HatchingFixture::AddBenchmarks(std::vector<MicroBenchmark>& outBenchmarks) {
+		outBenchmarks.push_back({ "HatchingLayer::HasCollision", 4096, nullptr, [this](int numOps) {
+			for (int i = 0; i < numOps; i++) {
+				g_Sink += m_Layer->HasCollision(m_QueryPoints[i % NUM_QUERY_POINTS], false) ? 1.0f : 0.0f;
+			}
+		} });
+
+		outBenchmarks.push_back({ "HatchingLayer::HasCollision(contours)", 4096, nullptr, [this](int numOps) {
+			for (int i = 0; i < numOps; i++) {
+				g_Sink += m_Layer->HasCollision(m_QueryPoints[i % NUM_QUERY_POINTS], true) ? 1.0f : 0.0f;
+			}
+		} });
+
+		outBenchmarks.push_back({ "Hatching::FindVisibleSeedsInRadius", 4096, nullptr, [this](int numOps) {
+			for (int i = 0; i < numOps; i++) {
+				g_Sink += m_Hatching->FindVisibleSeedsInRadius(m_QueryPoints[i % NUM_QUERY_POINTS], m_Layer->m_Settings.m_CoverRadius).size();
+			}
+		} });
+
+		outBenchmarks.push_back({ "HatchingLayer::ExtendLine", 256, nullptr, [this](int numOps) {
+			const HatchingSettings& settings = m_Layer->m_Settings;
+			for (int i = 0; i < numOps; i++) {
+				glm::vec2 tip = m_QueryPoints[i % NUM_QUERY_POINTS];
+				glm::vec2 dir = m_Hatching->GetHatchingDir(tip, settings.m_Direction);
+				if (glm::length(dir) < 1e-4f) dir = glm::vec2(1.0f, 0.0f);
+				g_Sink += m_Layer->ExtendLine(tip, tip - dir * settings.m_ExtendRadius).size();
+			}
+		} });
+
+		if (m_Lines.empty()) return;
+
+		outBenchmarks.push_back({ "HatchingLayer::EvaluatePointPos", 4096, nullptr, [this](int numOps) {
+			for (int i = 0; i < numOps; i++) {
+				HatchingLine& line = *m_Lines[i % m_Lines.size()];
+				const std::deque<glm::vec2>& points = line.getPoints();
+				int index = i % points.size();
+				glm::vec2 offset = glm::vec2(0.5f * ((i & 1) ? 1.0f : -1.0f), 0.25f);
+				g_Sink += m_Layer->EvaluatePointPos(line, index, points[index] + offset, points);
+			}
+		} });
+
+		outBenchmarks.push_back({ "HatchingLine::Resample", 256, [this]() {
+			m_LineCopies.clear();
+			m_LineCopies.reserve(256);
+			for (int i = 0; i < 256; i++) {
+				m_LineCopies.push_back(*m_Lines[i % m_Lines.size()]);
+			}
+		}, [this](int numOps) {
+			for (int i = 0; i < numOps; i++) {
+				m_LineCopies[i].Resample();
+				g_Sink += m_LineCopies[i].getPoints().size();
+			}
+		} });
+
+		outBenchmarks.push_back({ "HatchingLine::ReplaceSeeds", 1024, nullptr, [this](int numOps) {
+			for (int i = 0; i < numOps; i++) {
+				int lineIndex = i % m_Lines.size();
+				m_Lines[lineIndex]->ReplaceSeeds(m_LineSeeds[lineIndex]);
+				g_Sink += m_Lines[lineIndex]->getSeeds().size();
+			}
+		} });
+
+		outBenchmarks.push_back({ "Image::Sample", 4096, nullptr, [this](int numOps) {
+			Image* image = m_Hatching->GetField(HF_Curvature);
+			for (int i = 0; i < numOps; i++) {
+				g_Sink += image->Sample(m_QueryPoints[i % NUM_QUERY_POINTS]).x;
+			}
+		} });
+
+		outBenchmarks.push_back({ "Image::Sample(pixel)", 4096, nullptr, [this](int numOps) {
+			Image* image = m_Hatching->GetField(HF_Curvature);
+			for (int i = 0; i < numOps; i++) {
+				g_Sink += image->Sample(glm::ivec2(m_QueryPoints[i % NUM_QUERY_POINTS])).x;
+			}
+		} });
+
+		// restarted for every sample, the integer state would overflow after a few billion numbers
+		outBenchmarks.push_back({ "HaltonSequence::NextNumber", 4096, [this]() {
+			m_Halton = CreateUnique<HaltonSequence>(3);
+		}, [this](int numOps) {
+			for (int i = 0; i < numOps; i++) {
+				g_Sink += m_Halton->NextNumber();
+			}
+		} });
+	}
+
+	void addMeshBenchmark(std::vector<MicroBenchmark>& outBenchmarks, const std::string& meshFile) {
+		outBenchmarks.push_back({ "MeshCreator::ImportAsset", 1, nullptr, [meshFile](int numOps) {
+			// the importer logs every mesh, keep that out of the result table
+			std::streambuf* output = std::cout.rdbuf(nullptr);
+			for (int i = 0; i < numOps; i++) {
+				Shared<MeshAsset> asset = MeshCreator::ImportAsset(meshFile, false);
+				if (asset) g_Sink += asset->m_Meshes[0]->GetHalfEdgeMesh().GetNumFaces();
+			}
+			std::cout.rdbuf(output);
+		} });
+
+		// only the twin matching of the imported half edges, without parsing
+		Shared<HalfEdgeMesh> halfEdgeMesh = CreateShared<HalfEdgeMesh>();
+		outBenchmarks.push_back({ "HalfEdgeMesh::ConnectHalfEdges", 1, [meshFile, halfEdgeMesh]() {
+			if (halfEdgeMesh->halfEdges.empty()) {
+				std::streambuf* output = std::cout.rdbuf(nullptr);
+				Shared<MeshAsset> asset = MeshCreator::ImportAsset(meshFile, false);
+				std::cout.rdbuf(output);
+				if (asset) *halfEdgeMesh = asset->m_Meshes[0]->GetHalfEdgeMesh();
+			}
+		}, [halfEdgeMesh](int numOps) {
+			for (int i = 0; i < numOps; i++) {
+				halfEdgeMesh->ConnectHalfEdges();
+				if (!halfEdgeMesh->halfEdges.empty()) g_Sink += halfEdgeMesh->halfEdges[0].twin;
+			}
+		} });
+	}
+
+	MicroResult runBenchmark(const MicroBenchmark& benchmark, double minTime) {
+		// one untimed sample to warm up caches and allocators
+		if (benchmark.m_Setup) benchmark.m_Setup();
+		benchmark.m_Run(benchmark.m_OpsPerSample);
+
+		std::vector<double> samples;
+		double totalTime = 0.0;
+		while ((totalTime < minTime || samples.size() < MIN_SAMPLES) && samples.size() < MAX_SAMPLES) {
+			if (benchmark.m_Setup) benchmark.m_Setup();
+			auto start = std::chrono::steady_clock::now();
+			benchmark.m_Run(benchmark.m_OpsPerSample);
+			double time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			samples.push_back(time / benchmark.m_OpsPerSample);
+			totalTime += time * 1e-6;
+		}
+
+		MicroResult result;
+		result.m_Name = benchmark.m_Name;
+		result.m_Samples = samples.size();
+		result.m_OpsPerSample = benchmark.m_OpsPerSample;
+		result.m_Mean = 0.0;
+		for (double sample : samples) {
+			result.m_Mean += sample;
+		}
+		result.m_Mean /= samples.size();
+		result.m_Stddev = 0.0;
+		for (double sample : samples) {
+			result.m_Stddev += (sample - result.m_Mean) * (sample - result.m_Mean);
+		}
+		result.m_Stddev = std::sqrt(result.m_Stddev / samples.size());
+		std::sort(samples.begin(), samples.end());
+		result.m_Min = samples[0];
+		result.m_Median = samples[samples.size() / 2];
+		return result;
+	}
+
+	bool writeReport(const std::string& path, const std::vector<MicroResult>& results, const FixtureParams& params, int numSeeds, int numCollisionPoints, double minTime) {
+		rapidjson::StringBuffer buffer;
+		rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+		writer.StartObject();
+
+		writer.Key("config");
+		writer.StartObject();
+		writer.Key("width");
+		writer.Int(params.m_ViewportSize.x);
+		writer.Key("height");
+		writer.Int(params.m_ViewportSize.y);
+		writer.Key("seedDensity");
+		writer.Double(params.m_SeedDensity);
+		writer.Key("numSeeds");
+		writer.Int(numSeeds);
+		writer.Key("numLines");
+		writer.Int(params.m_NumLines);
+		writer.Key("numCollisionPoints");
+		writer.Int(numCollisionPoints);
+		writer.Key("seed");
+		writer.Int(params.m_RandomSeed);
+		writer.Key("minTimeMs");
+		writer.Double(minTime);
+		writer.EndObject();
+
+		writer.Key("benchmarks");
+		writer.StartArray();
+		for (const MicroResult& result : results) {
+			writer.StartObject();
+			writer.Key("name");
+			writer.String(result.m_Name.c_str());
+			writer.Key("samples");
+			writer.Int(result.m_Samples);
+			writer.Key("opsPerSample");
+			writer.Int(result.m_OpsPerSample);
+			writer.Key("medianNs");
+			writer.Double(result.m_Median);
+			writer.Key("meanNs");
+			writer.Double(result.m_Mean);
+			writer.Key("minNs");
+			writer.Double(result.m_Min);
+			writer.Key("stddevNs");
+			writer.Double(result.m_Stddev);
+			writer.EndObject();
+		}
+		writer.EndArray();
+
+		writer.EndObject();
+
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			std::cout << "Could not open " << path << std::endl;
+			return false;
+		}
+		file << buffer.GetString();
+		return true;
+	}
+
+	// Median times of a previous report by benchmark name
+	bool readBaseline(const std::string& path, std::map<std::string, double>& outMedians) {
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			std::cout << "Could not open " << path << std::endl;
+			return false;
+		}
+		rapidjson::IStreamWrapper stream(file);
+		rapidjson::Document document;
+		document.ParseStream(stream);
+		if (document.HasParseError() || !document.IsObject() || !document.HasMember("benchmarks") || !document["benchmarks"].IsArray()) {
+			std::cout << path << " is not a microbenchmark report" << std::endl;
+			return false;
+		}
+		for (const rapidjson::Value& benchmark : document["benchmarks"].GetArray()) {
+			if (benchmark.HasMember("name") && benchmark["name"].IsString() && benchmark.HasMember("medianNs") && benchmark["medianNs"].IsNumber())
+				outMedians[benchmark["name"].GetString()] = benchmark["medianNs"].GetDouble();
+		}
+		return true;
+	}
+}
+
+using namespace Copperplate;
+
+void printUsage() {
+	std::cout << "Usage: CopperplateMicrobench [options]" << std::endl
+		<< "  --size <w>x<h>         synthetic viewport size, default 1280x720" << std::endl
+		<< "  --density <n>          visible seeds per 100x100 pixels, default 40" << std::endl
+		<< "  --lines <n>            number of synthetic hatching lines, default 1000" << std::endl
+		<< "  --seed <n>             seed for the synthetic data, default 1" << std::endl
+		<< "  --mesh <file>          also benchmark importing this mesh, without GL upload" << std::endl
+		<< "  --filter <text>        only run benchmarks whose name contains text" << std::endl
+		<< "  --min-time <ms>        minimum measured time per benchmark, default 200" << std::endl
+		<< "  --json <file>          write the results as json" << std::endl
+		<< "  --baseline <file>      compare against a previous json report" << std::endl
+		<< "  --tolerance <f>        relative slowdown against the baseline that fails the run, default 0.1" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+	FixtureParams params;
+	std::string meshFile;
+	std::string filter;
+	std::string jsonPath;
+	std::string baselinePath;
+	double minTime = 200.0;
+	double tolerance = 0.1;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if (arg == "--size" && hasValue) {
+			std::string value = argv[++i];
+			size_t split = value.find('x');
+			if (split == std::string::npos) {
+				printUsage();
+				return 1;
+			}
+			params.m_ViewportSize = glm::ivec2(std::atoi(value.substr(0, split).c_str()), std::atoi(value.substr(split + 1).c_str()));
+		}
+		else if (arg == "--density" && hasValue) {
+			params.m_SeedDensity = std::atof(argv[++i]);
+		}
+		else if (arg == "--lines" && hasValue) {
+			params.m_NumLines = std::atoi(argv[++i]);
+		}
+		else if (arg == "--seed" && hasValue) {
+			params.m_RandomSeed = std::atoi(argv[++i]);
+		}
+		else if (arg == "--mesh" && hasValue) {
+			meshFile = argv[++i];
+		}
+		else if (arg == "--filter" && hasValue) {
+			filter = argv[++i];
+		}
+		else if (arg == "--min-time" && hasValue) {
+			minTime = std::atof(argv[++i]);
+		}
+		else if (arg == "--json" && hasValue) {
+			jsonPath = argv[++i];
+		}
+		else if (arg == "--baseline" && hasValue) {
+			baselinePath = argv[++i];
+		}
+		else if (arg == "--tolerance" && hasValue) {
+			tolerance = std::atof(argv[++i]);
+		}
+		else {
+			printUsage();
+			return 1;
+		}
+	}
+	if (params.m_ViewportSize.x <= 8 || params.m_ViewportSize.y <= 8) {
+		std::cout << "The viewport needs to be larger than 8x8 pixels" << std::endl;
+		return 1;
+	}
+
+	std::map<std::string, double> baseline;
+	if (!baselinePath.empty() && !readBaseline(baselinePath, baseline))
+		return 1;
+
+	HatchingFixture fixture(params);
+	std::vector<MicroBenchmark> benchmarks;
+	fixture.AddBenchmarks(benchmarks);
+	if (!meshFile.empty())
+		addMeshBenchmark(benchmarks, meshFile);
+
+	std::cout << "Viewport " << params.m_ViewportSize.x << "x" << params.m_ViewportSize.y << ", " << fixture.GetNumSeeds() << " seeds, "
+		<< params.m_NumLines << " lines, " << fixture.GetNumCollisionPoints() << " collision points" << std::endl;
+	std::cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(14) << "median ns" << std::setw(14) << "min ns"
+		<< std::setw(14) << "stddev ns" << std::setw(10) << "samples";
+	if (!baseline.empty())
+		std::cout << std::setw(12) << "vs base";
+	std::cout << std::endl;
+
+	std::vector<MicroResult> results;
+	bool regressed = false;
+	for (const MicroBenchmark& benchmark : benchmarks) {
+		if (!filter.empty() && benchmark.m_Name.find(filter) == std::string::npos) continue;
+		MicroResult result = runBenchmark(benchmark, minTime);
+		results.push_back(result);
+
+		std::cout << std::left << std::setw(40) << result.m_Name << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(14) << result.m_Median << std::setw(14) << result.m_Min << std::setw(14) << result.m_Stddev << std::setw(10) << result.m_Samples;
+		auto base = baseline.find(result.m_Name);
+		if (base != baseline.end() && base->second > 0.0) {
+			double ratio = result.m_Median / base->second;
+			std::cout << std::setw(11) << std::setprecision(2) << ratio << "x";
+			if (ratio > 1.0 + tolerance) {
+				std::cout << "  slower";
+				regressed = true;
+			}
+		}
+		std::cout << std::endl;
+	}
+
+	if (!jsonPath.empty() && !writeReport(jsonPath, results, params, fixture.GetNumSeeds(), fixture.GetNumCollisionPoints(), minTime))
+		return 1;
+	if (regressed) {
+		std::cout << "Some benchmarks are more than " << tolerance * 100.0 << "% slower than the baseline" << std::endl;
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
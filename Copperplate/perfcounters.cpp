@@ -0,0 +1,154 @@
+#pragma once
+
+#include "perfcounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace Copperplate {
+
+	const char* getPerfCounterName(EPerfCounterType type) {
+		switch (type) {
+		case PC_Cycles: return "cycles";
+		case PC_Instructions: return "instructions";
+		case PC_L1DMisses: return "L1D misses";
+		case PC_LLCMisses: return "LLC misses";
+		case PC_BranchMisses: return "branch misses";
+		case PC_NumCounters: break;
+		}
+		return "Unknown";
+	}
+
+#ifdef __linux__
+	int openPerfEvent(EPerfCounterType type, int groupFd) {
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		switch (type) {
+		case PC_Cycles:
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_CPU_CYCLES;
+			break;
+		case PC_Instructions:
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+			break;
+		case PC_L1DMisses:
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			break;
+		case PC_LLCMisses:
+			// the generic cache miss event counts last level misses on most CPUs
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_CACHE_MISSES;
+			break;
+		case PC_BranchMisses:
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+			break;
+		case PC_NumCounters:
+			errno = EINVAL;
+			return -1;
+		}
+		// only the leader starts disabled, the whole group is enabled at once
+		attr.disabled = (groupFd < 0) ? 1 : 0;
+		// user space only, works with the default perf_event_paranoid setting
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		// pid 0 and cpu -1 follow the calling thread on any cpu
+		return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+	}
+#endif
+
+	PerfCounters::PerfCounters() {
+		m_GroupFd = -1;
+		m_NumOpen = 0;
+		for (int i = 0; i < PC_NumCounters; i++) {
+			m_Fds[i] = -1;
+			m_Slots[i] = -1;
+		}
+
+#ifdef __linux__
+		int firstError = 0;
+		std::string missing;
+		for (int i = 0; i < PC_NumCounters; i++) {
+			int fd = openPerfEvent((EPerfCounterType)i, m_GroupFd);
+			if (fd < 0) {
+				if (firstError == 0) firstError = errno;
+				missing += std::string(missing.empty() ? "" : ", ") + getPerfCounterName((EPerfCounterType)i);
+				continue;
+			}
+			if (m_GroupFd < 0) m_GroupFd = fd;
+			m_Fds[i] = fd;
+			m_Slots[i] = m_NumOpen++;
+		}
+
+		if (m_NumOpen == 0) {
+			m_Status = std::string("unavailable, perf_event_open failed: ") + std::strerror(firstError);
+			if (firstError == EACCES || firstError == EPERM)
+				m_Status += " (check /proc/sys/kernel/perf_event_paranoid)";
+			else if (firstError == ENOENT || firstError == EOPNOTSUPP)
+				m_Status += " (the CPU or VM exposes no hardware counters)";
+			return;
+		}
+		ioctl(m_GroupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(m_GroupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		m_Status = std::to_string(m_NumOpen) + " of " + std::to_string(PC_NumCounters) + " counters open";
+		if (!missing.empty())
+			m_Status += ", missing " + missing + ": " + std::strerror(firstError);
+#else
+		m_Status = "unavailable, hardware counters are only supported on Linux";
+#endif
+	}
+
+	PerfCounters::~PerfCounters() {
+#ifdef __linux__
+		for (int fd : m_Fds) {
+			if (fd >= 0) close(fd);
+		}
+#endif
+	}
+
+	bool PerfCounters::IsAvailable() const {
+		return m_NumOpen > 0;
+	}
+
+	bool PerfCounters::HasCounter(EPerfCounterType type) const {
+		return m_Slots[type] >= 0;
+	}
+
+	const std::string& PerfCounters::GetStatus() const {
+		return m_Status;
+	}
+
+	bool PerfCounters::Read(uint64_t outValues[PC_NumCounters]) {
+		for (int i = 0; i < PC_NumCounters; i++) {
+			outValues[i] = 0;
+		}
+		if (m_NumOpen == 0) return false;
+
+#ifdef __linux__
+		// layout of a group read: number of counters, time enabled, time running, then the values
+		uint64_t data[3 + PC_NumCounters];
+		if (read(m_GroupFd, data, sizeof(data)) < (ssize_t)(3 * sizeof(uint64_t))) return false;
+		uint64_t enabled = data[1];
+		uint64_t running = data[2];
+		double scale = (running > 0 && running < enabled) ? (double)enabled / running : 1.0;
+		for (int i = 0; i < PC_NumCounters; i++) {
+			if (m_Slots[i] < 0 || m_Slots[i] >= (int)data[0]) continue;
+			outValues[i] = (uint64_t)(data[3 + m_Slots[i]] * scale);
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+}
\ No newline at end of file
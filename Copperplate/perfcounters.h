@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Copperplate {
+
+	enum EPerfCounterType {
+		PC_Cycles,
+		PC_Instructions,
+		PC_L1DMisses,
+		PC_LLCMisses,
+		PC_BranchMisses,
+		PC_NumCounters
+	};
+
+	const char* getPerfCounterName(EPerfCounterType type);
+
+	// Hardware performance counters of the calling thread, read through perf_event_open on Linux.
+	// All counters are opened as one group so they are scheduled together. Counters the kernel or
+	// the CPU do not provide read as zero, on other platforms nothing is available at all.
+	class PerfCounters {
+	public:
+
+		PerfCounters();
+		~PerfCounters();
+
+		bool IsAvailable() const;
+		bool HasCounter(EPerfCounterType type) const;
+		// Which counters are open, or why none are
+		const std::string& GetStatus() const;
+
+		// Counts since the group was opened, scaled up if the kernel had to multiplex the counters
+		bool Read(uint64_t outValues[PC_NumCounters]);
+
+	private:
+
+		int m_GroupFd;
+		int m_Fds[PC_NumCounters];
+		int m_Slots[PC_NumCounters];	//position of each counter in the group read, -1 if it is not open
+		int m_NumOpen;
+		std::string m_Status;
+	};
+}
\ No newline at end of file
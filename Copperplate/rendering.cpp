@@ -6,16 +6,14 @@
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/quaternion_trigonometric.hpp>
-#include <glm\gtx\string_cast.hpp>
+#include <glm/gtx/string_cast.hpp>
 
 #include <iostream>
 #include "utility.h"
+#include "stb_image.h"
 
 namespace Copperplate {
 
-	const int WINDOW_WIDTH = 2400;
-	const int WINDOW_HEIGHT = 1050;
-
 	//const glm::vec4 IMAGE_CLEARCOLOR = glm::vec4(0.89f, 0.87f, 0.53f, 1.0f);
 	const glm::vec4 IMAGE_CLEARCOLOR = glm::vec4(0.92f, 0.87f, 0.62f, 1.0f);
 	const glm::vec4 NORMAL_CLEARCOLOR = glm::vec4(0.0f);
@@ -30,34 +28,76 @@ namespace Copperplate {
 	bool DisplaySettings::RenderSeedPoints = false;
 	bool DisplaySettings::RenderScreenSpaceSeeds = false;
 	bool DisplaySettings::RenderHatching = true;
-	bool DisplaySettings::RegenerateHatching = false;
 	bool DisplaySettings::RenderHatchingCollision = false;
 	bool DisplaySettings::RenderCurrentDebug = true;
-	int DisplaySettings::NumHatchingLines = -1;
-	int DisplaySettings::NumPointsPerHatch = -1;
 	EHatchingDirections DisplaySettings::HatchingDirection = EHatchingDirections::HD_LargestCurvature;
 	EFramebuffers DisplaySettings::FramebufferToDisplay = EFramebuffers::FB_Default;
+	bool DisplaySettings::RenderCostHeatmap = false;
+	EHatchingCosts DisplaySettings::CostHeatmapType = EHatchingCosts::HC_NumCosts;
+	bool DisplaySettings::RecordCostHeatmap = false;
+	bool DisplaySettings::RenderHud = false;
 	bool DisplaySettings::RecordScreenShot = false;
 	bool DisplaySettings::RecordVideo = false;
 	int DisplaySettings::RecordFrameCount = 0;
+	int DisplaySettings::RecordThreads = 0;
+	float DisplaySettings::LodPixelError = 0.5f;
 
 
 	// Window Class
-	Window::Window() {
+	Window::Window(bool headless, int width, int height)
+		: m_OffscreenMemory(MC_GLRenderbuffers) {
+		m_Headless = headless;
+		m_Window = nullptr;
+		m_Width = width;
+		m_Height = height;
+		m_OffscreenFBO = 0;
+		m_OffscreenColor = 0;
+		m_OffscreenDepth = 0;
+
+		if (m_Headless)
+			m_Valid = CreateHeadlessContext(width, height);
+		else
+			m_Valid = CreateGlfwWindow(width, height);
+	}
+
+	Window::~Window() {
+		if (m_Headless) {
+#ifdef COPPERPLATE_HEADLESS
+			if (m_Valid) {
+				glDeleteFramebuffers(1, &m_OffscreenFBO);
+				glDeleteRenderbuffers(1, &m_OffscreenColor);
+				glDeleteRenderbuffers(1, &m_OffscreenDepth);
+			}
+			if (m_Display != EGL_NO_DISPLAY) {
+				eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+				if (m_Context != EGL_NO_CONTEXT) eglDestroyContext(m_Display, m_Context);
+				eglTerminate(m_Display);
+			}
+#endif
+		}
+		else {
+			if (m_Window) glfwDestroyWindow(m_Window);
+			glfwTerminate();
+		}
+	}
+
+	bool Window::CreateGlfwWindow(int width, int height) {
 		glfwSetErrorCallback(GlfwErrorCallback);
 
 		// initialize GLFW
 		if (!glfwInit()) {
 			std::cerr << "GLFW Initialization Failed!";
+			return false;
 		}
 
 		// setup OpenGL context and window
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-		m_Window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Copperplate", NULL, NULL);
+		m_Window = glfwCreateWindow(width, height, "Copperplate", NULL, NULL);
 		if (!m_Window) {
 			std::cerr << "Window Creation Failed!";
 			glfwTerminate();
+			return false;
 		}
 
 		glfwMakeContextCurrent(m_Window);
@@ -65,9 +105,11 @@ namespace Copperplate {
 		if (!gladInitRes) {
 			std::cerr << "Unable to initialize glad!";
 			glfwDestroyWindow(m_Window);
+			m_Window = nullptr;
 			glfwTerminate();
+			return false;
 		}
-		glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+		glViewport(0, 0, width, height);
 
 		// hookup callback functions
 		glfwSetFramebufferSizeCallback(m_Window, GlfwFramebufferSizeCallback);
@@ -77,18 +119,134 @@ namespace Copperplate {
 		glfwSetCursorPosCallback(m_Window, GlfwMousePosCallback);
 		
 		std::cout << "Window created! \n";
+		return true;
 	}
 
-	Window::~Window() {
-		glfwDestroyWindow(m_Window);
-		glfwTerminate();
+	bool Window::CreateHeadlessContext(int width, int height) {
+#ifdef COPPERPLATE_HEADLESS
+		m_Display = EGL_NO_DISPLAY;
+		m_Context = EGL_NO_CONTEXT;
+
+		// Prefer the Mesa surfaceless platform, it works without any display server and with llvmpipe
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay)
+			m_Display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		if (m_Display == EGL_NO_DISPLAY)
+			m_Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+		EGLint major, minor;
+		if (m_Display == EGL_NO_DISPLAY || !eglInitialize(m_Display, &major, &minor)) {
+			std::cerr << "EGL Initialization Failed!";
+			m_Display = EGL_NO_DISPLAY;
+			return false;
+		}
+		if (!eglBindAPI(EGL_OPENGL_API)) {
+			std::cerr << "EGL has no desktop OpenGL support!";
+			return false;
+		}
+
+		const EGLint configAttribs[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8,
+			EGL_GREEN_SIZE, 8,
+			EGL_BLUE_SIZE, 8,
+			EGL_DEPTH_SIZE, 24,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint numConfigs = 0;
+		if (!eglChooseConfig(m_Display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+			std::cerr << "No suitable EGL config found!";
+			return false;
+		}
+
+		// Software rasterizers may not expose 4.6 yet, 4.5 covers everything we use
+		const EGLint minorVersions[] = { 6, 5 };
+		for (EGLint minorVersion : minorVersions) {
+			const EGLint contextAttribs[] = {
+				EGL_CONTEXT_MAJOR_VERSION, 4,
+				EGL_CONTEXT_MINOR_VERSION, minorVersion,
+				EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+				EGL_NONE
+			};
+			m_Context = eglCreateContext(m_Display, config, EGL_NO_CONTEXT, contextAttribs);
+			if (m_Context != EGL_NO_CONTEXT) break;
+		}
+		if (m_Context == EGL_NO_CONTEXT) {
+			std::cerr << "EGL Context Creation Failed!";
+			return false;
+		}
+		if (!eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_Context)) {
+			std::cerr << "Unable to make the surfaceless EGL context current!";
+			return false;
+		}
+
+		int gladInitRes = gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+		if (!gladInitRes) {
+			std::cerr << "Unable to initialize glad!";
+			return false;
+		}
+
+		// There is no default framebuffer without a surface, so render into an offscreen one instead
+		glGenRenderbuffers(1, &m_OffscreenColor);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_OffscreenColor);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glGenRenderbuffers(1, &m_OffscreenDepth);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_OffscreenDepth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &m_OffscreenFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_OffscreenFBO);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_OffscreenColor);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_OffscreenDepth);
+		glCheckError();
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << "Offscreen Framebuffer incomplete!";
+			return false;
+		}
+		glViewport(0, 0, width, height);
+		m_OffscreenMemory.Set(getGLRenderbufferBytes(m_OffscreenColor) + getGLRenderbufferBytes(m_OffscreenDepth));
+
+		std::cout << "Headless context created! " << glGetString(GL_RENDERER) << ", " << glGetString(GL_VERSION) << "\n";
+		return true;
+#else
+		std::cerr << "Headless mode is not available, Copperplate was built without COPPERPLATE_HEADLESS!";
+		return false;
+#endif
+	}
+
+	void Window::PollEvents() {
+		if (!m_Headless)
+			glfwPollEvents();
 	}
 
 	void Window::SwapBuffers() {
-		glfwSwapBuffers(m_Window);
+		if (m_Headless)
+			glFlush();
+		else
+			glfwSwapBuffers(m_Window);
+	}
+
+	void Window::SetVSync(bool enabled) {
+		// the offscreen framebuffer is never presented, so there is nothing to sync to
+		if (!m_Headless)
+			glfwSwapInterval(enabled ? 1 : 0);
+	}
+
+	bool Window::IsValid() {
+		return m_Valid;
+	}
+
+	bool Window::IsHeadless() {
+		return m_Headless;
 	}
 
 	int Window::GetHeight() {
+		if (m_Headless)
+			return m_Height;
 		int width;
 		int height;
 		glfwGetFramebufferSize(m_Window, &width, &height);
@@ -96,11 +254,17 @@ namespace Copperplate {
 	}
 
 	int Window::GetWidth() {
+		if (m_Headless)
+			return m_Width;
 		int width;
 		int height;
 		glfwGetFramebufferSize(m_Window, &width, &height);
 		return width;
 	}
+
+	unsigned int Window::GetDefaultFramebuffer() {
+		return m_OffscreenFBO;
+	}
 	
 
 	// Camera Class
@@ -149,6 +313,21 @@ namespace Copperplate {
 		//m_ProjectionMatrix = glm::perspective(glm::radians(15.0f), (float)width / (float)height, 0.1f, 100.0f);
 	}
 
+	void Camera::SetTile(glm::ivec2 imageSize, glm::ivec2 origin, glm::ivec2 size) {
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)imageSize.x / (float)imageSize.y, 0.1f, 100.0f);
+		// scale and move the clip space so the tile covers -1 to 1
+		glm::vec2 tileMin = 2.0f * glm::vec2(origin) / glm::vec2(imageSize) - 1.0f;
+		glm::vec2 tileMax = 2.0f * glm::vec2(origin + size) / glm::vec2(imageSize) - 1.0f;
+		glm::vec2 scale = 2.0f / (tileMax - tileMin);
+		glm::vec2 offset = -(tileMax + tileMin) / (tileMax - tileMin);
+		glm::mat4 crop = glm::mat4(1.0f);
+		crop[0][0] = scale.x;
+		crop[1][1] = scale.y;
+		crop[3][0] = offset.x;
+		crop[3][1] = offset.y;
+		m_ProjectionMatrix = crop * projection;
+	}
+
 	void Camera::SetPosition(float azimuth, float height, float zoom) {
 		m_Azimuth = azimuth;
 		m_Height = height;
@@ -187,6 +366,9 @@ namespace Copperplate {
 
 	//Renderer Class
 	Renderer::Renderer(Shared<Window> window)
+		: m_BufferMemory(MC_GLBuffers)
+		, m_TextureMemory(MC_GLTextures)
+		, m_RenderbufferMemory(MC_GLRenderbuffers)
 	{
 		m_Window = window;
 		//Setup Screen Quad VAO
@@ -197,6 +379,7 @@ namespace Copperplate {
 		glBindVertexArray(m_ScreenQuadVAO);
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, 4 * 5 * sizeof(float), ScreenQuadVerts, GL_STATIC_DRAW);
+		m_BufferMemory.Set(4 * 5 * sizeof(float));
 
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (GLvoid*)0);
@@ -209,8 +392,8 @@ namespace Copperplate {
 		//Setup Framebuffers
 		//Default Render to Screen
 		unsigned int clearFlags = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT;
-		FrameBuffer default = { 0, 0, IMAGE_CLEARCOLOR, clearFlags };
-		m_Framebuffers[FB_Default] = default;
+		FrameBuffer defaultFramebuffer = { m_Window->GetDefaultFramebuffer(), 0, IMAGE_CLEARCOLOR, clearFlags };
+		m_Framebuffers[FB_Default] = defaultFramebuffer;
 
 		//Normal Framebuffer
 		FrameBuffer normal;
@@ -400,6 +583,21 @@ namespace Copperplate {
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 		m_Framebuffers[FB_ShadingGradient] = shadingGradient;
+
+		// the depth renderbuffers are only referenced by their framebuffers
+		int64_t textureBytes = 0;
+		int64_t renderbufferBytes = 0;
+		for (auto& [type, framebuffer] : m_Framebuffers) {
+			if (type == FB_Default) continue;
+			textureBytes += getGLTextureBytes(framebuffer.m_Texture);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.m_FBO);
+			int renderbuffer = 0;
+			glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &renderbuffer);
+			if (renderbuffer != 0) renderbufferBytes += getGLRenderbufferBytes(renderbuffer);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		m_TextureMemory.Set(textureBytes);
+		m_RenderbufferMemory.Set(renderbufferBytes);
 	}
 
 	void Renderer::SwitchFrameBuffer(EFramebuffers framebuffer, bool clear)
@@ -427,12 +625,37 @@ namespace Copperplate {
 
 	void Renderer::SaveCurrFramebufferContent(const std::string& path) {
 		const glm::ivec2 size = glm::ivec2(m_Window->GetWidth(), m_Window->GetHeight());
-		unsigned char* buffer{ new unsigned char[size.x * size.y * 3] };
-		glCheckError();
-		glReadPixels(0, 0, size.x, size.y, GL_RGB, GL_UNSIGNED_BYTE, buffer);
+		GetFrameWriter().ReadFramebuffer(size, path);
+	}
+
+	bool Renderer::StartVideo(const std::string& path, EFrameFormats format, int framesPerSecond) {
+		const glm::ivec2 size = glm::ivec2(m_Window->GetWidth(), m_Window->GetHeight());
+		return GetFrameWriter().OpenStream(path, format, size, framesPerSecond);
+	}
+
+	void Renderer::SaveVideoFrame() {
+		const glm::ivec2 size = glm::ivec2(m_Window->GetWidth(), m_Window->GetHeight());
+		GetFrameWriter().ReadFramebuffer(size, "");
+	}
+
+	void Renderer::FinishSaving() {
+		if (m_FrameWriter)
+			m_FrameWriter->Flush();
+	}
+
+	void Renderer::ReadFramebufferContent(glm::ivec2 origin, glm::ivec2 size, std::vector<unsigned char>& outPixels) {
+		TIME_FUNCTION(T_SaveFrame);
+		outPixels.resize((size_t)size.x * size.y * 3);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(origin.x, origin.y, size.x, size.y, GL_RGB, GL_UNSIGNED_BYTE, outPixels.data());
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
 		glCheckError();
-		writePngImage(path, size, buffer, 3);
-		delete[] buffer;
+	}
+
+	FrameWriter& Renderer::GetFrameWriter() {
+		if (!m_FrameWriter)
+			m_FrameWriter = CreateUnique<FrameWriter>(DisplaySettings::RecordThreads);
+		return *m_FrameWriter;
 	}
 
 	void Renderer::DrawTexFullscreen(unsigned int texture) {
@@ -441,6 +664,27 @@ namespace Copperplate {
 		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 	}
 
+	unsigned int loadTextureFile(const std::string& path, int& widthOut, int& heightOut, int& nrChannelsOut) {
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		unsigned char* imageData = stbi_load(path.c_str(), &widthOut, &heightOut, &nrChannelsOut, 0);
+		if (imageData) {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, widthOut, heightOut, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+		else {
+			std::cout << "Loading Texture " << path << "failed!" << std::endl;
+		}
+		stbi_image_free(imageData);
+		return texture;
+	}
+
 	// GLFW Callback Functions
 	void GlfwErrorCallback(int error, const char* description) {
 		std::cerr << "GLFW Error:" << error << description;
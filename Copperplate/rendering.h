@@ -1,9 +1,16 @@
 #pragma once
 
-#include "core.h"
+#include "framewriter.h"
+#include "gldebug.h"
+#include "hatchingsettings.h"
+#include "statistics.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#ifdef COPPERPLATE_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 #include <glm/ext/vector_float3.hpp>
 #include <glm/ext/matrix_float4x4.hpp>
 
@@ -13,18 +20,42 @@
 namespace Copperplate {	
 
 	// WINDOW CLASS
+	// Either a visible GLFW window or, in headless mode, a surfaceless EGL context rendering into an offscreen framebuffer
 	class Window {
 	public:
-		Window();
+		Window(bool headless, int width, int height);
 		~Window();
 
+		void PollEvents();
 		void SwapBuffers();
+		void SetVSync(bool enabled);
+
+		bool IsValid();
+		bool IsHeadless();
 
 		int GetWidth();
 		int GetHeight();
+		unsigned int GetDefaultFramebuffer();
 				
 	private:
+		bool CreateGlfwWindow(int width, int height);
+		bool CreateHeadlessContext(int width, int height);
+
+		bool m_Valid;
+		bool m_Headless;
 		GLFWwindow* m_Window;
+
+		// Headless mode only
+		int m_Width;
+		int m_Height;
+		unsigned int m_OffscreenFBO;
+		unsigned int m_OffscreenColor;
+		unsigned int m_OffscreenDepth;
+		MemoryCounter m_OffscreenMemory;
+#ifdef COPPERPLATE_HEADLESS
+		EGLDisplay m_Display;
+		EGLContext m_Context;
+#endif
 	};
 
 	// CAMERA CLASS
@@ -37,6 +68,8 @@ namespace Copperplate {
 		void SetPosition(float azimuth, float height, float zoom);
 		void Move(float addAzimuth, float addHeight, float addZoom);
 		void SetViewportSize(int width, int height);
+		// Narrows the projection of the whole image to the given pixel rectangle, which can reach outside the image
+		void SetTile(glm::ivec2 imageSize, glm::ivec2 origin, glm::ivec2 size);
 
 		glm::mat4 GetViewMatrix();		
 		glm::mat4 GetProjectionMatrix();
@@ -86,7 +119,14 @@ namespace Copperplate {
 
 		void DrawFramebufferContent(EFramebuffers framebuffer);
 
+		// Asynchronous, the png is written a few frames later by the frame writer threads
 		void SaveCurrFramebufferContent(const std::string& path);
+		bool StartVideo(const std::string& path, EFrameFormats format, int framesPerSecond);
+		void SaveVideoFrame();
+		// Blocks until all saved frames are on disk
+		void FinishSaving();
+		// Synchronous, tightly packed RGB rows starting at the bottom
+		void ReadFramebufferContent(glm::ivec2 origin, glm::ivec2 size, std::vector<unsigned char>& outPixels);
 		
 		void DrawTexFullscreen(unsigned int texture);
 
@@ -98,15 +138,13 @@ namespace Copperplate {
 
 		unsigned int m_ScreenQuadVAO;
 
-	};
+		// created on first use, so only sessions that save frames start the encoder threads
+		FrameWriter& GetFrameWriter();
+		Unique<FrameWriter> m_FrameWriter;
 
-	enum EHatchingDirections {
-		HD_LargestCurvature,
-		HD_SmallestCurvature,
-		HD_Normal,
-		HD_Tangent,
-		HD_ShadeGradient,
-		HD_ShadeNormal,
+		MemoryCounter m_BufferMemory;
+		MemoryCounter m_TextureMemory;
+		MemoryCounter m_RenderbufferMemory;
 	};
 
 	//DISPLAY SETTINGS CLASS
@@ -116,18 +154,23 @@ namespace Copperplate {
 		static bool RenderScreenSpaceSeeds;
 		static bool RenderContours;
 		static bool RenderHatching;
-		static bool RegenerateHatching;
 		static bool RenderHatchingCollision;
 		static bool RenderCurrentDebug;
-		static int NumHatchingLines;
-		static int NumPointsPerHatch;
 		static EHatchingDirections HatchingDirection;
 		static EFramebuffers FramebufferToDisplay;
+		static bool RenderCostHeatmap;
+		static EHatchingCosts CostHeatmapType;
+		static bool RecordCostHeatmap;
+		static bool RenderHud;
 		static bool RecordScreenShot;
 		static bool RecordVideo;
 		static int RecordFrameCount;
+		static int RecordThreads;	//encoder threads of the frame writer, 0 picks a count from the cores
+		static float LodPixelError;	//largest error of a simplified mesh on screen, 0 always draws the full resolution
 	};
 
+	unsigned int loadTextureFile(const std::string& path, int& widthOut, int& heightOut, int& nrChannelsOut);
+
 	// Callback Functions for the window
 	void GlfwErrorCallback(int error, const char* description);
 
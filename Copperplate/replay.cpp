@@ -0,0 +1,168 @@
+#pragma once
+
+#include "hatchingcapture.h"
+#include "statistics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace Copperplate;
+
+// Feeds a capture written with --capture into the stroke simulation as fast as possible and reports
+// the time spent in every stage. Needs no GL context, so it can run under perf or valgrind.
+
+void printUsage() {
+	std::cout << "Usage: CopperplateReplay <capture> [options]" << std::endl
+		<< "  --repeat <n>    replay the capture n times, default 1" << std::endl
+		<< "  --frames <n>    only replay the first n frames" << std::endl
+		<< "  --csv <file>    write the timings of every frame to file" << std::endl
+		<< "  --trace <file>  write the timed scopes of every frame as chrome trace json" << std::endl
+		<< "  --perf-counters count cycles, instructions and cache/branch misses per stage (Linux)" << std::endl
+		<< "  --histograms <file>  write p50/p95/p99/max of every stage, compare dumps with Copperplate --compare" << std::endl
+		<< "  --heatmaps <dir>     save where the hatching spent its work in every frame of the first run as png" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		printUsage();
+		return 1;
+	}
+	std::string capturePath = argv[1];
+	int repeat = 1;
+	int maxFrames = -1;
+	std::string csvPath;
+	std::string histogramPath;
+	std::string heatmapDir;
+	for (int i = 2; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if (arg == "--repeat" && hasValue) {
+			repeat = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "--frames" && hasValue) {
+			maxFrames = std::atoi(argv[++i]);
+		}
+		else if (arg == "--csv" && hasValue) {
+			csvPath = argv[++i];
+		}
+		else if (arg == "--perf-counters") {
+			Statistics::Get().enablePerfCounters();
+		}
+		else if (arg == "--histograms" && hasValue) {
+			histogramPath = argv[++i];
+		}
+		else if (arg == "--heatmaps" && hasValue) {
+			heatmapDir = argv[++i];
+		}
+		else if (arg == "--trace" && hasValue) {
+			if (!Statistics::Get().startTrace(argv[++i]))
+				return 1;
+		}
+		else {
+			printUsage();
+			return 1;
+		}
+	}
+
+	std::ofstream csv;
+	if (!csvPath.empty()) {
+		csv.open(csvPath);
+		csv << "run,frame,hatchingTime";
+		for (const StatFrameField& field : getStatFrameFields()) {
+			csv << "," << field.m_Name;
+		}
+		csv << "\n";
+	}
+	if (!heatmapDir.empty()) {
+		std::error_code error;
+		std::filesystem::create_directories(heatmapDir, error);
+		if (error) {
+			std::cout << "Could not create heatmap directory " << heatmapDir << ": " << error.message() << std::endl;
+			return 1;
+		}
+	}
+
+	// hatching time measured around CreateHatchingLines, followed by all StatFrame fields
+	std::vector<std::vector<float>> samples;
+	for (int run = 0; run < repeat; run++) {
+		HatchingCaptureReader reader;
+		if (!reader.Open(capturePath))
+			return 1;
+		Unique<Hatching> hatching = reader.CreateHatching();
+		bool saveHeatmaps = !heatmapDir.empty() && run == 0;
+		hatching->SetCostRecording(saveHeatmaps);
+
+		Statistics::Get().newFrame(false);
+		for (int frame = 0; maxFrames < 0 || frame < maxFrames; frame++) {
+			if (!reader.ReadFrame())
+				break;
+			reader.ApplyFrame(*hatching);
+
+			auto start = std::chrono::steady_clock::now();
+			hatching->CreateHatchingLines();
+			float hatchingTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+			if (saveHeatmaps) {
+				std::ostringstream path;
+				path << heatmapDir << "/heatmap" << std::setfill('0') << std::setw(5) << frame << ".png";
+				hatching->SaveCostHeatmap(path.str(), HC_NumCosts);
+			}
+
+			Statistics::Get().newFrame();
+			StatFrame stats = Statistics::Get().getLastFrame();
+			std::vector<float> sample = { hatchingTime };
+			for (const StatFrameField& field : getStatFrameFields()) {
+				sample.push_back(field.GetValue(stats));
+			}
+			if (csv.is_open()) {
+				csv << run << "," << frame;
+				for (float value : sample) {
+					csv << "," << value;
+				}
+				csv << "\n";
+			}
+			samples.push_back(sample);
+		}
+	}
+
+	Statistics::Get().stopTrace();
+
+	if (samples.empty()) {
+		std::cout << "Capture " << capturePath << " contains no frames" << std::endl;
+		return 1;
+	}
+
+	// Summary over all replayed frames
+	std::vector<const char*> names = { "hatchingTime" };
+	for (const StatFrameField& field : getStatFrameFields()) {
+		names.push_back(field.m_Name);
+	}
+	std::cout << "Replayed " << samples.size() << " frames of " << capturePath << std::endl;
+	std::cout << std::left << std::setw(20) << "stage" << std::right << std::setw(12) << "mean" << std::setw(12) << "min" << std::setw(12) << "max" << std::endl;
+	for (int i = 0; i < names.size(); i++) {
+		float sum = 0.0f;
+		float min = samples[0][i];
+		float max = samples[0][i];
+		for (const std::vector<float>& sample : samples) {
+			sum += sample[i];
+			min = std::min(min, sample[i]);
+			max = std::max(max, sample[i]);
+		}
+		std::cout << std::left << std::setw(20) << names[i] << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(12) << sum / samples.size() << std::setw(12) << min << std::setw(12) << max << std::endl;
+	}
+	if (!histogramPath.empty()) {
+		Statistics::Get().printPercentiles();
+		if (!Statistics::Get().writeHistograms(histogramPath))
+			return 1;
+	}
+	else {
+		Statistics::Get().printAllocations();
+		Statistics::Get().printMemory();
+		Statistics::Get().printPerfCounters();
+	}
+	return 0;
+}
\ No newline at end of file
@@ -4,7 +4,7 @@
 #include "core.h"
 #include "utility.h"
 #include "statistics.h"
-#include <glm\gtx\transform.hpp>
+#include <glm/gtx/transform.hpp>
 
 namespace Copperplate {
 
@@ -19,98 +19,69 @@ namespace Copperplate {
 	};
 
 	//SCENEOBJECT IMPLEMENTATION
-	SceneObject::SceneObject(std::string meshFile, Shared<Shader> shader, int id, Shared<SceneObject> parent, Shared<Hatching> hatching) {
-		m_Mesh = MeshCreator::ImportMesh(meshFile);
+	SceneObject::SceneObject(Shared<Mesh> mesh, glm::mat4 nodeTransform, Shared<Shader> shader, int id, Shared<SceneObject> parent, Shared<Hatching> hatching)
+		: m_ContourMemory(MC_Contours)
+		, m_BufferMemory(MC_GLBuffers)
+		, m_ContourBufferMemory(MC_GLBuffers) {
+		m_Mesh = mesh;
 		m_Shader = shader;
 		m_Id = id;
 		m_Hatching = hatching;
 		m_Parent = parent;
+		m_Lod = 0;
+		m_SeedDepthBias = SEED_DEPTH_BIAS;
 		m_LocalTransform = glm::mat4(1.0f);
+		m_NodeTransform = nodeTransform;
 		if (m_Parent)
 			m_Transform = m_Parent->getTransform();
 		else
 			m_Transform = glm::mat4(1.0f);
 		m_PrevTransform = m_Transform;
-
-		//Create Seed Points for Hatching Strokes
-		m_SeedPoints = std::vector<SeedPoint>();
-		m_SeedPoints.reserve(SEEDS_PER_OBJECT);
-		m_Hatching->CreateSeedPoints(m_SeedPoints, *m_Mesh, m_Id, SEEDS_PER_OBJECT);
-
 		m_ContourSegments = std::vector<glm::vec2>();
-		m_ContourSegments.reserve(m_Mesh->GetFaces().size() * 3 * 2);
-
-		std::vector<float> seedsData;
-		seedsData.reserve(8 * m_SeedPoints.size());
-		for (SeedPoint sp : m_SeedPoints) {
-			seedsData.push_back(sp.m_Pos.x);
-			seedsData.push_back(sp.m_Pos.y);
-			seedsData.push_back(sp.m_Pos.z);
-			seedsData.push_back(1.0f);	//padding
-			seedsData.push_back(sp.m_Importance);
-			seedsData.push_back(sp.m_Id);
-			seedsData.push_back(1.0f);	//padding
-			seedsData.push_back(1.0f);	//padding
-		}
+		// objects without a mesh only pass their transform on to their children
+		if (!m_Mesh)
+			return;
 
-		//Setup OpenGL Buffers
-		//Seed Points
-		glGenVertexArrays(1, &m_SeedsVAO);
-		glGenBuffers(1, &m_SeedsVertexBuffer);
+		//Seed Points for Hatching Strokes, shared with all objects placing the same mesh
+		m_Hatching->AddSeedPoints(m_Mesh->GetSeedPoints(), m_Id);
 
-		glBindVertexArray(m_SeedsVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_SeedsVertexBuffer);
-		glBufferData(GL_ARRAY_BUFFER, seedsData.size() * sizeof(float), seedsData.data(), GL_STATIC_DRAW);
-
-		int stride = 8 * sizeof(float);
-
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(4 * sizeof(float)));
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(5 * sizeof(float)));
-		glEnableVertexAttribArray(0);
-
-		glCheckError();
+		m_ContourSegments.reserve(m_Mesh->GetHalfEdgeMesh().GetNumFaces() * 3 * 2);
 
 		//SSBO for Compute Shader output
-		int numOutputs = (((m_SeedPoints.size() - 1) / COMPUTE_GROUPSIZE) + 1) * COMPUTE_GROUPSIZE;
+		int numOutputs = (((m_Mesh->GetSeedPoints().size() - 1) / COMPUTE_GROUPSIZE) + 1) * COMPUTE_GROUPSIZE;
 		
 		glGenBuffers(1, &m_SeedsSSBO);
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SeedsSSBO);
 		glBufferData(GL_SHADER_STORAGE_BUFFER, numOutputs * sizeof(struct OutputSeed), NULL, GL_DYNAMIC_READ);
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-		
-		//Transform Feedback Buffer for Contour Segments
-		m_Mesh->Bind();
-		glGenBuffers(1, &m_ContoursFeedbackBuffer);
-		glBindBuffer(GL_ARRAY_BUFFER, m_ContoursFeedbackBuffer);
-		glBufferData(GL_ARRAY_BUFFER, m_Mesh->GetFaces().size() * 3 * 2 * 2 * sizeof(float), nullptr, GL_DYNAMIC_READ);
 
 		glCheckError();
 
-		//Contour Vertex Data
+		//Contour Vertex Data, sized to the extracted segments when they are drawn
 		glGenVertexArrays(1, &m_ContoursVAO);
 		glGenBuffers(1, &m_ContoursVBO);
 
 		glBindVertexArray(m_ContoursVAO);
 		glBindBuffer(GL_ARRAY_BUFFER, m_ContoursVBO);
-		glBufferData(GL_ARRAY_BUFFER, m_Mesh->GetFaces().size() * 3 * 2 * 2 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
 
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (GLvoid*)0);
 
 		glCheckError();
+
+		m_ContourMemory.Set(estimateVectorBytes(m_ContourSegments));
+		m_BufferMemory.Set(numOutputs * sizeof(struct OutputSeed));
 	}
 
 	void SceneObject::Draw() {
+		if (!m_Mesh)
+			return;
 		m_Shader->SetMat4("model", m_Transform);
 		m_Shader->SetMat4("modelInvTrans", glm::transpose(glm::inverse(m_Transform)));
 		m_Shader->SetMat4("prevModel", m_PrevTransform);
 		glCheckError();
 		m_Shader->Use();
-		m_Mesh->Draw();
+		m_Mesh->Draw(m_Lod);
 	}
 
 	void SceneObject::Update() {
@@ -119,9 +90,46 @@ namespace Copperplate {
 			m_Transform = m_LocalTransform * m_Parent->getTransform();
 		else
 			m_Transform = m_LocalTransform;
+		m_Transform = m_Transform * m_NodeTransform;
+	}
+
+	void SceneObject::SelectLod(const glm::mat4& view, const glm::mat4& projection, float viewportHeight) {
+		m_Lod = 0;
+		m_SeedDepthBias = SEED_DEPTH_BIAS;
+		if (!m_Mesh || m_Mesh->GetNumLods() == 1 || DisplaySettings::LodPixelError <= 0.0f)
+			return;
+
+		// the nearest point of the bounding sphere sets the size on screen
+		glm::mat4 modelView = view * m_Transform;
+		float scale = std::max(glm::length(glm::vec3(modelView[0])), std::max(glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2]))));
+		glm::vec4 center = modelView * glm::vec4(m_Mesh->GetBoundsCenter(), 1.0f);
+		float distance = -center.z - scale * m_Mesh->GetBoundsRadius();
+		if (distance <= Z_MIN)
+			return;
+		float pixelsPerUnit = projection[1][1] * 0.5f * viewportHeight / distance;
+
+		for (int lod = m_Mesh->GetNumLods() - 1; lod > 0; lod--) {
+			float error = scale * m_Mesh->GetLodError(lod);
+			if (error * pixelsPerUnit > DisplaySettings::LodPixelError)
+				continue;
+			// the depth test of the seeds has to reach through the distance between the levels
+			auto depth = [&](float z) {
+				glm::vec4 clip = projection * glm::vec4(0.0f, 0.0f, -z, 1.0f);
+				return (clip.z / clip.w) * 0.5f + 0.5f;
+			};
+			m_Lod = lod;
+			m_SeedDepthBias = SEED_DEPTH_BIAS + std::max(0.0f, depth(distance) - depth(std::max(Z_MIN, distance - error)));
+			return;
+		}
+	}
+
+	int SceneObject::GetLod() {
+		return m_Lod;
 	}
 
 	void SceneObject::ExtractContours() {
+		if (!m_Mesh)
+			return;
 		unsigned int query;
 		glGenQueries(1, &query);
 		m_Shader->SetMat4("model", m_Transform);
@@ -129,11 +137,11 @@ namespace Copperplate {
 		glCheckError();
 		m_Shader->Use();
 
-		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_ContoursFeedbackBuffer);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_Mesh->GetContourFeedbackBuffer());
 		glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, query);
 		glBeginTransformFeedback(GL_LINES);
 		glCheckError();
-		m_Mesh->Draw();
+		m_Mesh->Draw(m_Lod);
 		glEndTransformFeedback();
 		glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
 		glFlush();
@@ -151,6 +159,7 @@ namespace Copperplate {
 			m_ContourSegments.push_back(feedback[2 * i]);
 			m_ContourSegments.push_back(feedback[2 * i + 1]);
 		}
+		m_ContourMemory.Set(estimateVectorBytes(m_ContourSegments));
 
 		m_Hatching->AddContourCollision(m_ContourSegments);
 		
@@ -158,10 +167,13 @@ namespace Copperplate {
 	}
 
 	void SceneObject::DrawContours() {
+		if (!m_Mesh)
+			return;
 		m_Shader->Use();
 		glBindVertexArray(m_ContoursVAO);
 		glBindBuffer(GL_ARRAY_BUFFER, m_ContoursVBO);
 		glBufferData(GL_ARRAY_BUFFER, m_ContourSegments.size() * 2 * sizeof(float), m_ContourSegments.data(), GL_DYNAMIC_DRAW);
+		m_ContourBufferMemory.Set(m_ContourSegments.size() * 2 * sizeof(float));
 		glDrawArrays(GL_LINES, 0, m_ContourSegments.size());
 	}
 
@@ -170,25 +182,30 @@ namespace Copperplate {
 	}
 
 	void SceneObject::DrawSeedPoints() {
+		if (!m_Mesh)
+			return;
 		m_Shader->SetMat4("model", m_Transform);
 		glCheckError();
 		m_Shader->Use();
-		glBindVertexArray(m_SeedsVAO);
-		glDrawArrays(GL_POINTS, 0, m_SeedPoints.size());
+		m_Mesh->DrawSeedPoints();
 	}
 
 	void SceneObject::TransformSeedPoints(Shared<ComputeShader> shader) {		
+		if (!m_Mesh)
+			return;
+		int numSeeds = m_Mesh->GetSeedPoints().size();
 		shader->SetMat4("model", m_Transform);
-		shader->SetFloat("numSeeds", (float)m_SeedPoints.size());
+		shader->SetFloat("numSeeds", (float)numSeeds);
+		shader->SetFloat("depthBias", m_SeedDepthBias);
 		shader->UpdateUniforms();
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_SeedsVertexBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_Mesh->GetSeedBuffer());
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_SeedsSSBO);
 
-		int numGroups = ((m_SeedPoints.size() - 1) / COMPUTE_GROUPSIZE) + 1;
+		int numGroups = ((numSeeds - 1) / COMPUTE_GROUPSIZE) + 1;
 		shader->Dispatch(numGroups, 1, 1);
 		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-		int numOutputs = m_SeedPoints.size();
+		int numOutputs = numSeeds;
 		OutputSeed* outputs{ new OutputSeed[numOutputs]{} };
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SeedsSSBO);
 		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, numOutputs * sizeof(struct OutputSeed), outputs);
@@ -232,56 +249,42 @@ namespace Copperplate {
 	}
 		
 	//SCENE IMPLEMENTATION
-	Scene::Scene(Shared<Window> window) {
+	Scene::Scene(Shared<Window> window, const SceneDescription& description)
+		: m_DebugTextureMemory(MC_GLTextures) {
 		m_Camera = CreateUnique<Camera>(window->GetWidth(), window->GetHeight());
+		m_Camera->SetPosition(description.m_Camera.m_Azimuth, description.m_Camera.m_Height, description.m_Camera.m_Zoom);
+		m_Camera->Update();
 		m_Renderer = CreateUnique<Renderer>(window);
 		m_Hatching = CreateShared<Hatching>(window->GetWidth(), window->GetHeight());
-		m_LightDir = glm::normalize(glm::vec3(-1.0f, -1.0f, 0.0f));
+		m_Hatching->SetRandomSeed(description.m_RandomSeed);
+		m_HatchingRenderer = CreateUnique<HatchingRenderer>(m_Hatching);
+		m_GpuTimer = CreateUnique<GpuTimer>();
+		m_Hud = CreateUnique<PerformanceHud>();
+		m_RecordCosts = false;
+		m_PaperRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		m_LightDir = glm::normalize(description.m_LightDirection);
 
 		//Setup the shaders
 		m_Shaders = std::map<EShaders, Shared<Shader>>();
 		m_ComputeShaders = std::map<EShaders, Shared<ComputeShader>>();
 		CreateShaders();
 		
-		//Create the Scene Objects
-		int numObjects = 1;
+		//Start loading the meshes, the objects join the scene as their files become ready. The seeds of a file
+		//are keyed by the first object placing it, which is also the id of that object in single mesh scenes.
+		m_MeshLibrary = CreateUnique<MeshLibrary>(m_Hatching, SEEDS_PER_OBJECT, MeshLibrary::LoaderThreads);
 		m_SceneObjects = std::vector<Shared<SceneObject>>();
-		//Full Scene Version
-		/*
-		m_SceneObjects.push_back(CreateShared<SceneObject>("Plane.obj", m_Shaders[SH_Contours], numObjects, nullptr, m_Hatching));
-		m_SceneObjects.back()->Move(glm::vec3(0.0f, -0.5f, -4.0f));
-		numObjects++;
-		m_SceneObjects.push_back(CreateShared<SceneObject>("BunnySmoothed.obj", m_Shaders[SH_Contours], numObjects, nullptr, m_Hatching));
-		m_SceneObjects.back()->Move(glm::vec3(-1.0f, 0.0f, 0.0f));
-		numObjects++;
-		m_SceneObjects.push_back(CreateShared<SceneObject>("Teapot.obj", m_Shaders[SH_Contours], numObjects, nullptr, m_Hatching));
-		m_SceneObjects.back()->Move(glm::vec3(1.0f, -0.5f, 0.3f));
-		numObjects++;
-		m_SceneObjects.push_back(CreateShared<SceneObject>("Blob.obj", m_Shaders[SH_Contours], numObjects, nullptr, m_Hatching));
-		m_SceneObjects.back()->Move(glm::vec3(0.0f, 0.3f, -2.0f));
-		numObjects++;*/
-		//Single Objects
-		//m_SceneObjects.push_back(CreateShared<SceneObject>("Blob.obj", m_Shaders[SH_Contours], numObjects, nullptr, m_Hatching));
-		//m_SceneObjects.push_back(CreateShared<SceneObject>("Sphere.obj", m_Shaders[SH_Contours], numObjects, nullptr, m_Hatching));
-		//m_SceneObjects.push_back(CreateShared<SceneObject>("Bunny.obj", m_Shaders[SH_Contours], numObjects, nullptr, m_Hatching));
-		//numObjects++;
-		//m_SceneObjects[0]->Move(glm::vec3(1.5f, 0.0f, 0.0f));
-		//m_SceneObjects.push_back(CreateShared<SceneObject>("BunnySmoothed.obj", m_Shaders[SH_Contours], numObjects, nullptr, m_Hatching));
-		//m_SceneObjects.push_back(CreateShared<SceneObject>("Teapot.obj", m_Shaders[SH_Contours], numObjects, nullptr, m_Hatching));
-		//m_SceneObjects.push_back(CreateShared<SceneObject>("Plane.obj", m_Shaders[SH_Contours], numObjects, nullptr, m_Hatching));
-		//m_SceneObjects[0]->Move(glm::vec3(0.0f, -0.5f, 0.0f));
-		//m_SceneObjects.push_back(CreateShared<SceneObject>("LucyRotSub.obj", m_Shaders[SH_Contours], numObjects, nullptr, m_Hatching));
-		//numObjects++;
-		//m_SceneObjects.push_back(CreateShared<SceneObject>("SuzanneSubdiv.obj", m_Shaders[SH_Contours], numObjects, m_SceneObjects[0], m_Hatching));
-		//m_SceneObjects[1]->Move(glm::vec3(0.0f, 1.0f, 0.0f));
-		m_SceneObjects.push_back(CreateShared<SceneObject>("dragon.obj", m_Shaders[SH_Contours], numObjects, nullptr, m_Hatching));
-		m_SceneObjects[0]->Move(glm::vec3(0.0f, 0.1f, 0.0f));
-		numObjects++;
+		m_ObjectDescriptions = description.m_Objects;
+		m_Instances = std::vector<Shared<SceneObject>>(m_ObjectDescriptions.size());
+		m_LoadStart = std::chrono::steady_clock::now();
+		for (int i = 0; i < m_ObjectDescriptions.size(); i++) {
+			m_MeshLibrary->Request(m_ObjectDescriptions[i].m_MeshFile, i + 1);
+		}
+		PopulateObjects();
 		
-
 		//Load debug texture
 		int width, height, channels;
 		m_DebugTexture = loadTextureFile("Paper.png", width, height, channels);
+		m_DebugTextureMemory.Set(getGLTextureBytes(m_DebugTexture));
 
 	}
 
@@ -293,6 +296,10 @@ namespace Copperplate {
 	}
 
 	void Scene::Draw() {
+		TIME_SCOPE("Scene::Draw");
+		if (IsLoading())
+			PopulateObjects();
+
 		// Update Scene Objects
 		for (auto& object : m_SceneObjects) {
 			object->Update();
@@ -301,54 +308,77 @@ namespace Copperplate {
 		//Update Shader Uniforms
 		UpdateUniforms();
 		m_Camera->Update();
+		for (auto& object : m_SceneObjects) {
+			object->SelectLod(m_Camera->GetViewMatrix(), m_Camera->GetProjectionMatrix(), m_Hatching->GetViewportSize().y);
+		}
 
 		//Reset Hatching
 		m_Hatching->ResetCollisions();
 
+		m_GpuTimer->Collect();
+		m_GpuTimer->BeginFrame();
+
 		//Fill Framebuffers
 		//Normals
 		m_Renderer->SwitchFrameBuffer(FB_Normals, true);
 		glCheckError();
+		m_GpuTimer->Begin(GT_Normals);
 		for (auto& object : m_SceneObjects) {
 			DrawObject(object, SH_Normals);
 		}
-		m_Hatching->GrabNormalData();
+		m_GpuTimer->End(GT_Normals);
+		m_HatchingRenderer->GrabField(HF_Normals);
 		//if(DisplaySettings::RenderCurrentDebug)
 		//	DrawFullScreen(SH_SphereNormals, FB_Default); 
 
 		//Depth
 		m_Renderer->SwitchFrameBuffer(FB_Depth, true); 
 		glCheckError();
+		m_GpuTimer->Begin(GT_Depth);
 		for (auto& object : m_SceneObjects) {
 			DrawObject(object, SH_Depth);
 		}
+		m_GpuTimer->End(GT_Depth);
 
 		//Movement
 		m_Renderer->SwitchFrameBuffer(FB_Movement, true);
 		glCheckError();
+		m_GpuTimer->Begin(GT_Movement);
 		for (auto& object : m_SceneObjects) {
 			DrawObject(object, SH_Movement);
 		}
-		m_Hatching->GrabMovementData();
+		m_GpuTimer->End(GT_Movement);
+		m_HatchingRenderer->GrabField(HF_Movement);
 
 		//Curvature
 		m_Renderer->SwitchFrameBuffer(FB_Curvature, true);
 		glCheckError();
+		m_GpuTimer->Begin(GT_Curvature);
 		DrawFullScreen(SH_Curvature, FB_Normals);
-		m_Hatching->GrabCurvatureData();
+		m_GpuTimer->End(GT_Curvature);
+		m_HatchingRenderer->GrabField(HF_Curvature);
 
 		//Diffuse Shading
 		m_Renderer->SwitchFrameBuffer(FB_Diffuse, true);
 		glCheckError();
+		m_GpuTimer->Begin(GT_Diffuse);
 		for (auto& object : m_SceneObjects) {
 			DrawObject(object, SH_Diffuse);
 		}
+		m_GpuTimer->End(GT_Diffuse);
 		
 		//Shading Gradient
 		m_Renderer->SwitchFrameBuffer(FB_ShadingGradient, true);
 		glCheckError();
+		m_GpuTimer->Begin(GT_ShadingGradient);
 		DrawFullScreen(SH_ShadingGradient, FB_Diffuse);
-		m_Hatching->GrabGradientData();
+		m_GpuTimer->End(GT_ShadingGradient);
+		m_HatchingRenderer->GrabField(HF_ShadingGradient);
+		// vector exports derive the line widths on the CPU
+		if (m_VectorWriter) {
+			m_Renderer->SwitchFrameBuffer(FB_Diffuse, false);
+			m_HatchingRenderer->GrabField(HF_Shading);
+		}
 
 		//DEBUG
 		//m_Renderer->SwitchFrameBuffer(FB_Diffuse, true);
@@ -359,33 +389,71 @@ namespace Copperplate {
 		//Draw the Objects
 		m_Renderer->SwitchFrameBuffer(FB_Default, true);
 		glCheckError();
+		m_Shaders[SH_DisplayTex]->SetVec4("texRect", m_PaperRect);
 		m_Shaders[SH_DisplayTex]->Use();
 		glDisable(GL_DEPTH_TEST);
 		m_Renderer->DrawTexFullscreen(m_DebugTexture);
+		m_Shaders[SH_DisplayTex]->SetVec4("texRect", glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
 		for (auto& object : m_SceneObjects) {			
 			//DrawFlatColor(object, glm::vec3(1.0f));
+			m_GpuTimer->Begin(GT_ExtractContours);
 			ExtractContours(object);
+			m_GpuTimer->End(GT_ExtractContours);
+			m_GpuTimer->Begin(GT_TransformSeeds);
 			TransformSeedPoints(object);
+			m_GpuTimer->End(GT_TransformSeeds);
+			if (m_Capture)
+				m_Capture->AddContours(object->GetContourSegments());
+			if (m_VectorWriter && DisplaySettings::RenderContours)
+				m_VectorWriter->AddContours(object->GetContourSegments());
 			if (DisplaySettings::RenderContours) 
 				DrawContours(object, glm::vec3(0.0f));
 			if (DisplaySettings::RenderSeedPoints) 
 				DrawSeedPoints(object, glm::vec3(0.89f, 0.37f, 0.27f), 4.0f);
 		}
 
+		if (m_Capture) {
+			m_Capture->SetCamera(m_Camera->GetViewMatrix(), m_Camera->GetProjectionMatrix());
+			m_Capture->WriteFrame(*m_Hatching);
+		}
+		m_Hatching->SetCostRecording(m_RecordCosts || DisplaySettings::RenderCostHeatmap || DisplaySettings::RecordCostHeatmap);
 		m_Hatching->CreateHatchingLines();
+		m_HatchingRenderer->UpdateBuffers();
+		if (m_VectorWriter)
+			m_VectorWriter->WriteFrame(*m_Hatching);
+		if (m_StrokeWriter)
+			m_StrokeWriter->WriteFrame(*m_Hatching);
 
 		if (DisplaySettings::RenderScreenSpaceSeeds)
 			DrawScreenSeeds(glm::vec3(0.13f, 0.67f, 0.27f), 4.0f);
-		if (DisplaySettings::RenderHatching)
+		if (DisplaySettings::RenderHatching) {
 			//DrawHatchingLines(SH_HatchingLines, glm::vec3(0.16f, 0.37f, 0.74f));
 			//glLineWidth(2.0f);
 			//DrawHatching(SH_HatchingLines, glm::vec3(0.8f, 0.4f, 0.2f));
+			m_GpuTimer->Begin(GT_DrawHatching);
 			DrawHatching(SH_Hatching, glm::vec3(0.0f));
+			m_GpuTimer->End(GT_DrawHatching);
+		}
 		if (DisplaySettings::RenderHatchingCollision)
 			DrawHatchingCollision(glm::vec3(0.9f, 0.3f, 0.7f), 3.0f);
 		
 		if (DisplaySettings::FramebufferToDisplay != EFramebuffers::FB_Default)
 			DrawFramebufferContent(DisplaySettings::FramebufferToDisplay);
+		if (DisplaySettings::RenderCostHeatmap)
+			DrawCostHeatmap();
+		if (DisplaySettings::RenderHud) {
+			m_GpuTimer->Begin(GT_DrawHud);
+			glm::ivec2 viewportSize = glm::ivec2(m_Hatching->GetViewportSize());
+			m_Hud->Draw(m_Shaders[SH_Hud], viewportSize, m_HatchingRenderer->GetNumVisibleScreenSeeds(), (int)m_Hatching->GetScreenSeeds().size());
+			m_GpuTimer->End(GT_DrawHud);
+		}
+
+		if (DisplaySettings::RecordCostHeatmap) {
+			DisplaySettings::RecordCostHeatmap = false;
+			std::string path = SCREENSHOT_PATH + currTimeToString() + "_heatmap.png";
+			SaveCostHeatmap(path);
+			std::cout << "Saved Heatmap of " << getHatchingCostName(DisplaySettings::CostHeatmapType) << " " << path << std::endl;
+		}
 
 		if (DisplaySettings::RecordScreenShot) {
 			DisplaySettings::RecordScreenShot = false;			
@@ -407,10 +475,121 @@ namespace Copperplate {
 		m_Camera->Move(x, y, z);
 	}
 
+	void Scene::SetCameraPosition(CameraPosition position) {
+		m_Camera->SetPosition(position.m_Azimuth, position.m_Height, position.m_Zoom);
+	}
+
+	void Scene::FinishLoading() {
+		m_MeshLibrary->Finish();
+		PopulateObjects();
+	}
+
+	bool Scene::IsLoading() {
+		for (const Shared<SceneObject>& instance : m_Instances) {
+			if (!instance)
+				return true;
+		}
+		return false;
+	}
+
+	void Scene::SetObjectPose(int index, const ObjectPose& pose) {
+		// objects that did not join yet take the pose of the scene description when they do
+		if (index < 0 || index >= m_Instances.size() || !m_Instances[index]) return;
+		m_Instances[index]->SetRot(pose.m_RotationAxis, pose.m_RotationAngle);
+		m_Instances[index]->SetPos(pose.m_Position);
+	}
+
+	int Scene::GetNumObjects() {
+		return m_Instances.size();
+	}
+
+	bool Scene::StartCapture(const std::string& path) {
+		m_Capture = CreateUnique<HatchingCaptureWriter>();
+		if (!m_Capture->Open(path, *m_Hatching)) {
+			m_Capture = nullptr;
+			return false;
+		}
+		return true;
+	}
+
+	bool Scene::StartVectorExport(const std::string& path, float simplifyTolerance) {
+		m_VectorWriter = CreateUnique<VectorWriter>();
+		if (!m_VectorWriter->Open(path, glm::ivec2(m_Hatching->GetViewportSize()), simplifyTolerance)) {
+			m_VectorWriter = nullptr;
+			return false;
+		}
+		return true;
+	}
+
+	bool Scene::StartStrokeStream(const std::string& path, int keyframeInterval) {
+		m_StrokeWriter = CreateUnique<StrokeStreamWriter>();
+		if (!m_StrokeWriter->Open(path, *m_Hatching, keyframeInterval)) {
+			m_StrokeWriter = nullptr;
+			return false;
+		}
+		return true;
+	}
+
+	void Scene::EnableCostRecording() {
+		m_RecordCosts = true;
+	}
+
+	void Scene::SaveCostHeatmap(const std::string& path) {
+		m_Hatching->SaveCostHeatmap(path, DisplaySettings::CostHeatmapType);
+	}
+
+	void Scene::CollectGpuTimes() {
+		m_GpuTimer->Collect();
+	}
+
+	void Scene::SaveFrame(const std::string& path) {
+		m_Renderer->SwitchFrameBuffer(FB_Default, false);
+		m_Renderer->SaveCurrFramebufferContent(path);
+	}
+
+	bool Scene::StartVideo(const std::string& path, int framesPerSecond) {
+		bool isY4m = path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+		return m_Renderer->StartVideo(path, isY4m ? FF_Y4m : FF_Raw, framesPerSecond);
+	}
+
+	void Scene::SaveVideoFrame() {
+		m_Renderer->SwitchFrameBuffer(FB_Default, false);
+		m_Renderer->SaveVideoFrame();
+	}
+
+	void Scene::FinishSaving() {
+		m_Renderer->FinishSaving();
+		if (m_VectorWriter && !m_VectorWriter->Close())
+			std::cout << "Could not finish the vector export" << std::endl;
+		if (m_StrokeWriter) {
+			int frames = m_StrokeWriter->GetNumFrames();
+			int64_t bytes = m_StrokeWriter->GetNumBytes();
+			if (!m_StrokeWriter->Close())
+				std::cout << "Could not finish the stroke stream" << std::endl;
+			else
+				std::cout << "Wrote " << frames << " frames of strokes in " << bytes / 1024 << " KiB" << std::endl;
+		}
+	}
+
+	void Scene::ReadFrame(glm::ivec2 origin, glm::ivec2 size, std::vector<unsigned char>& outPixels) {
+		m_Renderer->SwitchFrameBuffer(FB_Default, false);
+		m_Renderer->ReadFramebufferContent(origin, size, outPixels);
+	}
+
 	void Scene::ViewportSizeChanged(int newWidth, int newHeight) {
 		m_Camera->SetViewportSize(newWidth, newHeight);
 	}
 
+	void Scene::SetTile(glm::ivec2 imageSize, glm::ivec2 origin, glm::ivec2 size) {
+		m_Camera->SetTile(imageSize, origin, size);
+		// the paper is stretched over the whole image like in a single render
+		m_PaperRect = glm::vec4(glm::vec2(origin) / glm::vec2(imageSize), glm::vec2(size) / glm::vec2(imageSize));
+	}
+
+	Hatching& Scene::GetHatching() {
+		return *m_Hatching;
+	}
+
 	void Scene::SetLayer1Direction(EHatchingDirections newDir) {
 		m_Hatching->SetLayer1Direction(newDir);
 	}
@@ -479,6 +658,9 @@ namespace Copperplate {
 
 		Shared<Shader> hatching = CreateShared<Shader>(ST_VertGeomFrag, "shaders/hatching.vert", "shaders/hatching.geom", "shaders/hatching.frag");
 		m_Shaders[SH_Hatching] = hatching;
+
+		Shared<Shader> hud = CreateShared<Shader>(ST_VertFrag, "shaders/hud.vert", nullptr, "shaders/hud.frag");
+		m_Shaders[SH_Hud] = hud;
 	}
 
 	void Scene::UpdateUniforms() {
@@ -516,6 +698,80 @@ namespace Copperplate {
 		glCheckError();
 	}
 
+	void Scene::PopulateObjects() {
+		if (!IsLoading())
+			return;
+		m_MeshLibrary->Update();
+		// in description order, so parents are always placed before their children
+		for (int i = 0; i < m_ObjectDescriptions.size(); i++) {
+			const SceneObjectDescription& objectDesc = m_ObjectDescriptions[i];
+			if (m_Instances[i] || m_MeshLibrary->IsLoading(objectDesc.m_MeshFile))
+				continue;
+			Shared<SceneObject> parent = nullptr;
+			if (objectDesc.m_Parent >= 0) {
+				parent = m_Instances[objectDesc.m_Parent];
+				if (!parent)
+					continue;
+			}
+			Shared<SceneObject> object = CreateInstance(objectDesc.m_MeshFile, parent);
+			object->SetRot(objectDesc.m_Pose.m_RotationAxis, objectDesc.m_Pose.m_RotationAngle);
+			object->SetPos(objectDesc.m_Pose.m_Position);
+			m_Instances[i] = object;
+		}
+
+		if (!IsLoading()) {
+			float loadTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - m_LoadStart).count();
+			std::cout << "Placed " << m_SceneObjects.size() << " objects from " << m_MeshLibrary->GetNumAssets() << " mesh files in " << loadTime << "s\n";
+		}
+	}
+
+	Shared<SceneObject> Scene::CreateInstance(const std::string& meshFile, Shared<SceneObject> parent) {
+		auto createObject = [this](Shared<Mesh> mesh, glm::mat4 nodeTransform, Shared<SceneObject> objectParent) {
+			int id = m_SceneObjects.size() + 1;
+			Shared<SceneObject> object = CreateShared<SceneObject>(mesh, nodeTransform, m_Shaders[SH_Contours], id, objectParent, m_Hatching);
+			m_SceneObjects.push_back(object);
+			return object;
+		};
+		Shared<MeshAsset> asset = m_MeshLibrary->Get(meshFile);
+		// a failed import leaves an empty object, so the object indices of the animation stay valid
+		if (!asset)
+			return createObject(nullptr, glm::mat4(1.0f), parent);
+
+		// Nodes without meshes get no object, their transform is folded into their children. The root always
+		// gets one to carry the pose of the scene description, unless the file places a single mesh.
+		const std::vector<MeshNode>& nodes = asset->m_Nodes;
+		bool singleMesh = asset->GetNumInstances() == 1;
+		std::vector<Shared<SceneObject>> nodeObjects(nodes.size());
+		std::vector<glm::mat4> foldedTransforms(nodes.size());
+		Shared<SceneObject> instance = nullptr;
+		for (int i = 0; i < nodes.size(); i++) {
+			const MeshNode& node = nodes[i];
+			Shared<SceneObject> nodeParent = parent;
+			glm::mat4 transform = node.m_Transform;
+			if (node.m_Parent >= 0) {
+				nodeParent = nodeObjects[node.m_Parent];
+				transform = foldedTransforms[node.m_Parent] * node.m_Transform;
+			}
+			if (node.m_Meshes.empty() && (i > 0 || singleMesh)) {
+				nodeObjects[i] = nodeParent;
+				foldedTransforms[i] = transform;
+				continue;
+			}
+
+			Shared<Mesh> firstMesh = node.m_Meshes.empty() ? nullptr : asset->m_Meshes[node.m_Meshes[0]];
+			Shared<SceneObject> object = createObject(firstMesh, transform, nodeParent);
+			// further meshes of the node follow the first one
+			for (int j = 1; j < node.m_Meshes.size(); j++) {
+				createObject(asset->m_Meshes[node.m_Meshes[j]], glm::mat4(1.0f), object);
+			}
+			nodeObjects[i] = object;
+			foldedTransforms[i] = glm::mat4(1.0f);
+			if (!instance)
+				instance = object;
+		}
+		return instance;
+	}
+
 	void Scene::DrawObject(const Shared<SceneObject>& object, EShaders shader) {
 		object->SetShader(m_Shaders[shader]);
 		glEnable(GL_DEPTH_TEST);
@@ -564,7 +820,7 @@ namespace Copperplate {
 		m_Shaders[SH_Screenpoints]->SetVec3("color", color);
 		m_Shaders[SH_Screenpoints]->Use();
 		glPointSize(pointSize);
-		m_Hatching->DrawScreenSeeds();
+		m_HatchingRenderer->DrawScreenSeeds();
 	}
 
 	void Scene::DrawFramebufferContent(EFramebuffers framebuffer) {
@@ -590,14 +846,24 @@ namespace Copperplate {
 		m_Shaders[shader]->Use();
 		glDisable(GL_DEPTH_TEST);
 		glLineWidth(2.0f);
-		m_Hatching->DrawHatchingLines(m_Shaders[shader]);
+		m_HatchingRenderer->DrawHatchingLines(m_Shaders[shader]);
+	}
+
+	void Scene::DrawCostHeatmap() {
+		m_HatchingRenderer->UpdateCostHeatmap(DisplaySettings::CostHeatmapType);
+		m_Shaders[SH_DisplayTex]->Use();
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		m_Renderer->DrawTexFullscreen(m_HatchingRenderer->GetCostHeatmapTexture());
+		glDisable(GL_BLEND);
 	}
 
 	void Scene::DrawHatchingCollision(glm::vec3 color, float pointSize) {
 		m_Shaders[SH_Screenpoints]->SetVec3("color", color);
 		m_Shaders[SH_Screenpoints]->Use();
 		glPointSize(pointSize);
-		m_Hatching->DrawCollisionPoints();
+		m_HatchingRenderer->DrawCollisionPoints();
 	}
 
 	void Scene::DrawHatching(EShaders shader, glm::vec3 color) {
@@ -605,6 +871,6 @@ namespace Copperplate {
 		m_Shaders[shader]->Use();
 		m_Renderer->UseFrameBufferTexture(EFramebuffers::FB_Diffuse);
 		glDisable(GL_DEPTH_TEST);
-		m_Hatching->DrawHatchingLines(m_Shaders[shader]);
+		m_HatchingRenderer->DrawHatchingLines(m_Shaders[shader]);
 	}
 }
\ No newline at end of file
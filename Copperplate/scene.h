@@ -1,10 +1,18 @@
 #pragma once
 
+#include "gputimer.h"
 #include "hatching.h"
+#include "hatchingcapture.h"
+#include "hatchingrenderer.h"
+#include "hud.h"
 #include "mesh.h"
 #include "rendering.h"
+#include "scenedescription.h"
 #include "shader.h"
+#include "strokestream.h"
+#include "vectorwriter.h"
 
+#include <chrono>
 #include <map>
 
 namespace Copperplate {
@@ -12,6 +20,7 @@ namespace Copperplate {
 	const int SEEDS_PER_OBJECT = 16000;
 	const float Z_MIN = 0.1f;
 	const float Z_MAX = 50.0f;
+	const float SEED_DEPTH_BIAS = 1e-4f;
 	const int COMPUTE_GROUPSIZE = 128;
 	const std::string SCREENSHOT_PATH = "screenshots/";
 	const std::string VIDEO_PATH = "video/";
@@ -19,11 +28,15 @@ namespace Copperplate {
 	class SceneObject {
 	public:
 
-		SceneObject(std::string meshFile, Shared<Shader> shader, int id, Shared<SceneObject> parent, Shared<Hatching> hatching);
+		// The node transform places the mesh within its file, without a mesh the object only carries a transform
+		SceneObject(Shared<Mesh> mesh, glm::mat4 nodeTransform, Shared<Shader> shader, int id, Shared<SceneObject> parent, Shared<Hatching> hatching);
 
 		void Draw();
 
 		void Update();
+		// Picks the coarsest level of the mesh whose error stays below DisplaySettings::LodPixelError on screen
+		void SelectLod(const glm::mat4& view, const glm::mat4& projection, float viewportHeight);
+		int GetLod();
 
 		void ExtractContours();
 		void DrawContours();
@@ -49,24 +62,26 @@ namespace Copperplate {
 
 		SceneObject();
 
-		Unique<Mesh> m_Mesh;
+		Shared<Mesh> m_Mesh;
 		Shared<Shader> m_Shader;
 		Shared<Hatching> m_Hatching;
 		Shared<SceneObject> m_Parent;
 		int m_Id;
+		int m_Lod;
+		float m_SeedDepthBias;		//the seeds lie on the full resolution, the depth buffer may hold a coarser level
 		glm::mat4 m_Transform;
 		glm::mat4 m_PrevTransform;
-		glm::mat4 m_LocalTransform;
-		std::vector<SeedPoint> m_SeedPoints;
+		glm::mat4 m_LocalTransform;		//pose of the object, set by the scene description and the animation
+		glm::mat4 m_NodeTransform;		//fixed transform from the node hierarchy of the file
 		std::vector<glm::vec2> m_ContourSegments;
 		
-		unsigned int m_SeedsVAO;
-		unsigned int m_SeedsVertexBuffer;
 		unsigned int m_SeedsSSBO;
-		unsigned int m_ContoursFeedbackBuffer;
 		unsigned int m_ContoursVAO;
 		unsigned int m_ContoursVBO;
 
+		MemoryCounter m_ContourMemory;
+		MemoryCounter m_BufferMemory;
+		MemoryCounter m_ContourBufferMemory;	//resized to the extracted segments every frame
 	};
 	
 	enum EShaders {
@@ -86,18 +101,46 @@ namespace Copperplate {
 		SH_Diffuse,
 		SH_ShadingGradient,
 		SH_Hatching,
+		SH_Hud,
 	};
 
 	class Scene {
 	public:
 
-		Scene(Shared<Window> window);
+		Scene(Shared<Window> window, const SceneDescription& description);
 
 		void Update();
 		void Draw();
 
 		void MoveCamera(float x, float y, float z);
+		void SetCameraPosition(CameraPosition position);
+		// Index of the object in the scene description, its nodes follow the pose
+		void SetObjectPose(int index, const ObjectPose& pose);
+		int GetNumObjects();
+		// Objects join the scene at the start of a frame once their files are loaded, this waits for all of them
+		void FinishLoading();
+		bool IsLoading();
+		void SaveFrame(const std::string& path);
+		// .y4m files get a YUV4MPEG2 stream, anything else raw rgb24 frames
+		bool StartVideo(const std::string& path, int framesPerSecond);
+		void SaveVideoFrame();
+		// Frames are saved asynchronously, this waits until all of them are written
+		void FinishSaving();
+		// Reads a part of the finished frame right away, RGB rows start at the bottom
+		void ReadFrame(glm::ivec2 origin, glm::ivec2 size, std::vector<unsigned char>& outPixels);
+		bool StartCapture(const std::string& path);
+		// Writes the lines and contours of every frame as svg, eps or pdf, see VectorWriter
+		bool StartVectorExport(const std::string& path, float simplifyTolerance);
+		bool StartStrokeStream(const std::string& path, int keyframeInterval);
+		// Counts the hatching work per grid cell every frame, not only while the heatmap is shown
+		void EnableCostRecording();
+		void SaveCostHeatmap(const std::string& path);
+		// Merges all GPU pass times that are available into the statistics
+		void CollectGpuTimes();
 		void ViewportSizeChanged(int newWidth, int newHeight);
+		// Renders the pixel rectangle of a larger image into the viewport, origin and size are in image pixels
+		void SetTile(glm::ivec2 imageSize, glm::ivec2 origin, glm::ivec2 size);
+		Hatching& GetHatching();
 
 		//DEBUG
 		void SetLayer1Direction(EHatchingDirections newDir);
@@ -108,6 +151,10 @@ namespace Copperplate {
 
 		void CreateShaders();
 		void UpdateUniforms();
+		// Places the objects whose files are ready and whose parent was placed
+		void PopulateObjects();
+		// Creates the objects for the nodes of the file and returns the one the scene description poses
+		Shared<SceneObject> CreateInstance(const std::string& meshFile, Shared<SceneObject> parent);
 
 		void DrawObject(const Shared<SceneObject>& object, EShaders shader);
 		void DrawFlatColor(const Shared<SceneObject>& object, glm::vec3 color);
@@ -122,17 +169,31 @@ namespace Copperplate {
 		void DrawHatchingLines(EShaders shader, glm::vec3 color);
 		void DrawHatchingCollision(glm::vec3 color, float pointSize);
 		void DrawHatching(EShaders shader, glm::vec3 color);
+		void DrawCostHeatmap();
 		
 		unsigned int m_DebugTexture;
+		MemoryCounter m_DebugTextureMemory;
+		glm::vec4 m_PaperRect;		//offset and scale of the paper texture coordinates
 		unsigned int m_FrameNumber;
+		bool m_RecordCosts;
 
 		Unique<Renderer> m_Renderer;
 		Shared<Hatching> m_Hatching;
+		Unique<HatchingRenderer> m_HatchingRenderer;
+		Unique<HatchingCaptureWriter> m_Capture;
+		Unique<VectorWriter> m_VectorWriter;
+		Unique<StrokeStreamWriter> m_StrokeWriter;
+		Unique<GpuTimer> m_GpuTimer;
+		Unique<PerformanceHud> m_Hud;
 		Unique<Camera> m_Camera;
 		glm::vec3 m_LightDir;
 		std::map<EShaders, Shared<Shader>> m_Shaders;
 		std::map<EShaders, Shared<ComputeShader>> m_ComputeShaders;
-		std::vector<Shared<SceneObject>> m_SceneObjects;
+		Unique<MeshLibrary> m_MeshLibrary;
+		std::vector<Shared<SceneObject>> m_SceneObjects;	//parents come before their children
+		std::vector<SceneObjectDescription> m_ObjectDescriptions;
+		std::vector<Shared<SceneObject>> m_Instances;		//one per object of the scene description, null until it joins
+		std::chrono::steady_clock::time_point m_LoadStart;
 
 	};
 }
\ No newline at end of file
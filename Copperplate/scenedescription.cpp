@@ -0,0 +1,254 @@
+#pragma once
+
+#include "scenedescription.h"
+
+#include <rapidjson/document.h>
+#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/error/en.h>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace Copperplate {
+
+	bool readJsonFile(const std::string& path, rapidjson::Document& outDocument) {
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			std::cout << "Could not open " << path << std::endl;
+			return false;
+		}
+		rapidjson::IStreamWrapper stream(file);
+		outDocument.ParseStream(stream);
+		if (outDocument.HasParseError() || !outDocument.IsObject()) {
+			std::cout << "Parsing " << path << " failed at offset " << outDocument.GetErrorOffset() << ": "
+				<< rapidjson::GetParseError_En(outDocument.GetParseError()) << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	float readFloat(const rapidjson::Value& object, const char* name, float fallback) {
+		if (object.HasMember(name) && object[name].IsNumber())
+			return object[name].GetFloat();
+		return fallback;
+	}
+
+	glm::vec3 readVec3(const rapidjson::Value& object, const char* name, glm::vec3 fallback) {
+		if (!object.HasMember(name)) return fallback;
+		const rapidjson::Value& value = object[name];
+		if (!value.IsArray() || value.Size() != 3) return fallback;
+		for (rapidjson::SizeType i = 0; i < 3; i++) {
+			if (!value[i].IsNumber()) return fallback;
+		}
+		return glm::vec3(value[0].GetFloat(), value[1].GetFloat(), value[2].GetFloat());
+	}
+
+	CameraPosition readCameraPosition(const rapidjson::Value& object, CameraPosition fallback) {
+		CameraPosition result;
+		result.m_Azimuth = readFloat(object, "azimuth", fallback.m_Azimuth);
+		result.m_Height = readFloat(object, "height", fallback.m_Height);
+		result.m_Zoom = readFloat(object, "zoom", fallback.m_Zoom);
+		return result;
+	}
+
+	ObjectPose readObjectPose(const rapidjson::Value& object, ObjectPose fallback) {
+		ObjectPose result;
+		result.m_Position = readVec3(object, "position", fallback.m_Position);
+		result.m_RotationAxis = fallback.m_RotationAxis;
+		result.m_RotationAngle = fallback.m_RotationAngle;
+		if (object.HasMember("rotation") && object["rotation"].IsObject()) {
+			result.m_RotationAxis = readVec3(object["rotation"], "axis", fallback.m_RotationAxis);
+			result.m_RotationAngle = readFloat(object["rotation"], "angle", fallback.m_RotationAngle);
+		}
+		return result;
+	}
+
+	// Finds the two keyframes around the frame and the interpolation factor between them,
+	// frames outside of the keyframe range are clamped to the first or last keyframe
+	template<typename Keyframe>
+	void findKeyframes(const std::vector<Keyframe>& keyframes, int frame, const Keyframe*& outA, const Keyframe*& outB, float& outT) {
+		if (frame <= keyframes.front().m_Frame) {
+			outA = outB = &keyframes.front();
+			outT = 0.0f;
+			return;
+		}
+		if (frame >= keyframes.back().m_Frame) {
+			outA = outB = &keyframes.back();
+			outT = 0.0f;
+			return;
+		}
+		int next = 1;
+		while (keyframes[next].m_Frame <= frame) {
+			next++;
+		}
+		outA = &keyframes[next - 1];
+		outB = &keyframes[next];
+		outT = (float)(frame - outA->m_Frame) / (float)(outB->m_Frame - outA->m_Frame);
+	}
+
+	template<typename Keyframe>
+	void sortKeyframes(std::vector<Keyframe>& keyframes) {
+		std::stable_sort(keyframes.begin(), keyframes.end(), [](const Keyframe& a, const Keyframe& b) {
+			return a.m_Frame < b.m_Frame;
+		});
+	}
+
+	// SCENE DESCRIPTION IMPLEMENTATION
+	SceneDescription SceneDescription::CreateDefault() {
+		SceneDescription description;
+		SceneObjectDescription dragon;
+		dragon.m_MeshFile = "dragon.obj";
+		dragon.m_Pose.m_Position = glm::vec3(0.0f, 0.1f, 0.0f);
+		description.m_Objects.push_back(dragon);
+		return description;
+	}
+
+	bool SceneDescription::Load(const std::string& path, SceneDescription& outDescription) {
+		rapidjson::Document document;
+		if (!readJsonFile(path, document)) return false;
+
+		SceneDescription description;
+		if (document.HasMember("camera") && document["camera"].IsObject()) {
+			description.m_Camera = readCameraPosition(document["camera"], description.m_Camera);
+		}
+		description.m_LightDirection = readVec3(document, "lightDirection", description.m_LightDirection);
+		if (document.HasMember("seed") && document["seed"].IsInt()) {
+			description.m_RandomSeed = document["seed"].GetInt();
+		}
+
+		if (!document.HasMember("objects") || !document["objects"].IsArray()) {
+			std::cout << "Scene file " << path << " contains no objects" << std::endl;
+			return false;
+		}
+		const rapidjson::Value& objects = document["objects"];
+		for (rapidjson::SizeType i = 0; i < objects.Size(); i++) {
+			const rapidjson::Value& object = objects[i];
+			if (!object.IsObject() || !object.HasMember("mesh") || !object["mesh"].IsString()) {
+				std::cout << "Scene file " << path << ": object " << i << " has no mesh" << std::endl;
+				return false;
+			}
+			SceneObjectDescription objectDesc;
+			objectDesc.m_MeshFile = object["mesh"].GetString();
+			objectDesc.m_Pose = readObjectPose(object, objectDesc.m_Pose);
+			if (object.HasMember("parent") && object["parent"].IsInt()) {
+				objectDesc.m_Parent = object["parent"].GetInt();
+				// parents have to be created before their children
+				if (objectDesc.m_Parent >= (int)i) {
+					std::cout << "Scene file " << path << ": object " << i << " has invalid parent " << objectDesc.m_Parent << std::endl;
+					return false;
+				}
+			}
+			description.m_Objects.push_back(objectDesc);
+		}
+
+		outDescription = description;
+		return true;
+	}
+
+	// ANIMATION PATH IMPLEMENTATION
+	AnimationPath::AnimationPath() {
+		m_CameraKeyframes = std::vector<CameraKeyframe>();
+		m_ObjectKeyframes = std::map<int, std::vector<ObjectKeyframe>>();
+	}
+
+	bool AnimationPath::Load(const std::string& path) {
+		rapidjson::Document document;
+		if (!readJsonFile(path, document)) return false;
+
+		// camera path files only hold the camera keyframes, under "keyframes"
+		const char* cameraKey = document.HasMember("camera") ? "camera" : "keyframes";
+		std::vector<CameraKeyframe> cameraKeyframes;
+		if (document.HasMember(cameraKey) && document[cameraKey].IsArray()) {
+			CameraPosition lastPosition;
+			const rapidjson::Value& frames = document[cameraKey];
+			for (rapidjson::SizeType i = 0; i < frames.Size(); i++) {
+				const rapidjson::Value& frame = frames[i];
+				if (!frame.IsObject() || !frame.HasMember("frame") || !frame["frame"].IsInt()) {
+					std::cout << "Animation " << path << ": camera keyframe " << i << " has no frame number" << std::endl;
+					return false;
+				}
+				// missing values are carried over from the previous keyframe
+				lastPosition = readCameraPosition(frame, lastPosition);
+				cameraKeyframes.push_back({ frame["frame"].GetInt(), lastPosition });
+			}
+			sortKeyframes(cameraKeyframes);
+		}
+
+		std::map<int, std::vector<ObjectKeyframe>> objectKeyframes;
+		if (document.HasMember("objects") && document["objects"].IsArray()) {
+			const rapidjson::Value& objects = document["objects"];
+			for (rapidjson::SizeType i = 0; i < objects.Size(); i++) {
+				const rapidjson::Value& object = objects[i];
+				if (!object.IsObject() || !object.HasMember("index") || !object["index"].IsInt()
+					|| !object.HasMember("keyframes") || !object["keyframes"].IsArray()) {
+					std::cout << "Animation " << path << ": object entry " << i << " needs an index and keyframes" << std::endl;
+					return false;
+				}
+				std::vector<ObjectKeyframe>& keyframes = objectKeyframes[object["index"].GetInt()];
+				ObjectPose lastPose;
+				const rapidjson::Value& frames = object["keyframes"];
+				for (rapidjson::SizeType j = 0; j < frames.Size(); j++) {
+					const rapidjson::Value& frame = frames[j];
+					if (!frame.IsObject() || !frame.HasMember("frame") || !frame["frame"].IsInt()) {
+						std::cout << "Animation " << path << ": object entry " << i << " keyframe " << j << " has no frame number" << std::endl;
+						return false;
+					}
+					lastPose = readObjectPose(frame, lastPose);
+					keyframes.push_back({ frame["frame"].GetInt(), lastPose });
+				}
+				if (keyframes.empty()) {
+					objectKeyframes.erase(object["index"].GetInt());
+					continue;
+				}
+				sortKeyframes(keyframes);
+			}
+		}
+
+		if (cameraKeyframes.empty() && objectKeyframes.empty()) {
+			std::cout << "Animation " << path << " contains no keyframes" << std::endl;
+			return false;
+		}
+
+		m_CameraKeyframes = cameraKeyframes;
+		m_ObjectKeyframes = objectKeyframes;
+		return true;
+	}
+
+	bool AnimationPath::HasCameraPath() {
+		return !m_CameraKeyframes.empty();
+	}
+
+	CameraPosition AnimationPath::EvaluateCamera(int frame) {
+		if (m_CameraKeyframes.empty()) return CameraPosition();
+
+		const CameraKeyframe* a;
+		const CameraKeyframe* b;
+		float t;
+		findKeyframes(m_CameraKeyframes, frame, a, b, t);
+
+		CameraPosition result;
+		result.m_Azimuth = (1.0f - t) * a->m_Position.m_Azimuth + t * b->m_Position.m_Azimuth;
+		result.m_Height = (1.0f - t) * a->m_Position.m_Height + t * b->m_Position.m_Height;
+		result.m_Zoom = (1.0f - t) * a->m_Position.m_Zoom + t * b->m_Position.m_Zoom;
+		return result;
+	}
+
+	bool AnimationPath::EvaluateObject(int objectIndex, int frame, ObjectPose& outPose) {
+		auto found = m_ObjectKeyframes.find(objectIndex);
+		if (found == m_ObjectKeyframes.end()) return false;
+
+		const ObjectKeyframe* a;
+		const ObjectKeyframe* b;
+		float t;
+		findKeyframes(found->second, frame, a, b, t);
+
+		outPose.m_Position = glm::mix(a->m_Pose.m_Position, b->m_Pose.m_Position, t);
+		outPose.m_RotationAxis = glm::normalize(glm::mix(a->m_Pose.m_RotationAxis, b->m_Pose.m_RotationAxis, t));
+		outPose.m_RotationAngle = (1.0f - t) * a->m_Pose.m_RotationAngle + t * b->m_Pose.m_RotationAngle;
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "core.h"
+
+#include <glm/ext/vector_float3.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Copperplate {
+
+	struct CameraPosition {
+		float m_Azimuth = 3.4f;
+		float m_Height = -0.2f;
+		float m_Zoom = 3.0f;
+	};
+
+	struct ObjectPose {
+		glm::vec3 m_Position = glm::vec3(0.0f);
+		glm::vec3 m_RotationAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+		float m_RotationAngle = 0.0f;
+	};
+
+	struct SceneObjectDescription {
+		std::string m_MeshFile;
+		ObjectPose m_Pose;
+		int m_Parent = -1;	//index into the object list, -1 for no parent
+	};
+
+	// Everything needed to set up a Scene, either loaded from a json file or the built in default
+	struct SceneDescription {
+		CameraPosition m_Camera;
+		glm::vec3 m_LightDirection = glm::vec3(-1.0f, -1.0f, 0.0f);
+		int m_RandomSeed = -1;		//-1 seeds the random generators nondeterministically
+		std::vector<SceneObjectDescription> m_Objects;
+
+		static SceneDescription CreateDefault();
+		static bool Load(const std::string& path, SceneDescription& outDescription);
+	};
+
+	// Keyframes for the camera and for individual scene objects over frame numbers,
+	// poses between keyframes are interpolated linearly
+	class AnimationPath {
+	public:
+
+		AnimationPath();
+
+		bool Load(const std::string& path);
+
+		bool HasCameraPath();
+		CameraPosition EvaluateCamera(int frame);
+
+		// returns false if the object is not animated
+		bool EvaluateObject(int objectIndex, int frame, ObjectPose& outPose);
+
+	private:
+
+		struct CameraKeyframe {
+			int m_Frame;
+			CameraPosition m_Position;
+		};
+
+		struct ObjectKeyframe {
+			int m_Frame;
+			ObjectPose m_Pose;
+		};
+
+		std::vector<CameraKeyframe> m_CameraKeyframes;
+		std::map<int, std::vector<ObjectKeyframe>> m_ObjectKeyframes;
+	};
+}
\ No newline at end of file
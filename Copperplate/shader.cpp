@@ -3,7 +3,7 @@
 #include "shader.h"
 
 #include <glad/glad.h>
-#include <glm\gtc\type_ptr.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <string>
 #include <fstream>
@@ -13,6 +13,28 @@
 
 namespace Copperplate {
 
+	// Our shaders are written against GLSL 4.60 but use no 4.6 features. Contexts that only support
+	// 4.50, like Mesa llvmpipe in headless mode, get the version directive lowered so they still compile.
+	std::string adjustShaderVersion(const std::string& code) {
+		static int supportedVersion = -1;
+		if (supportedVersion < 0) {
+			const char* versionString = (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION);
+			int major = 4;
+			int minor = 60;
+			if (versionString) sscanf(versionString, "%d.%d", &major, &minor);
+			supportedVersion = major * 100 + minor;
+		}
+
+		const std::string directive = "#version 460";
+		size_t pos = code.find(directive);
+		if (supportedVersion >= 460 || supportedVersion < 450 || pos == std::string::npos)
+			return code;
+
+		std::string result = code;
+		result.replace(pos, directive.size(), "#version " + std::to_string(supportedVersion));
+		return result;
+	}
+
 	Shader::Shader(EShaderTypes types, const char* vertexPath, const char* geometryPath, const char* fragmentPath) {
 		bool hasVert = (types & ST_Vertex);
 		bool hasGeom = (types & ST_Geometry);
@@ -86,7 +108,7 @@ namespace Copperplate {
 			shaderFile.open(filePath);
 			shaderStream << shaderFile.rdbuf();
 			shaderFile.close();
-			shaderCode = shaderStream.str();
+			shaderCode = adjustShaderVersion(shaderStream.str());
 		}
 		catch (std::ifstream::failure e) {
 			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ:" << filePath << std::endl;
@@ -154,6 +176,11 @@ namespace Copperplate {
 			glUniform3fv(location, 1, glm::value_ptr(value));
 		}
 
+		for (const auto& [name, value] : m_UniformVec4s) {
+			int location = glGetUniformLocation(m_ProgramID, name.c_str());
+			glUniform4fv(location, 1, glm::value_ptr(value));
+		}
+
 		for (const auto& [name, value] : m_UniformFloats) {
 			int location = glGetUniformLocation(m_ProgramID, name.c_str());
 			glUniform1f(location, value);
@@ -168,6 +195,10 @@ namespace Copperplate {
 		m_UniformVecs[name] = value;
 	}
 
+	void Shader::SetVec4(const std::string& name, const glm::vec4& value) {
+		m_UniformVec4s[name] = value;
+	}
+
 	void Shader::SetFloat(const std::string& name, const float value)
 	{
 		m_UniformFloats[name] = value;
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <glm\ext\matrix_float4x4.hpp>
+#include <glm/ext/matrix_float4x4.hpp>
 
 #include <string>
 #include <map>
@@ -29,6 +29,7 @@ namespace Copperplate {
 
 		void SetMat4(const std::string& name, const glm::mat4& value);
 		void SetVec3(const std::string& name, const glm::vec3& value);
+		void SetVec4(const std::string& name, const glm::vec4& value);
 		void SetFloat(const std::string& name, const float value);
 
 		
@@ -43,6 +44,7 @@ namespace Copperplate {
 		unsigned int m_ProgramID = 0;
 		std::map<std::string, glm::mat4> m_UniformMats;
 		std::map<std::string, glm::vec3> m_UniformVecs;
+		std::map<std::string, glm::vec4> m_UniformVec4s;
 		std::map<std::string, float> m_UniformFloats;
 
 	private:
@@ -1,6 +1,6 @@
 #version 460 core
 layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aNorm;
+layout(location = 1) in vec2 aNormOct;		//octahedral encoded, see MeshBuffers
 
 out vec3 WSNorm;
 
@@ -12,7 +12,16 @@ uniform mat4 modelInvTrans;
 uniform mat4 viewInvTrans;
 //uniform mat4 projectionInvTrans;
 
+vec3 decodeNormal(vec2 encoded){
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.x += (normal.x >= 0.0) ? -fold : fold;
+	normal.y += (normal.y >= 0.0) ? -fold : fold;
+	return normalize(normal);
+}
+
 void main(){
+	vec3 aNorm = decodeNormal(aNormOct);
 	WSNorm = normalize((modelInvTrans * vec4(aNorm, 0.0)).xyz);
 	vec4 viewPos = view * model * vec4(aPos, 1.0);
 	vec4 screenPos = projection * viewPos;	
@@ -4,9 +4,12 @@ layout(location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
+// offset and scale of the texture coordinates, tiled renders show their part of the paper
+uniform vec4 texRect = vec4(0.0, 0.0, 1.0, 1.0);
+
 void main(){	
 	gl_Position = vec4(aPos, 1.0f);
-	TexCoords = aTexCoords;
+	TexCoords = texRect.xy + aTexCoords * texRect.zw;
 	
 	//gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);
 }
\ No newline at end of file
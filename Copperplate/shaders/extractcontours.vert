@@ -1,6 +1,6 @@
 #version 460 core
 layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aNorm;
+layout(location = 1) in vec2 aNormOct;		//octahedral encoded, see MeshBuffers
 
 out VS_OUT {
 	vec3 norm;
@@ -11,7 +11,16 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+vec3 decodeNormal(vec2 encoded){
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.x += (normal.x >= 0.0) ? -fold : fold;
+	normal.y += (normal.y >= 0.0) ? -fold : fold;
+	return normalize(normal);
+}
+
 void main(){
+	vec3 aNorm = decodeNormal(aNormOct);
 	vs_out.norm = normalize((model * vec4(aNorm.x, aNorm.y, aNorm.z, 0.0f)).xyz);
 	vs_out.worldPos = (model * vec4(aPos, 1.0f)).xyz;
 	vec4 testPos = projection * view * model * vec4(aPos.x, aPos.y, aPos.z, 1.0f);
@@ -0,0 +1,13 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec4 Color;
+
+uniform sampler2D fontTexture;
+
+void main()
+{
+	float coverage = texelFetch(fontTexture, ivec2(TexCoords), 0).r;
+	FragColor = vec4(Color.rgb, Color.a * coverage);
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 460 core
+layout(location = 0) in vec2 aPos;
+layout(location = 1) in vec2 aTexCoords;
+layout(location = 2) in vec4 aColor;
+
+out vec2 TexCoords;
+out vec4 Color;
+
+uniform vec3 viewportSize;
+
+void main(){
+	// positions are in pixels from the top left corner
+	vec2 pos = aPos / viewportSize.xy;
+	gl_Position = vec4(pos.x * 2.0 - 1.0, 1.0 - pos.y * 2.0, 0.0, 1.0);
+	TexCoords = aTexCoords;
+	Color = aColor;
+}
\ No newline at end of file
@@ -1,16 +1,306 @@
 #pragma once
 #include "statistics.h"
 
+#include <rapidjson/document.h>
+#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
 namespace Copperplate {
 
+	const int MAX_TRACE_EVENTS_PER_FRAME = 1 << 16;
+	// row of the gpu passes in the trace, far away from the cpu thread indices
+	const int GPU_TRACE_THREAD = 1000;
+	// differences below this many ms are noise and never count as a regression
+	const float REGRESSION_NOISE_FLOOR = 0.05f;
+
+	// threads can exit after the statistics were destroyed at the end of the program
+	std::atomic<bool> StatisticsExist(false);
+
+	// Hands the stats of a thread back when the thread exits, so short lived workers do not pile up
+	struct ThreadStatsOwner {
+		ThreadStats* m_Stats = nullptr;
+		~ThreadStatsOwner();
+	};
+
+#ifdef COPPERPLATE_ALLOC_TRACKING
+	// only counts while the statistics exist, allocations during static init and shutdown are ignored
+	std::atomic<bool> AllocationHookActive(false);
+	// set while the hook itself allocates, e.g. when a thread registers its statistics
+	thread_local bool InAllocationHook = false;
+
+	void trackAllocation(size_t size) {
+		if (!AllocationHookActive || InAllocationHook) return;
+		InAllocationHook = true;
+		Statistics::Get().recordAllocation(size);
+		InAllocationHook = false;
+	}
+
+	void trackFree() {
+		if (!AllocationHookActive || InAllocationHook) return;
+		InAllocationHook = true;
+		Statistics::Get().recordFree();
+		InAllocationHook = false;
+	}
+#endif
+
+	const char* getTimerName(ETimerType type) {
+		switch (type) {
+		case T_RenderContour: return "RenderContour";
+		case T_UpdateHatch: return "UpdateHatch";
+		case T_RenderHatch: return "RenderHatch";
+		case T_Advect: return "Advect";
+		case T_Resample: return "Resample";
+		case T_Relax: return "Relax";
+		case T_Topology: return "Topology";
+		case T_Delete: return "Delete";
+		case T_Split: return "Split";
+		case T_Trim: return "Trim";
+		case T_Extend: return "Extend";
+		case T_Merge: return "Merge";
+		case T_Insert: return "Insert";
+		case T_Readback: return "Readback";
+		case T_DrawHud: return "DrawHud";
+		case T_SaveFrame: return "SaveFrame";
+		case T_NumTimers: break;
+		}
+		return "Unknown";
+	}
+
+	const char* getGpuTimerName(EGpuTimerType type) {
+		switch (type) {
+		case GT_Normals: return "Normals";
+		case GT_Depth: return "Depth";
+		case GT_Movement: return "Movement";
+		case GT_Curvature: return "Curvature";
+		case GT_Diffuse: return "Diffuse";
+		case GT_ShadingGradient: return "ShadingGradient";
+		case GT_ExtractContours: return "ExtractContours";
+		case GT_TransformSeeds: return "TransformSeeds";
+		case GT_DrawHatching: return "DrawHatching";
+		case GT_DrawHud: return "DrawHud";
+		case GT_NumGpuTimers: break;
+		}
+		return "Unknown";
+	}
+
+	const char* getMemoryCategoryName(EMemoryCategory category) {
+		switch (category) {
+		case MC_Images: return "Images";
+		case MC_Seeds: return "Seeds";
+		case MC_SeedGrids: return "SeedGrids";
+		case MC_CollisionGrids: return "CollisionGrids";
+		case MC_Lines: return "Lines";
+		case MC_Contours: return "Contours";
+		case MC_Meshes: return "Meshes";
+		case MC_GLBuffers: return "GLBuffers";
+		case MC_GLTextures: return "GLTextures";
+		case MC_GLRenderbuffers: return "GLRenderbuffers";
+		case MC_NumCategories: break;
+		}
+		return "Unknown";
+	}
+
+	MemoryCounter::MemoryCounter(EMemoryCategory category) {
+		m_category = category;
+		m_bytes = 0;
+	}
+
+	MemoryCounter::~MemoryCounter() {
+		Set(0);
+	}
+
+	void MemoryCounter::Set(int64_t bytes) {
+		if (bytes == m_bytes) return;
+		Statistics::Get().recordMemory(m_category, bytes - m_bytes);
+		m_bytes = bytes;
+	}
+
+	int64_t MemoryCounter::Get() const {
+		return m_bytes;
+	}
+
+	float StatFrameField::GetValue(const StatFrame& frame) const {
+		switch (m_Type) {
+		case SF_Timer: return frame.times[m_Index];
+		case SF_GpuTimer: return frame.gpuTimes[m_Index];
+		case SF_Counter: return (float)frame.counts[m_Index];
+		case SF_Allocations:
+		case SF_Frees:
+		case SF_AllocatedBytes: {
+			int64_t sum = 0;
+			for (int i = 0; i <= T_NumTimers; i++) {
+				if (m_Type == SF_Allocations) sum += frame.allocations[i];
+				else if (m_Type == SF_Frees) sum += frame.frees[i];
+				else sum += frame.allocatedBytes[i];
+			}
+			return (float)sum;
+		}
+		case SF_PerfCounter: return (float)frame.perfCounts[T_UpdateHatch][m_Index];
+		case SF_Memory: return (float)frame.memoryBytes[m_Index];
+		case SF_TotalTime: break;
+		}
+		return frame.totalTime;
+	}
+
+	const std::vector<StatFrameField>& getStatFrameFields() {
+		static const std::vector<StatFrameField> fields = {
+			{ "totalTime", SF_TotalTime, 0 },
+			{ "renderContourTime", SF_Timer, T_RenderContour },
+			{ "updateHatchTime", SF_Timer, T_UpdateHatch },
+			{ "renderHatchTime", SF_Timer, T_RenderHatch },
+			{ "advectTime", SF_Timer, T_Advect },
+			{ "resampleTime", SF_Timer, T_Resample },
+			{ "relaxTime", SF_Timer, T_Relax },
+			{ "topoTime", SF_Timer, T_Topology },
+			{ "deleteTime", SF_Timer, T_Delete },
+			{ "splitTime", SF_Timer, T_Split },
+			{ "trimTime", SF_Timer, T_Trim },
+			{ "extendTime", SF_Timer, T_Extend },
+			{ "mergeTime", SF_Timer, T_Merge },
+			{ "insertTime", SF_Timer, T_Insert },
+			{ "readbackTime", SF_Timer, T_Readback },
+			{ "hudTime", SF_Timer, T_DrawHud },
+			{ "saveFrameTime", SF_Timer, T_SaveFrame },
+			{ "gpuNormalsTime", SF_GpuTimer, GT_Normals },
+			{ "gpuDepthTime", SF_GpuTimer, GT_Depth },
+			{ "gpuMovementTime", SF_GpuTimer, GT_Movement },
+			{ "gpuCurvatureTime", SF_GpuTimer, GT_Curvature },
+			{ "gpuDiffuseTime", SF_GpuTimer, GT_Diffuse },
+			{ "gpuShadingGradientTime", SF_GpuTimer, GT_ShadingGradient },
+			{ "gpuExtractContoursTime", SF_GpuTimer, GT_ExtractContours },
+			{ "gpuTransformSeedsTime", SF_GpuTimer, GT_TransformSeeds },
+			{ "gpuDrawHatchingTime", SF_GpuTimer, GT_DrawHatching },
+			{ "gpuHudTime", SF_GpuTimer, GT_DrawHud },
+			{ "numInsertions", SF_Counter, C_Insertions },
+			{ "numDeletions", SF_Counter, C_Deletions },
+			{ "numMerges", SF_Counter, C_Merges },
+			{ "numSplits", SF_Counter, C_Splits },
+			{ "numLines", SF_Counter, C_Lines },
+			{ "numAllocations", SF_Allocations, 0 },
+			{ "numFrees", SF_Frees, 0 },
+			{ "allocatedBytes", SF_AllocatedBytes, 0 },
+			{ "hatchCycles", SF_PerfCounter, PC_Cycles },
+			{ "hatchInstructions", SF_PerfCounter, PC_Instructions },
+			{ "hatchL1DMisses", SF_PerfCounter, PC_L1DMisses },
+			{ "hatchLLCMisses", SF_PerfCounter, PC_LLCMisses },
+			{ "hatchBranchMisses", SF_PerfCounter, PC_BranchMisses },
+			{ "memImages", SF_Memory, MC_Images },
+			{ "memSeeds", SF_Memory, MC_Seeds },
+			{ "memSeedGrids", SF_Memory, MC_SeedGrids },
+			{ "memCollisionGrids", SF_Memory, MC_CollisionGrids },
+			{ "memLines", SF_Memory, MC_Lines },
+			{ "memContours", SF_Memory, MC_Contours },
+			{ "memMeshes", SF_Memory, MC_Meshes },
+			{ "memGLBuffers", SF_Memory, MC_GLBuffers },
+			{ "memGLTextures", SF_Memory, MC_GLTextures },
+			{ "memGLRenderbuffers", SF_Memory, MC_GLRenderbuffers },
+		};
+		return fields;
+	}
+
+	bool readHistogramDump(const std::string& path, rapidjson::Document& outDocument) {
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			std::cout << "Could not open " << path << std::endl;
+			return false;
+		}
+		rapidjson::IStreamWrapper stream(file);
+		outDocument.ParseStream(stream);
+		if (outDocument.HasParseError() || !outDocument.IsObject() || !outDocument.HasMember("fields") || !outDocument["fields"].IsObject()) {
+			std::cout << path << " is not a histogram dump" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool compareHistogramDumps(const std::string& basePath, const std::string& newPath, float tolerance, bool& outRegressed) {
+		rapidjson::Document baseDump;
+		rapidjson::Document newDump;
+		if (!readHistogramDump(basePath, baseDump) || !readHistogramDump(newPath, newDump))
+			return false;
+
+		const char* percentiles[] = { "p50", "p95", "p99" };
+		outRegressed = false;
+		std::cout << "Comparing " << newPath << " (" << newDump["frames"].GetInt() << " frames) against "
+			<< basePath << " (" << baseDump["frames"].GetInt() << " frames)" << std::endl;
+		std::cout << std::left << std::setw(24) << "stage" << std::right;
+		for (const char* percentile : percentiles) {
+			std::cout << std::setw(10) << percentile << std::setw(10) << "new" << std::setw(9) << "change";
+		}
+		std::cout << std::endl;
+
+		for (const StatFrameField& field : getStatFrameFields()) {
+			const rapidjson::Value& baseFields = baseDump["fields"];
+			const rapidjson::Value& newFields = newDump["fields"];
+			if (!baseFields.HasMember(field.m_Name) || !newFields.HasMember(field.m_Name)) continue;
+			const rapidjson::Value& baseField = baseFields[field.m_Name];
+			const rapidjson::Value& newField = newFields[field.m_Name];
+			if (baseField["max"].GetFloat() == 0.0f && newField["max"].GetFloat() == 0.0f) continue;
+
+			// counters and memory only tell that the simulation behaves differently, they are shown but never flagged
+			bool isTime = field.m_Type != SF_Counter && field.m_Type != SF_Memory;
+			bool regressed = false;
+			std::cout << std::left << std::setw(24) << field.m_Name << std::right << std::fixed << std::setprecision(3);
+			for (const char* percentile : percentiles) {
+				float baseValue = baseField[percentile].GetFloat();
+				float newValue = newField[percentile].GetFloat();
+				float change = (baseValue > 0.0f) ? (newValue / baseValue - 1.0f) : 0.0f;
+				if (isTime && newValue > baseValue * (1.0f + tolerance) && newValue - baseValue > REGRESSION_NOISE_FLOOR)
+					regressed = true;
+				std::cout << std::setw(10) << baseValue << std::setw(10) << newValue << std::setw(8) << std::setprecision(1) << change * 100.0f << "%" << std::setprecision(3);
+			}
+			if (regressed) {
+				std::cout << "  REGRESSION";
+				outRegressed = true;
+			}
+			std::cout << std::endl;
+		}
+
+		if (outRegressed)
+			std::cout << "Some stages got slower by more than " << tolerance * 100.0f << "%" << std::endl;
+		else
+			std::cout << "No regressions beyond " << tolerance * 100.0f << "%" << std::endl;
+		return true;
+	}
+
 	StatTimer::StatTimer(ETimerType type) {
 		m_type = type;
-		m_start = clock();
+		m_name = getTimerName(type);
+#ifdef COPPERPLATE_ALLOC_TRACKING
+		m_parentStage = Statistics::Get().enterStage(type);
+#endif
+		// read the counters before the clock so the time does not include the syscall
+		m_countingPerf = Statistics::Get().isCountingPerf() && Statistics::Get().readPerfCounters(m_perfStart);
+		m_start = std::chrono::steady_clock::now();
+	}
+
+	StatTimer::StatTimer(const char* name) {
+		m_type = T_NumTimers;
+		m_name = name;
+		m_countingPerf = false;
+		m_start = std::chrono::steady_clock::now();
 	}
+
 	StatTimer::~StatTimer()	{
-		clock_t now = clock();
-		float elapsedTime = ((float)now - m_start) * 1000.0f / CLOCKS_PER_SEC;
-		Statistics::Get().recordTime(m_type, elapsedTime);
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (m_countingPerf) {
+			uint64_t perfEnd[PC_NumCounters];
+			if (Statistics::Get().readPerfCounters(perfEnd))
+				Statistics::Get().recordPerfCounts(m_type, m_perfStart, perfEnd);
+		}
+		if (m_type != T_NumTimers)
+			Statistics::Get().recordTime(m_type, std::chrono::duration<float, std::milli>(now - m_start).count());
+		Statistics::Get().recordEvent(m_name, m_start, now);
+#ifdef COPPERPLATE_ALLOC_TRACKING
+		if (m_type != T_NumTimers)
+			Statistics::Get().leaveStage(m_parentStage);
+#endif
 	}
 
 
@@ -19,13 +309,113 @@ namespace Copperplate {
 		m_currIndex = 0;
 		m_currFrame = StatFrame();
 		m_currFrame.number = m_numFrames;
-		m_currFrameStart = clock();
+		for (int i = 0; i < 20; i++) {
+			m_buffer[i] = StatFrame();
+			m_buffer[i].number = -1;
+			m_histogramPending[i] = false;
+		}
+		m_histograms = std::vector<Histogram>(getStatFrameFields().size());
+		m_numSessionFrames = 0;
+		for (int i = 0; i <= T_NumTimers; i++) {
+			m_sessionAllocations[i] = 0;
+			m_sessionFrees[i] = 0;
+			m_sessionAllocatedBytes[i] = 0;
+			m_maxFrameAllocations[i] = 0;
+		}
+		for (int i = 0; i < T_NumTimers; i++) {
+			for (int j = 0; j < PC_NumCounters; j++) {
+				m_sessionPerfCounts[i][j] = 0;
+			}
+		}
+		m_countingPerf = false;
+		for (int i = 0; i < MC_NumCategories; i++) {
+			m_liveMemory[i] = 0;
+			m_peakMemory[i] = 0;
+		}
+		m_numImports = 0;
+		m_importedBytes = 0;
+		m_importMicroseconds = 0;
+		m_epoch = std::chrono::steady_clock::now();
+		m_currFrameStart = m_epoch;
+		m_threads = std::vector<Unique<ThreadStats>>();
+		m_tracing = false;
+		StatisticsExist = true;
+#ifdef COPPERPLATE_ALLOC_TRACKING
+		AllocationHookActive = true;
+#endif
 	}
 
-	void Statistics::newFrame()	{
-		clock_t now = clock();
-		m_currFrame.totalTime = ((float)now - m_currFrameStart) * 1000.0f / CLOCKS_PER_SEC;
+	Statistics::~Statistics() {
+		StatisticsExist = false;
+#ifdef COPPERPLATE_ALLOC_TRACKING
+		AllocationHookActive = false;
+#endif
+		stopTrace();
+	}
+
+	void Statistics::newFrame(bool recordHistograms)	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		m_currFrame.totalTime = std::chrono::duration<float, std::milli>(now - m_currFrameStart).count();
+
+		// collect what all threads recorded during the frame
+		{
+			std::lock_guard<std::mutex> lock(m_threadsMutex);
+			for (Unique<ThreadStats>& thread : m_threads) {
+				for (int i = 0; i < T_NumTimers; i++) {
+					m_currFrame.times[i] += thread->times[i];
+					thread->times[i] = 0.0f;
+				}
+				for (int i = 0; i < C_NumCounters; i++) {
+					m_currFrame.counts[i] += thread->counts[i];
+					thread->counts[i] = 0;
+				}
+				for (int i = 0; i <= T_NumTimers; i++) {
+					m_currFrame.allocations[i] += thread->allocations[i].exchange(0, std::memory_order_relaxed);
+					m_currFrame.frees[i] += thread->frees[i].exchange(0, std::memory_order_relaxed);
+					m_currFrame.allocatedBytes[i] += thread->allocatedBytes[i].exchange(0, std::memory_order_relaxed);
+				}
+				for (int i = 0; i < T_NumTimers; i++) {
+					for (int j = 0; j < PC_NumCounters; j++) {
+						m_currFrame.perfCounts[i][j] += thread->perfCounts[i][j];
+						thread->perfCounts[i][j] = 0;
+					}
+				}
+				if (m_tracing)
+					writeTraceEvents(*thread);
+				thread->numEvents = 0;
+				thread->numDropped = 0;
+			}
+		}
+		for (int i = 0; i < MC_NumCategories; i++) {
+			m_currFrame.memoryBytes[i] = m_liveMemory[i];
+		}
+		if (m_tracing) {
+			// the frame itself spans the whole main thread row
+			int64_t start = std::chrono::duration_cast<std::chrono::nanoseconds>(m_currFrameStart - m_epoch).count();
+			int64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_currFrameStart).count();
+			m_traceFile << ",\n{\"name\":\"Frame " << m_currFrame.number << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"
+				<< start / 1000.0 << ",\"dur\":" << duration / 1000.0 << "}";
+		}
+
+		if (recordHistograms) {
+			for (int i = 0; i <= T_NumTimers; i++) {
+				m_sessionAllocations[i] += m_currFrame.allocations[i];
+				m_sessionFrees[i] += m_currFrame.frees[i];
+				m_sessionAllocatedBytes[i] += m_currFrame.allocatedBytes[i];
+				m_maxFrameAllocations[i] = std::max(m_maxFrameAllocations[i], m_currFrame.allocations[i]);
+			}
+			for (int i = 0; i < T_NumTimers; i++) {
+				for (int j = 0; j < PC_NumCounters; j++) {
+					m_sessionPerfCounts[i][j] += m_currFrame.perfCounts[i][j];
+				}
+			}
+			m_numSessionFrames++;
+		}
+
+		if (m_histogramPending[m_currIndex])
+			addToHistograms(m_buffer[m_currIndex], m_histograms);
 		m_buffer[m_currIndex] = m_currFrame;
+		m_histogramPending[m_currIndex] = recordHistograms;
 		m_currIndex = (m_currIndex + 1) % 20;
 
 		m_numFrames++;
@@ -35,41 +425,108 @@ namespace Copperplate {
 	}
 
 	void Statistics::recordTime(ETimerType timeType, float elapsedTime) {
-		switch (timeType) {
-		case T_RenderContour: m_currFrame.renderContourTime += elapsedTime; break;
-		case T_UpdateHatch: m_currFrame.updateHatchTime += elapsedTime; break;
-		case T_RenderHatch: m_currFrame.renderHatchTime += elapsedTime; break;
-		case T_Advect: m_currFrame.advectTime += elapsedTime; break;
-		case T_Resample: m_currFrame.resampleTime += elapsedTime; break;
-		case T_Relax: m_currFrame.relaxTime += elapsedTime; break;
-		case T_Topology: m_currFrame.topoTime += elapsedTime; break;
-		case T_Delete: m_currFrame.deleteTime += elapsedTime; break;
-		case T_Split: m_currFrame.splitTime += elapsedTime; break;
-		case T_Trim: m_currFrame.trimTime += elapsedTime; break;
-		case T_Extend: m_currFrame.extendTime += elapsedTime; break;
-		case T_Merge: m_currFrame.mergeTime += elapsedTime; break;
-		case T_Insert: m_currFrame.insertTime += elapsedTime; break;
+		getThreadStats().times[timeType] += elapsedTime;
+	}
+
+	void Statistics::recordEvent(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+		if (!m_tracing) return;
+		ThreadStats& thread = getThreadStats();
+		if (thread.numEvents >= (int)thread.events.size()) {
+			thread.numDropped++;
+			return;
+		}
+		TraceEvent& event = thread.events[thread.numEvents++];
+		event.name = name;
+		event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start - m_epoch).count();
+		event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	}
+
+	void Statistics::recordGpuTime(int frameNumber, EGpuTimerType type, int64_t start, int64_t duration) {
+		float time = duration / 1000000.0f;
+		if (frameNumber == m_currFrame.number) {
+			m_currFrame.gpuTimes[type] += time;
+		}
+		else {
+			for (StatFrame& frame : m_buffer) {
+				if (frame.number == frameNumber) {
+					frame.gpuTimes[type] += time;
+					break;
+				}
+			}
+		}
+		if (m_tracing) {
+			m_traceFile << ",\n{\"name\":\"" << getGpuTimerName(type) << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << GPU_TRACE_THREAD
+				<< ",\"ts\":" << start / 1000.0 << ",\"dur\":" << duration / 1000.0 << "}";
 		}
 	}
 
 	void Statistics::countInsertion() {
-		m_currFrame.numInsertions++;
+		getThreadStats().counts[C_Insertions]++;
 	}
 
 	void Statistics::countDeletion() {
-		m_currFrame.numDeletions++;
+		getThreadStats().counts[C_Deletions]++;
 	}
 
 	void Statistics::countMerge() {
-		m_currFrame.numMerges++;
+		getThreadStats().counts[C_Merges]++;
 	}
 
 	void Statistics::countSplit() {
-		m_currFrame.numSplits++;
+		getThreadStats().counts[C_Splits]++;
 	}
 
 	void Statistics::countLines(int count) {
-		m_currFrame.numLines += count;
+		getThreadStats().counts[C_Lines] += count;
+	}
+
+	void Statistics::recordAllocation(size_t size) {
+		ThreadStats& thread = getThreadStats();
+		// only counts, relaxed is enough and keeps the hook cheap
+		thread.allocations[thread.currentStage].fetch_add(1, std::memory_order_relaxed);
+		thread.allocatedBytes[thread.currentStage].fetch_add(size, std::memory_order_relaxed);
+		thread.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+		thread.totalAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	void Statistics::recordFree() {
+		ThreadStats& thread = getThreadStats();
+		thread.frees[thread.currentStage].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	int Statistics::enterStage(ETimerType type) {
+		ThreadStats& thread = getThreadStats();
+		int previous = thread.currentStage;
+		thread.currentStage = type;
+		return previous;
+	}
+
+	void Statistics::leaveStage(int previousStage) {
+		getThreadStats().currentStage = previousStage;
+	}
+
+	void Statistics::enablePerfCounters() {
+		m_countingPerf = true;
+	}
+
+	bool Statistics::isCountingPerf() {
+		return m_countingPerf;
+	}
+
+	bool Statistics::readPerfCounters(uint64_t outValues[PC_NumCounters]) {
+		ThreadStats& thread = getThreadStats();
+		if (!thread.perfCounters) {
+			thread.perfCounters = CreateUnique<PerfCounters>();
+			std::cout << "Hardware counters of thread " << thread.threadIndex << ": " << thread.perfCounters->GetStatus() << std::endl;
+		}
+		return thread.perfCounters->Read(outValues);
+	}
+
+	void Statistics::recordPerfCounts(ETimerType type, const uint64_t start[PC_NumCounters], const uint64_t end[PC_NumCounters]) {
+		ThreadStats& thread = getThreadStats();
+		for (int i = 0; i < PC_NumCounters; i++) {
+			thread.perfCounts[type][i] += end[i] - start[i];
+		}
 	}
 
 	void Statistics::printLastFrame() {
@@ -83,62 +540,391 @@ namespace Copperplate {
 		printFrame(getMeanValues());
 	}
 
+	void Statistics::printPercentiles() {
+		std::vector<Histogram> histograms = getSessionHistograms();
+		std::cout << "Frame Stats over the whole session, " << histograms[0].GetCount() << " frames:" << std::endl;
+		std::cout << std::left << std::setw(24) << "stage" << std::right << std::setw(10) << "mean" << std::setw(10) << "p50"
+			<< std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+		const std::vector<StatFrameField>& fields = getStatFrameFields();
+		for (int i = 0; i < fields.size(); i++) {
+			const Histogram& histogram = histograms[i];
+			// stages that never ran only clutter the table
+			if (histogram.GetMax() == 0.0f) continue;
+			std::cout << std::left << std::setw(24) << fields[i].m_Name << std::right << std::fixed << std::setprecision(3)
+				<< std::setw(10) << histogram.GetMean() << std::setw(10) << histogram.GetPercentile(0.5f) << std::setw(10) << histogram.GetPercentile(0.95f)
+				<< std::setw(10) << histogram.GetPercentile(0.99f) << std::setw(10) << histogram.GetMax() << std::endl;
+		}
+		std::cout.unsetf(std::ios::fixed);
+		printAllocations();
+		printMemory();
+		printPerfCounters();
+	}
+
+	void Statistics::printAllocations() {
+#ifdef COPPERPLATE_ALLOC_TRACKING
+		if (m_numSessionFrames == 0) return;
+		std::cout << "Heap allocations per frame over " << m_numSessionFrames << " frames:" << std::endl;
+		std::cout << std::left << std::setw(24) << "stage" << std::right << std::setw(12) << "allocs" << std::setw(12) << "frees"
+			<< std::setw(12) << "KB" << std::setw(12) << "max allocs" << std::endl;
+		for (int i = 0; i <= T_NumTimers; i++) {
+			if (m_sessionAllocations[i] == 0 && m_sessionFrees[i] == 0) continue;
+			const char* name = (i < T_NumTimers) ? getTimerName((ETimerType)i) : "untimed";
+			std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+				<< std::setw(12) << (double)m_sessionAllocations[i] / m_numSessionFrames
+				<< std::setw(12) << (double)m_sessionFrees[i] / m_numSessionFrames
+				<< std::setw(12) << m_sessionAllocatedBytes[i] / 1024.0 / m_numSessionFrames
+				<< std::setw(12) << m_maxFrameAllocations[i] << std::endl;
+		}
+
+		std::lock_guard<std::mutex> lock(m_threadsMutex);
+		for (const Unique<ThreadStats>& thread : m_threads) {
+			std::cout << "Thread " << thread->threadIndex << ": " << thread->totalAllocations.load(std::memory_order_relaxed) << " allocations, "
+				<< thread->totalAllocatedBytes.load(std::memory_order_relaxed) / (1024.0 * 1024.0) << " MB in total" << std::endl;
+		}
+		std::cout.unsetf(std::ios::fixed);
+#endif
+	}
+
+	void Statistics::printMemory() {
+		std::cout << "Memory per category:" << std::endl;
+		std::cout << std::left << std::setw(24) << "category" << std::right << std::setw(12) << "live MB" << std::setw(12) << "peak MB" << std::endl;
+		for (int i = 0; i < MC_NumCategories; i++) {
+			if (m_peakMemory[i] == 0) continue;
+			std::cout << std::left << std::setw(24) << getMemoryCategoryName((EMemoryCategory)i) << std::right << std::fixed << std::setprecision(2)
+				<< std::setw(12) << m_liveMemory[i] / (1024.0 * 1024.0) << std::setw(12) << m_peakMemory[i] / (1024.0 * 1024.0) << std::endl;
+		}
+		std::cout << std::left << std::setw(24) << "total" << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(12) << getTotalLiveMemory() / (1024.0 * 1024.0) << std::endl;
+		std::cout.unsetf(std::ios::fixed);
+	}
+
+	void Statistics::printImports() {
+		if (m_numImports == 0) return;
+		double megabytes = m_importedBytes / (1024.0 * 1024.0);
+		double seconds = m_importMicroseconds / 1000000.0;
+		std::cout << "Mesh imports: " << m_numImports << " files, " << std::fixed << std::setprecision(2) << megabytes << " MB read, "
+			<< seconds * 1000.0 << " ms parsing";
+		if (seconds > 0.0)
+			std::cout << ", " << megabytes / seconds << " MB/s";
+		std::cout << std::endl;
+		std::cout.unsetf(std::ios::fixed);
+	}
+
+	void Statistics::printPerfCounters() {
+		if (!m_countingPerf || m_numSessionFrames == 0) return;
+		bool anyCounts = false;
+		for (int i = 0; i < T_NumTimers; i++) {
+			anyCounts |= m_sessionPerfCounts[i][PC_Cycles] > 0 || m_sessionPerfCounts[i][PC_Instructions] > 0;
+		}
+		if (!anyCounts) return;
+		std::cout << "Hardware counters per frame over " << m_numSessionFrames << " frames, misses per 1000 instructions:" << std::endl;
+		std::cout << std::left << std::setw(24) << "stage" << std::right << std::setw(12) << "Mcycles" << std::setw(8) << "IPC"
+			<< std::setw(10) << "L1D" << std::setw(10) << "LLC" << std::setw(10) << "branch" << std::endl;
+		for (int i = 0; i < T_NumTimers; i++) {
+			const uint64_t* counts = m_sessionPerfCounts[i];
+			if (counts[PC_Cycles] == 0 && counts[PC_Instructions] == 0) continue;
+			double instructions = std::max((double)counts[PC_Instructions], 1.0);
+			std::cout << std::left << std::setw(24) << getTimerName((ETimerType)i) << std::right << std::fixed << std::setprecision(2)
+				<< std::setw(12) << counts[PC_Cycles] / 1000000.0 / m_numSessionFrames
+				<< std::setw(8) << (counts[PC_Cycles] > 0 ? counts[PC_Instructions] / (double)counts[PC_Cycles] : 0.0)
+				<< std::setw(10) << counts[PC_L1DMisses] * 1000.0 / instructions
+				<< std::setw(10) << counts[PC_LLCMisses] * 1000.0 / instructions
+				<< std::setw(10) << counts[PC_BranchMisses] * 1000.0 / instructions << std::endl;
+		}
+		std::cout.unsetf(std::ios::fixed);
+	}
+
+	bool Statistics::writeHistograms(const std::string& path) {
+		std::vector<Histogram> histograms = getSessionHistograms();
+		const std::vector<StatFrameField>& fields = getStatFrameFields();
+
+		rapidjson::StringBuffer buffer;
+		rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+		writer.StartObject();
+		writer.Key("frames");
+		writer.Int((int)histograms[0].GetCount());
+		writer.Key("fields");
+		writer.StartObject();
+		for (int i = 0; i < fields.size(); i++) {
+			const Histogram& histogram = histograms[i];
+			writer.Key(fields[i].m_Name);
+			writer.StartObject();
+			writer.Key("mean");
+			writer.Double(histogram.GetMean());
+			writer.Key("min");
+			writer.Double(histogram.GetMin());
+			writer.Key("p50");
+			writer.Double(histogram.GetPercentile(0.5f));
+			writer.Key("p95");
+			writer.Double(histogram.GetPercentile(0.95f));
+			writer.Key("p99");
+			writer.Double(histogram.GetPercentile(0.99f));
+			writer.Key("max");
+			writer.Double(histogram.GetMax());
+			// only the filled buckets, as pairs of bucket center and count
+			writer.Key("buckets");
+			writer.StartArray();
+			for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+				uint64_t count = histogram.GetBucketCount(bucket);
+				if (count == 0) continue;
+				writer.StartArray();
+				writer.Double(Histogram::GetBucketValue(bucket));
+				writer.Uint64(count);
+				writer.EndArray();
+			}
+			writer.EndArray();
+			writer.EndObject();
+		}
+		writer.EndObject();
+		writer.EndObject();
+
+		std::ofstream file(path, std::ios::trunc);
+		if (!file.is_open()) {
+			std::cout << "Could not open histogram file " << path << std::endl;
+			return false;
+		}
+		file << buffer.GetString() << std::endl;
+		return true;
+	}
+
+	StatFrame Statistics::getLastFrame() {
+		return m_buffer[(m_currIndex + 19) % 20];
+	}
+
+	StatFrame Statistics::getRecentFrame(int age) {
+		return m_buffer[(m_currIndex + 19 - age % 20) % 20];
+	}
+
+	int Statistics::getFrameNumber() {
+		return m_currFrame.number;
+	}
+
+	int64_t Statistics::getTimestamp() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count();
+	}
+
+	bool Statistics::startTrace(const std::string& path) {
+		stopTrace();
+		m_traceFile.open(path, std::ios::trunc);
+		if (!m_traceFile.is_open()) {
+			std::cout << "Could not open trace file " << path << std::endl;
+			return false;
+		}
+		// timestamps are in microseconds, keep nanosecond resolution for long sessions
+		m_traceFile << std::fixed << std::setprecision(3);
+		m_traceFile << "[\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"Frames\"}}";
+		m_traceFile << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GPU_TRACE_THREAD << ",\"args\":{\"name\":\"GPU\"}}";
+		// the event buffers are only needed while tracing, threads only write to them once m_tracing is set
+		std::lock_guard<std::mutex> lock(m_threadsMutex);
+		for (Unique<ThreadStats>& thread : m_threads) {
+			if (thread->events.empty())
+				thread->events = std::vector<TraceEvent>(MAX_TRACE_EVENTS_PER_FRAME);
+		}
+		m_tracing = true;
+		return true;
+	}
+
+	void Statistics::stopTrace() {
+		if (!m_tracing) return;
+		m_tracing = false;
+		m_traceFile << "\n]\n";
+		m_traceFile.close();
+	}
+
 	void Statistics::printFrame(StatFrame frame) {
 		//std::cout << "Frame " << frame.number << "Total Time: " << frame.totalTime << "ms, divided among" << std::endl
-		//	<< "Contour Rendering: " << frame.renderContourTime << "ms, Line Updating: " << frame.updateHatchTime << "ms, Line Rendering: " << frame.renderHatchTime << "ms" << std::endl;
-		//std::cout << "Update had the steps: Advect " << frame.advectTime << "ms, Resample " << frame.resampleTime << "ms, Relax " << frame.relaxTime << "ms, Delete " << frame.deleteTime
-		//	<< "ms, Split " << frame.splitTime << "ms, Trim " << frame.trimTime << "ms, Extend " << frame.extendTime << "ms, Merge " << frame.mergeTime << "ms, and Insert " << frame.insertTime << "ms." << std::endl;
-		std::cout << "Frame " << frame.number << ": " << frame.numDeletions << " Deletions, " << frame.numSplits << " Splits, " << frame.numMerges << " Merges, " << frame.numInsertions << " Insertions. " << frame.numLines << " Lines in total." << std::endl;
+		//	<< "Contour Rendering: " << frame.times[T_RenderContour] << "ms, Line Updating: " << frame.times[T_UpdateHatch] << "ms, Line Rendering: " << frame.times[T_RenderHatch] << "ms" << std::endl;
+		//std::cout << "Update had the steps: Advect " << frame.times[T_Advect] << "ms, Resample " << frame.times[T_Resample] << "ms, Relax " << frame.times[T_Relax] << "ms, Delete " << frame.times[T_Delete]
+		//	<< "ms, Split " << frame.times[T_Split] << "ms, Trim " << frame.times[T_Trim] << "ms, Extend " << frame.times[T_Extend] << "ms, Merge " << frame.times[T_Merge] << "ms, and Insert " << frame.times[T_Insert] << "ms." << std::endl;
+		std::cout << "Frame " << frame.number << ": " << frame.counts[C_Deletions] << " Deletions, " << frame.counts[C_Splits] << " Splits, " << frame.counts[C_Merges] << " Merges, "
+			<< frame.counts[C_Insertions] << " Insertions. " << frame.counts[C_Lines] << " Lines in total." << std::endl;
 	}
 
 	StatFrame Statistics::getMeanValues() {
 		StatFrame result = StatFrame();
 		for (int i = 0; i < 20; i++) {
 			result.totalTime += m_buffer[i].totalTime;
-			result.renderContourTime += m_buffer[i].renderContourTime;
-			result.updateHatchTime += m_buffer[i].updateHatchTime;
-			result.renderHatchTime += m_buffer[i].renderHatchTime;
-			result.advectTime += m_buffer[i].advectTime;
-			result.resampleTime += m_buffer[i].resampleTime;
-			result.relaxTime += m_buffer[i].relaxTime;
-			result.topoTime += m_buffer[i].topoTime;
-			result.deleteTime += m_buffer[i].deleteTime;
-			result.splitTime += m_buffer[i].splitTime;
-			result.trimTime += m_buffer[i].trimTime;
-			result.extendTime += m_buffer[i].extendTime;
-			result.mergeTime += m_buffer[i].mergeTime;
-			result.insertTime += m_buffer[i].insertTime;
-			result.numInsertions += m_buffer[i].numInsertions;
-			result.numDeletions += m_buffer[i].numDeletions;
-			result.numMerges += m_buffer[i].numMerges;
-			result.numSplits += m_buffer[i].numSplits;
-			result.numLines += m_buffer[i].numLines;
-		}
-		result.totalTime			/= 20.0f;
-		result.renderContourTime	/= 20.0f;
-		result.updateHatchTime		/= 20.0f;
-		result.renderHatchTime		/= 20.0f;
-		result.advectTime			/= 20.0f;
-		result.resampleTime			/= 20.0f;
-		result.relaxTime			/= 20.0f;
-		result.topoTime				/= 20.0f;
-		result.deleteTime			/= 20.0f;
-		result.splitTime			/= 20.0f;
-		result.trimTime				/= 20.0f;
-		result.extendTime			/= 20.0f;
-		result.mergeTime			/= 20.0f;
-		result.insertTime			/= 20.0f;
-		result.numInsertions		/= 20.0f;
-		result.numDeletions			/= 20.0f;
-		result.numMerges			/= 20.0f;
-		result.numSplits			/= 20.0f;
-		result.numLines				/= 20.0f;
+			for (int j = 0; j < T_NumTimers; j++) {
+				result.times[j] += m_buffer[i].times[j];
+			}
+			for (int j = 0; j < GT_NumGpuTimers; j++) {
+				result.gpuTimes[j] += m_buffer[i].gpuTimes[j];
+			}
+			for (int j = 0; j < C_NumCounters; j++) {
+				result.counts[j] += m_buffer[i].counts[j];
+			}
+		}
+		result.totalTime /= 20.0f;
+		for (int j = 0; j < T_NumTimers; j++) {
+			result.times[j] /= 20.0f;
+		}
+		for (int j = 0; j < GT_NumGpuTimers; j++) {
+			result.gpuTimes[j] /= 20.0f;
+		}
+		for (int j = 0; j < C_NumCounters; j++) {
+			result.counts[j] /= 20;
+		}
 
 		return result;
 	}
 
+	std::vector<Histogram> Statistics::getSessionHistograms() {
+		std::vector<Histogram> result = m_histograms;
+		for (int i = 0; i < 20; i++) {
+			if (m_histogramPending[i])
+				addToHistograms(m_buffer[i], result);
+		}
+		return result;
+	}
+
+	void Statistics::addToHistograms(const StatFrame& frame, std::vector<Histogram>& histograms) {
+		const std::vector<StatFrameField>& fields = getStatFrameFields();
+		for (int i = 0; i < fields.size(); i++) {
+			histograms[i].Record(fields[i].GetValue(frame));
+		}
+	}
+
+	ThreadStats& Statistics::getThreadStats() {
+		// every thread registers once, after that no locking or allocation is needed
+		thread_local ThreadStats* threadStats = nullptr;
+		if (!threadStats) {
+			thread_local ThreadStatsOwner owner;
+			std::lock_guard<std::mutex> lock(m_threadsMutex);
+			if (!m_freeThreads.empty()) {
+				threadStats = m_freeThreads.back();
+				m_freeThreads.pop_back();
+			}
+			else {
+				Unique<ThreadStats> stats = CreateUnique<ThreadStats>();
+				stats->currentStage = T_NumTimers;
+				stats->threadIndex = m_threads.size() + 1;
+				if (m_tracing)
+					stats->events = std::vector<TraceEvent>(MAX_TRACE_EVENTS_PER_FRAME);
+				threadStats = stats.get();
+				m_threads.push_back(std::move(stats));
+			}
+			owner.m_Stats = threadStats;
+		}
+		return *threadStats;
+	}
+
+	void Statistics::releaseThreadStats(ThreadStats& thread) {
+		// the perf events follow the thread that opened them, the next owner opens its own
+		thread.perfCounters.reset();
+		thread.currentStage = T_NumTimers;
+		std::lock_guard<std::mutex> lock(m_threadsMutex);
+		m_freeThreads.push_back(&thread);
+	}
+
+	void Statistics::writeTraceEvents(ThreadStats& thread) {
+		if (!thread.named) {
+			m_traceFile << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread.threadIndex
+				<< ",\"args\":{\"name\":\"Thread " << thread.threadIndex << "\"}}";
+			thread.named = true;
+		}
+		for (int i = 0; i < thread.numEvents; i++) {
+			const TraceEvent& event = thread.events[i];
+			m_traceFile << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread.threadIndex
+				<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+		}
+		if (thread.numDropped > 0) {
+			std::cout << "Trace buffer of thread " << thread.threadIndex << " overflowed, " << thread.numDropped << " events of frame " << m_currFrame.number << " are missing" << std::endl;
+		}
+	}
+
+	void Statistics::recordMemory(EMemoryCategory category, int64_t bytes) {
+		int64_t live = m_liveMemory[category].fetch_add(bytes) + bytes;
+		int64_t peak = m_peakMemory[category];
+		while (live > peak && !m_peakMemory[category].compare_exchange_weak(peak, live)) {}
+	}
+
+	int64_t Statistics::getLiveMemory(EMemoryCategory category) {
+		return m_liveMemory[category];
+	}
+
+	int64_t Statistics::getPeakMemory(EMemoryCategory category) {
+		return m_peakMemory[category];
+	}
+
+	int64_t Statistics::getTotalLiveMemory() {
+		int64_t total = 0;
+		for (int i = 0; i < MC_NumCategories; i++) {
+			total += m_liveMemory[i];
+		}
+		return total;
+	}
+
+	void Statistics::recordImport(int64_t bytesRead, float parseTime) {
+		// loader threads import outside of the frames, so the imports are only summed over the session
+		m_numImports++;
+		m_importedBytes += bytesRead;
+		m_importMicroseconds += (int64_t)(parseTime * 1000.0f);
+	}
+
+	ThreadStatsOwner::~ThreadStatsOwner() {
+		if (!m_Stats || !StatisticsExist) return;
+#ifdef COPPERPLATE_ALLOC_TRACKING
+		// the stats may belong to another thread soon, whatever this one frees on its way out is not counted
+		InAllocationHook = true;
+#endif
+		Statistics::Get().releaseThreadStats(*m_Stats);
+	}
+
 	Statistics& Statistics::Get() {
 		static Statistics instance;
 		return instance;
 	}
-}
\ No newline at end of file
+}
+
+#ifdef COPPERPLATE_ALLOC_TRACKING
+// Replaces the global allocation functions, every allocation of the process goes through the statistics
+
+void* operator new(std::size_t size) {
+	void* memory = std::malloc(size > 0 ? size : 1);
+	if (!memory)
+		throw std::bad_alloc();
+	Copperplate::trackAllocation(size);
+	return memory;
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	void* memory = std::malloc(size > 0 ? size : 1);
+	if (memory)
+		Copperplate::trackAllocation(size);
+	return memory;
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+	return operator new(size, tag);
+}
+
+void operator delete(void* memory) noexcept {
+	if (!memory) return;
+	Copperplate::trackFree();
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	operator delete(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+	operator delete(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	operator delete(memory);
+}
+#endif
\ No newline at end of file
@@ -1,7 +1,14 @@
 #pragma once
 #include "core.h"
+#include "histogram.h"
+#include "perfcounters.h"
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <fstream>
 #include <map>
+#include <mutex>
+#include <vector>
 
 namespace Copperplate {
 
@@ -19,76 +26,314 @@ namespace Copperplate {
 		T_Extend,
 		T_Merge,
 		T_Insert,
+		T_Readback,
+		T_DrawHud,
+		T_SaveFrame,
+		T_NumTimers
 	};
 
+	// GPU passes, measured with timer queries and merged into the frame once the results arrived
+	enum EGpuTimerType {
+		GT_Normals,
+		GT_Depth,
+		GT_Movement,
+		GT_Curvature,
+		GT_Diffuse,
+		GT_ShadingGradient,
+		GT_ExtractContours,
+		GT_TransformSeeds,
+		GT_DrawHatching,
+		GT_DrawHud,
+		GT_NumGpuTimers
+	};
+
+	enum ECounterType {
+		C_Insertions,
+		C_Deletions,
+		C_Merges,
+		C_Splits,
+		C_Lines,
+		C_NumCounters
+	};
+
+	// Owners of large data structures report their size in one of these
+	enum EMemoryCategory {
+		MC_Images,			//guiding fields read back for the hatching
+		MC_Seeds,			//object and screen space seeds
+		MC_SeedGrids,		//visible and unused seeds per grid cell
+		MC_CollisionGrids,
+		MC_Lines,			//points and seeds of the hatching lines
+		MC_Contours,		//contour segments read back per object
+		MC_Meshes,			//half-edge data and the vertex data built from it
+		MC_GLBuffers,
+		MC_GLTextures,
+		MC_GLRenderbuffers,
+		MC_NumCategories
+	};
+
+	// Name of the timer in traces
+	const char* getTimerName(ETimerType type);
+	const char* getGpuTimerName(EGpuTimerType type);
+	const char* getMemoryCategoryName(EMemoryCategory category);
+
+	// Measures the scope it lives in on the steady clock, without any allocation.
+	// Scopes nest, in the trace they show up as a hierarchy per thread.
+	// With COPPERPLATE_ALLOC_TRACKING heap allocations are charged to the innermost timer scope,
+	// with hardware counters enabled every timer also reads them at its start and end.
 	class StatTimer {
 	public:
 		StatTimer(ETimerType type);
+		// only shows up in the trace, the name has to be a string literal
+		StatTimer(const char* name);
 		~StatTimer();
 
 	private:
 		ETimerType m_type;
-		clock_t m_start;
+		const char* m_name;
+		std::chrono::steady_clock::time_point m_start;
+		bool m_countingPerf;
+		uint64_t m_perfStart[PC_NumCounters];
+#ifdef COPPERPLATE_ALLOC_TRACKING
+		int m_parentStage;
+#endif
+	};
+
+	// Bytes one object holds in a category. Every change is passed on to the statistics as a difference,
+	// so the live bytes of a category are the sum over all counters that currently exist.
+	class MemoryCounter {
+	public:
+		MemoryCounter(EMemoryCategory category);
+		~MemoryCounter();
+		MemoryCounter(const MemoryCounter&) = delete;
+		MemoryCounter& operator=(const MemoryCounter&) = delete;
+
+		void Set(int64_t bytes);
+		int64_t Get() const;
+
+	private:
+		EMemoryCategory m_category;
+		int64_t m_bytes;
 	};
 
+	// Heap footprint estimates of the standard containers, node based ones pay two pointers per element
+	template<typename Container>
+	int64_t estimateVectorBytes(const Container& container) {
+		return (int64_t)container.capacity() * sizeof(typename Container::value_type);
+	}
+
+	template<typename Container>
+	int64_t estimateHashSetBytes(const Container& container) {
+		return (int64_t)container.bucket_count() * sizeof(void*) + (int64_t)container.size() * (sizeof(typename Container::value_type) + 2 * sizeof(void*));
+	}
+
+	template<typename Container>
+	int64_t estimateNodeBytes(const Container& container) {
+		return (int64_t)container.size() * (sizeof(typename Container::value_type) + 2 * sizeof(void*));
+	}
+
+	// deques allocate blocks of 512 bytes plus a map of block pointers
+	template<typename Container>
+	int64_t estimateDequeBytes(const Container& container) {
+		int64_t blocks = (int64_t)container.size() * sizeof(typename Container::value_type) / 512 + 1;
+		return blocks * (512 + sizeof(void*));
+	}
+
 	struct StatFrame {
 		int number;
 		float totalTime;
-		float renderContourTime;
-		float updateHatchTime;
-		float renderHatchTime;
-		float advectTime;
-		float resampleTime;
-		float relaxTime;
-		float topoTime;
-		float deleteTime;
-		float splitTime;
-		float trimTime;
-		float extendTime;
-		float mergeTime;
-		float insertTime;
-		int numInsertions;
-		int numDeletions;
-		int numMerges;
-		int numSplits;
-		int numLines;
+		float times[T_NumTimers];		//ms spent in the scopes of each timer, summed over all threads
+		float gpuTimes[GT_NumGpuTimers];	//ms the GPU spent in each pass, zero until the queries are read back
+		int counts[C_NumCounters];
+		// heap allocations per timer, the last entry collects everything outside of a timer scope
+		int allocations[T_NumTimers + 1];
+		int frees[T_NumTimers + 1];
+		int64_t allocatedBytes[T_NumTimers + 1];
+		uint64_t perfCounts[T_NumTimers][PC_NumCounters];	//hardware counters per timer, zero unless enabled
+		int64_t memoryBytes[MC_NumCategories];	//live bytes of every category at the end of the frame
+	};
+
+	enum EStatFieldType {
+		SF_TotalTime,
+		SF_Timer,
+		SF_GpuTimer,
+		SF_Counter,
+		SF_Allocations,
+		SF_Frees,
+		SF_AllocatedBytes,
+		SF_PerfCounter,
+		SF_Memory,
+	};
+
+	// Name and index of every StatFrame value, either a time in ms or a count. Allocations are summed over all timers,
+	// hardware counters are the ones of the whole hatching update, memory is in bytes.
+	struct StatFrameField {
+		const char* m_Name;
+		EStatFieldType m_Type;
+		int m_Index;
+
+		float GetValue(const StatFrame& frame) const;
+	};
+
+	const std::vector<StatFrameField>& getStatFrameFields();
+
+	// Compares two dumps written by Statistics::writeHistograms and prints every time whose p50, p95 or p99
+	// got slower by more than tolerance. Returns false if a dump could not be read.
+	bool compareHistogramDumps(const std::string& basePath, const std::string& newPath, float tolerance, bool& outRegressed);
+
+	struct TraceEvent {
+		const char* name;
+		int64_t start;		//ns since the statistics were created
+		int64_t duration;	//ns
+	};
+
+	// Everything one thread records during a frame. Only the owning thread writes to it,
+	// newFrame collects it while no other thread is inside a timed scope. Allocations also
+	// happen outside of timed scopes on the encoder and loader threads, so their counters
+	// are atomic and newFrame swaps them out.
+	struct ThreadStats {
+		int threadIndex;
+		float times[T_NumTimers];
+		int counts[C_NumCounters];
+		int currentStage;	//innermost timer scope, T_NumTimers outside of all of them
+		std::atomic<int> allocations[T_NumTimers + 1];
+		std::atomic<int> frees[T_NumTimers + 1];
+		std::atomic<int64_t> allocatedBytes[T_NumTimers + 1];
+		std::atomic<int64_t> totalAllocations;	//over the whole session
+		std::atomic<int64_t> totalAllocatedBytes;
+		Unique<PerfCounters> perfCounters;	//opened on the first timer after they were enabled
+		uint64_t perfCounts[T_NumTimers][PC_NumCounters];
+		std::vector<TraceEvent> events;		//allocated once tracing starts, events beyond the capacity are dropped
+		int numEvents;
+		int numDropped;
+		bool named;
 	};
 
 	class Statistics {
 	public:
 
 		Statistics();
+		~Statistics();
 
-		void newFrame();
+		// Frames that only did setup work can be kept out of the session histograms
+		void newFrame(bool recordHistograms = true);
 
 		void recordTime(ETimerType timeType, float elapsedTime);
+		void recordEvent(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+		// start is in ns since the statistics were created, the frame may already be finished
+		void recordGpuTime(int frameNumber, EGpuTimerType type, int64_t start, int64_t duration);
 
 		void countInsertion();
 		void countDeletion();
 		void countMerge();
 		void countSplit();
 		void countLines(int count);
-		
+
+		// Called by the allocation hook, only with COPPERPLATE_ALLOC_TRACKING
+		void recordAllocation(size_t size);
+		void recordFree();
+		// Makes type the stage allocations are charged to, returns the previous one for leaveStage
+		int enterStage(ETimerType type);
+		void leaveStage(int previousStage);
+
+		// Called by MemoryCounter with the change in bytes
+		void recordMemory(EMemoryCategory category, int64_t bytes);
+		int64_t getLiveMemory(EMemoryCategory category);
+		int64_t getPeakMemory(EMemoryCategory category);
+		int64_t getTotalLiveMemory();
+
+		// Called by the mesh import for every file with the bytes the importer read and the time it took, from any thread
+		void recordImport(int64_t bytesRead, float parseTime);
+
+		// Hardware counters around every timer scope, on Linux through perf_event_open
+		void enablePerfCounters();
+		bool isCountingPerf();
+		bool readPerfCounters(uint64_t outValues[PC_NumCounters]);
+		void recordPerfCounts(ETimerType type, const uint64_t start[PC_NumCounters], const uint64_t end[PC_NumCounters]);
+
 		void printLastFrame();
 		void printMeanValues();
+		// p50, p95, p99 and max of every StatFrame field over the whole session
+		void printPercentiles();
+		bool writeHistograms(const std::string& path);
+		// Allocations per frame of every stage and allocations per thread over the whole session
+		void printAllocations();
+		// Cycles, IPC and misses per thousand instructions of every stage over the whole session
+		void printPerfCounters();
+		// Live and peak bytes of every memory category
+		void printMemory();
+		// Files, bytes and parse time of the mesh imports of the session
+		void printImports();
 
+		StatFrame getLastFrame();
+		// age 0 is the last finished frame, up to 19 frames back. GPU times of the newest frames may still be missing,
+		// the number is -1 if there was no such frame yet.
+		StatFrame getRecentFrame(int age);
+		int getFrameNumber();
+		// ns since the statistics were created, the time base of all trace events
+		int64_t getTimestamp();
+
+		// Chrome trace event json, open it in chrome://tracing or ui.perfetto.dev
+		bool startTrace(const std::string& path);
+		void stopTrace();
 
 		static Statistics& Get();
 
 	private:
 		void printFrame(StatFrame frame);
 		StatFrame getMeanValues();
+		// Histograms of all recorded frames, including the ones still waiting for their GPU times
+		std::vector<Histogram> getSessionHistograms();
+		void addToHistograms(const StatFrame& frame, std::vector<Histogram>& histograms);
+
+		ThreadStats& getThreadStats();
+		// Called when the owning thread exits, the next new thread takes the stats over
+		void releaseThreadStats(ThreadStats& thread);
+		void writeTraceEvents(ThreadStats& thread);
+		friend struct ThreadStatsOwner;
 
 		int m_numFrames;
 
-		clock_t m_currFrameStart;
+		std::chrono::steady_clock::time_point m_epoch;
+		std::chrono::steady_clock::time_point m_currFrameStart;
 		StatFrame m_currFrame;
 
 		int m_currIndex;
 		StatFrame m_buffer[20];
+		bool m_histogramPending[20];	//frames go into the histograms when they leave the buffer, late GPU times included
+
+		std::vector<Histogram> m_histograms;	//one per StatFrame field, over the whole session
+
+		int m_numSessionFrames;
+		int64_t m_sessionAllocations[T_NumTimers + 1];
+		int64_t m_sessionFrees[T_NumTimers + 1];
+		int64_t m_sessionAllocatedBytes[T_NumTimers + 1];
+		int m_maxFrameAllocations[T_NumTimers + 1];
+		uint64_t m_sessionPerfCounts[T_NumTimers][PC_NumCounters];
+		std::atomic<bool> m_countingPerf;
+		std::atomic<int64_t> m_liveMemory[MC_NumCategories];
+		std::atomic<int64_t> m_peakMemory[MC_NumCategories];
+		std::atomic<int> m_numImports;
+		std::atomic<int64_t> m_importedBytes;
+		std::atomic<int64_t> m_importMicroseconds;
+
+		std::mutex m_threadsMutex;
+		std::vector<Unique<ThreadStats>> m_threads;
+		std::vector<ThreadStats*> m_freeThreads;	//of exited threads, their counts are still collected
+
+		std::atomic<bool> m_tracing;
+		std::ofstream m_traceFile;
 	};
-	
-#define TIME_FUNCTION(timertype) Unique<StatTimer> timer = CreateUnique<StatTimer>(timertype)
+
+	// Profiling scopes are compiled out unless COPPERPLATE_PROFILE is defined, counters always stay
+#define STAT_CONCAT_(a, b) a##b
+#define STAT_CONCAT(a, b) STAT_CONCAT_(a, b)
+#ifdef COPPERPLATE_PROFILE
+#define TIME_FUNCTION(timertype) StatTimer STAT_CONCAT(statTimer, __LINE__)(timertype)
+#define TIME_SCOPE(name) StatTimer STAT_CONCAT(statTimer, __LINE__)(name)
+#else
+#define TIME_FUNCTION(timertype)
+#define TIME_SCOPE(name)
+#endif
 #define STAT_COUNT_INSERTION Statistics::Get().countInsertion()
 #define STAT_COUNT_DELETION Statistics::Get().countDeletion()
 #define STAT_COUNT_MERGE Statistics::Get().countMerge()
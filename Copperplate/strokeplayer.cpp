@@ -0,0 +1,155 @@
+#pragma once
+
+#include "strokestream.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+using namespace Copperplate;
+
+// Renders the lines of a stroke stream written with --strokes into png frames at any scale. Only the
+// stream is decoded, the scene and the stroke simulation are not needed.
+
+void printUsage() {
+	std::cout << "Usage: CopperplatePlayer <stream> [options]" << std::endl
+		<< "  --output <dir>  save the frames as png into dir, without it the stream is only decoded" << std::endl
+		<< "  --scale <f>     render at f times the recorded viewport size, default 1" << std::endl
+		<< "  --width <px>    line width in recorded pixels, default 1.5" << std::endl
+		<< "  --frame <n>     only render frame n, decoding starts at the keyframe before it" << std::endl
+		<< "  --frames <n>    only render the first n frames" << std::endl;
+}
+
+// Draws the polyline as antialiased capsules, overlapping segments do not darken each other
+void drawLine(const std::vector<glm::vec2>& points, float scale, float width, glm::ivec2 size, int stride, std::vector<unsigned char>& pixels) {
+	float radius = 0.5f * width * scale;
+	for (int i = 0; i + 1 < points.size(); i++) {
+		glm::vec2 start = points[i] * scale;
+		glm::vec2 end = points[i + 1] * scale;
+		glm::vec2 segment = end - start;
+		float lengthSquared = glm::dot(segment, segment);
+		glm::ivec2 min = glm::max(glm::ivec2(glm::floor(glm::min(start, end) - radius - 1.0f)), glm::ivec2(0));
+		glm::ivec2 max = glm::min(glm::ivec2(glm::ceil(glm::max(start, end) + radius + 1.0f)), size - glm::ivec2(1));
+		for (int y = min.y; y <= max.y; y++) {
+			for (int x = min.x; x <= max.x; x++) {
+				glm::vec2 pixel = glm::vec2(x, y) + 0.5f;
+				float t = (lengthSquared > 0.0f) ? glm::clamp(glm::dot(pixel - start, segment) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+				float coverage = glm::clamp(radius + 0.5f - glm::distance(pixel, start + t * segment), 0.0f, 1.0f);
+				unsigned char value = (unsigned char)std::round(255.0f * (1.0f - coverage));
+				unsigned char* target = &pixels[y * stride + 3 * x];
+				for (int c = 0; c < 3; c++) {
+					target[c] = std::min(target[c], value);
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		printUsage();
+		return 1;
+	}
+	std::string streamPath = argv[1];
+	std::string outputDir;
+	float scale = 1.0f;
+	float width = 1.5f;
+	int singleFrame = -1;
+	int maxFrames = -1;
+	for (int i = 2; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+		if (arg == "--output" && hasValue) {
+			outputDir = argv[++i];
+		}
+		else if (arg == "--scale" && hasValue) {
+			scale = (float)std::atof(argv[++i]);
+		}
+		else if (arg == "--width" && hasValue) {
+			width = (float)std::atof(argv[++i]);
+		}
+		else if (arg == "--frame" && hasValue) {
+			singleFrame = std::atoi(argv[++i]);
+		}
+		else if (arg == "--frames" && hasValue) {
+			maxFrames = std::atoi(argv[++i]);
+		}
+		else {
+			printUsage();
+			return 1;
+		}
+	}
+	if (scale <= 0.0f || width <= 0.0f) {
+		std::cout << "Scale and line width have to be positive" << std::endl;
+		return 1;
+	}
+
+	StrokeStreamReader reader;
+	if (!reader.Open(streamPath))
+		return 1;
+	if (!outputDir.empty()) {
+		std::error_code error;
+		std::filesystem::create_directories(outputDir, error);
+		if (error) {
+			std::cout << "Could not create output directory " << outputDir << ": " << error.message() << std::endl;
+			return 1;
+		}
+	}
+
+	int firstFrame = 0;
+	int endFrame = reader.GetNumFrames();
+	if (maxFrames >= 0)
+		endFrame = std::min(endFrame, maxFrames);
+	if (singleFrame >= 0) {
+		if (singleFrame >= reader.GetNumFrames()) {
+			std::cout << "Stroke stream " << streamPath << " only has " << reader.GetNumFrames() << " frames" << std::endl;
+			return 1;
+		}
+		firstFrame = singleFrame;
+		endFrame = singleFrame + 1;
+	}
+
+	glm::ivec2 size = glm::ivec2(glm::round(glm::vec2(reader.GetViewportSize()) * scale));
+	int stride = (int)ceil((float)(size.x * 3) / 4.0f) * 4;
+	std::vector<unsigned char> pixels;
+	std::vector<std::vector<glm::vec2>> lines;
+	float decodeTime = 0.0f;
+	int64_t numLines = 0;
+	for (int frame = firstFrame; frame < endFrame; frame++) {
+		auto start = std::chrono::steady_clock::now();
+		if (!reader.ReadFrame(frame))
+			return 1;
+		decodeTime += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if (!outputDir.empty())
+			pixels.assign(stride * size.y, 255);
+		for (int layer = 0; layer < reader.GetNumLayers(); layer++) {
+			reader.GetLines(layer, lines);
+			numLines += lines.size();
+			if (outputDir.empty())
+				continue;
+			for (const std::vector<glm::vec2>& line : lines) {
+				drawLine(line, scale, width, size, stride, pixels);
+			}
+		}
+		if (!outputDir.empty()) {
+			std::ostringstream path;
+			path << outputDir << "/" << std::setfill('0') << std::setw(5) << frame << ".png";
+			writePngImage(path.str(), size, pixels.data(), 3);
+		}
+	}
+
+	int numFrames = endFrame - firstFrame;
+	std::error_code error;
+	int64_t fileSize = std::filesystem::file_size(streamPath, error);
+	std::cout << "Played " << numFrames << " of " << reader.GetNumFrames() << " frames of " << streamPath
+		<< " (" << fileSize / 1024 << " KiB, " << reader.GetViewportSize().x << "x" << reader.GetViewportSize().y << ")" << std::endl;
+	if (numFrames > 0) {
+		std::cout << std::fixed << std::setprecision(3) << "decoding took " << decodeTime / numFrames << " ms per frame, "
+			<< numLines / numFrames << " lines per frame" << std::endl;
+	}
+	return 0;
+}
\ No newline at end of file
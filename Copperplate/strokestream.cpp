@@ -0,0 +1,462 @@
+#pragma once
+
+#include "strokestream.h"
+#include "statistics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
+
+namespace Copperplate {
+
+	void writeVarint(std::vector<uint8_t>& buffer, uint32_t value) {
+		while (value >= 0x80) {
+			buffer.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		buffer.push_back((uint8_t)value);
+	}
+
+	void writeZigzag(std::vector<uint8_t>& buffer, int32_t value) {
+		writeVarint(buffer, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+	}
+
+	bool readVarint(const std::vector<uint8_t>& buffer, size_t& inOutPos, uint32_t& outValue) {
+		outValue = 0;
+		for (int shift = 0; shift < 35; shift += 7) {
+			if (inOutPos >= buffer.size()) return false;
+			uint8_t byte = buffer[inOutPos++];
+			outValue |= (uint32_t)(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0) return true;
+		}
+		return false;
+	}
+
+	bool readZigzag(const std::vector<uint8_t>& buffer, size_t& inOutPos, int32_t& outValue) {
+		uint32_t value;
+		if (!readVarint(buffer, inOutPos, value)) return false;
+		outValue = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+		return true;
+	}
+
+	int getNumEventLines(ELineEvents type) {
+		switch (type) {
+		case LE_Split:
+			return 2;
+		case LE_Merge:
+			return 3;
+		default:
+			return 1;
+		}
+	}
+
+	// Lines created by a split or merge are predicted from the line they came from
+	void collectParents(const std::vector<LineEvent>& events, std::unordered_map<int, int>& outParents) {
+		outParents.clear();
+		for (const LineEvent& event : events) {
+			if (event.m_Type == LE_Split)
+				outParents[event.m_Lines[1]] = event.m_Lines[0];
+			else if (event.m_Type == LE_Merge)
+				outParents[event.m_Lines[2]] = event.m_Lines[0];
+		}
+	}
+
+	const std::vector<glm::ivec2>* findReference(int id, const StrokeStreamLayer& previous, const std::unordered_map<int, int>& parents) {
+		// parents always have smaller ids, so this ends
+		while (true) {
+			auto line = previous.find(id);
+			if (line != previous.end()) return &line->second;
+			auto parent = parents.find(id);
+			if (parent == parents.end()) return nullptr;
+			id = parent->second;
+		}
+	}
+
+	int64_t squaredDistance(glm::ivec2 a, glm::ivec2 b) {
+		int64_t x = a.x - b.x;
+		int64_t y = a.y - b.y;
+		return x * x + y * y;
+	}
+
+	// Index offset of the reference against the line, either the front was cut off or points were added to it
+	int findAlignment(const std::vector<glm::ivec2>& points, const std::vector<glm::ivec2>& reference) {
+		int cutFront = 0;
+		int64_t cutDistance = std::numeric_limits<int64_t>::max();
+		for (int j = 0; j < reference.size(); j++) {
+			int64_t distance = squaredDistance(points[0], reference[j]);
+			if (distance < cutDistance) {
+				cutDistance = distance;
+				cutFront = j;
+			}
+		}
+		int extendedFront = 0;
+		int64_t extendedDistance = std::numeric_limits<int64_t>::max();
+		for (int i = 0; i < points.size(); i++) {
+			int64_t distance = squaredDistance(points[i], reference[0]);
+			if (distance < extendedDistance) {
+				extendedDistance = distance;
+				extendedFront = i;
+			}
+		}
+		return (cutDistance <= extendedDistance) ? cutFront : -extendedFront;
+	}
+
+	// Only uses the points before index, the reader has not decoded the others yet. Lines without reference
+	// start where the line before them started, new lines are inserted next to each other.
+	glm::ivec2 predictPoint(const std::vector<glm::ivec2>& points, int index, const std::vector<glm::ivec2>* reference, int offset, glm::ivec2 lastStart) {
+		if (reference) {
+			int j = index + offset;
+			if (j >= 0 && j < reference->size()) {
+				if (index > 0 && j > 0)
+					return (*reference)[j] + points[index - 1] - (*reference)[j - 1];
+				return (*reference)[j];
+			}
+		}
+		if (index >= 2)
+			return 2 * points[index - 1] - points[index - 2];
+		if (index == 1)
+			return points[0];
+		if (reference)
+			return (*reference)[glm::clamp(index + offset, 0, (int)reference->size() - 1)];
+		return lastStart;
+	}
+
+	// STROKE STREAM WRITER IMPLEMENTATION
+	StrokeStreamWriter::StrokeStreamWriter() {
+		m_KeyframeInterval = STROKESTREAM_KEYFRAME_INTERVAL;
+		m_NumFrames = 0;
+		m_NumBytes = 0;
+	}
+
+	bool StrokeStreamWriter::Open(const std::string& path, Hatching& hatching, int keyframeInterval) {
+		m_File.open(path, std::ios::binary | std::ios::trunc);
+		if (!m_File.is_open()) {
+			std::cout << "Could not open stroke stream " << path << std::endl;
+			return false;
+		}
+		m_KeyframeInterval = std::max(1, keyframeInterval);
+		m_NumFrames = 0;
+
+		glm::ivec2 size = glm::ivec2(hatching.GetViewportSize());
+		uint32_t header[6] = { STROKESTREAM_MAGIC, STROKESTREAM_VERSION, (uint32_t)size.x, (uint32_t)size.y,
+			(uint32_t)hatching.GetLayers().size(), (uint32_t)STROKESTREAM_SUBPIXELS };
+		m_File.write((const char*)header, sizeof(header));
+		m_NumBytes = sizeof(header);
+		m_Layers = std::vector<StrokeStreamLayer>(hatching.GetLayers().size());
+		return (bool)m_File;
+	}
+
+	void StrokeStreamWriter::WriteFrame(Hatching& hatching) {
+		TIME_FUNCTION(T_SaveFrame);
+		const std::vector<Unique<HatchingLayer>>& layers = hatching.GetLayers();
+
+		// lines that changed without an event, e.g. after a regeneration, need a keyframe
+		bool isKeyframe = (m_NumFrames % m_KeyframeInterval == 0);
+		for (int l = 0; l < layers.size() && !isKeyframe; l++) {
+			isKeyframe = !CheckEvents(*layers[l], m_Layers[l]);
+		}
+
+		m_Buffer.clear();
+		m_Buffer.push_back(isKeyframe ? 1 : 0);
+		for (int l = 0; l < layers.size(); l++) {
+			HatchingLayer& layer = *layers[l];
+			StrokeStreamLayer& previous = m_Layers[l];
+			if (isKeyframe) {
+				previous.clear();
+				writeVarint(m_Buffer, 0);
+				m_Parents.clear();
+			}
+			else {
+				const std::vector<LineEvent>& events = layer.GetLineEvents();
+				writeVarint(m_Buffer, events.size());
+				int lastId = 0;
+				for (const LineEvent& event : events) {
+					m_Buffer.push_back((uint8_t)event.m_Type);
+					for (int i = 0; i < getNumEventLines(event.m_Type); i++) {
+						writeZigzag(m_Buffer, event.m_Lines[i] - lastId);
+						lastId = event.m_Lines[i];
+					}
+				}
+				collectParents(events, m_Parents);
+			}
+
+			m_Current.clear();
+			m_ChangedLines.clear();
+			for (const HatchingLine& line : layer.GetLines()) {
+				std::vector<glm::ivec2>& points = m_Current[line.GetId()];
+				points.reserve(line.getPoints().size());
+				for (glm::vec2 point : line.getPoints()) {
+					points.push_back(glm::ivec2(glm::round(point * (float)STROKESTREAM_SUBPIXELS)));
+				}
+				auto same = previous.find(line.GetId());
+				if (same == previous.end() || same->second != points)
+					m_ChangedLines.push_back(line.GetId());
+			}
+
+			// sorted ids only need small deltas
+			std::sort(m_ChangedLines.begin(), m_ChangedLines.end());
+			writeVarint(m_Buffer, m_ChangedLines.size());
+			int lastId = 0;
+			glm::ivec2 lastStart = glm::ivec2(0);
+			for (int id : m_ChangedLines) {
+				const std::vector<glm::ivec2>& points = m_Current[id];
+				const std::vector<glm::ivec2>* reference = findReference(id, previous, m_Parents);
+				writeZigzag(m_Buffer, id - lastId);
+				lastId = id;
+				writeVarint(m_Buffer, points.size());
+				int offset = 0;
+				if (reference) {
+					offset = findAlignment(points, *reference);
+					writeZigzag(m_Buffer, offset);
+				}
+				for (int i = 0; i < points.size(); i++) {
+					glm::ivec2 residual = points[i] - predictPoint(points, i, reference, offset, lastStart);
+					writeZigzag(m_Buffer, residual.x);
+					writeZigzag(m_Buffer, residual.y);
+				}
+				lastStart = points[0];
+			}
+			std::swap(previous, m_Current);
+		}
+
+		uint32_t size = m_Buffer.size();
+		m_File.write((const char*)&size, sizeof(uint32_t));
+		m_File.write((const char*)m_Buffer.data(), size);
+		m_NumBytes += sizeof(uint32_t) + size;
+		m_NumFrames++;
+	}
+
+	bool StrokeStreamWriter::Close() {
+		if (!m_File.is_open()) return true;
+		m_File.close();
+		return !m_File.fail();
+	}
+
+	int StrokeStreamWriter::GetNumFrames() {
+		return m_NumFrames;
+	}
+
+	int64_t StrokeStreamWriter::GetNumBytes() {
+		return m_NumBytes;
+	}
+
+	bool StrokeStreamWriter::CheckEvents(HatchingLayer& layer, const StrokeStreamLayer& previous) {
+		std::unordered_set<int> ids;
+		for (const auto& [id, points] : previous) {
+			ids.insert(id);
+		}
+		for (const LineEvent& event : layer.GetLineEvents()) {
+			switch (event.m_Type) {
+			case LE_Insert:
+				if (!ids.insert(event.m_Lines[0]).second) return false;
+				break;
+			case LE_Delete:
+				if (ids.erase(event.m_Lines[0]) == 0) return false;
+				break;
+			case LE_Split:
+				if (ids.count(event.m_Lines[0]) == 0 || !ids.insert(event.m_Lines[1]).second) return false;
+				break;
+			case LE_Merge:
+				if (ids.erase(event.m_Lines[0]) == 0 || ids.erase(event.m_Lines[1]) == 0 || !ids.insert(event.m_Lines[2]).second) return false;
+				break;
+			}
+		}
+		const std::list<HatchingLine>& lines = layer.GetLines();
+		if (ids.size() != lines.size()) return false;
+		for (const HatchingLine& line : lines) {
+			if (ids.count(line.GetId()) == 0) return false;
+		}
+		return true;
+	}
+
+	// STROKE STREAM READER IMPLEMENTATION
+	StrokeStreamReader::StrokeStreamReader() {
+		m_ViewportSize = glm::ivec2(0);
+		m_CurrentFrame = -1;
+	}
+
+	bool StrokeStreamReader::Open(const std::string& path) {
+		m_Path = path;
+		m_File.open(path, std::ios::binary);
+		if (!m_File.is_open()) {
+			std::cout << "Could not open stroke stream " << path << std::endl;
+			return false;
+		}
+		uint32_t header[6];
+		m_File.read((char*)header, sizeof(header));
+		if (!m_File || header[0] != STROKESTREAM_MAGIC) {
+			std::cout << path << " is not a stroke stream" << std::endl;
+			return false;
+		}
+		if (header[1] != STROKESTREAM_VERSION || header[5] != STROKESTREAM_SUBPIXELS) {
+			std::cout << "Stroke stream " << path << " has version " << header[1] << ", expected " << STROKESTREAM_VERSION << std::endl;
+			return false;
+		}
+		m_ViewportSize = glm::ivec2(header[2], header[3]);
+		m_Layers = std::vector<StrokeStreamLayer>(header[4]);
+
+		// a frame that was cut off when the writer did not finish is left out
+		m_File.seekg(0, std::ios::end);
+		int64_t fileSize = m_File.tellg();
+		int64_t offset = sizeof(header);
+		m_FrameOffsets.clear();
+		m_IsKeyframe.clear();
+		while (offset + (int64_t)sizeof(uint32_t) < fileSize) {
+			uint32_t size;
+			char keyframe;
+			m_File.seekg(offset);
+			m_File.read((char*)&size, sizeof(uint32_t));
+			m_File.read(&keyframe, 1);
+			if (!m_File || size == 0 || offset + (int64_t)sizeof(uint32_t) + size > fileSize)
+				break;
+			m_FrameOffsets.push_back(offset);
+			m_IsKeyframe.push_back(keyframe != 0);
+			offset += sizeof(uint32_t) + size;
+		}
+		m_File.clear();
+		m_CurrentFrame = -1;
+		return true;
+	}
+
+	int StrokeStreamReader::GetNumFrames() {
+		return m_FrameOffsets.size();
+	}
+
+	glm::ivec2 StrokeStreamReader::GetViewportSize() {
+		return m_ViewportSize;
+	}
+
+	int StrokeStreamReader::GetNumLayers() {
+		return m_Layers.size();
+	}
+
+	bool StrokeStreamReader::ReadFrame(int frame) {
+		if (frame < 0 || frame >= m_FrameOffsets.size()) return false;
+		if (frame == m_CurrentFrame) return true;
+
+		int start = frame;
+		while (start > 0 && !m_IsKeyframe[start]) {
+			start--;
+		}
+		if (m_CurrentFrame >= start && m_CurrentFrame < frame)
+			start = m_CurrentFrame + 1;
+		for (int current = start; current <= frame; current++) {
+			if (!DecodeFrame(current)) {
+				std::cout << "Stroke stream " << m_Path << " is corrupt at frame " << current << std::endl;
+				m_CurrentFrame = -1;
+				return false;
+			}
+		}
+		m_CurrentFrame = frame;
+		return true;
+	}
+
+	void StrokeStreamReader::GetLines(int layer, std::vector<std::vector<glm::vec2>>& outLines) {
+		outLines.clear();
+		if (layer < 0 || layer >= m_Layers.size()) return;
+		std::vector<int> ids;
+		for (const auto& [id, points] : m_Layers[layer]) {
+			ids.push_back(id);
+		}
+		std::sort(ids.begin(), ids.end());
+		for (int id : ids) {
+			std::vector<glm::vec2> line;
+			for (glm::ivec2 point : m_Layers[layer][id]) {
+				line.push_back(glm::vec2(point) / (float)STROKESTREAM_SUBPIXELS);
+			}
+			outLines.push_back(std::move(line));
+		}
+	}
+
+	// PRIVATE FUNCTIONS
+
+	bool StrokeStreamReader::DecodeFrame(int frame) {
+		uint32_t size;
+		m_File.seekg(m_FrameOffsets[frame]);
+		m_File.read((char*)&size, sizeof(uint32_t));
+		m_Buffer.resize(size);
+		m_File.read((char*)m_Buffer.data(), size);
+		if (!m_File) {
+			m_File.clear();
+			return false;
+		}
+
+		size_t pos = 0;
+		bool isKeyframe = m_Buffer[pos++] != 0;
+		for (StrokeStreamLayer& layer : m_Layers) {
+			if (isKeyframe)
+				layer.clear();
+
+			uint32_t numEvents;
+			if (!readVarint(m_Buffer, pos, numEvents)) return false;
+			m_Events.clear();
+			int lastId = 0;
+			for (uint32_t i = 0; i < numEvents; i++) {
+				if (pos >= m_Buffer.size() || m_Buffer[pos] > LE_Merge) return false;
+				LineEvent event = { (ELineEvents)m_Buffer[pos++], { -1, -1, -1 } };
+				for (int j = 0; j < getNumEventLines(event.m_Type); j++) {
+					int32_t delta;
+					if (!readZigzag(m_Buffer, pos, delta)) return false;
+					lastId += delta;
+					event.m_Lines[j] = lastId;
+				}
+				m_Events.push_back(event);
+			}
+			collectParents(m_Events, m_Parents);
+
+			// the lines are predicted from the previous frame, so the events are applied after decoding them
+			uint32_t numLines;
+			if (!readVarint(m_Buffer, pos, numLines)) return false;
+			m_Decoded.clear();
+			lastId = 0;
+			glm::ivec2 lastStart = glm::ivec2(0);
+			for (uint32_t i = 0; i < numLines; i++) {
+				int32_t delta;
+				uint32_t numPoints;
+				if (!readZigzag(m_Buffer, pos, delta) || !readVarint(m_Buffer, pos, numPoints)) return false;
+				lastId += delta;
+				const std::vector<glm::ivec2>* reference = findReference(lastId, layer, m_Parents);
+				int32_t offset = 0;
+				if (reference && !readZigzag(m_Buffer, pos, offset)) return false;
+
+				std::vector<glm::ivec2>& points = m_Decoded[lastId];
+				points.reserve(numPoints);
+				for (uint32_t j = 0; j < numPoints; j++) {
+					glm::ivec2 residual;
+					if (!readZigzag(m_Buffer, pos, residual.x) || !readZigzag(m_Buffer, pos, residual.y)) return false;
+					points.push_back(predictPoint(points, j, reference, offset, lastStart) + residual);
+				}
+				if (numPoints == 0) return false;
+				lastStart = points[0];
+			}
+
+			for (const LineEvent& event : m_Events) {
+				switch (event.m_Type) {
+				case LE_Insert:
+					layer[event.m_Lines[0]];
+					break;
+				case LE_Delete:
+					layer.erase(event.m_Lines[0]);
+					break;
+				case LE_Split:
+					layer[event.m_Lines[1]];
+					break;
+				case LE_Merge:
+					layer.erase(event.m_Lines[0]);
+					layer.erase(event.m_Lines[1]);
+					layer[event.m_Lines[2]];
+					break;
+				}
+			}
+			for (auto& [id, points] : m_Decoded) {
+				layer[id] = std::move(points);
+			}
+			// every new line has to come with its points
+			for (const auto& [id, points] : layer) {
+				if (points.empty()) return false;
+			}
+		}
+		return pos == m_Buffer.size();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "hatching.h"
+
+#include <glm/ext/vector_int2.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Copperplate {
+
+	// Binary archive of the hatching lines of an animation, small enough to keep whole renders as geometry.
+	// Layout: a header with the viewport size and the number of layers, then per frame its byte size, a
+	// keyframe flag and per layer the line events of the frame followed by the lines whose points changed.
+	// Points are quantized to STROKESTREAM_SUBPIXELS steps per pixel and predicted from the same line in the
+	// previous frame, shifted by the movement of the point before. Lines that were split off or merged are
+	// predicted from the line they came from, inserted lines only from their own preceding points. Only the
+	// residuals are stored as zigzag varints, so advected lines take about two bytes per point.
+	// Keyframes store all lines without prediction, a reader seeks to any frame from the keyframe before it.
+	const uint32_t STROKESTREAM_MAGIC = 0x53535043;	//"CPSS"
+	const uint32_t STROKESTREAM_VERSION = 1;
+	const int STROKESTREAM_SUBPIXELS = 8;
+	const int STROKESTREAM_KEYFRAME_INTERVAL = 120;
+
+	// Quantized points of the lines of one layer by line id
+	using StrokeStreamLayer = std::unordered_map<int, std::vector<glm::ivec2>>;
+
+	class StrokeStreamWriter {
+	public:
+
+		StrokeStreamWriter();
+
+		bool Open(const std::string& path, Hatching& hatching, int keyframeInterval);
+
+		// Call after Hatching::CreateHatchingLines
+		void WriteFrame(Hatching& hatching);
+		bool Close();
+
+		int GetNumFrames();
+		int64_t GetNumBytes();
+
+	private:
+
+		// Applies the events to the ids of the last frame, false if they do not lead to the current lines
+		bool CheckEvents(HatchingLayer& layer, const StrokeStreamLayer& previous);
+
+		std::ofstream m_File;
+		int m_KeyframeInterval;
+		int m_NumFrames;
+		int64_t m_NumBytes;
+
+		std::vector<StrokeStreamLayer> m_Layers;
+		StrokeStreamLayer m_Current;
+		std::unordered_map<int, int> m_Parents;
+		std::vector<int> m_ChangedLines;
+		std::vector<uint8_t> m_Buffer;
+	};
+
+	class StrokeStreamReader {
+	public:
+
+		StrokeStreamReader();
+
+		// Reads the header and the offsets of all frames
+		bool Open(const std::string& path);
+
+		int GetNumFrames();
+		glm::ivec2 GetViewportSize();
+		int GetNumLayers();
+
+		// Decodes the frame, going back to the last keyframe unless it follows the frame read before
+		bool ReadFrame(int frame);
+		// Lines of the last decoded frame in pixels, sorted by id
+		void GetLines(int layer, std::vector<std::vector<glm::vec2>>& outLines);
+
+	private:
+
+		bool DecodeFrame(int frame);
+
+		std::ifstream m_File;
+		std::string m_Path;
+		glm::ivec2 m_ViewportSize;
+
+		std::vector<int64_t> m_FrameOffsets;
+		std::vector<bool> m_IsKeyframe;
+		int m_CurrentFrame;
+
+		std::vector<StrokeStreamLayer> m_Layers;
+		StrokeStreamLayer m_Decoded;
+		std::vector<LineEvent> m_Events;
+		std::unordered_map<int, int> m_Parents;
+		std::vector<uint8_t> m_Buffer;
+	};
+}
\ No newline at end of file
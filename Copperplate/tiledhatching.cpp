@@ -0,0 +1,215 @@
+#pragma once
+
+#include "tiledhatching.h"
+
+#include <algorithm>
+
+namespace Copperplate {
+
+	TiledHatching::TiledHatching(glm::ivec2 imageSize, int tileSize, int guardBand)
+		: m_ImageSize(imageSize)
+		, m_TileSize(tileSize)
+		, m_GuardBand(guardBand)
+		, m_StrokeMemory(MC_Lines) {
+		m_NumTiles = (imageSize + glm::ivec2(tileSize - 1)) / tileSize;
+		m_NextStrokeId = 0;
+	}
+
+	int TiledHatching::GetNumTiles() {
+		return m_NumTiles.x * m_NumTiles.y;
+	}
+
+	glm::ivec2 TiledHatching::GetCoreOrigin(int tile) {
+		return glm::ivec2(tile % m_NumTiles.x, tile / m_NumTiles.x) * m_TileSize;
+	}
+
+	glm::ivec2 TiledHatching::GetCoreSize(int tile) {
+		return glm::min(glm::ivec2(m_TileSize), m_ImageSize - GetCoreOrigin(tile));
+	}
+
+	glm::ivec2 TiledHatching::GetWindowOrigin(int tile) {
+		return GetCoreOrigin(tile) - glm::ivec2(m_GuardBand);
+	}
+
+	glm::ivec2 TiledHatching::GetWindowSize() {
+		return glm::min(glm::ivec2(m_TileSize), m_ImageSize) + glm::ivec2(2 * m_GuardBand);
+	}
+
+	void TiledHatching::BeginTile(int tile, Hatching& hatching) {
+		hatching.ClearLines();
+
+		glm::vec2 windowOrigin = glm::vec2(GetWindowOrigin(tile));
+		glm::vec4 windowBounds = GetWindowBounds(tile);
+
+		// everything outside the image stays empty like the border of a single render, the finished cores keep their lines
+		const float outside = 1e9f;
+		std::vector<glm::vec4> blocked;
+		blocked.push_back(glm::vec4(-outside, -outside, 0.0f, outside));
+		blocked.push_back(glm::vec4(-outside, -outside, outside, 0.0f));
+		blocked.push_back(glm::vec4((float)m_ImageSize.x, -outside, outside, outside));
+		blocked.push_back(glm::vec4(-outside, (float)m_ImageSize.y, outside, outside));
+		for (int finished = 0; finished < tile; finished++) {
+			glm::vec2 coreMin = glm::vec2(GetCoreOrigin(finished));
+			glm::vec2 coreMax = coreMin + glm::vec2(GetCoreSize(finished));
+			if (coreMax.x > windowBounds.x && coreMin.x < windowBounds.z && coreMax.y > windowBounds.y && coreMin.y < windowBounds.w)
+				blocked.push_back(glm::vec4(coreMin, coreMax));
+		}
+		for (glm::vec4& region : blocked) {
+			region -= glm::vec4(windowOrigin, windowOrigin);
+		}
+		hatching.SetBlockedRegions(blocked);
+
+		// strokes are sorted by id so the import order and with it the hatching does not depend on the hash map
+		glm::ivec2 cellMin, cellMax;
+		GetCellRange(windowBounds, cellMin, cellMax);
+		std::vector<int> ids;
+		for (int y = cellMin.y; y <= cellMax.y; y++) {
+			for (int x = cellMin.x; x <= cellMax.x; x++) {
+				auto cell = m_Cells.find(y * m_NumTiles.x + x);
+				if (cell != m_Cells.end())
+					ids.insert(ids.end(), cell->second.begin(), cell->second.end());
+			}
+		}
+		std::sort(ids.begin(), ids.end());
+		ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+		const std::vector<Unique<HatchingLayer>>& layers = hatching.GetLayers();
+		for (int id : ids) {
+			const Stroke& stroke = m_Strokes[id];
+			if (stroke.m_Bounds.z < windowBounds.x || stroke.m_Bounds.x > windowBounds.z
+				|| stroke.m_Bounds.w < windowBounds.y || stroke.m_Bounds.y > windowBounds.w)
+				continue;
+			std::vector<glm::vec2> points;
+			points.reserve(stroke.m_Points.size());
+			for (glm::vec2 point : stroke.m_Points) {
+				points.push_back(point - windowOrigin);
+			}
+			layers[stroke.m_Layer]->AddPinnedLine(points, id);
+		}
+		UpdateMemoryCounters();
+	}
+
+	void TiledHatching::EndTile(int tile, Hatching& hatching) {
+		glm::vec2 windowOrigin = glm::vec2(GetWindowOrigin(tile));
+		glm::vec2 coreMin = glm::vec2(GetCoreOrigin(tile)) - windowOrigin;
+		glm::vec2 coreMax = coreMin + glm::vec2(GetCoreSize(tile));
+
+		const std::vector<Unique<HatchingLayer>>& layers = hatching.GetLayers();
+		for (int layer = 0; layer < layers.size(); layer++) {
+			for (const HatchingLine& line : layers[layer]->GetLines()) {
+				const std::deque<glm::vec2>& points = line.getPoints();
+				// lines that stay in the guard band are simulated again by the tile they belong to
+				bool touchesCore = line.IsPinned();
+				for (int i = 0; i < points.size() && !touchesCore; i++) {
+					touchesCore = points[i].x >= coreMin.x && points[i].x < coreMax.x && points[i].y >= coreMin.y && points[i].y < coreMax.y;
+				}
+				if (!touchesCore)
+					continue;
+
+				Stroke stroke;
+				stroke.m_Layer = layer;
+				stroke.m_Points.reserve(points.size());
+				glm::vec2 boundsMin = glm::vec2(1e9f);
+				glm::vec2 boundsMax = glm::vec2(-1e9f);
+				for (glm::vec2 point : points) {
+					glm::vec2 imagePoint = point + windowOrigin;
+					stroke.m_Points.push_back(imagePoint);
+					boundsMin = glm::min(boundsMin, imagePoint);
+					boundsMax = glm::max(boundsMax, imagePoint);
+				}
+				stroke.m_Bounds = glm::vec4(boundsMin, boundsMax);
+
+				// pinned lines may have grown into this tile
+				int id = line.IsPinned() ? line.GetStrokeId() : m_NextStrokeId++;
+				if (line.IsPinned())
+					RemoveStroke(id);
+				AddStroke(id, std::move(stroke));
+			}
+		}
+		hatching.ClearLines();
+
+		// the index only has to cover the band of rows that is still hatched, which keeps it bounded by the image width
+		std::vector<int> released;
+		for (const auto& [id, stroke] : m_Strokes) {
+			if (!CanReachLaterTiles(stroke.m_Bounds, tile))
+				released.push_back(id);
+		}
+		for (int id : released) {
+			RemoveStroke(id);
+		}
+		UpdateMemoryCounters();
+	}
+
+	int TiledHatching::GetNumStrokes() {
+		return m_Strokes.size();
+	}
+
+	// PRIVATE FUNCTIONS //
+
+	void TiledHatching::AddStroke(int id, Stroke&& stroke) {
+		glm::ivec2 cellMin, cellMax;
+		GetCellRange(stroke.m_Bounds, cellMin, cellMax);
+		for (int y = cellMin.y; y <= cellMax.y; y++) {
+			for (int x = cellMin.x; x <= cellMax.x; x++) {
+				m_Cells[y * m_NumTiles.x + x].push_back(id);
+			}
+		}
+		m_Strokes[id] = std::move(stroke);
+	}
+
+	void TiledHatching::RemoveStroke(int id) {
+		auto stroke = m_Strokes.find(id);
+		if (stroke == m_Strokes.end()) return;
+		glm::ivec2 cellMin, cellMax;
+		GetCellRange(stroke->second.m_Bounds, cellMin, cellMax);
+		for (int y = cellMin.y; y <= cellMax.y; y++) {
+			for (int x = cellMin.x; x <= cellMax.x; x++) {
+				auto cell = m_Cells.find(y * m_NumTiles.x + x);
+				if (cell == m_Cells.end()) continue;
+				std::vector<int>& ids = cell->second;
+				ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+				if (ids.empty())
+					m_Cells.erase(cell);
+			}
+		}
+		m_Strokes.erase(stroke);
+	}
+
+	void TiledHatching::GetCellRange(const glm::vec4& bounds, glm::ivec2& outMin, glm::ivec2& outMax) {
+		outMin = glm::clamp(glm::ivec2(glm::floor(glm::vec2(bounds.x, bounds.y) / (float)m_TileSize)), glm::ivec2(0), m_NumTiles - glm::ivec2(1));
+		outMax = glm::clamp(glm::ivec2(glm::floor(glm::vec2(bounds.z, bounds.w) / (float)m_TileSize)), glm::ivec2(0), m_NumTiles - glm::ivec2(1));
+	}
+
+	bool TiledHatching::CanReachLaterTiles(const glm::vec4& bounds, int tile) {
+		glm::ivec2 tilePos = glm::ivec2(tile % m_NumTiles.x, tile / m_NumTiles.x);
+		// the rest of the current row
+		if (tilePos.x + 1 < m_NumTiles.x) {
+			glm::vec4 window = GetWindowBounds(tile + 1);
+			if (bounds.z >= window.x && bounds.y <= window.w && bounds.w >= window.y)
+				return true;
+		}
+		// all rows above, their windows reach down into the current row by the guard band
+		if (tilePos.y + 1 < m_NumTiles.y) {
+			glm::vec4 window = GetWindowBounds((tilePos.y + 1) * m_NumTiles.x);
+			if (bounds.w >= window.y)
+				return true;
+		}
+		return false;
+	}
+
+	glm::vec4 TiledHatching::GetWindowBounds(int tile) {
+		glm::vec2 windowMin = glm::vec2(GetWindowOrigin(tile));
+		return glm::vec4(windowMin, windowMin + glm::vec2(GetWindowSize()));
+	}
+
+	void TiledHatching::UpdateMemoryCounters() {
+		int64_t bytes = estimateNodeBytes(m_Strokes) + estimateNodeBytes(m_Cells);
+		for (const auto& [id, stroke] : m_Strokes) {
+			bytes += estimateVectorBytes(stroke.m_Points);
+		}
+		for (const auto& [index, ids] : m_Cells) {
+			bytes += estimateVectorBytes(ids);
+		}
+		m_StrokeMemory.Set(bytes);
+	}
+}
\ No newline at end of file
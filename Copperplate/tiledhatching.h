@@ -0,0 +1,67 @@
+#pragma once
+
+#include "hatching.h"
+#include "statistics.h"
+
+#include <glm/ext/vector_float4.hpp>
+#include <glm/ext/vector_int2.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace Copperplate {
+
+	// Splits an image that is too large for one framebuffer into tiles and keeps the strokes continuous across
+	// their borders. Every tile is hatched in a window that extends its core by a guard band on all sides. Tiles are
+	// processed row by row from the bottom, so the finished cores are blocked for new lines and the strokes that were
+	// committed there are imported as pinned lines, which the new tile can extend but not move. Image coordinates
+	// start in the bottom left corner like the framebuffers.
+	class TiledHatching {
+	public:
+
+		TiledHatching(glm::ivec2 imageSize, int tileSize, int guardBand);
+
+		int GetNumTiles();
+		// Part of the image a tile writes, the tiles on the right and top border are smaller
+		glm::ivec2 GetCoreOrigin(int tile);
+		glm::ivec2 GetCoreSize(int tile);
+		// Part of the image a tile is rendered and hatched in, the same size for all tiles
+		glm::ivec2 GetWindowOrigin(int tile);
+		glm::ivec2 GetWindowSize();
+
+		// Clears the lines of the last tile, blocks the finished cores and imports the strokes in reach
+		void BeginTile(int tile, Hatching& hatching);
+		// Commits the lines that touch the core and releases strokes no later tile can reach
+		void EndTile(int tile, Hatching& hatching);
+
+		int GetNumStrokes();
+
+	private:
+
+		struct Stroke {
+			int m_Layer;
+			std::vector<glm::vec2> m_Points;	//image coordinates
+			glm::vec4 m_Bounds;					//min and max corner
+		};
+
+		void AddStroke(int id, Stroke&& stroke);
+		void RemoveStroke(int id);
+		// Cells of the index the bounds overlap, clamped to the image
+		void GetCellRange(const glm::vec4& bounds, glm::ivec2& outMin, glm::ivec2& outMax);
+		bool CanReachLaterTiles(const glm::vec4& bounds, int tile);
+		glm::vec4 GetWindowBounds(int tile);
+		void UpdateMemoryCounters();
+
+		glm::ivec2 m_ImageSize;
+		int m_TileSize;
+		int m_GuardBand;
+		glm::ivec2 m_NumTiles;
+
+		// Sparse index over the image with one cell per tile, only cells near unfinished tiles hold strokes
+		std::unordered_map<int, Stroke> m_Strokes;
+		std::unordered_map<int, std::vector<int>> m_Cells;
+		int m_NextStrokeId;
+
+		MemoryCounter m_StrokeMemory;
+	};
+}
\ No newline at end of file
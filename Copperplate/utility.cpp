@@ -4,17 +4,29 @@
 
 #include <random>
 #include <queue>
-#include <glm\detail\func_geometric.inl>
+#include <glm/detail/func_geometric.inl>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #define STBIW_WINDOWS_UTF8
 #include "stb_image_write.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <iomanip>
 #include <sstream>
 #include <iostream>
-#include <glad\glad.h>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#endif
 
 namespace Copperplate {
 
@@ -35,6 +47,18 @@ namespace Copperplate {
 		}
 	}
 
+	float HaltonSequence::Get(int base, int index) {
+		// radical inverse, the digits of the index mirrored at the decimal point
+		int numerator = 0;
+		int denominator = 1;
+		while (index > 0) {
+			numerator = numerator * base + index % base;
+			denominator *= base;
+			index /= base;
+		}
+		return (float)numerator / (float)denominator;
+	}
+
 	float HaltonSequence::NextNumber() {
 		//Algorithm taken from https://en.wikipedia.org/wiki/Halton_sequence
 		int x = m_Denominator - m_Numerator;
@@ -88,8 +112,10 @@ namespace Copperplate {
 		return polarToCartesian(glm::vec2(1.0f, newAngle));
 	}
 
+	// stb keeps the flip in a global, so it is set once at startup instead of by every encoder thread
+	const bool PngRowsBottomUp = (stbi_flip_vertically_on_write(1), true);
+
 	void writePngImage(const std::string& path, glm::ivec2 size, unsigned char* data, int channels) {
-		stbi_flip_vertically_on_write(1);
 		int stride = (int)ceil((float)(size.x * channels) / 4.0f) * 4;
 		int success = stbi_write_png(path.c_str(), size.x, size.y, channels, data, stride);
 		if (!success) {
@@ -97,27 +123,6 @@ namespace Copperplate {
 		}
 	}
 
-	unsigned int loadTextureFile(const std::string& path, int& widthOut, int& heightOut, int& nrChannelsOut) {
-		unsigned int texture;
-		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		unsigned char* imageData = stbi_load(path.c_str(), &widthOut, &heightOut, &nrChannelsOut, 0);
-		if (imageData) {
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, widthOut, heightOut, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
-			glGenerateMipmap(GL_TEXTURE_2D);
-		}
-		else {
-			std::cout << "Loading Texture " << path << "failed!" << std::endl;
-		}
-		stbi_image_free(imageData);
-		return texture;
-	}
-
 	std::string currTimeToString() {
 		auto t = std::time(nullptr);
 		auto time = *std::localtime(&t);
@@ -128,4 +133,75 @@ namespace Copperplate {
 		return stream.str();
 	}
 
+	size_t getResidentMemory() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+		return counters.WorkingSetSize;
+#elif defined(__linux__)
+		// statm holds the total and the resident size in pages, read without stdio to stay allocation free
+		int fd = open("/proc/self/statm", O_RDONLY);
+		if (fd < 0)
+			return 0;
+		char buffer[128];
+		ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+		close(fd);
+		if (length <= 0)
+			return 0;
+		buffer[length] = '\0';
+		char* residentStart = nullptr;
+		std::strtoull(buffer, &residentStart, 10);
+		size_t residentPages = std::strtoull(residentStart, nullptr, 10);
+		return residentPages * (size_t)sysconf(_SC_PAGESIZE);
+#else
+		return 0;
+#endif
+	}
+
+	// cores no thread works on, the main thread has one from the start
+	std::atomic<int> FreeCores(std::max(1, (int)std::thread::hardware_concurrency()) - 1);
+
+	int reserveCores(int wanted) {
+		int free = FreeCores.load();
+		int reserved;
+		do {
+			reserved = std::min(wanted, free);
+			if (reserved <= 0)
+				return 0;
+		} while (!FreeCores.compare_exchange_weak(free, free - reserved));
+		return reserved;
+	}
+
+	CoreReservation::CoreReservation() {
+		m_NumCores = reserveCores(1);
+	}
+
+	CoreReservation::~CoreReservation() {
+		FreeCores += m_NumCores;
+	}
+
+	void parallelFor(int count, const std::function<void(int begin, int end)>& function, int minPerThread) {
+		int numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+		numThreads = std::max(1, std::min(numThreads, count / std::max(1, minPerThread)));
+		// the calling thread already has a core, the others have to be free
+		int numExtraThreads = (numThreads > 1) ? reserveCores(numThreads - 1) : 0;
+		numThreads = numExtraThreads + 1;
+		if (numThreads == 1) {
+			if (count > 0) function(0, count);
+			return;
+		}
+		std::vector<std::thread> threads;
+		threads.reserve(numThreads - 1);
+		for (int i = 1; i < numThreads; i++) {
+			int begin = (int)((int64_t)count * i / numThreads);
+			int end = (int)((int64_t)count * (i + 1) / numThreads);
+			threads.emplace_back(std::cref(function), begin, end);
+		}
+		function(0, (int)((int64_t)count / numThreads));
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		FreeCores += numExtraThreads;
+	}
 }
\ No newline at end of file
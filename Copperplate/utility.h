@@ -1,6 +1,7 @@
 #pragma once
-#include <glm\ext\vector_float2.hpp>
-#include <glm\ext\vector_int2.hpp>
+#include <glm/ext/vector_float2.hpp>
+#include <glm/ext/vector_int2.hpp>
+#include <functional>
 #include <string>
 
 namespace Copperplate {
@@ -17,10 +18,30 @@ namespace Copperplate {
 
 	void writePngImage(const std::string& path, glm::ivec2 size, unsigned char* data, int channels);
 
-	unsigned int loadTextureFile(const std::string& path, int& widthOut, int& heightOut, int& nrChannelsOut);
-
 	std::string currTimeToString();
 
+	// Resident set size of the process in bytes, 0 where it cannot be queried. Does not allocate.
+	size_t getResidentMemory();
+
+	// Splits [0, count) into one contiguous range per core and calls function(begin, end) for each of them in
+	// parallel, the calling thread takes the first range. Ranges below minPerThread are not worth a thread.
+	// Only as many extra threads are started as cores are left over, so parallelFor calls from several threads at
+	// once, or nested ones, do not start more threads than there are cores.
+	void parallelFor(int count, const std::function<void(int begin, int end)>& function, int minPerThread = 4096);
+
+	// Holds a core for a thread that works outside of parallelFor, like a mesh loader, while it exists.
+	// parallelFor calls from other threads leave that core to it.
+	class CoreReservation {
+	public:
+
+		CoreReservation();
+		~CoreReservation();
+
+	private:
+
+		int m_NumCores;
+	};
+
 	class HaltonSequence {
 	public:
 
@@ -29,6 +50,8 @@ namespace Copperplate {
 		void Skip(int amount);
 
 		float NextNumber();
+		// Element of the sequence counting from 1 like NextNumber, so a sequence can be split between threads
+		static float Get(int base, int index);
 
 	private:
 
@@ -0,0 +1,331 @@
+#pragma once
+
+#include "vectorwriter.h"
+#include "statistics.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+namespace Copperplate {
+
+	EVectorFormats getVectorFormat(const std::string& path) {
+		size_t dot = path.find_last_of('.');
+		std::string extension = (dot == std::string::npos) ? "" : path.substr(dot);
+		if (extension == ".pdf") return VF_Pdf;
+		if (extension == ".eps" || extension == ".ps") return VF_Eps;
+		return VF_Svg;
+	}
+
+	VectorWriter::VectorWriter() {
+		m_Format = VF_Svg;
+		m_Size = glm::ivec2(0, 0);
+		m_SimplifyTolerance = 0.0f;
+		m_NumFrames = 0;
+		m_StreamStart = 0;
+		m_ContentId = 0;
+	}
+
+	VectorWriter::~VectorWriter() {
+		Close();
+	}
+
+	bool VectorWriter::Open(const std::string& path, glm::ivec2 size, float simplifyTolerance) {
+		m_Path = path;
+		m_Format = getVectorFormat(path);
+		m_Size = size;
+		m_SimplifyTolerance = simplifyTolerance;
+		m_NumFrames = 0;
+		if (m_Format != VF_Pdf)
+			return true;
+
+		m_File.open(path, std::ios::binary);
+		if (!m_File.is_open()) {
+			std::cout << "Could not open " << path << std::endl;
+			return false;
+		}
+		// object 1 is the catalog, 2 the page tree that can only be written once all pages are known
+		m_File << "%PDF-1.4\n";
+		m_ObjectOffsets = std::vector<int64_t>(3, 0);
+		WriteObjectStart(1);
+		m_File << "<< /Type /Catalog /Pages 2 0 R >>\nendobj\n";
+		return m_File.good();
+	}
+
+	void VectorWriter::AddContours(const std::vector<glm::vec2>& contourSegments) {
+		m_Contours.insert(m_Contours.end(), contourSegments.begin(), contourSegments.end());
+	}
+
+	void VectorWriter::WriteFrame(Hatching& hatching) {
+		TIME_FUNCTION(T_SaveFrame);
+		if (!BeginPage()) {
+			m_Contours.clear();
+			return;
+		}
+
+		BeginGroup("contours");
+		WriteContours();
+		EndGroup();
+
+		const std::vector<Unique<HatchingLayer>>& layers = hatching.GetLayers();
+		for (int layer = 0; layer < layers.size(); layer++) {
+			const HatchingSettings& settings = layers[layer]->m_Settings;
+			std::string name = "layer" + std::to_string(layer);
+			BeginGroup(name.c_str());
+			for (const HatchingLine& line : layers[layer]->GetLines()) {
+				const std::deque<glm::vec2>& points = line.getPoints();
+				float runWidth = -1.0f;
+				for (int i = 0; i + 1 < points.size(); i++) {
+					float shade1 = hatching.SampleShade(points[i]);
+					float shade2 = hatching.SampleShade(points[i + 1]);
+					// hatching.geom skips segments in light areas and offsets by half the width in texels of clip
+					// space, which are half a pixel, so the ribbon it draws is half the width wide
+					float width = 0.0f;
+					if (shade1 > settings.m_MinShade || shade2 > settings.m_MinShade) {
+						float shade = 0.5f * (shade1 + shade2);
+						float s = glm::clamp((shade - settings.m_MinShade) / (settings.m_MaxShade - settings.m_MinShade), 0.0f, 1.0f);
+						width = 0.5f * (settings.m_MinLineWidth + s * (settings.m_MaxLineWidth - settings.m_MinLineWidth));
+						width = std::max(VECTOR_WIDTH_STEP, std::round(width / VECTOR_WIDTH_STEP) * VECTOR_WIDTH_STEP);
+					}
+					if (width != runWidth) {
+						WritePolyline(m_Polyline, runWidth);
+						runWidth = width;
+						if (width > 0.0f)
+							m_Polyline.push_back(points[i]);
+					}
+					if (width > 0.0f)
+						m_Polyline.push_back(points[i + 1]);
+				}
+				WritePolyline(m_Polyline, runWidth);
+			}
+			EndGroup();
+		}
+
+		EndPage();
+		m_NumFrames++;
+	}
+
+	bool VectorWriter::Close() {
+		if (m_Format != VF_Pdf || !m_File.is_open())
+			return true;
+
+		m_ObjectOffsets[2] = m_File.tellp();
+		m_File << "2 0 obj\n<< /Type /Pages /Kids [";
+		for (int id : m_PageIds) {
+			m_File << " " << id << " 0 R";
+		}
+		m_File << " ] /Count " << m_PageIds.size() << " >>\nendobj\n";
+
+		// every cross reference entry has exactly 20 bytes
+		int64_t xrefOffset = m_File.tellp();
+		m_File << "xref\n0 " << m_ObjectOffsets.size() << "\n0000000000 65535 f \n";
+		char entry[32];
+		for (int id = 1; id < m_ObjectOffsets.size(); id++) {
+			std::snprintf(entry, sizeof(entry), "%010lld 00000 n \n", (long long)m_ObjectOffsets[id]);
+			m_File << entry;
+		}
+		m_File << "trailer\n<< /Size " << m_ObjectOffsets.size() << " /Root 1 0 R >>\nstartxref\n" << xrefOffset << "\n%%EOF\n";
+		m_File.close();
+		return !m_File.fail();
+	}
+
+	int VectorWriter::GetNumFrames() {
+		return m_NumFrames;
+	}
+
+	// PRIVATE FUNCTIONS //
+
+	bool VectorWriter::BeginPage() {
+		if (m_Format == VF_Pdf) {
+			if (!m_File.is_open()) return false;
+			m_ContentId = m_ObjectOffsets.size();
+			m_ObjectOffsets.resize(m_ContentId + 3, 0);
+			// the length is written as its own object after the stream, so nothing has to be buffered
+			WriteObjectStart(m_ContentId);
+			m_File << "<< /Length " << m_ContentId + 1 << " 0 R >>\nstream\n";
+			m_StreamStart = m_File.tellp();
+			m_File << "1 J 1 j 0 G\n";
+			return true;
+		}
+
+		// single page formats get the frame number in front of the extension
+		char number[16];
+		std::snprintf(number, sizeof(number), "_%05d", m_NumFrames);
+		size_t dot = m_Path.find_last_of('.');
+		std::string path = (dot == std::string::npos) ? m_Path + number : m_Path.substr(0, dot) + number + m_Path.substr(dot);
+		m_File.open(path, std::ios::binary);
+		if (!m_File.is_open()) {
+			std::cout << "Could not open " << path << std::endl;
+			return false;
+		}
+		if (m_Format == VF_Svg) {
+			m_File << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+				<< "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << m_Size.x << "\" height=\"" << m_Size.y
+				<< "\" viewBox=\"0 0 " << m_Size.x << " " << m_Size.y << "\">\n"
+				<< "<g fill=\"none\" stroke=\"black\" stroke-linecap=\"round\" stroke-linejoin=\"round\">\n";
+		}
+		else {
+			m_File << "%!PS-Adobe-3.0 EPSF-3.0\n%%BoundingBox: 0 0 " << m_Size.x << " " << m_Size.y << "\n"
+				<< "%%Creator: Copperplate\n%%EndComments\n"
+				<< "/m {moveto} bind def /l {lineto} bind def /w {setlinewidth} bind def /s {stroke} bind def\n"
+				<< "1 setlinecap 1 setlinejoin 0 setgray\n";
+		}
+		return true;
+	}
+
+	void VectorWriter::EndPage() {
+		if (m_Format == VF_Pdf) {
+			int64_t length = (int64_t)m_File.tellp() - m_StreamStart;
+			m_File << "endstream\nendobj\n";
+			WriteObjectStart(m_ContentId + 1);
+			m_File << length << "\nendobj\n";
+			WriteObjectStart(m_ContentId + 2);
+			m_File << "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 " << m_Size.x << " " << m_Size.y << "] /Contents " << m_ContentId << " 0 R >>\nendobj\n";
+			m_PageIds.push_back(m_ContentId + 2);
+			return;
+		}
+		if (m_Format == VF_Svg)
+			m_File << "</g>\n</svg>\n";
+		else
+			m_File << "showpage\n%%EOF\n";
+		m_File.close();
+	}
+
+	void VectorWriter::WriteContours() {
+		// the extraction emits the segments per triangle in no particular order, they are chained at shared end points
+		glm::vec2 viewportSize = glm::vec2(m_Size);
+		int numSegments = m_Contours.size() / 2;
+		for (glm::vec2& point : m_Contours) {
+			point *= viewportSize;
+		}
+		auto getKey = [](glm::vec2 point) {
+			return ((int64_t)std::round(point.x * 64.0f) << 32) ^ (int64_t)(uint32_t)std::round(point.y * 64.0f);
+		};
+		m_ContourEnds.clear();
+		for (int i = 0; i < numSegments * 2; i++) {
+			m_ContourEnds.insert({ getKey(m_Contours[i]), i });
+		}
+		std::vector<bool> used(numSegments, false);
+		std::vector<glm::vec2> front;
+
+		// follows unused segments from an end point and returns the points it passed
+		auto follow = [&](glm::vec2 point, std::vector<glm::vec2>& outPoints) {
+			while (true) {
+				int next = -1;
+				auto range = m_ContourEnds.equal_range(getKey(point));
+				for (auto it = range.first; it != range.second; it++) {
+					if (!used[it->second / 2]) {
+						next = it->second;
+						break;
+					}
+				}
+				if (next < 0) return;
+				used[next / 2] = true;
+				point = m_Contours[next ^ 1];
+				outPoints.push_back(point);
+			}
+		};
+
+		for (int segment = 0; segment < numSegments; segment++) {
+			if (used[segment]) continue;
+			used[segment] = true;
+			front.clear();
+			follow(m_Contours[2 * segment], front);
+			m_Polyline.assign(front.rbegin(), front.rend());
+			m_Polyline.push_back(m_Contours[2 * segment]);
+			m_Polyline.push_back(m_Contours[2 * segment + 1]);
+			follow(m_Contours[2 * segment + 1], m_Polyline);
+			WritePolyline(m_Polyline, VECTOR_CONTOUR_WIDTH);
+		}
+		m_Contours.clear();
+	}
+
+	void VectorWriter::BeginGroup(const char* name) {
+		// plotters map the groups to pens
+		if (m_Format == VF_Svg)
+			m_File << "<g id=\"" << name << "\">\n";
+		else if (m_Format == VF_Eps)
+			m_File << "%" << name << "\n";
+	}
+
+	void VectorWriter::EndGroup() {
+		if (m_Format == VF_Svg)
+			m_File << "</g>\n";
+	}
+
+	void VectorWriter::WritePolyline(std::vector<glm::vec2>& points, float width) {
+		if (points.size() < 2 || width <= 0.0f) {
+			points.clear();
+			return;
+		}
+		if (m_SimplifyTolerance > 0.0f)
+			simplifyPolyline(points, m_SimplifyTolerance);
+
+		char buffer[64];
+		if (m_Format == VF_Svg) {
+			std::snprintf(buffer, sizeof(buffer), "<polyline stroke-width=\"%.2f\" points=\"", width);
+			m_File << buffer;
+			for (int i = 0; i < points.size(); i++) {
+				// svg counts rows from the top
+				std::snprintf(buffer, sizeof(buffer), i == 0 ? "%.2f,%.2f" : " %.2f,%.2f", points[i].x, m_Size.y - points[i].y);
+				m_File << buffer;
+			}
+			m_File << "\"/>\n";
+		}
+		else {
+			bool isPdf = m_Format == VF_Pdf;
+			std::snprintf(buffer, sizeof(buffer), "%.2f w\n", width);
+			m_File << buffer;
+			for (int i = 0; i < points.size(); i++) {
+				std::snprintf(buffer, sizeof(buffer), "%.2f %.2f %s\n", points[i].x, points[i].y, i == 0 ? "m" : "l");
+				m_File << buffer;
+			}
+			m_File << (isPdf ? "S\n" : "s\n");
+		}
+		points.clear();
+	}
+
+	void VectorWriter::WriteObjectStart(int id) {
+		m_ObjectOffsets[id] = m_File.tellp();
+		m_File << id << " 0 obj\n";
+	}
+
+	void simplifyPolyline(std::vector<glm::vec2>& points, float tolerance) {
+		if (points.size() < 3) return;
+		std::vector<bool> keep(points.size(), false);
+		keep.front() = true;
+		keep.back() = true;
+		std::vector<std::pair<int, int>> ranges;
+		ranges.push_back({ 0, (int)points.size() - 1 });
+		while (!ranges.empty()) {
+			auto [first, last] = ranges.back();
+			ranges.pop_back();
+			glm::vec2 dir = points[last] - points[first];
+			float length = glm::length(dir);
+			float maxDist = 0.0f;
+			int farthest = -1;
+			for (int i = first + 1; i < last; i++) {
+				glm::vec2 offset = points[i] - points[first];
+				float dist = (length > 1e-6f) ? std::abs(offset.x * dir.y - offset.y * dir.x) / length : glm::length(offset);
+				if (dist > maxDist) {
+					maxDist = dist;
+					farthest = i;
+				}
+			}
+			if (farthest >= 0 && maxDist > tolerance) {
+				keep[farthest] = true;
+				ranges.push_back({ first, farthest });
+				ranges.push_back({ farthest, last });
+			}
+		}
+		int count = 0;
+		for (int i = 0; i < points.size(); i++) {
+			if (keep[i])
+				points[count++] = points[i];
+		}
+		points.resize(count);
+	}
+}
\ No newline at end of file
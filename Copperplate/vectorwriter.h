@@ -0,0 +1,78 @@
+#pragma once
+
+#include "hatching.h"
+
+#include <glm/ext/vector_int2.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Copperplate {
+
+	const float VECTOR_WIDTH_STEP = 0.25f;		//px, a stroke is split where its quantized width changes
+	const float VECTOR_CONTOUR_WIDTH = 2.0f;	//px, the line width the contours are drawn with
+
+	enum EVectorFormats {
+		VF_Svg,		//one file per frame
+		VF_Eps,		//one file per frame
+		VF_Pdf,		//one page per frame
+	};
+
+	// Picks the format from the extension, anything unknown is SVG
+	EVectorFormats getVectorFormat(const std::string& path);
+
+	// Writes the hatching lines and contours of every frame as polylines, one unit is one pixel. The shade dependent
+	// width of hatching.geom becomes a sequence of polylines with constant width. Everything is written while the lines
+	// are visited, only the offsets of the PDF objects are kept until the file is closed.
+	class VectorWriter {
+	public:
+
+		VectorWriter();
+		~VectorWriter();
+
+		// A tolerance above 0 drops points that are closer than it to the simplified polyline
+		bool Open(const std::string& path, glm::ivec2 size, float simplifyTolerance);
+
+		// Segments in view coordinates like the contour extraction writes them
+		void AddContours(const std::vector<glm::vec2>& contourSegments);
+		// Call after Hatching::CreateHatchingLines, the shading field has to be read back
+		void WriteFrame(Hatching& hatching);
+		bool Close();
+
+		int GetNumFrames();
+
+	private:
+
+		bool BeginPage();
+		void EndPage();
+		void WriteContours();
+		void BeginGroup(const char* name);
+		void EndGroup();
+		// Simplifies the polyline in place and writes it
+		void WritePolyline(std::vector<glm::vec2>& points, float width);
+		void WriteObjectStart(int id);
+
+		std::string m_Path;
+		EVectorFormats m_Format;
+		glm::ivec2 m_Size;
+		float m_SimplifyTolerance;
+		std::ofstream m_File;
+		int m_NumFrames;
+
+		// PDF only
+		std::vector<int64_t> m_ObjectOffsets;	//indexed by object id, 0 is unused
+		std::vector<int> m_PageIds;
+		int64_t m_StreamStart;
+		int m_ContentId;
+
+		std::vector<glm::vec2> m_Contours;
+		std::unordered_multimap<int64_t, int> m_ContourEnds;	//quantized end point to index into the contours
+		std::vector<glm::vec2> m_Polyline;
+	};
+
+	// Ramer-Douglas-Peucker, keeps both ends
+	void simplifyPolyline(std::vector<glm::vec2>& points, float tolerance);
+}
\ No newline at end of file